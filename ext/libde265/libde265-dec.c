@@ -39,6 +39,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <gst/video/gstvideometa.h>
+#include <gst/video/gstvideopool.h>
+
 #include "libde265-dec.h"
 
 /* use two decoder threads if no information about
@@ -85,6 +88,8 @@ static gboolean gst_libde265_dec_set_format (GstVideoDecoder * decoder,
     GstVideoCodecState * state);
 static gboolean gst_libde265_dec_flush (GstVideoDecoder * decoder);
 static GstFlowReturn gst_libde265_dec_finish (GstVideoDecoder * decoder);
+static gboolean gst_libde265_dec_decide_allocation (GstVideoDecoder * decoder,
+    GstQuery * query);
 static GstFlowReturn _gst_libde265_return_image (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame, const struct de265_image *img);
 static GstFlowReturn gst_libde265_dec_handle_frame (GstVideoDecoder * decoder,
@@ -116,6 +121,8 @@ gst_libde265_dec_class_init (GstLibde265DecClass * klass)
   decoder_class->finish = GST_DEBUG_FUNCPTR (gst_libde265_dec_finish);
   decoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_libde265_dec_handle_frame);
+  decoder_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_libde265_dec_decide_allocation);
 
   gst_element_class_add_static_pad_template (gstelement_class, &sink_template);
   gst_element_class_add_static_pad_template (gstelement_class, &src_template);
@@ -136,6 +143,11 @@ _gst_libde265_dec_reset_decoder (GstLibde265Dec * dec)
   dec->codec_data_size = 0;
   dec->input_state = NULL;
   dec->output_state = NULL;
+  dec->padding_right = 0;
+  dec->padding_bottom = 0;
+  dec->alignment = 16;
+  dec->renegotiate = FALSE;
+  dec->aligned_pool = FALSE;
 }
 
 static void
@@ -246,6 +258,7 @@ gst_libde265_dec_get_buffer (de265_decoder_context * ctx,
   struct GstLibde265FrameRef *ref;
   GstVideoInfo *info;
   int frame_number;
+  int padding_right, padding_bottom;
 
   frame_number = (uintptr_t) de265_get_image_user_data (img) - 1;
   if (G_UNLIKELY (frame_number == -1)) {
@@ -264,17 +277,36 @@ gst_libde265_dec_get_buffer (de265_decoder_context * ctx,
   if (width % spec->alignment) {
     width += spec->alignment - (width % spec->alignment);
   }
-  if (width != spec->visible_width || height != spec->visible_height) {
-    /* clipping not supported for now */
+  if (spec->crop_left != 0 || spec->crop_top != 0) {
+    /* would need a crop meta, not supported for now */
     goto fallback;
   }
 
-  ret = _gst_libde265_image_available (base, width, height);
+  /* the output frames are the visible part of the decoded pictures, the
+   * rest is padding that is negotiated in decide_allocation() */
+  padding_right = width - spec->visible_width;
+  padding_bottom = height - spec->visible_height;
+  if (padding_right != dec->padding_right ||
+      padding_bottom != dec->padding_bottom ||
+      spec->alignment != dec->alignment) {
+    dec->padding_right = padding_right;
+    dec->padding_bottom = padding_bottom;
+    dec->alignment = spec->alignment;
+    dec->renegotiate = TRUE;
+  }
+
+  ret = _gst_libde265_image_available (base, spec->visible_width,
+      spec->visible_height);
   if (G_UNLIKELY (ret != GST_FLOW_OK)) {
     GST_ERROR_OBJECT (dec, "Failed to notify about available image");
     goto fallback;
   }
 
+  if ((padding_right != 0 || padding_bottom != 0) && !dec->aligned_pool) {
+    GST_LOG_OBJECT (dec, "Downstream can't handle padded frames");
+    goto fallback;
+  }
+
   ret =
       gst_video_decoder_allocate_output_frame (GST_VIDEO_DECODER (dec), frame);
   if (G_UNLIKELY (ret != GST_FLOW_OK)) {
@@ -305,9 +337,9 @@ gst_libde265_dec_get_buffer (de265_decoder_context * ctx,
     goto error;
   }
 
-  if (GST_VIDEO_FRAME_COMP_HEIGHT (&ref->vframe, 0) < height) {
+  if (GST_VIDEO_FRAME_COMP_HEIGHT (&ref->vframe, 0) + padding_bottom < height) {
     GST_DEBUG_OBJECT (dec, "plane 0: lines too few (%d/%d)",
-        GST_VIDEO_FRAME_COMP_HEIGHT (&ref->vframe, 0), height);
+        GST_VIDEO_FRAME_COMP_HEIGHT (&ref->vframe, 0) + padding_bottom, height);
     goto error;
   }
 
@@ -525,12 +557,127 @@ _gst_libde265_image_available (GstVideoDecoder * decoder, int width, int height)
       gst_video_codec_state_unref (dec->output_state);
     }
     dec->output_state = state;
+    dec->renegotiate = FALSE;
     GST_DEBUG_OBJECT (dec, "Frame dimensions are %d x %d", width, height);
+  } else if (G_UNLIKELY (dec->renegotiate)) {
+    /* only the padding changed, reconfigure the buffer pool */
+    dec->renegotiate = FALSE;
+    if (!gst_video_decoder_negotiate (decoder)) {
+      GST_ERROR_OBJECT (dec, "Failed to negotiate format");
+      return GST_FLOW_ERROR;
+    }
   }
 
   return GST_FLOW_OK;
 }
 
+static gboolean
+gst_libde265_dec_set_pool_config (GstLibde265Dec * dec, GstBufferPool * pool,
+    GstCaps * caps, guint size, guint min, guint max, GstAllocator * allocator,
+    GstAllocationParams * params)
+{
+  GstStructure *config;
+  GstVideoAlignment align;
+  gint i;
+
+  gst_video_alignment_reset (&align);
+  align.padding_right = dec->padding_right;
+  align.padding_bottom = dec->padding_bottom;
+  for (i = 0; i < GST_VIDEO_MAX_PLANES; i++)
+    align.stride_align[i] = dec->alignment - 1;
+
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, size, min, max);
+  gst_buffer_pool_config_set_allocator (config, allocator, params);
+  gst_buffer_pool_config_add_option (config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+  gst_buffer_pool_config_set_video_alignment (config, &align);
+
+  return gst_buffer_pool_set_config (pool, config);
+}
+
+static gboolean
+gst_libde265_dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
+{
+  GstLibde265Dec *dec = GST_LIBDE265_DEC (decoder);
+  GstVideoCodecState *state;
+  GstBufferPool *proposed, *pool = NULL;
+  GstAllocator *allocator = NULL;
+  GstAllocationParams params;
+  guint size, min, max;
+
+  if (!GST_VIDEO_DECODER_CLASS (parent_class)->decide_allocation (decoder,
+          query))
+    return FALSE;
+
+  dec->aligned_pool = FALSE;
+
+  /* frames that are padded for libde265 can only be pushed downstream if it
+   * understands the strides and offsets in the video meta */
+  if (!gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL)) {
+    GST_DEBUG_OBJECT (dec, "No video meta support, padded frames are copied");
+    return TRUE;
+  }
+
+  state = gst_video_decoder_get_output_state (decoder);
+  if (state == NULL)
+    return TRUE;
+
+  gst_query_parse_nth_allocation_pool (query, 0, &proposed, &size, &min,
+      &max);
+
+  if (gst_query_get_n_allocation_params (query) > 0) {
+    gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+  } else {
+    gst_allocation_params_init (&params);
+  }
+  params.align = MAX (params.align, (gsize) dec->alignment - 1);
+
+  /* prefer the proposed pool if it can pad frames */
+  if (proposed && gst_buffer_pool_has_option (proposed,
+          GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT)) {
+    GstStructure *config = gst_buffer_pool_get_config (proposed);
+
+    if (gst_libde265_dec_set_pool_config (dec, proposed, state->caps, size,
+            min, max, allocator, &params)) {
+      gst_structure_free (config);
+      pool = gst_object_ref (proposed);
+    } else {
+      /* a failed configuration may have been partially applied */
+      gst_buffer_pool_set_config (proposed, config);
+    }
+  }
+
+  if (pool == NULL) {
+    pool = gst_video_buffer_pool_new ();
+    if (!gst_libde265_dec_set_pool_config (dec, pool, state->caps, size, min,
+            max, allocator, &params)) {
+      gst_object_unref (pool);
+      pool = NULL;
+    }
+  }
+
+  if (pool) {
+    GST_DEBUG_OBJECT (dec, "Configured pool for direct rendering with "
+        "padding %dx%d", dec->padding_right, dec->padding_bottom);
+    dec->aligned_pool = TRUE;
+    gst_query_set_nth_allocation_pool (query, 0, pool, size, min, max);
+    gst_object_unref (pool);
+  } else {
+    GST_DEBUG_OBJECT (dec, "Failed to configure a pool with padding %dx%d, "
+        "padded frames are copied", dec->padding_right, dec->padding_bottom);
+  }
+
+  if (proposed)
+    gst_object_unref (proposed);
+  if (allocator)
+    gst_object_unref (allocator);
+  gst_video_codec_state_unref (state);
+
+  return TRUE;
+}
+
 static gboolean
 gst_libde265_dec_set_format (GstVideoDecoder * decoder,
     GstVideoCodecState * state)
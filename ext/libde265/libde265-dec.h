@@ -55,6 +55,13 @@ typedef struct _GstLibde265Dec
   int codec_data_size;
   GstVideoCodecState *input_state;
   GstVideoCodecState *output_state;
+
+  /* direct rendering into downstream buffers */
+  int padding_right;
+  int padding_bottom;
+  int alignment;
+  gboolean renegotiate;
+  gboolean aligned_pool;
 } GstLibde265Dec;
 
 typedef struct _GstLibde265DecClass
@@ -155,6 +155,7 @@ gst_openh264dec_stop (GstVideoDecoder * decoder)
     openh264dec->input_state = NULL;
   }
   openh264dec->width = openh264dec->height = 0;
+  openh264dec->stride[0] = openh264dec->stride[1] = 0;
 
   return TRUE;
 }
@@ -202,6 +203,7 @@ gst_openh264dec_handle_frame (GstVideoDecoder * decoder,
   guint i;
   guint8 *p;
   guint row_stride, component_width, component_height, src_width, row;
+  gint stride[2];
 
   if (frame) {
     if (!gst_buffer_map (frame->input_buffer, &map_info, GST_MAP_READ)) {
@@ -263,15 +265,22 @@ gst_openh264dec_handle_frame (GstVideoDecoder * decoder,
 
   actual_width = dst_buf_info.UsrData.sSystemBuffer.iWidth;
   actual_height = dst_buf_info.UsrData.sSystemBuffer.iHeight;
+  stride[0] = dst_buf_info.UsrData.sSystemBuffer.iStride[0];
+  stride[1] = dst_buf_info.UsrData.sSystemBuffer.iStride[1];
 
+  /* the strides are renegotiated too, see decide_allocation() */
   if (!gst_pad_has_current_caps (GST_VIDEO_DECODER_SRC_PAD (openh264dec))
       || actual_width != openh264dec->width
-      || actual_height != openh264dec->height) {
+      || actual_height != openh264dec->height
+      || stride[0] != openh264dec->stride[0]
+      || stride[1] != openh264dec->stride[1]) {
     state =
         gst_video_decoder_set_output_state (decoder, GST_VIDEO_FORMAT_I420,
         actual_width, actual_height, openh264dec->input_state);
     openh264dec->width = actual_width;
     openh264dec->height = actual_height;
+    openh264dec->stride[0] = stride[0];
+    openh264dec->stride[1] = stride[1];
 
     if (!gst_video_decoder_negotiate (decoder)) {
       GST_ERROR_OBJECT (openh264dec,
@@ -304,10 +313,17 @@ gst_openh264dec_handle_frame (GstVideoDecoder * decoder,
     row_stride = GST_VIDEO_FRAME_COMP_STRIDE (&video_frame, i);
     component_width = GST_VIDEO_FRAME_COMP_WIDTH (&video_frame, i);
     component_height = GST_VIDEO_FRAME_COMP_HEIGHT (&video_frame, i);
-    src_width =
-        i <
-        1 ? dst_buf_info.UsrData.sSystemBuffer.
-        iStride[0] : dst_buf_info.UsrData.sSystemBuffer.iStride[1];
+    src_width = i < 1 ? stride[0] : stride[1];
+
+    /* openh264 reuses its pictures for the following frames without telling
+     * us, so they can't be pushed downstream directly. If the output frame
+     * has the same stride, the plane is copied in one go at least. */
+    if (src_width == row_stride) {
+      memcpy (p, yuvdata[i],
+          row_stride * (component_height - 1) + component_width);
+      continue;
+    }
+
     for (row = 0; row < component_height; row++) {
       memcpy (p, yuvdata[i], component_width);
       p += row_stride;
@@ -340,6 +356,7 @@ gst_openh264dec_finish (GstVideoDecoder * decoder)
 static gboolean
 gst_openh264dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
 {
+  GstOpenh264Dec *openh264dec = GST_OPENH264DEC (decoder);
   GstVideoCodecState *state;
   GstBufferPool *pool;
   guint size, min, max;
@@ -357,6 +374,24 @@ gst_openh264dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
   if (gst_query_find_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL)) {
     gst_buffer_pool_config_add_option (config,
         GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+    /* pad the output frames to the strides of the decoded pictures so that
+     * every plane can be copied with a single memcpy */
+    if (openh264dec->stride[0] > GST_VIDEO_INFO_WIDTH (&state->info)
+        && gst_buffer_pool_has_option (pool,
+            GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT)) {
+      GstVideoAlignment align;
+
+      gst_video_alignment_reset (&align);
+      align.padding_right =
+          openh264dec->stride[0] - GST_VIDEO_INFO_WIDTH (&state->info);
+      gst_buffer_pool_config_add_option (config,
+          GST_BUFFER_POOL_OPTION_VIDEO_ALIGNMENT);
+      gst_buffer_pool_config_set_video_alignment (config, &align);
+
+      GST_DEBUG_OBJECT (openh264dec, "padding output frames by %u pixels",
+          align.padding_right);
+    }
   }
 
   gst_buffer_pool_set_config (pool, config);
@@ -56,6 +56,8 @@ struct _GstOpenh264Dec
   ISVCDecoder *decoder;
   GstVideoCodecState *input_state;
   guint width, height;
+  /* luma and chroma strides of the decoded pictures */
+  gint stride[2];
 };
 
 struct _GstOpenh264DecClass
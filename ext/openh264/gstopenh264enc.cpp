@@ -740,6 +740,8 @@ gst_openh264enc_set_format (GstVideoEncoder * encoder,
 
   openh264enc->encoder->SetOption (ENCODER_OPTION_DATAFORMAT, &video_format);
 
+  memset (&openh264enc->src_pic, 0, sizeof (SSourcePicture));
+
   outcaps =
       gst_caps_copy (gst_static_pad_template_get_caps
       (&gst_openh264enc_src_template));
@@ -774,16 +776,12 @@ gst_openh264enc_handle_frame (GstVideoEncoder * encoder,
   GstMapInfo map;
   gint i, j;
   gsize buf_length = 0;
+  const guint8 *layer_data = NULL;
+  gsize layer_size = 0;
 
   if (frame) {
-    src_pic = new SSourcePicture;
-
-    if (src_pic == NULL) {
-      if (frame)
-        gst_video_codec_frame_unref (frame);
-      return GST_FLOW_ERROR;
-    }
-    //fill default src_pic
+    /* the picture descriptor is reused, only the planes change */
+    src_pic = &openh264enc->src_pic;
     src_pic->iColorFormat = videoFormatI420;
     src_pic->uiTimeStamp = frame->pts / GST_MSECOND;
   }
@@ -831,7 +829,6 @@ gst_openh264enc_handle_frame (GstVideoEncoder * encoder,
     if (frame) {
       gst_video_frame_unmap (&video_frame);
       gst_video_codec_frame_unref (frame);
-      delete src_pic;
       GST_ELEMENT_ERROR (openh264enc, STREAM, ENCODE,
           ("Could not encode frame"), ("Openh264 returned %d", ret));
       return GST_FLOW_ERROR;
@@ -844,7 +841,6 @@ gst_openh264enc_handle_frame (GstVideoEncoder * encoder,
     if (frame) {
       gst_video_frame_unmap (&video_frame);
       gst_video_encoder_finish_frame (encoder, frame);
-      delete src_pic;
     }
 
     return GST_FLOW_OK;
@@ -853,7 +849,6 @@ gst_openh264enc_handle_frame (GstVideoEncoder * encoder,
   if (frame) {
     gst_video_frame_unmap (&video_frame);
     gst_video_codec_frame_unref (frame);
-    delete src_pic;
     src_pic = NULL;
     frame = NULL;
   }
@@ -885,15 +880,30 @@ gst_openh264enc_handle_frame (GstVideoEncoder * encoder,
       gst_video_encoder_allocate_output_buffer (encoder, buf_length);
   gst_buffer_map (frame->output_buffer, &map, GST_MAP_WRITE);
 
+  /* openh264 writes the layers back to back into its bitstream buffer, so
+   * they can usually be copied at once */
   buf_length = 0;
   for (i = 0; i < frame_info.iLayerNum; i++) {
-    gsize layer_size = 0;
+    gsize size = 0;
     for (j = 0; j < frame_info.sLayerInfo[i].iNalCount; j++) {
-      layer_size += frame_info.sLayerInfo[i].pNalLengthInByte[j];
+      size += frame_info.sLayerInfo[i].pNalLengthInByte[j];
+    }
+
+    if (layer_data &&
+        layer_data + layer_size == frame_info.sLayerInfo[i].pBsBuf) {
+      layer_size += size;
+      continue;
+    }
+
+    if (layer_size > 0) {
+      memcpy (map.data + buf_length, layer_data, layer_size);
+      buf_length += layer_size;
     }
-    memcpy (map.data + buf_length, frame_info.sLayerInfo[i].pBsBuf, layer_size);
-    buf_length += layer_size;
+    layer_data = frame_info.sLayerInfo[i].pBsBuf;
+    layer_size = size;
   }
+  if (layer_size > 0)
+    memcpy (map.data + buf_length, layer_data, layer_size);
 
   gst_buffer_unmap (frame->output_buffer, &map);
 
@@ -89,6 +89,8 @@ struct _GstOpenh264Enc
   GstOpenh264EncSliceMode slice_mode;
   guint num_slices;
   ECOMPLEXITY_MODE complexity;
+
+  SSourcePicture src_pic;
 };
 
 struct _GstOpenh264EncClass
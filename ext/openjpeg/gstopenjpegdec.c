@@ -32,12 +32,55 @@
 GST_DEBUG_CATEGORY_STATIC (gst_openjpeg_dec_debug);
 #define GST_CAT_DEFAULT gst_openjpeg_dec_debug
 
+enum
+{
+  PROP_0,
+  PROP_MAX_THREADS
+};
+
+#define DEFAULT_MAX_THREADS 1
+
+typedef enum
+{
+  GST_OPENJPEG_DEC_JOB_OK,
+  GST_OPENJPEG_DEC_JOB_INIT_ERROR,
+  GST_OPENJPEG_DEC_JOB_MAP_ERROR,
+  GST_OPENJPEG_DEC_JOB_OPEN_ERROR,
+  GST_OPENJPEG_DEC_JOB_DECODE_ERROR
+} GstOpenJPEGDecJobError;
+
+/* A frame that is decoded by one of the decoding threads. The stream
+ * parameters are copied so that caps changes don't affect queued frames */
+typedef struct
+{
+  GstVideoCodecFrame *frame;
+  OPJ_CODEC_FORMAT codec_format;
+  gboolean is_jp2c;
+  gint ncomps;
+
+  opj_image_t *image;
+  GstOpenJPEGDecJobError error;
+} GstOpenJPEGDecJob;
+
+static void gst_openjpeg_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_openjpeg_dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
 static gboolean gst_openjpeg_dec_start (GstVideoDecoder * decoder);
 static gboolean gst_openjpeg_dec_stop (GstVideoDecoder * decoder);
 static gboolean gst_openjpeg_dec_set_format (GstVideoDecoder * decoder,
     GstVideoCodecState * state);
 static GstFlowReturn gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame);
+static GstFlowReturn gst_openjpeg_dec_finish (GstVideoDecoder * decoder);
+static gboolean gst_openjpeg_dec_flush (GstVideoDecoder * decoder);
+static void gst_openjpeg_dec_decode_job (GstOpenJPEGDecJob * job,
+    GstOpenJPEGDec * self);
+static GstFlowReturn gst_openjpeg_dec_finish_queued_job (GstOpenJPEGDecJob *
+    job, gboolean drop, GstOpenJPEGDec * self);
+static void gst_openjpeg_dec_discard_job (GstOpenJPEGDecJob * job,
+    GstOpenJPEGDec * self);
 static gboolean gst_openjpeg_dec_decide_allocation (GstVideoDecoder * decoder,
     GstQuery * query);
 
@@ -73,12 +116,30 @@ G_DEFINE_TYPE (GstOpenJPEGDec, gst_openjpeg_dec, GST_TYPE_VIDEO_DECODER);
 static void
 gst_openjpeg_dec_class_init (GstOpenJPEGDecClass * klass)
 {
+  GObjectClass *gobject_class;
   GstElementClass *element_class;
   GstVideoDecoderClass *video_decoder_class;
 
+  gobject_class = (GObjectClass *) klass;
   element_class = (GstElementClass *) klass;
   video_decoder_class = (GstVideoDecoderClass *) klass;
 
+  gobject_class->set_property = gst_openjpeg_dec_set_property;
+  gobject_class->get_property = gst_openjpeg_dec_get_property;
+
+  /**
+   * GstOpenJPEGDec:max-threads:
+   *
+   * Number of frames that are decoded in parallel. Every frame is decoded
+   * by its own OpenJPEG decoder instance and output in decoding order, at
+   * the cost of up to this many frames of latency.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of frames to decode in parallel (0 = automatic, "
+          "1 = decode in the streaming thread)", 0, G_MAXINT,
+          DEFAULT_MAX_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (element_class,
       &gst_openjpeg_dec_src_template);
   gst_element_class_add_static_pad_template (element_class,
@@ -97,6 +158,8 @@ gst_openjpeg_dec_class_init (GstOpenJPEGDecClass * klass)
   video_decoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_openjpeg_dec_handle_frame);
   video_decoder_class->decide_allocation = gst_openjpeg_dec_decide_allocation;
+  video_decoder_class->finish = GST_DEBUG_FUNCPTR (gst_openjpeg_dec_finish);
+  video_decoder_class->flush = GST_DEBUG_FUNCPTR (gst_openjpeg_dec_flush);
 
   GST_DEBUG_CATEGORY_INIT (gst_openjpeg_dec_debug, "openjpegdec", 0,
       "OpenJPEG Decoder");
@@ -117,6 +180,39 @@ gst_openjpeg_dec_init (GstOpenJPEGDec * self)
   self->params.cp_limit_decoding = NO_LIMITATION;
 #endif
   self->sampling = GST_JPEG2000_SAMPLING_NONE;
+  self->max_threads = DEFAULT_MAX_THREADS;
+}
+
+static void
+gst_openjpeg_dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (object);
+
+  switch (prop_id) {
+    case PROP_MAX_THREADS:
+      self->max_threads = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_openjpeg_dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (object);
+
+  switch (prop_id) {
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, self->max_threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
 }
 
 static gboolean
@@ -126,6 +222,27 @@ gst_openjpeg_dec_start (GstVideoDecoder * decoder)
 
   GST_DEBUG_OBJECT (self, "Starting");
 
+  if (self->max_threads == 0)
+    self->n_threads = g_get_num_processors ();
+  else
+    self->n_threads = self->max_threads;
+
+  if (self->n_threads > 1) {
+    GError *err = NULL;
+
+    self->jobs = gst_video_job_queue_new (self->n_threads,
+        (GstVideoJobFunc) gst_openjpeg_dec_decode_job,
+        (GstVideoJobFinishFunc) gst_openjpeg_dec_finish_queued_job,
+        (GstVideoJobFunc) gst_openjpeg_dec_discard_job, self, &err);
+    if (!self->jobs) {
+      GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+          ("Failed to create decoding threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+    GST_DEBUG_OBJECT (self, "Decoding with %u threads", self->n_threads);
+  }
+
   return TRUE;
 }
 
@@ -136,6 +253,11 @@ gst_openjpeg_dec_stop (GstVideoDecoder * video_decoder)
 
   GST_DEBUG_OBJECT (self, "Stopping");
 
+  if (self->jobs) {
+    gst_video_job_queue_free (self->jobs);
+    self->jobs = NULL;
+  }
+
   if (self->output_state) {
     gst_video_codec_state_unref (self->output_state);
     self->output_state = NULL;
@@ -195,6 +317,14 @@ gst_openjpeg_dec_set_format (GstVideoDecoder * decoder,
     gst_video_codec_state_unref (self->input_state);
   self->input_state = gst_video_codec_state_ref (state);
 
+  /* up to n_threads frames are queued before the first one is output */
+  if (self->jobs && state->info.fps_n > 0) {
+    GstClockTime latency = gst_util_uint64_scale (self->n_threads,
+        state->info.fps_d * GST_SECOND, state->info.fps_n);
+
+    gst_video_decoder_set_latency (decoder, latency, latency);
+  }
+
   return TRUE;
 }
 
@@ -945,13 +1075,12 @@ seek_fn (OPJ_OFF_T p_nb_bytes, void *p_user_data)
 }
 #endif
 
-static GstFlowReturn
-gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
-    GstVideoCodecFrame * frame)
+/* Decodes the codestream of job->frame into job->image. This is called from
+ * the decoding threads and only reads the state snapshotted in the job */
+static void
+gst_openjpeg_dec_decode_image (GstOpenJPEGDec * self, GstOpenJPEGDecJob * job)
 {
-  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
-  GstFlowReturn ret = GST_FLOW_OK;
-  gint64 deadline;
+  GstBuffer *input = job->frame->input_buffer;
   GstMapInfo map;
 #ifdef HAVE_OPENJPEG_1
   opj_dinfo_t *dec;
@@ -962,20 +1091,9 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
   MemStream mstream;
 #endif
   opj_image_t *image;
-  GstVideoFrame vframe;
   opj_dparameters_t params;
 
-  GST_DEBUG_OBJECT (self, "Handling frame");
-
-  deadline = gst_video_decoder_get_max_decode_time (decoder, frame);
-  if (deadline < 0) {
-    GST_LOG_OBJECT (self, "Dropping too late frame: deadline %" G_GINT64_FORMAT,
-        deadline);
-    ret = gst_video_decoder_drop_frame (decoder, frame);
-    return ret;
-  }
-
-  dec = opj_create_decompress (self->codec_format);
+  dec = opj_create_decompress (job->codec_format);
   if (!dec)
     goto initialization_error;
 
@@ -1005,16 +1123,16 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
 #endif
 
   params = self->params;
-  if (self->ncomps)
-    params.jpwl_exp_comps = self->ncomps;
+  if (job->ncomps)
+    params.jpwl_exp_comps = job->ncomps;
   opj_setup_decoder (dec, &params);
 
-  if (!gst_buffer_map (frame->input_buffer, &map, GST_MAP_READ))
+  if (!gst_buffer_map (input, &map, GST_MAP_READ))
     goto map_read_error;
 
 #ifdef HAVE_OPENJPEG_1
-  io = opj_cio_open ((opj_common_ptr) dec, map.data + (self->is_jp2c ? 8 : 0),
-      map.size - (self->is_jp2c ? 8 : 0));
+  io = opj_cio_open ((opj_common_ptr) dec, map.data + (job->is_jp2c ? 8 : 0),
+      map.size - (job->is_jp2c ? 8 : 0));
   if (!io)
     goto open_error;
 
@@ -1026,9 +1144,9 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
   if (!stream)
     goto open_error;
 
-  mstream.data = map.data + (self->is_jp2c ? 8 : 0);
+  mstream.data = map.data + (job->is_jp2c ? 8 : 0);
   mstream.offset = 0;
-  mstream.size = map.size - (self->is_jp2c ? 8 : 0);
+  mstream.size = map.size - (job->is_jp2c ? 8 : 0);
 
   opj_stream_set_read_function (stream, read_fn);
   opj_stream_set_write_function (stream, write_fn);
@@ -1058,45 +1176,25 @@ gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
     }
   }
 
-  gst_buffer_unmap (frame->input_buffer, &map);
-
-  ret = gst_openjpeg_dec_negotiate (self, image);
-  if (ret != GST_FLOW_OK)
-    goto negotiate_error;
-
-  ret = gst_video_decoder_allocate_output_frame (decoder, frame);
-  if (ret != GST_FLOW_OK)
-    goto allocate_error;
-
-  if (!gst_video_frame_map (&vframe, &self->output_state->info,
-          frame->output_buffer, GST_MAP_WRITE))
-    goto map_write_error;
-
-  self->fill_frame (&vframe, image);
-
-  gst_video_frame_unmap (&vframe);
+  gst_buffer_unmap (input, &map);
 
 #ifdef HAVE_OPENJPEG_1
   opj_cio_close (io);
-  opj_image_destroy (image);
   opj_destroy_decompress (dec);
 #else
   opj_end_decompress (dec, stream);
   opj_stream_destroy (stream);
-  opj_image_destroy (image);
   opj_destroy_codec (dec);
 #endif
 
-  ret = gst_video_decoder_finish_frame (decoder, frame);
-
-  return ret;
+  job->image = image;
+  job->error = GST_OPENJPEG_DEC_JOB_OK;
+  return;
 
 initialization_error:
   {
-    gst_video_codec_frame_unref (frame);
-    GST_ELEMENT_ERROR (self, LIBRARY, INIT,
-        ("Failed to initialize OpenJPEG decoder"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_DEC_JOB_INIT_ERROR;
+    return;
   }
 map_read_error:
   {
@@ -1105,11 +1203,8 @@ map_read_error:
 #else
     opj_destroy_codec (dec);
 #endif
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, CORE, FAILED,
-        ("Failed to map input buffer"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_DEC_JOB_MAP_ERROR;
+    return;
   }
 open_error:
   {
@@ -1118,12 +1213,9 @@ open_error:
 #else
     opj_destroy_codec (dec);
 #endif
-    gst_buffer_unmap (frame->input_buffer, &map);
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, LIBRARY, INIT,
-        ("Failed to open OpenJPEG stream"), (NULL));
-    return GST_FLOW_ERROR;
+    gst_buffer_unmap (input, &map);
+    job->error = GST_OPENJPEG_DEC_JOB_OPEN_ERROR;
+    return;
   }
 decode_error:
   {
@@ -1136,23 +1228,73 @@ decode_error:
     opj_stream_destroy (stream);
     opj_destroy_codec (dec);
 #endif
-    gst_buffer_unmap (frame->input_buffer, &map);
-    gst_video_codec_frame_unref (frame);
+    gst_buffer_unmap (input, &map);
+    job->error = GST_OPENJPEG_DEC_JOB_DECODE_ERROR;
+    return;
+  }
+}
 
-    GST_VIDEO_DECODER_ERROR (self, 1, STREAM, DECODE,
-        ("Failed to decode OpenJPEG stream"), (NULL), ret);
-    return ret;
+/* Converts the decoded image of @job into an output frame and finishes it.
+ * Takes ownership of the frame and the image */
+static GstFlowReturn
+gst_openjpeg_dec_finish_job (GstOpenJPEGDec * self, GstOpenJPEGDecJob * job)
+{
+  GstVideoDecoder *decoder = GST_VIDEO_DECODER (self);
+  GstVideoCodecFrame *frame = job->frame;
+  opj_image_t *image = job->image;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstVideoFrame vframe;
+
+  switch (job->error) {
+    case GST_OPENJPEG_DEC_JOB_OK:
+      break;
+    case GST_OPENJPEG_DEC_JOB_INIT_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, LIBRARY, INIT,
+          ("Failed to initialize OpenJPEG decoder"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_DEC_JOB_MAP_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, CORE, FAILED,
+          ("Failed to map input buffer"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_DEC_JOB_OPEN_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, LIBRARY, INIT,
+          ("Failed to open OpenJPEG stream"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_DEC_JOB_DECODE_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_VIDEO_DECODER_ERROR (self, 1, STREAM, DECODE,
+          ("Failed to decode OpenJPEG stream"), (NULL), ret);
+      return ret;
   }
+
+  ret = gst_openjpeg_dec_negotiate (self, image);
+  if (ret != GST_FLOW_OK)
+    goto negotiate_error;
+
+  ret = gst_video_decoder_allocate_output_frame (decoder, frame);
+  if (ret != GST_FLOW_OK)
+    goto allocate_error;
+
+  if (!gst_video_frame_map (&vframe, &self->output_state->info,
+          frame->output_buffer, GST_MAP_WRITE))
+    goto map_write_error;
+
+  self->fill_frame (&vframe, image);
+
+  gst_video_frame_unmap (&vframe);
+
+  opj_image_destroy (image);
+
+  ret = gst_video_decoder_finish_frame (decoder, frame);
+
+  return ret;
+
 negotiate_error:
   {
     opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, NEGOTIATION,
@@ -1162,13 +1304,6 @@ negotiate_error:
 allocate_error:
   {
     opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, FAILED,
@@ -1178,13 +1313,6 @@ allocate_error:
 map_write_error:
   {
     opj_image_destroy (image);
-#ifdef HAVE_OPENJPEG_1
-    opj_cio_close (io);
-    opj_destroy_decompress (dec);
-#else
-    opj_stream_destroy (stream);
-    opj_destroy_codec (dec);
-#endif
     gst_video_codec_frame_unref (frame);
 
     GST_ELEMENT_ERROR (self, CORE, FAILED,
@@ -1193,6 +1321,103 @@ map_write_error:
   }
 }
 
+static void
+gst_openjpeg_dec_decode_job (GstOpenJPEGDecJob * job, GstOpenJPEGDec * self)
+{
+  gst_openjpeg_dec_decode_image (self, job);
+}
+
+/* Finishes a frame that was decoded by the decoding threads. Frames after a
+ * failed one are released without output */
+static GstFlowReturn
+gst_openjpeg_dec_finish_queued_job (GstOpenJPEGDecJob * job, gboolean drop,
+    GstOpenJPEGDec * self)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (drop) {
+    if (job->image)
+      opj_image_destroy (job->image);
+    gst_video_decoder_release_frame (GST_VIDEO_DECODER (self), job->frame);
+  } else {
+    ret = gst_openjpeg_dec_finish_job (self, job);
+  }
+  g_slice_free (GstOpenJPEGDecJob, job);
+
+  return ret;
+}
+
+static void
+gst_openjpeg_dec_discard_job (GstOpenJPEGDecJob * job, GstOpenJPEGDec * self)
+{
+  if (job->image)
+    opj_image_destroy (job->image);
+  gst_video_codec_frame_unref (job->frame);
+  g_slice_free (GstOpenJPEGDecJob, job);
+}
+
+static GstFlowReturn
+gst_openjpeg_dec_handle_frame (GstVideoDecoder * decoder,
+    GstVideoCodecFrame * frame)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
+  GstOpenJPEGDecJob *job;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gint64 deadline;
+
+  GST_DEBUG_OBJECT (self, "Handling frame");
+
+  deadline = gst_video_decoder_get_max_decode_time (decoder, frame);
+  if (deadline < 0) {
+    GST_LOG_OBJECT (self, "Dropping too late frame: deadline %" G_GINT64_FORMAT,
+        deadline);
+    ret = gst_video_decoder_drop_frame (decoder, frame);
+    return ret;
+  }
+
+  job = g_slice_new0 (GstOpenJPEGDecJob);
+  job->frame = frame;
+  job->codec_format = self->codec_format;
+  job->is_jp2c = self->is_jp2c;
+  job->ncomps = self->ncomps;
+
+  if (!self->jobs) {
+    gst_openjpeg_dec_decode_image (self, job);
+    ret = gst_openjpeg_dec_finish_job (self, job);
+    g_slice_free (GstOpenJPEGDecJob, job);
+    return ret;
+  }
+
+  /* bound the number of frames in flight to the number of threads */
+  return gst_video_job_queue_push (self->jobs, job, self->n_threads);
+}
+
+static GstFlowReturn
+gst_openjpeg_dec_finish (GstVideoDecoder * decoder)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
+
+  GST_DEBUG_OBJECT (self, "Draining");
+
+  if (!self->jobs)
+    return GST_FLOW_OK;
+
+  return gst_video_job_queue_finish (self->jobs, 0);
+}
+
+static gboolean
+gst_openjpeg_dec_flush (GstVideoDecoder * decoder)
+{
+  GstOpenJPEGDec *self = GST_OPENJPEG_DEC (decoder);
+
+  GST_DEBUG_OBJECT (self, "Flushing");
+
+  if (self->jobs)
+    gst_video_job_queue_discard (self->jobs);
+
+  return TRUE;
+}
+
 static gboolean
 gst_openjpeg_dec_decide_allocation (GstVideoDecoder * decoder, GstQuery * query)
 {
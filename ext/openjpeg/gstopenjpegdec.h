@@ -25,6 +25,7 @@
 #include <gst/gst.h>
 #include <gst/video/video.h>
 #include <gst/codecparsers/gstjpeg2000sampling.h>
+#include <gst/video/gstvideojobqueue.h>
 
 #include "gstopenjpeg.h"
 
@@ -61,6 +62,12 @@ struct _GstOpenJPEGDec
   void (*fill_frame) (GstVideoFrame *frame, opj_image_t * image);
 
   opj_dparameters_t params;
+
+  gint max_threads;
+  guint n_threads;
+
+  /* frame threading, frames are queued in decoding order */
+  GstVideoJobQueue *jobs;
 };
 
 struct _GstOpenJPEGDecClass
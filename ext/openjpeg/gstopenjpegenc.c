@@ -66,7 +66,9 @@ enum
   PROP_TILE_OFFSET_X,
   PROP_TILE_OFFSET_Y,
   PROP_TILE_WIDTH,
-  PROP_TILE_HEIGHT
+  PROP_TILE_HEIGHT,
+  PROP_MAX_THREADS,
+  PROP_QUEUE_DEPTH
 };
 
 #define DEFAULT_NUM_LAYERS 1
@@ -76,6 +78,35 @@ enum
 #define DEFAULT_TILE_OFFSET_Y 0
 #define DEFAULT_TILE_WIDTH 0
 #define DEFAULT_TILE_HEIGHT 0
+#define DEFAULT_MAX_THREADS 1
+#define DEFAULT_QUEUE_DEPTH 0
+
+typedef enum
+{
+  GST_OPENJPEG_ENC_JOB_OK,
+  GST_OPENJPEG_ENC_JOB_INIT_ERROR,
+  GST_OPENJPEG_ENC_JOB_MAP_ERROR,
+  GST_OPENJPEG_ENC_JOB_FILL_ERROR,
+  GST_OPENJPEG_ENC_JOB_OPEN_ERROR,
+  GST_OPENJPEG_ENC_JOB_ENCODE_ERROR,
+  GST_OPENJPEG_ENC_JOB_ALLOCATE_ERROR
+} GstOpenJPEGEncJobError;
+
+/* A frame that is encoded by one of the encoding threads. The encoder
+ * settings are copied so that property and caps changes don't affect
+ * queued frames */
+typedef struct
+{
+  GstVideoCodecFrame *frame;
+  GstVideoInfo info;
+  opj_cparameters_t params;
+  OPJ_CODEC_FORMAT codec_format;
+  gboolean is_jp2c;
+  void (*fill_image) (opj_image_t * image, GstVideoFrame * frame);
+
+  GstBuffer *output;
+  GstOpenJPEGEncJobError error;
+} GstOpenJPEGEncJob;
 
 static void gst_openjpeg_enc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
@@ -90,6 +121,14 @@ static GstFlowReturn gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
     GstVideoCodecFrame * frame);
 static gboolean gst_openjpeg_enc_propose_allocation (GstVideoEncoder * encoder,
     GstQuery * query);
+static GstFlowReturn gst_openjpeg_enc_finish (GstVideoEncoder * encoder);
+static gboolean gst_openjpeg_enc_flush (GstVideoEncoder * encoder);
+static void gst_openjpeg_enc_encode_job (GstOpenJPEGEncJob * job,
+    GstOpenJPEGEnc * self);
+static GstFlowReturn gst_openjpeg_enc_finish_queued_job (GstOpenJPEGEncJob *
+    job, gboolean drop, GstOpenJPEGEnc * self);
+static void gst_openjpeg_enc_discard_job (GstOpenJPEGEncJob * job,
+    GstOpenJPEGEnc * self);
 
 #if G_BYTE_ORDER == G_LITTLE_ENDIAN
 #define GRAY16 "GRAY16_LE"
@@ -180,6 +219,31 @@ gst_openjpeg_enc_class_init (GstOpenJPEGEncClass * klass)
           "Tile Height", 0, G_MAXINT, DEFAULT_TILE_HEIGHT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstOpenJPEGEnc:max-threads:
+   *
+   * Number of threads that encode frames in parallel, every frame being
+   * encoded by its own OpenJPEG encoder instance.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of frames to encode in parallel (0 = automatic, "
+          "1 = encode in the streaming thread)", 0, G_MAXINT,
+          DEFAULT_MAX_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstOpenJPEGEnc:queue-depth:
+   *
+   * Number of frames that can be queued for encoding before the oldest one
+   * has to be output. Frames are output in input order, so this is also the
+   * latency of the encoder in frames.
+   */
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_int ("queue-depth", "Queue depth",
+          "Maximum number of frames being encoded at once "
+          "(0 = number of threads)", 0, G_MAXINT,
+          DEFAULT_QUEUE_DEPTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (element_class,
       &gst_openjpeg_enc_src_template);
   gst_element_class_add_static_pad_template (element_class,
@@ -198,6 +262,8 @@ gst_openjpeg_enc_class_init (GstOpenJPEGEncClass * klass)
   video_encoder_class->handle_frame =
       GST_DEBUG_FUNCPTR (gst_openjpeg_enc_handle_frame);
   video_encoder_class->propose_allocation = gst_openjpeg_enc_propose_allocation;
+  video_encoder_class->finish = GST_DEBUG_FUNCPTR (gst_openjpeg_enc_finish);
+  video_encoder_class->flush = GST_DEBUG_FUNCPTR (gst_openjpeg_enc_flush);
 
   GST_DEBUG_CATEGORY_INIT (gst_openjpeg_enc_debug, "openjpegenc", 0,
       "OpenJPEG Encoder");
@@ -235,6 +301,9 @@ gst_openjpeg_enc_init (GstOpenJPEGEnc * self)
   self->params.cp_tdy = DEFAULT_TILE_HEIGHT;
   self->params.tile_size_on = (self->params.cp_tdx != 0
       && self->params.cp_tdy != 0);
+
+  self->max_threads = DEFAULT_MAX_THREADS;
+  self->queue_depth = DEFAULT_QUEUE_DEPTH;
 }
 
 static void
@@ -269,6 +338,12 @@ gst_openjpeg_enc_set_property (GObject * object, guint prop_id,
       self->params.tile_size_on = (self->params.cp_tdx != 0
           && self->params.cp_tdy != 0);
       break;
+    case PROP_MAX_THREADS:
+      self->max_threads = g_value_get_int (value);
+      break;
+    case PROP_QUEUE_DEPTH:
+      self->queue_depth = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -303,6 +378,12 @@ gst_openjpeg_enc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_TILE_HEIGHT:
       g_value_set_int (value, self->params.cp_tdy);
       break;
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, self->max_threads);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_int (value, self->queue_depth);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -316,6 +397,33 @@ gst_openjpeg_enc_start (GstVideoEncoder * encoder)
 
   GST_DEBUG_OBJECT (self, "Starting");
 
+  if (self->max_threads == 0)
+    self->n_threads = g_get_num_processors ();
+  else
+    self->n_threads = self->max_threads;
+
+  if (self->queue_depth == 0)
+    self->queue_size = self->n_threads;
+  else
+    self->queue_size = self->queue_depth;
+
+  if (self->n_threads > 1) {
+    GError *err = NULL;
+
+    self->jobs = gst_video_job_queue_new (self->n_threads,
+        (GstVideoJobFunc) gst_openjpeg_enc_encode_job,
+        (GstVideoJobFinishFunc) gst_openjpeg_enc_finish_queued_job,
+        (GstVideoJobFunc) gst_openjpeg_enc_discard_job, self, &err);
+    if (!self->jobs) {
+      GST_ELEMENT_ERROR (self, RESOURCE, FAILED,
+          ("Failed to create encoding threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+    GST_DEBUG_OBJECT (self, "Encoding with %u threads, %u frames in flight",
+        self->n_threads, self->queue_size);
+  }
+
   return TRUE;
 }
 
@@ -326,6 +434,11 @@ gst_openjpeg_enc_stop (GstVideoEncoder * video_encoder)
 
   GST_DEBUG_OBJECT (self, "Stopping");
 
+  if (self->jobs) {
+    gst_video_job_queue_free (self->jobs);
+    self->jobs = NULL;
+  }
+
   if (self->output_state) {
     gst_video_codec_state_unref (self->output_state);
     self->output_state = NULL;
@@ -706,13 +819,22 @@ gst_openjpeg_enc_set_format (GstVideoEncoder * encoder,
   self->output_state =
       gst_video_encoder_set_output_state (encoder, caps, state);
 
+  /* up to queue_size frames are queued before the first one is output */
+  if (self->jobs && state->info.fps_n > 0) {
+    GstClockTime latency = gst_util_uint64_scale (self->queue_size,
+        state->info.fps_d * GST_SECOND, state->info.fps_n);
+
+    gst_video_encoder_set_latency (encoder, latency, latency);
+  }
+
   gst_video_encoder_negotiate (GST_VIDEO_ENCODER (encoder));
 
   return TRUE;
 }
 
 static opj_image_t *
-gst_openjpeg_enc_fill_image (GstOpenJPEGEnc * self, GstVideoFrame * frame)
+gst_openjpeg_enc_fill_image (GstOpenJPEGEnc * self, GstOpenJPEGEncJob * job,
+    GstVideoFrame * frame)
 {
   gint i, ncomps;
   opj_image_cmptparm_t *comps;
@@ -750,7 +872,7 @@ gst_openjpeg_enc_fill_image (GstOpenJPEGEnc * self, GstVideoFrame * frame)
   image->x1 = GST_VIDEO_FRAME_WIDTH (frame);
   image->y1 = GST_VIDEO_FRAME_HEIGHT (frame);
 
-  self->fill_image (image, frame);
+  job->fill_image (image, frame);
 
   return image;
 }
@@ -851,12 +973,12 @@ seek_fn (OPJ_OFF_T p_nb_bytes, void *p_user_data)
 }
 #endif
 
-static GstFlowReturn
-gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
-    GstVideoCodecFrame * frame)
+/* Encodes job->frame into job->output. This is called from the encoding
+ * threads and only reads the state snapshotted in the job */
+static void
+gst_openjpeg_enc_encode_frame (GstOpenJPEGEnc * self, GstOpenJPEGEncJob * job)
 {
-  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
-  GstFlowReturn ret = GST_FLOW_OK;
+  GstVideoCodecFrame *frame = job->frame;
 #ifdef HAVE_OPENJPEG_1
   opj_cinfo_t *enc;
   GstMapInfo map;
@@ -870,9 +992,7 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
   opj_image_t *image;
   GstVideoFrame vframe;
 
-  GST_DEBUG_OBJECT (self, "Handling frame");
-
-  enc = opj_create_compress (self->codec_format);
+  enc = opj_create_compress (job->codec_format);
   if (!enc)
     goto initialization_error;
 
@@ -901,19 +1021,19 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
   }
 #endif
 
-  if (!gst_video_frame_map (&vframe, &self->input_state->info,
-          frame->input_buffer, GST_MAP_READ))
+  if (!gst_video_frame_map (&vframe, &job->info, frame->input_buffer,
+          GST_MAP_READ))
     goto map_read_error;
 
-  image = gst_openjpeg_enc_fill_image (self, &vframe);
+  image = gst_openjpeg_enc_fill_image (self, job, &vframe);
   if (!image)
     goto fill_image_error;
   gst_video_frame_unmap (&vframe);
 
   if (vframe.info.finfo->flags & GST_VIDEO_FORMAT_FLAG_RGB) {
-    self->params.tcp_mct = 1;
+    job->params.tcp_mct = 1;
   }
-  opj_setup_encoder (enc, &self->params, image);
+  opj_setup_encoder (enc, &job->params, image);
 
 #ifdef HAVE_OPENJPEG_1
   io = opj_cio_open ((opj_common_ptr) enc, NULL, 0);
@@ -927,19 +1047,27 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
 
   length = cio_tell (io);
 
-  ret =
-      gst_video_encoder_allocate_output_frame (encoder, frame,
-      length + (self->is_jp2c ? 8 : 0));
-  if (ret != GST_FLOW_OK)
-    goto allocate_error;
+  if (self->jobs) {
+    /* the output frame can't be allocated from the encoding threads, the
+     * streaming thread holds the stream lock while waiting for them */
+    job->output = gst_buffer_new_allocate (NULL,
+        length + (job->is_jp2c ? 8 : 0), NULL);
+    if (!job->output)
+      goto allocate_error;
+  } else {
+    if (gst_video_encoder_allocate_output_frame (GST_VIDEO_ENCODER (self),
+            frame, length + (job->is_jp2c ? 8 : 0)) != GST_FLOW_OK)
+      goto allocate_error;
+    job->output = frame->output_buffer;
+    frame->output_buffer = NULL;
+  }
 
-  gst_buffer_fill (frame->output_buffer, self->is_jp2c ? 8 : 0, io->buffer,
-      length);
-  if (self->is_jp2c) {
-    gst_buffer_map (frame->output_buffer, &map, GST_MAP_WRITE);
+  gst_buffer_fill (job->output, job->is_jp2c ? 8 : 0, io->buffer, length);
+  if (job->is_jp2c) {
+    gst_buffer_map (job->output, &map, GST_MAP_WRITE);
     GST_WRITE_UINT32_BE (map.data, length + 8);
     GST_WRITE_UINT32_BE (map.data + 4, GST_MAKE_FOURCC ('j', 'p', '2', 'c'));
-    gst_buffer_unmap (frame->output_buffer, &map);
+    gst_buffer_unmap (job->output, &map);
   }
 
   opj_cio_close (io);
@@ -978,9 +1106,9 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
   opj_stream_destroy (stream);
   opj_destroy_codec (enc);
 
-  frame->output_buffer = gst_buffer_new ();
+  job->output = gst_buffer_new ();
 
-  if (self->is_jp2c) {
+  if (job->is_jp2c) {
     GstMapInfo map;
     GstMemory *mem;
 
@@ -989,25 +1117,21 @@ gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
     GST_WRITE_UINT32_BE (map.data, mstream.size + 8);
     GST_WRITE_UINT32_BE (map.data + 4, GST_MAKE_FOURCC ('j', 'p', '2', 'c'));
     gst_memory_unmap (mem, &map);
-    gst_buffer_append_memory (frame->output_buffer, mem);
+    gst_buffer_append_memory (job->output, mem);
   }
 
-  gst_buffer_append_memory (frame->output_buffer,
+  gst_buffer_append_memory (job->output,
       gst_memory_new_wrapped (0, mstream.data, mstream.allocsize, 0,
           mstream.size, NULL, (GDestroyNotify) g_free));
 #endif
 
-  GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
-  ret = gst_video_encoder_finish_frame (encoder, frame);
-
-  return ret;
+  job->error = GST_OPENJPEG_ENC_JOB_OK;
+  return;
 
 initialization_error:
   {
-    gst_video_codec_frame_unref (frame);
-    GST_ELEMENT_ERROR (self, LIBRARY, INIT,
-        ("Failed to initialize OpenJPEG encoder"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_ENC_JOB_INIT_ERROR;
+    return;
   }
 map_read_error:
   {
@@ -1016,11 +1140,8 @@ map_read_error:
 #else
     opj_destroy_codec (enc);
 #endif
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, CORE, FAILED,
-        ("Failed to map input buffer"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_ENC_JOB_MAP_ERROR;
+    return;
   }
 fill_image_error:
   {
@@ -1030,11 +1151,8 @@ fill_image_error:
     opj_destroy_codec (enc);
 #endif
     gst_video_frame_unmap (&vframe);
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, LIBRARY, INIT,
-        ("Failed to fill OpenJPEG image"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_ENC_JOB_FILL_ERROR;
+    return;
   }
 open_error:
   {
@@ -1044,11 +1162,8 @@ open_error:
 #else
     opj_destroy_codec (enc);
 #endif
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, LIBRARY, INIT,
-        ("Failed to open OpenJPEG data"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_ENC_JOB_OPEN_ERROR;
+    return;
   }
 encode_error:
   {
@@ -1062,24 +1177,160 @@ encode_error:
     opj_image_destroy (image);
     opj_destroy_codec (enc);
 #endif
-    gst_video_codec_frame_unref (frame);
-
-    GST_ELEMENT_ERROR (self, STREAM, ENCODE,
-        ("Failed to encode OpenJPEG stream"), (NULL));
-    return GST_FLOW_ERROR;
+    job->error = GST_OPENJPEG_ENC_JOB_ENCODE_ERROR;
+    return;
   }
 #ifdef HAVE_OPENJPEG_1
 allocate_error:
   {
     opj_cio_close (io);
     opj_destroy_compress (enc);
-    gst_video_codec_frame_unref (frame);
+    job->error = GST_OPENJPEG_ENC_JOB_ALLOCATE_ERROR;
+    return;
+  }
+#endif
+}
+
+/* Finishes the frame of @job with its encoded output. Takes ownership of the
+ * frame */
+static GstFlowReturn
+gst_openjpeg_enc_finish_job (GstOpenJPEGEnc * self, GstOpenJPEGEncJob * job)
+{
+  GstVideoCodecFrame *frame = job->frame;
+
+  switch (job->error) {
+    case GST_OPENJPEG_ENC_JOB_OK:
+      break;
+    case GST_OPENJPEG_ENC_JOB_INIT_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, LIBRARY, INIT,
+          ("Failed to initialize OpenJPEG encoder"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_ENC_JOB_MAP_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, CORE, FAILED,
+          ("Failed to map input buffer"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_ENC_JOB_FILL_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, LIBRARY, INIT,
+          ("Failed to fill OpenJPEG image"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_ENC_JOB_OPEN_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, LIBRARY, INIT,
+          ("Failed to open OpenJPEG data"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_ENC_JOB_ENCODE_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, STREAM, ENCODE,
+          ("Failed to encode OpenJPEG stream"), (NULL));
+      return GST_FLOW_ERROR;
+    case GST_OPENJPEG_ENC_JOB_ALLOCATE_ERROR:
+      gst_video_codec_frame_unref (frame);
+      GST_ELEMENT_ERROR (self, CORE, FAILED,
+          ("Failed to allocate output buffer"), (NULL));
+      return GST_FLOW_ERROR;
+  }
 
-    GST_ELEMENT_ERROR (self, CORE, FAILED,
-        ("Failed to allocate output buffer"), (NULL));
+  frame->output_buffer = job->output;
+  job->output = NULL;
+
+  GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
+  return gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (self), frame);
+}
+
+static void
+gst_openjpeg_enc_free_job (GstOpenJPEGEncJob * job)
+{
+  if (job->output)
+    gst_buffer_unref (job->output);
+  g_slice_free (GstOpenJPEGEncJob, job);
+}
+
+static void
+gst_openjpeg_enc_encode_job (GstOpenJPEGEncJob * job, GstOpenJPEGEnc * self)
+{
+  gst_openjpeg_enc_encode_frame (self, job);
+}
+
+/* Finishes a frame that was encoded by the encoding threads. Frames after a
+ * failed one are finished without output, which drops them */
+static GstFlowReturn
+gst_openjpeg_enc_finish_queued_job (GstOpenJPEGEncJob * job, gboolean drop,
+    GstOpenJPEGEnc * self)
+{
+  GstFlowReturn ret;
+
+  if (drop)
+    ret = gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (self),
+        job->frame);
+  else
+    ret = gst_openjpeg_enc_finish_job (self, job);
+  gst_openjpeg_enc_free_job (job);
+
+  return ret;
+}
+
+static void
+gst_openjpeg_enc_discard_job (GstOpenJPEGEncJob * job, GstOpenJPEGEnc * self)
+{
+  gst_video_codec_frame_unref (job->frame);
+  gst_openjpeg_enc_free_job (job);
+}
+
+static GstFlowReturn
+gst_openjpeg_enc_handle_frame (GstVideoEncoder * encoder,
+    GstVideoCodecFrame * frame)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
+  GstOpenJPEGEncJob *job;
+  GstFlowReturn ret;
+
+  GST_DEBUG_OBJECT (self, "Handling frame");
+
+  job = g_slice_new0 (GstOpenJPEGEncJob);
+  job->frame = frame;
+  job->info = self->input_state->info;
+  job->params = self->params;
+  job->codec_format = self->codec_format;
+  job->is_jp2c = self->is_jp2c;
+  job->fill_image = self->fill_image;
+
+  if (!self->jobs) {
+    gst_openjpeg_enc_encode_frame (self, job);
+    ret = gst_openjpeg_enc_finish_job (self, job);
+    gst_openjpeg_enc_free_job (job);
     return ret;
   }
-#endif
+
+  return gst_video_job_queue_push (self->jobs, job, self->queue_size);
+}
+
+static GstFlowReturn
+gst_openjpeg_enc_finish (GstVideoEncoder * encoder)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
+
+  GST_DEBUG_OBJECT (self, "Draining");
+
+  if (!self->jobs)
+    return GST_FLOW_OK;
+
+  return gst_video_job_queue_finish (self->jobs, 0);
+}
+
+static gboolean
+gst_openjpeg_enc_flush (GstVideoEncoder * encoder)
+{
+  GstOpenJPEGEnc *self = GST_OPENJPEG_ENC (encoder);
+
+  GST_DEBUG_OBJECT (self, "Flushing");
+
+  if (self->jobs)
+    gst_video_job_queue_discard (self->jobs);
+
+  return TRUE;
 }
 
 static gboolean
@@ -24,6 +24,7 @@
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
+#include <gst/video/gstvideojobqueue.h>
 
 #include "gstopenjpeg.h"
 
@@ -57,6 +58,14 @@ struct _GstOpenJPEGEnc
   void (*fill_image) (opj_image_t * image, GstVideoFrame *frame);
 
   opj_cparameters_t params;
+
+  gint max_threads;
+  gint queue_depth;
+  guint n_threads;
+  guint queue_size;
+
+  /* frame threading, frames are queued in input order */
+  GstVideoJobQueue *jobs;
 };
 
 struct _GstOpenJPEGEncClass
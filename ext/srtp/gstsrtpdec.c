@@ -210,6 +210,10 @@ static GstFlowReturn gst_srtp_dec_chain_rtp (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
 static GstFlowReturn gst_srtp_dec_chain_rtcp (GstPad * pad,
     GstObject * parent, GstBuffer * buf);
+static GstFlowReturn gst_srtp_dec_chain_list_rtp (GstPad * pad,
+    GstObject * parent, GstBufferList * buf_list);
+static GstFlowReturn gst_srtp_dec_chain_list_rtcp (GstPad * pad,
+    GstObject * parent, GstBufferList * buf_list);
 
 static GstStateChangeReturn gst_srtp_dec_change_state (GstElement * element,
     GstStateChange transition);
@@ -373,6 +377,8 @@ gst_srtp_dec_init (GstSrtpDec * filter)
       GST_DEBUG_FUNCPTR (gst_srtp_dec_iterate_internal_links_rtp));
   gst_pad_set_chain_function (filter->rtp_sinkpad,
       GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_rtp));
+  gst_pad_set_chain_list_function (filter->rtp_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_list_rtp));
 
   filter->rtp_srcpad =
       gst_pad_new_from_static_template (&rtp_src_template, "rtp_src");
@@ -396,6 +402,8 @@ gst_srtp_dec_init (GstSrtpDec * filter)
       GST_DEBUG_FUNCPTR (gst_srtp_dec_iterate_internal_links_rtcp));
   gst_pad_set_chain_function (filter->rtcp_sinkpad,
       GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_rtcp));
+  gst_pad_set_chain_list_function (filter->rtcp_sinkpad,
+      GST_DEBUG_FUNCPTR (gst_srtp_dec_chain_list_rtcp));
 
   filter->rtcp_srcpad =
       gst_pad_new_from_static_template (&rtcp_src_template, "rtcp_src");
@@ -498,6 +506,8 @@ gst_srtp_dec_remove_stream (GstSrtpDec * filter, guint ssrc)
   if (filter->streams == NULL)
     return;
 
+  filter->last_stream = NULL;
+
   stream = g_hash_table_lookup (filter->streams, GUINT_TO_POINTER (ssrc));
 
   if (stream) {
@@ -509,7 +519,18 @@ gst_srtp_dec_remove_stream (GstSrtpDec * filter, guint ssrc)
 static GstSrtpDecSsrcStream *
 find_stream_by_ssrc (GstSrtpDec * filter, guint32 ssrc)
 {
-  return g_hash_table_lookup (filter->streams, GUINT_TO_POINTER (ssrc));
+  GstSrtpDecSsrcStream *stream;
+
+  if (filter->last_stream && filter->last_ssrc == ssrc)
+    return filter->last_stream;
+
+  stream = g_hash_table_lookup (filter->streams, GUINT_TO_POINTER (ssrc));
+  if (stream) {
+    filter->last_stream = stream;
+    filter->last_ssrc = ssrc;
+  }
+
+  return stream;
 }
 
 
@@ -651,6 +672,7 @@ init_session_stream (GstSrtpDec * filter, guint32 ssrc,
     }
 
     filter->first_session = FALSE;
+    filter->last_stream = NULL;
     g_hash_table_insert (filter->streams, GUINT_TO_POINTER (stream->ssrc),
         stream);
   }
@@ -783,6 +805,8 @@ gst_srtp_dec_clear_streams (GstSrtpDec * filter)
   if (filter->streams)
     nb = g_hash_table_foreach_remove (filter->streams, remove_yes, NULL);
 
+  filter->last_stream = NULL;
+
   filter->first_session = TRUE;
 
   GST_OBJECT_UNLOCK (filter);
@@ -1133,19 +1157,21 @@ gst_srtp_dec_push_early_events (GstSrtpDec * filter, GstPad * pad,
  * This function should be called while holding the filter lock
  */
 static gboolean
-gst_srtp_dec_decode_buffer (GstSrtpDec * filter, GstPad * pad, GstBuffer * buf,
-    gboolean is_rtcp, guint32 ssrc)
+gst_srtp_dec_decode_buffer (GstSrtpDec * filter, GstPad * pad,
+    GstBuffer ** buffer, gboolean is_rtcp, guint32 ssrc)
 {
+  GstBuffer *buf;
   GstMapInfo map;
   err_status_t err;
   gint size;
 
   GST_LOG_OBJECT (pad, "Received %s buffer of size %" G_GSIZE_FORMAT
-      " with SSRC = %u", is_rtcp ? "RTCP" : "RTP", gst_buffer_get_size (buf),
-      ssrc);
+      " with SSRC = %u", is_rtcp ? "RTCP" : "RTP",
+      gst_buffer_get_size (*buffer), ssrc);
 
-  /* Change buffer to remove protection */
-  buf = gst_buffer_make_writable (buf);
+  /* Change buffer to remove protection, this only copies if the buffer is
+   * not exclusively ours */
+  buf = *buffer = gst_buffer_make_writable (*buffer);
 
   gst_buffer_map (buf, &map, GST_MAP_READWRITE);
   size = map.size;
@@ -1235,21 +1261,21 @@ unprotect:
   return TRUE;
 }
 
-static GstFlowReturn
-gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
-    gboolean is_rtcp)
+/* Takes ownership of @buf and returns the decoded buffer, or %NULL if it
+ * was dropped. @is_rtcp is updated if an RTCP packet arrived on the RTP pad.
+ */
+static GstBuffer *
+gst_srtp_dec_process_buffer (GstSrtpDec * filter, GstPad * pad,
+    GstBuffer * buf, gboolean * is_rtcp)
 {
-  GstSrtpDec *filter = GST_SRTP_DEC (parent);
-  GstPad *otherpad;
   GstSrtpDecSsrcStream *stream = NULL;
-  GstFlowReturn ret = GST_FLOW_OK;
   guint32 ssrc = 0;
 
   GST_OBJECT_LOCK (filter);
 
   /* Check if this stream exists, if not create a new stream */
 
-  if (!(stream = validate_buffer (filter, buf, &ssrc, &is_rtcp))) {
+  if (!(stream = validate_buffer (filter, buf, &ssrc, is_rtcp))) {
     GST_OBJECT_UNLOCK (filter);
     GST_WARNING_OBJECT (filter, "Invalid buffer, dropping");
     goto drop_buffer;
@@ -1257,10 +1283,10 @@ gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
 
   if (!STREAM_HAS_CRYPTO (stream)) {
     GST_OBJECT_UNLOCK (filter);
-    goto push_out;
+    return buf;
   }
 
-  if (!gst_srtp_dec_decode_buffer (filter, pad, buf, is_rtcp, ssrc)) {
+  if (!gst_srtp_dec_decode_buffer (filter, pad, &buf, *is_rtcp, ssrc)) {
     GST_OBJECT_UNLOCK (filter);
     goto drop_buffer;
   }
@@ -1271,29 +1297,46 @@ gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
   if (gst_srtp_get_soft_limit_reached ())
     request_key_with_signal (filter, ssrc, SIGNAL_SOFT_LIMIT);
 
-push_out:
-  /* Push buffer to source pad */
+  return buf;
+
+drop_buffer:
+  gst_buffer_unref (buf);
+
+  return NULL;
+}
+
+/* Returns the source pad for RTP or RTCP packets, making sure the sticky
+ * events were sent on it */
+static GstPad *
+gst_srtp_dec_get_src_pad (GstSrtpDec * filter, gboolean is_rtcp)
+{
   if (is_rtcp) {
-    otherpad = filter->rtcp_srcpad;
     if (!filter->rtcp_has_segment)
       gst_srtp_dec_push_early_events (filter, filter->rtcp_srcpad,
           filter->rtp_srcpad, TRUE);
+    return filter->rtcp_srcpad;
   } else {
-    otherpad = filter->rtp_srcpad;
     if (!filter->rtp_has_segment)
       gst_srtp_dec_push_early_events (filter, filter->rtp_srcpad,
           filter->rtcp_srcpad, FALSE);
+    return filter->rtp_srcpad;
   }
-  ret = gst_pad_push (otherpad, buf);
+}
 
-  return ret;
+static GstFlowReturn
+gst_srtp_dec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf,
+    gboolean is_rtcp)
+{
+  GstSrtpDec *filter = GST_SRTP_DEC (parent);
 
-drop_buffer:
-  /* Drop buffer, except if gst_pad_push returned OK or an error */
+  buf = gst_srtp_dec_process_buffer (filter, pad, buf, &is_rtcp);
 
-  gst_buffer_unref (buf);
+  /* Drop buffer */
+  if (buf == NULL)
+    return GST_FLOW_OK;
 
-  return ret;
+  /* Push buffer to source pad */
+  return gst_pad_push (gst_srtp_dec_get_src_pad (filter, is_rtcp), buf);
 }
 
 static GstFlowReturn
@@ -1308,6 +1351,96 @@ gst_srtp_dec_chain_rtcp (GstPad * pad, GstObject * parent, GstBuffer * buf)
   return gst_srtp_dec_chain (pad, parent, buf, TRUE);
 }
 
+typedef struct
+{
+  GstSrtpDec *filter;
+  GstPad *pad;
+  gboolean is_rtcp;
+  GstBufferList *rtp_list;
+  GstBufferList *rtcp_list;
+} ProcessBufferItData;
+
+static gboolean
+process_buffer_it (GstBuffer ** buffer, guint index, gpointer user_data)
+{
+  ProcessBufferItData *data = user_data;
+  gboolean is_rtcp = data->is_rtcp;
+  GstBuffer *buf;
+
+  /* Take the buffer out of the list, so it can be decoded in place if
+   * nobody else holds a reference to it */
+  buf = *buffer;
+  *buffer = NULL;
+
+  buf = gst_srtp_dec_process_buffer (data->filter, data->pad, buf, &is_rtcp);
+  if (buf)
+    gst_buffer_list_add (is_rtcp ? data->rtcp_list : data->rtp_list, buf);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_srtp_dec_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * buf_list, gboolean is_rtcp)
+{
+  GstSrtpDec *filter = GST_SRTP_DEC (parent);
+  GstFlowReturn ret = GST_FLOW_OK, rtcp_ret;
+  ProcessBufferItData process_data;
+  guint len;
+
+  len = gst_buffer_list_length (buf_list);
+
+  GST_LOG_OBJECT (pad, "Buffer chain with list of %u", len);
+
+  if (len == 0) {
+    gst_buffer_list_unref (buf_list);
+    return GST_FLOW_OK;
+  }
+
+  buf_list = gst_buffer_list_make_writable (buf_list);
+
+  process_data.filter = filter;
+  process_data.pad = pad;
+  process_data.is_rtcp = is_rtcp;
+  process_data.rtp_list = gst_buffer_list_new_sized (is_rtcp ? 0 : len);
+  process_data.rtcp_list = gst_buffer_list_new_sized (is_rtcp ? len : 0);
+
+  gst_buffer_list_foreach (buf_list, process_buffer_it, &process_data);
+  gst_buffer_list_unref (buf_list);
+
+  /* Push buffers to source pads */
+  if (gst_buffer_list_length (process_data.rtp_list) > 0)
+    ret = gst_pad_push_list (gst_srtp_dec_get_src_pad (filter, FALSE),
+        process_data.rtp_list);
+  else
+    gst_buffer_list_unref (process_data.rtp_list);
+
+  if (gst_buffer_list_length (process_data.rtcp_list) > 0) {
+    rtcp_ret = gst_pad_push_list (gst_srtp_dec_get_src_pad (filter, TRUE),
+        process_data.rtcp_list);
+    if (ret == GST_FLOW_OK)
+      ret = rtcp_ret;
+  } else {
+    gst_buffer_list_unref (process_data.rtcp_list);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_srtp_dec_chain_list_rtp (GstPad * pad, GstObject * parent,
+    GstBufferList * buf_list)
+{
+  return gst_srtp_dec_chain_list (pad, parent, buf_list, FALSE);
+}
+
+static GstFlowReturn
+gst_srtp_dec_chain_list_rtcp (GstPad * pad, GstObject * parent,
+    GstBufferList * buf_list)
+{
+  return gst_srtp_dec_chain_list (pad, parent, buf_list, TRUE);
+}
+
 static GstStateChangeReturn
 gst_srtp_dec_change_state (GstElement * element, GstStateChange transition)
 {
@@ -1321,6 +1454,7 @@ gst_srtp_dec_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_READY_TO_PAUSED:
       filter->streams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
           NULL, (GDestroyNotify) free_stream);
+      filter->last_stream = NULL;
       filter->rtp_has_segment = FALSE;
       filter->rtcp_has_segment = FALSE;
       break;
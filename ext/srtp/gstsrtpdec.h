@@ -81,6 +81,11 @@ struct _GstSrtpDec
   gboolean first_session;
   GHashTable *streams;
 
+  /* last stream found by SSRC, consecutive packets mostly belong to the
+   * same stream */
+  GstSrtpDecSsrcStream *last_stream;
+  guint32 last_ssrc;
+
   gboolean rtp_has_segment;
   gboolean rtcp_has_segment;
 
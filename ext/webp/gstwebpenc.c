@@ -37,13 +37,30 @@ enum
   PROP_LOSSLESS,
   PROP_QUALITY,
   PROP_SPEED,
-  PROP_PRESET
+  PROP_PRESET,
+  PROP_MAX_THREADS
 };
 
 #define DEFAULT_LOSSLESS FALSE
 #define DEFAULT_QUALITY 90
 #define DEFAULT_SPEED 4
 #define DEFAULT_PRESET WEBP_PRESET_PHOTO
+#define DEFAULT_MAX_THREADS 1
+
+/* A frame that is encoded by one of the encoding threads. Jobs are kept
+ * around after their frame is finished, so that the picture and output
+ * memory can be reused by later frames of the same size */
+typedef struct
+{
+  GstVideoCodecFrame *frame;
+  GstVideoFrame vframe;
+
+  struct WebPPicture picture;
+  WebPMemoryWriter writer;
+  gboolean use_argb;
+
+  gboolean ok;
+} GstWebpEncJob;
 
 static void gst_webp_enc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
@@ -57,12 +74,19 @@ static GstFlowReturn gst_webp_enc_handle_frame (GstVideoEncoder * encoder,
     GstVideoCodecFrame * frame);
 static gboolean gst_webp_enc_propose_allocation (GstVideoEncoder * encoder,
     GstQuery * query);
+static GstFlowReturn gst_webp_enc_finish (GstVideoEncoder * encoder);
+static gboolean gst_webp_enc_flush (GstVideoEncoder * encoder);
+static void gst_webp_enc_encode_job (GstWebpEncJob * job, GstWebpEnc * enc);
+static GstFlowReturn gst_webp_enc_finish_queued_job (GstWebpEncJob * job,
+    gboolean drop, GstWebpEnc * enc);
+static void gst_webp_enc_discard_job (GstWebpEncJob * job, GstWebpEnc * enc);
 
 static GstStaticPadTemplate webp_enc_sink_factory =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ I420, YV12, RGB, RGBA}"))
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE
+        ("{ I420, YV12, RGB, RGBA, BGR, BGRA }"))
     );
 static GstStaticPadTemplate webp_enc_src_factory =
 GST_STATIC_PAD_TEMPLATE ("src",
@@ -136,6 +160,8 @@ gst_webp_enc_class_init (GstWebpEncClass * klass)
   venc_class->set_format = gst_webp_enc_set_format;
   venc_class->handle_frame = gst_webp_enc_handle_frame;
   venc_class->propose_allocation = gst_webp_enc_propose_allocation;
+  venc_class->finish = gst_webp_enc_finish;
+  venc_class->flush = gst_webp_enc_flush;
 
   g_object_class_install_property (gobject_class, PROP_LOSSLESS,
       g_param_spec_boolean ("lossless", "Lossless",
@@ -155,6 +181,18 @@ gst_webp_enc_class_init (GstWebpEncClass * klass)
           GST_WEBP_ENC_PRESET_TYPE, DEFAULT_PRESET,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstWebpEnc:max-threads:
+   *
+   * Number of threads that encode frames in parallel. Frames are still
+   * output in input order.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of frames to encode in parallel (0 = automatic, "
+          "1 = encode in the streaming thread)", 0, G_MAXINT,
+          DEFAULT_MAX_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   GST_DEBUG_CATEGORY_INIT (webpenc_debug, "webpenc", 0,
       "WEBP encoding element");
 }
@@ -169,8 +207,12 @@ gst_webp_enc_init (GstWebpEnc * webpenc)
   webpenc->speed = DEFAULT_SPEED;
   webpenc->preset = DEFAULT_PRESET;
 
+  webpenc->max_threads = DEFAULT_MAX_THREADS;
+
   webpenc->use_argb = FALSE;
   webpenc->rgb_format = GST_VIDEO_FORMAT_UNKNOWN;
+
+  g_queue_init (&webpenc->free_jobs);
 }
 
 static gboolean
@@ -181,9 +223,16 @@ gst_webp_enc_set_format (GstVideoEncoder * encoder, GstVideoCodecState * state)
   GstVideoInfo *info;
   GstVideoFormat format;
 
+  /* frames in flight were set up for the previous format */
+  if (enc->jobs && gst_video_job_queue_finish (enc->jobs, 0) != GST_FLOW_OK) {
+    GST_WARNING_OBJECT (enc, "Failed to finish pending frames");
+    return FALSE;
+  }
+
   info = &state->info;
   format = GST_VIDEO_INFO_FORMAT (info);
 
+  enc->use_argb = FALSE;
   if (GST_VIDEO_INFO_IS_YUV (info)) {
     switch (format) {
       case GST_VIDEO_FORMAT_I420:
@@ -212,99 +261,258 @@ gst_webp_enc_set_format (GstVideoEncoder * encoder, GstVideoCodecState * state)
   return TRUE;
 }
 
+static GstWebpEncJob *
+gst_webp_enc_get_job (GstWebpEnc * enc)
+{
+  GstWebpEncJob *job;
+
+  job = g_queue_pop_head (&enc->free_jobs);
+  if (!job) {
+    job = g_slice_new0 (GstWebpEncJob);
+    WebPMemoryWriterInit (&job->writer);
+  }
+
+  return job;
+}
+
+static void
+gst_webp_enc_free_job (GstWebpEncJob * job)
+{
+  WebPPictureFree (&job->picture);
+  free (job->writer.mem);
+  g_slice_free (GstWebpEncJob, job);
+}
+
+/* Returns a job to the free list once its frame is finished */
+static void
+gst_webp_enc_release_job (GstWebpEnc * enc, GstWebpEncJob * job)
+{
+  gst_video_frame_unmap (&job->vframe);
+  job->frame = NULL;
+  g_queue_push_head (&enc->free_jobs, job);
+}
+
 static gboolean
-gst_webp_set_picture_params (GstWebpEnc * enc)
+gst_webp_set_picture_params (GstWebpEnc * enc, GstWebpEncJob * job)
 {
+  struct WebPPicture *picture = &job->picture;
   GstVideoInfo *info;
-  gboolean ret = TRUE;
 
   info = &enc->input_state->info;
 
-  if (!WebPPictureInit (&enc->webp_picture)) {
-    ret = FALSE;
-    goto failed_pic_init;
+  /* the ARGB memory of a picture is kept for all frames of the same size,
+   * instead of being reallocated by WebPPictureImportRGB() every time */
+  if (picture->width != GST_VIDEO_INFO_WIDTH (info)
+      || picture->height != GST_VIDEO_INFO_HEIGHT (info)
+      || job->use_argb != enc->use_argb) {
+    WebPPictureFree (picture);
+    if (!WebPPictureInit (picture))
+      goto failed_pic_init;
+
+    picture->width = GST_VIDEO_INFO_WIDTH (info);
+    picture->height = GST_VIDEO_INFO_HEIGHT (info);
+    job->use_argb = enc->use_argb;
+
+    if (enc->use_argb) {
+      picture->use_argb = 1;
+      if (!WebPPictureAlloc (picture))
+        goto failed_pic_init;
+    }
   }
 
-  enc->webp_picture.use_argb = enc->use_argb;
-  if (!enc->use_argb)
-    enc->webp_picture.colorspace = enc->webp_color_space;
-
-  enc->webp_picture.width = GST_VIDEO_INFO_WIDTH (info);
-  enc->webp_picture.height = GST_VIDEO_INFO_HEIGHT (info);
+  if (enc->use_argb) {
+    /* lossy encoding converts the picture to YUV and clears this */
+    picture->use_argb = 1;
+  } else {
+    /* YUV input is encoded straight from the frame. Lossless encoding
+     * converts it to ARGB memory owned by the picture, which would be
+     * encoded again instead of the next frame, so drop it */
+    WebPPictureFree (picture);
+    picture->use_argb = 0;
+    picture->colorspace = enc->webp_color_space;
+
+    picture->y = GST_VIDEO_FRAME_COMP_DATA (&job->vframe, 0);
+    picture->u = GST_VIDEO_FRAME_COMP_DATA (&job->vframe, 1);
+    picture->v = GST_VIDEO_FRAME_COMP_DATA (&job->vframe, 2);
+
+    picture->y_stride = GST_VIDEO_FRAME_COMP_STRIDE (&job->vframe, 0);
+    picture->uv_stride = GST_VIDEO_FRAME_COMP_STRIDE (&job->vframe, 1);
+  }
 
-  WebPMemoryWriterInit (&enc->webp_writer);
-  enc->webp_picture.writer = WebPMemoryWrite;
-  enc->webp_picture.custom_ptr = &enc->webp_writer;
+  /* the output memory grows to the largest frame and is then reused */
+  job->writer.size = 0;
+  picture->writer = WebPMemoryWrite;
+  picture->custom_ptr = &job->writer;
 
-  return ret;
+  return TRUE;
 
 failed_pic_init:
   {
     GST_ERROR_OBJECT (enc, "Failed to Initialize WebPPicture !");
-    return ret;
+    return FALSE;
+  }
+}
+
+/* Packs RGB(A) input into the ARGB words of the picture, the same
+ * conversion WebPPictureImportRGB() does */
+static void
+gst_webp_enc_fill_argb (struct WebPPicture *picture, GstVideoFrame * vframe)
+{
+  const guint8 *r, *g, *b, *a;
+  gint pstride, stride;
+  gint x, y;
+
+  r = GST_VIDEO_FRAME_COMP_DATA (vframe, GST_VIDEO_COMP_R);
+  g = GST_VIDEO_FRAME_COMP_DATA (vframe, GST_VIDEO_COMP_G);
+  b = GST_VIDEO_FRAME_COMP_DATA (vframe, GST_VIDEO_COMP_B);
+  a = GST_VIDEO_INFO_HAS_ALPHA (&vframe->info) ?
+      GST_VIDEO_FRAME_COMP_DATA (vframe, GST_VIDEO_COMP_A) : NULL;
+  pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (vframe, 0);
+  stride = GST_VIDEO_FRAME_PLANE_STRIDE (vframe, 0);
+
+  for (y = 0; y < picture->height; y++) {
+    uint32_t *argb = picture->argb + y * picture->argb_stride;
+    gint offset = y * stride;
+
+    for (x = 0; x < picture->width; x++) {
+      argb[x] = ((guint32) (a ? a[offset] : 0xff) << 24) |
+          ((guint32) r[offset] << 16) | ((guint32) g[offset] << 8) |
+          b[offset];
+      offset += pstride;
+    }
   }
 }
 
+/* Encodes the frame of @job, called from the encoding threads */
+static void
+gst_webp_enc_encode_frame (GstWebpEnc * enc, GstWebpEncJob * job)
+{
+  if (job->use_argb)
+    gst_webp_enc_fill_argb (&job->picture, &job->vframe);
+
+  job->ok = WebPEncode (&enc->webp_config, &job->picture);
+}
+
+/* Finishes the frame of @job with its encoded output and releases the job.
+ * Takes ownership of the frame */
+static GstFlowReturn
+gst_webp_enc_finish_job (GstWebpEnc * enc, GstWebpEncJob * job)
+{
+  GstVideoCodecFrame *frame = job->frame;
+  GstBuffer *out_buffer;
+
+  if (!job->ok) {
+    GST_ELEMENT_ERROR (enc, STREAM, ENCODE, ("Failed to encode WebPPicture"),
+        ("error code %d", job->picture.error_code));
+    gst_webp_enc_release_job (enc, job);
+    gst_video_codec_frame_unref (frame);
+    return GST_FLOW_ERROR;
+  }
+
+  out_buffer = gst_buffer_new_allocate (NULL, job->writer.size, NULL);
+  if (!out_buffer) {
+    GST_ERROR_OBJECT (enc, "Failed to create output buffer");
+    gst_webp_enc_release_job (enc, job);
+    gst_video_codec_frame_unref (frame);
+    return GST_FLOW_ERROR;
+  }
+  gst_buffer_fill (out_buffer, 0, job->writer.mem, job->writer.size);
+
+  gst_webp_enc_release_job (enc, job);
+
+  frame->output_buffer = out_buffer;
+  return gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (enc), frame);
+}
+
+static void
+gst_webp_enc_encode_job (GstWebpEncJob * job, GstWebpEnc * enc)
+{
+  gst_webp_enc_encode_frame (enc, job);
+}
+
+/* Finishes a frame that was encoded by the encoding threads. Frames after a
+ * failed one are finished without output, which drops them */
+static GstFlowReturn
+gst_webp_enc_finish_queued_job (GstWebpEncJob * job, gboolean drop,
+    GstWebpEnc * enc)
+{
+  GstVideoCodecFrame *frame = job->frame;
+
+  if (!drop)
+    return gst_webp_enc_finish_job (enc, job);
+
+  gst_webp_enc_release_job (enc, job);
+  return gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (enc), frame);
+}
+
+static void
+gst_webp_enc_discard_job (GstWebpEncJob * job, GstWebpEnc * enc)
+{
+  gst_video_codec_frame_unref (job->frame);
+  gst_webp_enc_release_job (enc, job);
+}
+
 static GstFlowReturn
 gst_webp_enc_handle_frame (GstVideoEncoder * encoder,
     GstVideoCodecFrame * frame)
 {
   GstWebpEnc *enc = GST_WEBP_ENC (encoder);
-  GstBuffer *out_buffer = NULL;
-  GstVideoFrame vframe;
+  GstWebpEncJob *job;
 
   GST_LOG_OBJECT (enc, "got new frame");
 
-  gst_webp_set_picture_params (enc);
+  job = gst_webp_enc_get_job (enc);
 
-  if (!gst_video_frame_map (&vframe, &enc->input_state->info,
-          frame->input_buffer, GST_MAP_READ))
+  if (!gst_video_frame_map (&job->vframe, &enc->input_state->info,
+          frame->input_buffer, GST_MAP_READ)) {
+    g_queue_push_head (&enc->free_jobs, job);
+    gst_video_codec_frame_unref (frame);
+    GST_ELEMENT_ERROR (enc, CORE, FAILED, ("Failed to map input buffer"),
+        (NULL));
     return GST_FLOW_ERROR;
+  }
+  job->frame = frame;
 
-  if (!enc->use_argb) {
-    enc->webp_picture.y = GST_VIDEO_FRAME_COMP_DATA (&vframe, 0);
-    enc->webp_picture.u = GST_VIDEO_FRAME_COMP_DATA (&vframe, 1);
-    enc->webp_picture.v = GST_VIDEO_FRAME_COMP_DATA (&vframe, 2);
-
-    enc->webp_picture.y_stride = GST_VIDEO_FRAME_COMP_STRIDE (&vframe, 0);
-    enc->webp_picture.uv_stride = GST_VIDEO_FRAME_COMP_STRIDE (&vframe, 1);
+  if (!gst_webp_set_picture_params (enc, job)) {
+    gst_webp_enc_release_job (enc, job);
+    gst_video_codec_frame_unref (frame);
+    GST_ELEMENT_ERROR (enc, LIBRARY, INIT,
+        ("Failed to initialize WebPPicture"), (NULL));
+    return GST_FLOW_ERROR;
+  }
 
-  } else {
-    switch (enc->rgb_format) {
-      case GST_VIDEO_FORMAT_RGB:
-        WebPPictureImportRGB (&enc->webp_picture,
-            GST_VIDEO_FRAME_COMP_DATA (&vframe, 0),
-            GST_VIDEO_FRAME_COMP_STRIDE (&vframe, 0));
-        break;
-      case GST_VIDEO_FORMAT_RGBA:
-        WebPPictureImportRGBA (&enc->webp_picture,
-            GST_VIDEO_FRAME_COMP_DATA (&vframe, 0),
-            GST_VIDEO_FRAME_COMP_STRIDE (&vframe, 0));
-        break;
-      default:
-        break;
-    }
+  if (!enc->jobs) {
+    gst_webp_enc_encode_frame (enc, job);
+    return gst_webp_enc_finish_job (enc, job);
   }
 
-  if (WebPEncode (&enc->webp_config, &enc->webp_picture)) {
-    WebPPictureFree (&enc->webp_picture);
+  return gst_video_job_queue_push (enc->jobs, job, enc->n_threads);
+}
 
-    out_buffer = gst_buffer_new_allocate (NULL, enc->webp_writer.size, NULL);
-    if (!out_buffer) {
-      GST_ERROR_OBJECT (enc, "Failed to create output buffer");
-      return GST_FLOW_ERROR;
-    }
-    gst_buffer_fill (out_buffer, 0, enc->webp_writer.mem,
-        enc->webp_writer.size);
-    free (enc->webp_writer.mem);
-  } else {
-    GST_ERROR_OBJECT (enc, "Failed to encode WebPPicture");
-    return GST_FLOW_ERROR;
-  }
+static GstFlowReturn
+gst_webp_enc_finish (GstVideoEncoder * encoder)
+{
+  GstWebpEnc *enc = GST_WEBP_ENC (encoder);
 
-  gst_video_frame_unmap (&vframe);
-  frame->output_buffer = out_buffer;
-  return gst_video_encoder_finish_frame (encoder, frame);
+  GST_DEBUG_OBJECT (enc, "Draining");
+
+  if (!enc->jobs)
+    return GST_FLOW_OK;
+
+  return gst_video_job_queue_finish (enc->jobs, 0);
+}
+
+static gboolean
+gst_webp_enc_flush (GstVideoEncoder * encoder)
+{
+  GstWebpEnc *enc = GST_WEBP_ENC (encoder);
+
+  GST_DEBUG_OBJECT (enc, "Flushing");
+
+  if (enc->jobs)
+    gst_video_job_queue_discard (enc->jobs);
+
+  return TRUE;
 }
 
 static gboolean
@@ -335,6 +543,9 @@ gst_webp_enc_set_property (GObject * object, guint prop_id,
     case PROP_PRESET:
       webpenc->preset = g_value_get_enum (value);
       break;
+    case PROP_MAX_THREADS:
+      webpenc->max_threads = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -361,6 +572,9 @@ gst_webp_enc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_PRESET:
       g_value_set_enum (value, webpenc->preset);
       break;
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, webpenc->max_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -383,6 +597,28 @@ gst_webp_enc_start (GstVideoEncoder * benc)
     GST_ERROR_OBJECT (enc, "Failed to Validate the WebPConfig");
     return FALSE;
   }
+
+  if (enc->max_threads == 0)
+    enc->n_threads = g_get_num_processors ();
+  else
+    enc->n_threads = enc->max_threads;
+
+  if (enc->n_threads > 1) {
+    GError *err = NULL;
+
+    enc->jobs = gst_video_job_queue_new (enc->n_threads,
+        (GstVideoJobFunc) gst_webp_enc_encode_job,
+        (GstVideoJobFinishFunc) gst_webp_enc_finish_queued_job,
+        (GstVideoJobFunc) gst_webp_enc_discard_job, enc, &err);
+    if (!enc->jobs) {
+      GST_ELEMENT_ERROR (enc, RESOURCE, FAILED,
+          ("Failed to create encoding threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+    GST_DEBUG_OBJECT (enc, "Encoding with %u threads", enc->n_threads);
+  }
+
   return TRUE;
 }
 
@@ -390,8 +626,19 @@ static gboolean
 gst_webp_enc_stop (GstVideoEncoder * benc)
 {
   GstWebpEnc *enc = GST_WEBP_ENC (benc);
+  GstWebpEncJob *job;
+
+  if (enc->jobs) {
+    gst_video_job_queue_free (enc->jobs);
+    enc->jobs = NULL;
+  }
+
+  while ((job = g_queue_pop_head (&enc->free_jobs)))
+    gst_webp_enc_free_job (job);
+
   if (enc->input_state)
     gst_video_codec_state_unref (enc->input_state);
+  enc->input_state = NULL;
   return TRUE;
 }
 
@@ -21,6 +21,7 @@
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
+#include <gst/video/gstvideojobqueue.h>
 #include <webp/encode.h>
 
 G_BEGIN_DECLS
@@ -60,8 +61,15 @@ struct _GstWebpEnc
 
   WebPEncCSP webp_color_space;
   struct WebPConfig webp_config;
-  struct WebPPicture webp_picture;
-  WebPMemoryWriter webp_writer;
+
+  gint max_threads;
+  guint n_threads;
+
+  /* frame threading, frames are queued in input order */
+  GstVideoJobQueue *jobs;
+
+  /* finished jobs, their pictures are reused for the next frames */
+  GQueue free_jobs;
 };
 
 struct _GstWebpEncClass
@@ -32,6 +32,7 @@
 #endif
 
 #include "gstx265enc.h"
+#include "gstx265ladderenc.h"
 
 #include <gst/pbutils/pbutils.h>
 #include <gst/video/video.h>
@@ -64,14 +65,7 @@ static GString *x265enc_defaults;
 #define PROP_SPEED_PRESET_DEFAULT        6      // Medium
 #define PROP_TUNE_DEFAULT                2      // SSIM
 
-#if G_BYTE_ORDER == G_LITTLE_ENDIAN
-#define FORMATS "I420, Y444, I420_10LE, Y444_10LE"
-#else
-#define FORMATS "I420, Y444, I420_10BE, Y444_10BE"
-#endif
-
-#define GST_X265_ENC_LOG_LEVEL_TYPE (gst_x265_enc_log_level_get_type())
-static GType
+GType
 gst_x265_enc_log_level_get_type (void)
 {
   static GType log_level = 0;
@@ -92,8 +86,7 @@ gst_x265_enc_log_level_get_type (void)
   return log_level;
 }
 
-#define GST_X265_ENC_SPEED_PRESET_TYPE (gst_x265_enc_speed_preset_get_type())
-static GType
+GType
 gst_x265_enc_speed_preset_get_type (void)
 {
   static GType speed_preset = 0;
@@ -124,8 +117,7 @@ gst_x265_enc_speed_preset_get_type (void)
   return speed_preset;
 }
 
-#define GST_X265_ENC_TUNE_TYPE (gst_x265_enc_tune_get_type())
-static GType
+GType
 gst_x265_enc_tune_get_type (void)
 {
   static GType tune = 0;
@@ -279,7 +271,7 @@ gst_x265_enc_add_x265_chroma_format (GstStructure * s,
     gst_structure_take_value (s, "format", &fmt);
 }
 
-static GstCaps *
+GstCaps *
 gst_x265_enc_get_supported_input_caps (void)
 {
   GstCaps *caps;
@@ -545,7 +537,7 @@ gst_x265_enc_finalize (GObject * object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
-static gint
+gint
 gst_x265_enc_gst_to_x265_video_format (GstVideoFormat format, gint * nplanes)
 {
   switch (format) {
@@ -569,14 +561,16 @@ gst_x265_enc_gst_to_x265_video_format (GstVideoFormat format, gint * nplanes)
 
 /*
  * gst_x265_enc_parse_options
- * @encoder: Encoder to which options are assigned
+ * @object: Element the options belong to, for logging
+ * @param: x265 parameters to which options are assigned
  * @str: Option string
  *
  * Parse option string and assign to x265 parameters
  *
  */
-static gboolean
-gst_x265_enc_parse_options (GstX265Enc * encoder, const gchar * str)
+gboolean
+gst_x265_enc_parse_options (GstObject * object, x265_param * param,
+    const gchar * str)
 {
   GStrv kvpairs;
   guint npairs, i;
@@ -592,15 +586,14 @@ gst_x265_enc_parse_options (GstX265Enc * encoder, const gchar * str)
   for (i = 0; i < npairs; i++) {
     GStrv key_val = g_strsplit (kvpairs[i], "=", 2);
 
-    parse_result =
-        x265_param_parse (&encoder->x265param, key_val[0], key_val[1]);
+    parse_result = x265_param_parse (param, key_val[0], key_val[1]);
 
     if (parse_result == X265_PARAM_BAD_NAME) {
-      GST_ERROR_OBJECT (encoder, "Bad name for option %s=%s",
+      GST_ERROR_OBJECT (object, "Bad name for option %s=%s",
           key_val[0] ? key_val[0] : "", key_val[1] ? key_val[1] : "");
     }
     if (parse_result == X265_PARAM_BAD_VALUE) {
-      GST_ERROR_OBJECT (encoder,
+      GST_ERROR_OBJECT (object,
           "Bad value for option %s=%s (Note: a NULL value for a non-boolean triggers this)",
           key_val[0] ? key_val[0] : "", key_val[1] ? key_val[1] : "");
     }
@@ -678,8 +671,8 @@ gst_x265_enc_init_encoder (GstX265Enc * encoder)
   if (encoder->option_string_prop && encoder->option_string_prop->len) {
     GST_DEBUG_OBJECT (encoder, "Applying option-string: %s",
         encoder->option_string_prop->str);
-    if (gst_x265_enc_parse_options (encoder,
-            encoder->option_string_prop->str) == FALSE) {
+    if (gst_x265_enc_parse_options (GST_OBJECT (encoder),
+            &encoder->x265param, encoder->option_string_prop->str) == FALSE) {
       GST_DEBUG_OBJECT (encoder, "Your option-string contains errors.");
       GST_OBJECT_UNLOCK (encoder);
       return FALSE;
@@ -755,8 +748,9 @@ x265_nal_free (x265_nal * nal)
   g_free (nal);
 }
 
-static gboolean
-gst_x265_enc_set_level_tier_and_profile (GstX265Enc * encoder, GstCaps * caps)
+gboolean
+gst_x265_enc_set_level_tier_and_profile (GstElement * encoder,
+    x265_encoder * x265enc, GstCaps * caps)
 {
   x265_nal *nal, *vps_nal;
   guint32 i_nal;
@@ -765,7 +759,7 @@ gst_x265_enc_set_level_tier_and_profile (GstX265Enc * encoder, GstCaps * caps)
 
   GST_DEBUG_OBJECT (encoder, "set profile, level and tier");
 
-  header_return = x265_encoder_headers (encoder->x265enc, &nal, &i_nal);
+  header_return = x265_encoder_headers (x265enc, &nal, &i_nal);
   if (header_return < 0) {
     GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x265 header failed."),
         ("x265_encoder_headers return code=%d", header_return));
@@ -791,8 +785,8 @@ gst_x265_enc_set_level_tier_and_profile (GstX265Enc * encoder, GstCaps * caps)
   return ret;
 }
 
-static GstBuffer *
-gst_x265_enc_get_header_buffer (GstX265Enc * encoder)
+GstBuffer *
+gst_x265_enc_get_header_buffer (GstElement * encoder, x265_encoder * x265enc)
 {
   x265_nal *nal;
   guint32 i_nal, i, offset;
@@ -800,7 +794,7 @@ gst_x265_enc_get_header_buffer (GstX265Enc * encoder)
   int header_return;
   GstBuffer *buf;
 
-  header_return = x265_encoder_headers (encoder->x265enc, &nal, &i_nal);
+  header_return = x265_encoder_headers (x265enc, &nal, &i_nal);
   if (header_return < 0) {
     GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x265 header failed."),
         ("x265_encoder_headers return code=%d", header_return));
@@ -862,7 +856,8 @@ gst_x265_enc_set_src_caps (GstX265Enc * encoder, GstCaps * caps)
       NULL);
   gst_structure_set (structure, "alignment", G_TYPE_STRING, "au", NULL);
 
-  if (!gst_x265_enc_set_level_tier_and_profile (encoder, outcaps)) {
+  if (!gst_x265_enc_set_level_tier_and_profile (GST_ELEMENT (encoder),
+          encoder->x265enc, outcaps)) {
     gst_caps_unref (outcaps);
     return FALSE;
   }
@@ -1123,7 +1118,8 @@ gst_x265_enc_encode_frame (GstX265Enc * encoder, x265_picture * pic_in,
   if (encoder->push_header) {
     GstBuffer *header;
 
-    header = gst_x265_enc_get_header_buffer (encoder);
+    header = gst_x265_enc_get_header_buffer (GST_ELEMENT (encoder),
+        encoder->x265enc);
     frame->output_buffer = gst_buffer_append (header, frame->output_buffer);
     encoder->push_header = FALSE;
   }
@@ -1257,8 +1253,12 @@ plugin_init (GstPlugin * plugin)
 
   GST_INFO ("x265 build: %u", X265_BUILD);
 
-  return gst_element_register (plugin, "x265enc",
-      GST_RANK_PRIMARY, GST_TYPE_X265_ENC);
+  if (!gst_element_register (plugin, "x265enc",
+          GST_RANK_PRIMARY, GST_TYPE_X265_ENC))
+    return FALSE;
+
+  return gst_element_register (plugin, "x265ladderenc",
+      GST_RANK_NONE, GST_TYPE_X265_LADDER_ENC);
 }
 
 GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
@@ -83,5 +83,29 @@ struct _GstX265EncClass
 
 GType gst_x265_enc_get_type (void);
 
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+#define FORMATS "I420, Y444, I420_10LE, Y444_10LE"
+#else
+#define FORMATS "I420, Y444, I420_10BE, Y444_10BE"
+#endif
+
+#define GST_X265_ENC_LOG_LEVEL_TYPE (gst_x265_enc_log_level_get_type())
+GType gst_x265_enc_log_level_get_type (void);
+#define GST_X265_ENC_SPEED_PRESET_TYPE (gst_x265_enc_speed_preset_get_type())
+GType gst_x265_enc_speed_preset_get_type (void);
+#define GST_X265_ENC_TUNE_TYPE (gst_x265_enc_tune_get_type())
+GType gst_x265_enc_tune_get_type (void);
+
+/* shared with x265ladderenc */
+GstCaps *gst_x265_enc_get_supported_input_caps (void);
+gint gst_x265_enc_gst_to_x265_video_format (GstVideoFormat format,
+    gint * nplanes);
+gboolean gst_x265_enc_parse_options (GstObject * object, x265_param * param,
+    const gchar * str);
+gboolean gst_x265_enc_set_level_tier_and_profile (GstElement * encoder,
+    x265_encoder * x265enc, GstCaps * caps);
+GstBuffer *gst_x265_enc_get_header_buffer (GstElement * encoder,
+    x265_encoder * x265enc);
+
 G_END_DECLS
 #endif /* __GST_X265_ENC_H__ */
@@ -0,0 +1,1332 @@
+/* GStreamer H265 multi-rendition encoder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-x265ladderenc
+ *
+ * This element encodes raw video into several H265 renditions at once, as
+ * needed for adaptive streaming. Every requested source pad is one rendition
+ * with its own resolution and bitrate. The input frame is shared between the
+ * renditions, which are scaled and encoded in parallel by a common pool of
+ * threads.
+ *
+ * All renditions use the same fixed GOP structure without scene-cut
+ * detection, so that their keyframes are aligned and a player can switch
+ * between them at every keyframe.
+ *
+ * <refsect2>
+ * <title>Example pipeline</title>
+ * |[
+ * gst-launch-1.0 videotestsrc num-buffers=300 ! x265ladderenc name=l \
+ *     src_0::bitrate=4000 \
+ *     src_1::height=540 src_1::bitrate=1500 \
+ *     src_2::height=360 src_2::bitrate=800 \
+ *   l.src_0 ! h265parse ! matroskamux ! filesink location=high.mkv \
+ *   l.src_1 ! h265parse ! matroskamux ! filesink location=mid.mkv \
+ *   l.src_2 ! h265parse ! matroskamux ! filesink location=low.mkv
+ * ]|
+ * </refsect2>
+ **/
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gstx265enc.h"
+#include "gstx265ladderenc.h"
+
+#include <gst/video/gstvideometa.h>
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC (x265_ladder_enc_debug);
+#define GST_CAT_DEFAULT x265_ladder_enc_debug
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_WIDTH,
+  PROP_PAD_HEIGHT,
+  PROP_PAD_BITRATE
+};
+
+#define PROP_PAD_WIDTH_DEFAULT          0
+#define PROP_PAD_HEIGHT_DEFAULT         0
+#define PROP_PAD_BITRATE_DEFAULT        (2 * 1024)
+
+enum
+{
+  PROP_0,
+  PROP_X265_LOG_LEVEL,
+  PROP_SPEED_PRESET,
+  PROP_TUNE,
+  PROP_KEY_INT_MAX,
+  PROP_OPTION_STRING,
+  PROP_MAX_THREADS
+};
+
+#define PROP_LOG_LEVEL_DEFAULT          -1      // None
+#define PROP_SPEED_PRESET_DEFAULT       6       // Medium
+#define PROP_TUNE_DEFAULT               2       // SSIM
+#define PROP_KEY_INT_MAX_DEFAULT        0
+#define PROP_OPTION_STRING_DEFAULT      ""
+#define PROP_MAX_THREADS_DEFAULT        0
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw, "
+        "format = (string) { " FORMATS " }, "
+        "framerate = (fraction) [0, MAX], "
+        "width = (int) [ 4, MAX ], " "height = (int) [ 4, MAX ]")
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS ("video/x-h265, "
+        "framerate = (fraction) [0/1, MAX], "
+        "width = (int) [ 4, MAX ], " "height = (int) [ 4, MAX ], "
+        "stream-format = (string) byte-stream, " "alignment = (string) au")
+    );
+
+/* GstX265LadderPad */
+
+G_DEFINE_TYPE (GstX265LadderPad, gst_x265_ladder_pad, GST_TYPE_PAD);
+
+static void
+gst_x265_ladder_pad_close (GstX265LadderPad * pad)
+{
+  if (pad->x265enc != NULL) {
+    x265_encoder_close (pad->x265enc);
+    pad->x265enc = NULL;
+  }
+  if (pad->convert != NULL) {
+    gst_video_converter_free (pad->convert);
+    pad->convert = NULL;
+  }
+  gst_buffer_replace (&pad->scaled, NULL);
+  gst_buffer_replace (&pad->outbuf, NULL);
+}
+
+static void
+gst_x265_ladder_pad_finalize (GObject * object)
+{
+  GstX265LadderPad *pad = GST_X265_LADDER_PAD (object);
+
+  gst_x265_ladder_pad_close (pad);
+
+  G_OBJECT_CLASS (gst_x265_ladder_pad_parent_class)->finalize (object);
+}
+
+static void
+gst_x265_ladder_pad_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstX265LadderPad *pad = GST_X265_LADDER_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      pad->width = g_value_get_int (value);
+      break;
+    case PROP_PAD_HEIGHT:
+      pad->height = g_value_get_int (value);
+      break;
+    case PROP_PAD_BITRATE:
+      pad->bitrate = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+gst_x265_ladder_pad_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstX265LadderPad *pad = GST_X265_LADDER_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (prop_id) {
+    case PROP_PAD_WIDTH:
+      g_value_set_int (value, pad->width);
+      break;
+    case PROP_PAD_HEIGHT:
+      g_value_set_int (value, pad->height);
+      break;
+    case PROP_PAD_BITRATE:
+      g_value_set_uint (value, pad->bitrate);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+gst_x265_ladder_pad_class_init (GstX265LadderPadClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->set_property = gst_x265_ladder_pad_set_property;
+  gobject_class->get_property = gst_x265_ladder_pad_get_property;
+  gobject_class->finalize = gst_x265_ladder_pad_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_PAD_WIDTH,
+      g_param_spec_int ("width", "Width",
+          "Width of this rendition (0 = keep the aspect ratio of the input)",
+          0, G_MAXINT, PROP_PAD_WIDTH_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PAD_HEIGHT,
+      g_param_spec_int ("height", "Height",
+          "Height of this rendition (0 = keep the aspect ratio of the input)",
+          0, G_MAXINT, PROP_PAD_HEIGHT_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PAD_BITRATE,
+      g_param_spec_uint ("bitrate", "Bitrate",
+          "Bitrate of this rendition in kbit/sec", 1, 100 * 1024,
+          PROP_PAD_BITRATE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_x265_ladder_pad_init (GstX265LadderPad * pad)
+{
+  pad->width = PROP_PAD_WIDTH_DEFAULT;
+  pad->height = PROP_PAD_HEIGHT_DEFAULT;
+  pad->bitrate = PROP_PAD_BITRATE_DEFAULT;
+
+  pad->need_stream_start = TRUE;
+  pad->need_caps = TRUE;
+  pad->need_segment = TRUE;
+}
+
+/* GstX265LadderEnc */
+
+static void gst_x265_ladder_enc_child_proxy_init (gpointer g_iface,
+    gpointer iface_data);
+
+static void gst_x265_ladder_enc_finalize (GObject * object);
+static void gst_x265_ladder_enc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_x265_ladder_enc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static GstStateChangeReturn gst_x265_ladder_enc_change_state (GstElement *
+    element, GstStateChange transition);
+static GstPad *gst_x265_ladder_enc_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * req_name, const GstCaps * caps);
+static void gst_x265_ladder_enc_release_pad (GstElement * element,
+    GstPad * pad);
+
+static GstFlowReturn gst_x265_ladder_enc_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+static gboolean gst_x265_ladder_enc_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_x265_ladder_enc_sink_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static gboolean gst_x265_ladder_enc_src_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+
+static void gst_x265_ladder_enc_encode_job (GstX265LadderPad * pad,
+    GstX265LadderEnc * ladder);
+
+#define gst_x265_ladder_enc_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE (GstX265LadderEnc, gst_x265_ladder_enc,
+    GST_TYPE_ELEMENT, G_IMPLEMENT_INTERFACE (GST_TYPE_CHILD_PROXY,
+        gst_x265_ladder_enc_child_proxy_init));
+
+static void
+gst_x265_ladder_enc_class_init (GstX265LadderEncClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *element_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->set_property = gst_x265_ladder_enc_set_property;
+  gobject_class->get_property = gst_x265_ladder_enc_get_property;
+  gobject_class->finalize = gst_x265_ladder_enc_finalize;
+
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_change_state);
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_request_new_pad);
+  element_class->release_pad =
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_release_pad);
+
+  g_object_class_install_property (gobject_class, PROP_X265_LOG_LEVEL,
+      g_param_spec_enum ("log-level", "(internal) x265 log level",
+          "x265 log level", GST_X265_ENC_LOG_LEVEL_TYPE,
+          PROP_LOG_LEVEL_DEFAULT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_SPEED_PRESET,
+      g_param_spec_enum ("speed-preset", "Speed preset",
+          "Preset name for speed/quality tradeoff options",
+          GST_X265_ENC_SPEED_PRESET_TYPE, PROP_SPEED_PRESET_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TUNE,
+      g_param_spec_enum ("tune", "Tune options",
+          "Preset name for tuning options", GST_X265_ENC_TUNE_TYPE,
+          PROP_TUNE_DEFAULT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_KEY_INT_MAX,
+      g_param_spec_uint ("key-int-max", "Key-frame maximal interval",
+          "Distance between keyframes of all renditions "
+          "(0 = x265 default)", 0, G_MAXINT, PROP_KEY_INT_MAX_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_OPTION_STRING,
+      g_param_spec_string ("option-string", "Option string",
+          "String of x265 options applied to all renditions "
+          "(overrides element properties)", PROP_OPTION_STRING_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstX265LadderEnc:max-threads:
+   *
+   * Number of threads that scale and encode the renditions of a frame in
+   * parallel. Each x265 encoder additionally runs its own worker threads.
+   */
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_int ("max-threads", "Maximum threads",
+          "Maximum number of renditions to encode in parallel "
+          "(0 = automatic)", 0, G_MAXINT, PROP_MAX_THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_set_static_metadata (element_class,
+      "x265ladderenc", "Codec/Encoder/Video",
+      "H265 encoder producing several renditions of the same input",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  gst_element_class_add_static_pad_template (element_class, &sink_factory);
+  gst_element_class_add_static_pad_template (element_class, &src_factory);
+
+  GST_DEBUG_CATEGORY_INIT (x265_ladder_enc_debug, "x265ladderenc", 0,
+      "h265 multi-rendition encoding element");
+}
+
+static void
+gst_x265_ladder_enc_init (GstX265LadderEnc * ladder)
+{
+  ladder->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
+  gst_pad_set_chain_function (ladder->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_chain));
+  gst_pad_set_event_function (ladder->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_sink_event));
+  gst_pad_set_query_function (ladder->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_sink_query));
+  gst_element_add_pad (GST_ELEMENT (ladder), ladder->sinkpad);
+
+  ladder->flow_combiner = gst_flow_combiner_new ();
+
+  ladder->log_level = PROP_LOG_LEVEL_DEFAULT;
+  ladder->speed_preset = PROP_SPEED_PRESET_DEFAULT;
+  ladder->tune = PROP_TUNE_DEFAULT;
+  ladder->key_int_max = PROP_KEY_INT_MAX_DEFAULT;
+  ladder->option_string = g_strdup (PROP_OPTION_STRING_DEFAULT);
+  ladder->max_threads = PROP_MAX_THREADS_DEFAULT;
+
+  g_mutex_init (&ladder->lock);
+  g_cond_init (&ladder->cond);
+}
+
+static void
+gst_x265_ladder_enc_finalize (GObject * object)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (object);
+
+  gst_flow_combiner_free (ladder->flow_combiner);
+  g_free (ladder->option_string);
+  g_mutex_clear (&ladder->lock);
+  g_cond_clear (&ladder->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+/* Returns the source pads with a reference each */
+static GList *
+gst_x265_ladder_enc_get_renditions (GstX265LadderEnc * ladder)
+{
+  GList *pads;
+
+  GST_OBJECT_LOCK (ladder);
+  pads = g_list_copy_deep (GST_ELEMENT_CAST (ladder)->srcpads,
+      (GCopyFunc) gst_object_ref, NULL);
+  GST_OBJECT_UNLOCK (ladder);
+
+  return pads;
+}
+
+static void
+gst_x265_ladder_enc_close_renditions (GstX265LadderEnc * ladder)
+{
+  GList *pads, *l;
+
+  pads = gst_x265_ladder_enc_get_renditions (ladder);
+  for (l = pads; l; l = l->next)
+    gst_x265_ladder_pad_close (GST_X265_LADDER_PAD (l->data));
+  g_list_free_full (pads, gst_object_unref);
+}
+
+/*
+ * gst_x265_ladder_enc_open_rendition
+ * @ladder: Element
+ * @pad: Rendition which should be initialized.
+ *
+ * Set up scaling from the input and the x265 encoder of a rendition.
+ */
+static gboolean
+gst_x265_ladder_enc_open_rendition (GstX265LadderEnc * ladder,
+    GstX265LadderPad * pad)
+{
+  GstVideoInfo *in = &ladder->info;
+  x265_param *param = &pad->x265param;
+  const gchar *preset, *tune;
+  gint width, height, par_n, par_d;
+  guint bitrate;
+
+  GST_OBJECT_LOCK (pad);
+  width = pad->width;
+  height = pad->height;
+  bitrate = pad->bitrate;
+  GST_OBJECT_UNLOCK (pad);
+
+  /* a missing dimension is derived from the aspect ratio of the input */
+  if (width == 0 && height == 0) {
+    width = GST_VIDEO_INFO_WIDTH (in);
+    height = GST_VIDEO_INFO_HEIGHT (in);
+  } else if (width == 0) {
+    width = gst_util_uint64_scale_int (height, GST_VIDEO_INFO_WIDTH (in),
+        GST_VIDEO_INFO_HEIGHT (in));
+  } else if (height == 0) {
+    height = gst_util_uint64_scale_int (width, GST_VIDEO_INFO_HEIGHT (in),
+        GST_VIDEO_INFO_WIDTH (in));
+  }
+  /* chroma subsampling needs even dimensions */
+  width = MAX (GST_ROUND_UP_2 (width), 4);
+  height = MAX (GST_ROUND_UP_2 (height), 4);
+
+  /* keep the display aspect ratio of the input */
+  if (!gst_util_fraction_multiply (GST_VIDEO_INFO_PAR_N (in),
+          GST_VIDEO_INFO_PAR_D (in), GST_VIDEO_INFO_WIDTH (in) * height,
+          GST_VIDEO_INFO_HEIGHT (in) * width, &par_n, &par_d)) {
+    par_n = GST_VIDEO_INFO_PAR_N (in);
+    par_d = GST_VIDEO_INFO_PAR_D (in);
+  }
+
+  gst_video_info_set_format (&pad->info, GST_VIDEO_INFO_FORMAT (in), width,
+      height);
+  GST_VIDEO_INFO_FPS_N (&pad->info) = GST_VIDEO_INFO_FPS_N (in);
+  GST_VIDEO_INFO_FPS_D (&pad->info) = GST_VIDEO_INFO_FPS_D (in);
+  GST_VIDEO_INFO_PAR_N (&pad->info) = par_n;
+  GST_VIDEO_INFO_PAR_D (&pad->info) = par_d;
+  pad->info.colorimetry = in->colorimetry;
+  pad->info.chroma_site = in->chroma_site;
+
+  GST_DEBUG_OBJECT (pad, "rendition %dx%d (par %d/%d) at %u kbit/sec", width,
+      height, par_n, par_d, bitrate);
+
+  /* renditions at the input size encode straight from the input frame */
+  if (width != GST_VIDEO_INFO_WIDTH (in)
+      || height != GST_VIDEO_INFO_HEIGHT (in)) {
+    pad->convert = gst_video_converter_new (in, &pad->info, NULL);
+    if (!pad->convert) {
+      GST_ELEMENT_ERROR (ladder, CORE, NEGOTIATION, (NULL),
+          ("Can not scale to %dx%d", width, height));
+      return FALSE;
+    }
+    pad->scaled = gst_buffer_new_allocate (NULL,
+        GST_VIDEO_INFO_SIZE (&pad->info), NULL);
+  }
+
+  GST_OBJECT_LOCK (ladder);
+
+  preset = ladder->speed_preset > 0 ?
+      x265_preset_names[ladder->speed_preset - 1] : NULL;
+  tune = ladder->tune > 0 ? x265_tune_names[ladder->tune - 1] : NULL;
+  if (x265_param_default_preset (param, preset, tune) < 0) {
+    GST_DEBUG_OBJECT (ladder, "preset or tune unrecognized");
+    GST_OBJECT_UNLOCK (ladder);
+    goto open_failed;
+  }
+
+  /* set up encoder parameters */
+  param->logLevel = ladder->log_level;
+  param->internalCsp =
+      gst_x265_enc_gst_to_x265_video_format (GST_VIDEO_INFO_FORMAT (in),
+      NULL);
+  if (GST_VIDEO_INFO_FPS_N (in) > 0 && GST_VIDEO_INFO_FPS_D (in) > 0) {
+    param->fpsNum = GST_VIDEO_INFO_FPS_N (in);
+    param->fpsDenom = GST_VIDEO_INFO_FPS_D (in);
+  }
+  param->sourceWidth = width;
+  param->sourceHeight = height;
+  param->vui.aspectRatioIdc = X265_EXTENDED_SAR;
+  param->vui.sarWidth = par_n;
+  param->vui.sarHeight = par_d;
+
+  param->rc.bitrate = bitrate;
+  param->rc.rateControlMode = X265_RC_ABR;
+
+  /* scene-cut decisions differ between resolutions, use closed GOPs of
+   * fixed length to keep the keyframes of the renditions aligned */
+  param->scenecutThreshold = 0;
+  param->bOpenGOP = 0;
+  if (ladder->key_int_max > 0)
+    param->keyframeMax = ladder->key_int_max;
+
+  if (ladder->option_string && *ladder->option_string) {
+    GST_DEBUG_OBJECT (ladder, "Applying option-string: %s",
+        ladder->option_string);
+    if (!gst_x265_enc_parse_options (GST_OBJECT (ladder), param,
+            ladder->option_string)) {
+      GST_DEBUG_OBJECT (ladder, "Your option-string contains errors.");
+      GST_OBJECT_UNLOCK (ladder);
+      goto open_failed;
+    }
+  }
+
+  GST_OBJECT_UNLOCK (ladder);
+
+  pad->x265enc = x265_encoder_open (param);
+  if (!pad->x265enc)
+    goto open_failed;
+
+  pad->push_header = TRUE;
+  pad->need_caps = TRUE;
+
+  return TRUE;
+
+open_failed:
+  {
+    GST_ELEMENT_ERROR (ladder, STREAM, ENCODE,
+        ("Can not initialize x265 encoder."), ("for pad %s:%s",
+            GST_DEBUG_PAD_NAME (pad)));
+    gst_x265_ladder_pad_close (pad);
+    return FALSE;
+  }
+}
+
+static GstCaps *
+gst_x265_ladder_enc_get_caps (GstX265LadderEnc * ladder,
+    GstX265LadderPad * pad)
+{
+  GstVideoInfo *info = &pad->info;
+  GstCaps *caps;
+
+  caps = gst_caps_new_simple ("video/x-h265",
+      "width", G_TYPE_INT, GST_VIDEO_INFO_WIDTH (info),
+      "height", G_TYPE_INT, GST_VIDEO_INFO_HEIGHT (info),
+      "framerate", GST_TYPE_FRACTION, GST_VIDEO_INFO_FPS_N (info),
+      GST_VIDEO_INFO_FPS_D (info),
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, GST_VIDEO_INFO_PAR_N (info),
+      GST_VIDEO_INFO_PAR_D (info),
+      "stream-format", G_TYPE_STRING, "byte-stream",
+      "alignment", G_TYPE_STRING, "au", NULL);
+
+  if (!gst_x265_enc_set_level_tier_and_profile (GST_ELEMENT (ladder),
+          pad->x265enc, caps)) {
+    gst_caps_unref (caps);
+    return NULL;
+  }
+
+  return caps;
+}
+
+/* Sends the stream-start, caps and segment events a rendition is missing.
+ * Renditions can be requested at any time, so these are only sent right
+ * before the first data or EOS instead of being forwarded directly */
+static gboolean
+gst_x265_ladder_enc_send_sticky (GstX265LadderEnc * ladder,
+    GstX265LadderPad * pad)
+{
+  GstEvent *event;
+
+  if (pad->need_stream_start) {
+    GstEvent *upstream;
+    gchar *stream_id;
+    guint group_id;
+
+    stream_id = gst_pad_create_stream_id (GST_PAD (pad), GST_ELEMENT (ladder),
+        GST_PAD_NAME (pad));
+    event = gst_event_new_stream_start (stream_id);
+    g_free (stream_id);
+
+    upstream = gst_pad_get_sticky_event (ladder->sinkpad,
+        GST_EVENT_STREAM_START, 0);
+    if (upstream) {
+      if (gst_event_parse_group_id (upstream, &group_id))
+        gst_event_set_group_id (event, group_id);
+      gst_event_unref (upstream);
+    }
+
+    gst_pad_push_event (GST_PAD (pad), event);
+    pad->need_stream_start = FALSE;
+  }
+
+  if (pad->need_caps && pad->x265enc) {
+    GstCaps *caps;
+    GstTagList *tags;
+
+    caps = gst_x265_ladder_enc_get_caps (ladder, pad);
+    if (!caps)
+      return FALSE;
+
+    GST_DEBUG_OBJECT (pad, "output caps: %" GST_PTR_FORMAT, caps);
+    gst_pad_push_event (GST_PAD (pad), gst_event_new_caps (caps));
+    gst_caps_unref (caps);
+
+    tags = gst_tag_list_new (GST_TAG_ENCODER, "x265",
+        GST_TAG_ENCODER_VERSION, x265_version_str, NULL);
+    gst_pad_push_event (GST_PAD (pad), gst_event_new_tag (tags));
+
+    pad->need_caps = FALSE;
+  }
+
+  if (pad->need_segment) {
+    event = gst_pad_get_sticky_event (ladder->sinkpad, GST_EVENT_SEGMENT, 0);
+    if (event)
+      gst_pad_push_event (GST_PAD (pad), event);
+    pad->need_segment = FALSE;
+  }
+
+  return TRUE;
+}
+
+/* runs in the thread pool */
+static void
+gst_x265_ladder_enc_encode_job (GstX265LadderPad * pad,
+    GstX265LadderEnc * ladder)
+{
+  GstVideoFrame *vframe = ladder->vframe;
+  GstVideoFrame scaled;
+  x265_picture pic_in, pic_out;
+  x265_nal *nal;
+  guint32 i_nal = 0;
+  gint i, nplanes = 0, encoder_return;
+
+  if (vframe && pad->convert) {
+    if (!gst_video_frame_map (&scaled, &pad->info, pad->scaled,
+            GST_MAP_WRITE)) {
+      GST_ERROR_OBJECT (pad, "Failed to map scaled frame");
+      pad->failed = TRUE;
+      goto done;
+    }
+    gst_video_converter_frame (pad->convert, vframe, &scaled);
+    vframe = &scaled;
+  }
+
+  if (vframe) {
+    x265_picture_init (&pad->x265param, &pic_in);
+
+    pic_in.colorSpace =
+        gst_x265_enc_gst_to_x265_video_format (GST_VIDEO_FRAME_FORMAT
+        (vframe), &nplanes);
+    for (i = 0; i < nplanes; i++) {
+      pic_in.planes[i] = GST_VIDEO_FRAME_PLANE_DATA (vframe, i);
+      pic_in.stride[i] = GST_VIDEO_FRAME_COMP_STRIDE (vframe, i);
+    }
+
+    pic_in.sliceType = ladder->slice_type;
+    pic_in.pts = ladder->pts;
+    pic_in.bitDepth = GST_VIDEO_FRAME_COMP_DEPTH (vframe, 0);
+  }
+
+  /* x265 copies the picture, the scaled frame can be reused right away */
+  encoder_return = x265_encoder_encode (pad->x265enc, &nal, &i_nal,
+      vframe ? &pic_in : NULL, &pic_out);
+
+  if (vframe == &scaled)
+    gst_video_frame_unmap (&scaled);
+
+  GST_LOG_OBJECT (pad, "encoder result (%d) with %u nal units",
+      encoder_return, i_nal);
+
+  if (encoder_return < 0) {
+    pad->failed = TRUE;
+  } else if (i_nal > 0) {
+    GstBuffer *buf;
+    gsize size = 0, offset = 0;
+
+    for (i = 0; i < i_nal; i++)
+      size += nal[i].sizeBytes;
+    buf = gst_buffer_new_allocate (NULL, size, NULL);
+    for (i = 0; i < i_nal; i++) {
+      gst_buffer_fill (buf, offset, nal[i].payload, nal[i].sizeBytes);
+      offset += nal[i].sizeBytes;
+    }
+
+    GST_BUFFER_PTS (buf) = pic_out.pts;
+    /* x265 starts the DTS below the first PTS when reordering */
+    GST_BUFFER_DTS (buf) = pic_out.dts >= 0 ? pic_out.dts : GST_CLOCK_TIME_NONE;
+    if (GST_VIDEO_INFO_FPS_N (&pad->info) > 0)
+      GST_BUFFER_DURATION (buf) = gst_util_uint64_scale_int (GST_SECOND,
+          GST_VIDEO_INFO_FPS_D (&pad->info), GST_VIDEO_INFO_FPS_N (&pad->info));
+    if (!IS_X265_TYPE_I (pic_out.sliceType))
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    pad->outbuf = buf;
+  }
+
+done:
+  g_mutex_lock (&ladder->lock);
+  if (--ladder->pending == 0)
+    g_cond_signal (&ladder->cond);
+  g_mutex_unlock (&ladder->lock);
+}
+
+/*
+ * gst_x265_ladder_enc_encode
+ * @ladder: Element
+ * @vframe: Input frame, or %NULL to drain the encoders
+ * @produced: Set to %TRUE if any rendition produced output
+ *
+ * Encode @vframe in all renditions and push their output.
+ */
+static GstFlowReturn
+gst_x265_ladder_enc_encode (GstX265LadderEnc * ladder, GstVideoFrame * vframe,
+    gboolean * produced)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GList *pads, *l;
+  guint n_jobs = 0;
+
+  pads = gst_x265_ladder_enc_get_renditions (ladder);
+
+  for (l = pads; l; l = l->next) {
+    GstX265LadderPad *pad = l->data;
+
+    /* renditions requested since the last frame start with this one */
+    if (!pad->x265enc && vframe) {
+      if (!gst_x265_ladder_enc_open_rendition (ladder, pad)) {
+        ret = GST_FLOW_ERROR;
+        goto done;
+      }
+    }
+    if (pad->x265enc) {
+      pad->failed = FALSE;
+      n_jobs++;
+    }
+  }
+
+  if (n_jobs == 0)
+    goto done;
+
+  ladder->vframe = vframe;
+  ladder->pending = n_jobs;
+
+  if (n_jobs == 1 || ladder->pool == NULL) {
+    for (l = pads; l; l = l->next) {
+      if (GST_X265_LADDER_PAD (l->data)->x265enc)
+        gst_x265_ladder_enc_encode_job (l->data, ladder);
+    }
+  } else {
+    for (l = pads; l; l = l->next) {
+      if (GST_X265_LADDER_PAD (l->data)->x265enc)
+        g_thread_pool_push (ladder->pool, l->data, NULL);
+    }
+
+    g_mutex_lock (&ladder->lock);
+    while (ladder->pending > 0)
+      g_cond_wait (&ladder->cond, &ladder->lock);
+    g_mutex_unlock (&ladder->lock);
+  }
+
+  ladder->vframe = NULL;
+
+  /* a failed rendition stops the whole ladder, nothing of this frame is
+   * pushed */
+  for (l = pads; l; l = l->next) {
+    GstX265LadderPad *pad = l->data;
+
+    if (pad->x265enc && pad->failed) {
+      GST_ELEMENT_ERROR (ladder, STREAM, ENCODE, ("Encode x265 frame failed."),
+          ("x265_encoder_encode failed for pad %s:%s",
+              GST_DEBUG_PAD_NAME (pad)));
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+  }
+
+  if (ret != GST_FLOW_OK) {
+    for (l = pads; l; l = l->next)
+      gst_buffer_replace (&GST_X265_LADDER_PAD (l->data)->outbuf, NULL);
+    goto done;
+  }
+
+  /* push the output in the order of the renditions */
+  for (l = pads; l; l = l->next) {
+    GstX265LadderPad *pad = l->data;
+    GstBuffer *buf;
+    GstFlowReturn flow;
+
+    if (!pad->x265enc)
+      continue;
+
+    if (!pad->outbuf)
+      continue;
+
+    buf = pad->outbuf;
+    pad->outbuf = NULL;
+    *produced = TRUE;
+
+    if (!gst_x265_ladder_enc_send_sticky (ladder, pad)) {
+      gst_buffer_unref (buf);
+      ret = GST_FLOW_ERROR;
+      continue;
+    }
+
+    if (pad->push_header) {
+      GstBuffer *header;
+
+      header = gst_x265_enc_get_header_buffer (GST_ELEMENT (ladder),
+          pad->x265enc);
+      if (header)
+        buf = gst_buffer_append (header, buf);
+      pad->push_header = FALSE;
+    }
+
+    GST_LOG_OBJECT (pad, "output: dts %" GST_TIME_FORMAT " pts %"
+        GST_TIME_FORMAT, GST_TIME_ARGS (GST_BUFFER_DTS (buf)),
+        GST_TIME_ARGS (GST_BUFFER_PTS (buf)));
+
+    flow = gst_pad_push (GST_PAD (pad), buf);
+
+    GST_OBJECT_LOCK (ladder);
+    flow = gst_flow_combiner_update_pad_flow (ladder->flow_combiner,
+        GST_PAD (pad), flow);
+    GST_OBJECT_UNLOCK (ladder);
+
+    if (ret == GST_FLOW_OK)
+      ret = flow;
+  }
+
+done:
+  g_list_free_full (pads, gst_object_unref);
+
+  return ret;
+}
+
+/* x265 can't continue after being drained, the renditions are closed
+ * afterwards and reopened with the next frame */
+static GstFlowReturn
+gst_x265_ladder_enc_drain (GstX265LadderEnc * ladder)
+{
+  GstFlowReturn ret;
+  gboolean produced;
+
+  GST_DEBUG_OBJECT (ladder, "draining renditions");
+
+  do {
+    produced = FALSE;
+    ret = gst_x265_ladder_enc_encode (ladder, NULL, &produced);
+  } while (ret == GST_FLOW_OK && produced);
+
+  gst_x265_ladder_enc_close_renditions (ladder);
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_x265_ladder_enc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (parent);
+  GstVideoFrame vframe;
+  GstFlowReturn ret;
+  gboolean produced = FALSE;
+
+  if (G_UNLIKELY (!ladder->have_info))
+    goto not_negotiated;
+
+  if (!gst_video_frame_map (&vframe, &ladder->info, buf, GST_MAP_READ))
+    goto invalid_frame;
+
+  if (g_atomic_int_compare_and_exchange (&ladder->force_keyframe, TRUE,
+          FALSE)) {
+    GST_INFO_OBJECT (ladder, "Forcing key frame");
+    ladder->slice_type = X265_TYPE_IDR;
+  } else {
+    ladder->slice_type = X265_TYPE_AUTO;
+  }
+  ladder->pts = GST_BUFFER_PTS (buf);
+
+  ret = gst_x265_ladder_enc_encode (ladder, &vframe, &produced);
+
+  gst_video_frame_unmap (&vframe);
+  gst_buffer_unref (buf);
+
+  return ret;
+
+/* ERRORS */
+not_negotiated:
+  {
+    GST_WARNING_OBJECT (ladder, "Got buffer before caps");
+    gst_buffer_unref (buf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+invalid_frame:
+  {
+    GST_ERROR_OBJECT (ladder, "Failed to map frame");
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static gboolean
+gst_x265_ladder_enc_set_caps (GstX265LadderEnc * ladder, GstCaps * caps)
+{
+  GstVideoInfo info;
+  GstFlowReturn ret;
+
+  if (!gst_video_info_from_caps (&info, caps)) {
+    GST_WARNING_OBJECT (ladder, "Invalid caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+
+  if (ladder->have_info && gst_video_info_is_equal (&info, &ladder->info))
+    return TRUE;
+
+  /* finish the renditions with the old format, they are reopened with
+   * the first frame of the new one */
+  ret = gst_x265_ladder_enc_drain (ladder);
+  if (ret != GST_FLOW_OK) {
+    GST_WARNING_OBJECT (ladder, "Failed to drain renditions before caps "
+        "change: %s", gst_flow_get_name (ret));
+    return FALSE;
+  }
+
+  ladder->info = info;
+  ladder->have_info = TRUE;
+
+  return TRUE;
+}
+
+static void
+gst_x265_ladder_enc_set_pads_flag (GstX265LadderEnc * ladder,
+    GstEventType type)
+{
+  GList *pads, *l;
+
+  pads = gst_x265_ladder_enc_get_renditions (ladder);
+  for (l = pads; l; l = l->next) {
+    GstX265LadderPad *pad = l->data;
+
+    if (type == GST_EVENT_STREAM_START) {
+      pad->need_stream_start = TRUE;
+      pad->need_caps = TRUE;
+    }
+    pad->need_segment = TRUE;
+  }
+  g_list_free_full (pads, gst_object_unref);
+}
+
+static gboolean
+gst_x265_ladder_enc_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (parent);
+  gboolean res;
+
+  GST_LOG_OBJECT (pad, "received %" GST_PTR_FORMAT, event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:
+    case GST_EVENT_SEGMENT:
+      /* stored on the sink pad and sent to the renditions with their
+       * next buffer */
+      gst_x265_ladder_enc_set_pads_flag (ladder, GST_EVENT_TYPE (event));
+      gst_event_unref (event);
+      res = TRUE;
+      break;
+    case GST_EVENT_CAPS:{
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      res = gst_x265_ladder_enc_set_caps (ladder, caps);
+      gst_event_unref (event);
+      break;
+    }
+    case GST_EVENT_EOS:{
+      GList *pads, *l;
+      GstFlowReturn ret;
+
+      ret = gst_x265_ladder_enc_drain (ladder);
+      if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+        /* post the error before the EOS so the application sees it first */
+        GST_ELEMENT_FLOW_ERROR (ladder, ret);
+      }
+
+      pads = gst_x265_ladder_enc_get_renditions (ladder);
+      for (l = pads; l; l = l->next)
+        gst_x265_ladder_enc_send_sticky (ladder, l->data);
+      g_list_free_full (pads, gst_object_unref);
+
+      res = gst_pad_event_default (pad, parent, event);
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      gst_x265_ladder_enc_close_renditions (ladder);
+      GST_OBJECT_LOCK (ladder);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      GST_OBJECT_UNLOCK (ladder);
+      res = gst_pad_event_default (pad, parent, event);
+      break;
+    default:
+      if (gst_video_event_is_force_key_unit (event))
+        g_atomic_int_set (&ladder->force_keyframe, TRUE);
+      res = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return res;
+}
+
+static gboolean
+gst_x265_ladder_enc_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  gboolean res;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_CAPS:{
+      GstCaps *filter, *caps;
+
+      gst_query_parse_caps (query, &filter);
+      caps = gst_x265_enc_get_supported_input_caps ();
+      if (filter) {
+        GstCaps *tmp = caps;
+
+        caps = gst_caps_intersect_full (filter, tmp, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref (tmp);
+      }
+      gst_query_set_caps_result (query, caps);
+      gst_caps_unref (caps);
+      res = TRUE;
+      break;
+    }
+    case GST_QUERY_ACCEPT_CAPS:{
+      GstCaps *acceptable, *caps;
+
+      acceptable = gst_x265_enc_get_supported_input_caps ();
+      gst_query_parse_accept_caps (query, &caps);
+
+      gst_query_set_accept_caps_result (query,
+          gst_caps_is_subset (caps, acceptable));
+      gst_caps_unref (acceptable);
+      res = TRUE;
+      break;
+    }
+    case GST_QUERY_ALLOCATION:
+      gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+      res = TRUE;
+      break;
+    default:
+      res = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return res;
+}
+
+static gboolean
+gst_x265_ladder_enc_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (parent);
+
+  /* a keyframe requested by one rendition is inserted in all of them */
+  if (gst_video_event_is_force_key_unit (event)) {
+    GST_DEBUG_OBJECT (pad, "keyframe requested");
+    g_atomic_int_set (&ladder->force_keyframe, TRUE);
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstPad *
+gst_x265_ladder_enc_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * req_name, const GstCaps * caps)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (element);
+  GstPad *pad;
+  gchar *name;
+
+  GST_OBJECT_LOCK (ladder);
+  if (req_name == NULL || strlen (req_name) < 5
+      || !g_str_has_prefix (req_name, "src_")) {
+    name = g_strdup_printf ("src_%u", ladder->pad_counter++);
+  } else {
+    guint serial = g_ascii_strtoull (&req_name[4], NULL, 10);
+
+    if (serial >= ladder->pad_counter)
+      ladder->pad_counter = serial + 1;
+    name = g_strdup (req_name);
+  }
+  GST_OBJECT_UNLOCK (ladder);
+
+  pad = g_object_new (GST_TYPE_X265_LADDER_PAD, "name", name,
+      "direction", GST_PAD_SRC, "template", templ, NULL);
+  g_free (name);
+
+  gst_pad_set_event_function (pad,
+      GST_DEBUG_FUNCPTR (gst_x265_ladder_enc_src_event));
+  gst_pad_use_fixed_caps (pad);
+
+  if (!gst_element_add_pad (element, pad))
+    goto could_not_add;
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_add_pad (ladder->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_child_proxy_child_added (GST_CHILD_PROXY (element), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+
+  return pad;
+
+could_not_add:
+  {
+    GST_DEBUG_OBJECT (element, "could not add pad");
+    gst_object_unref (pad);
+    return NULL;
+  }
+}
+
+static void
+gst_x265_ladder_enc_release_pad (GstElement * element, GstPad * pad)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (element);
+
+  GST_DEBUG_OBJECT (ladder, "release pad %s:%s", GST_DEBUG_PAD_NAME (pad));
+
+  GST_OBJECT_LOCK (ladder);
+  gst_flow_combiner_remove_pad (ladder->flow_combiner, pad);
+  GST_OBJECT_UNLOCK (ladder);
+
+  gst_child_proxy_child_removed (GST_CHILD_PROXY (ladder), G_OBJECT (pad),
+      GST_OBJECT_NAME (pad));
+
+  /* the encoder is closed when the streaming thread drops its reference */
+  gst_element_remove_pad (element, pad);
+}
+
+static gboolean
+gst_x265_ladder_enc_start (GstX265LadderEnc * ladder)
+{
+  gint n_threads;
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (ladder);
+  n_threads = ladder->max_threads;
+  GST_OBJECT_UNLOCK (ladder);
+
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  if (n_threads > 1) {
+    ladder->pool = g_thread_pool_new ((GFunc) gst_x265_ladder_enc_encode_job,
+        ladder, n_threads, FALSE, &err);
+    if (!ladder->pool) {
+      GST_ELEMENT_ERROR (ladder, RESOURCE, FAILED,
+          ("Failed to create encoding threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+  }
+
+  ladder->have_info = FALSE;
+  ladder->force_keyframe = FALSE;
+  gst_flow_combiner_reset (ladder->flow_combiner);
+
+  return TRUE;
+}
+
+static void
+gst_x265_ladder_enc_stop (GstX265LadderEnc * ladder)
+{
+  GList *pads, *l;
+
+  if (ladder->pool) {
+    g_thread_pool_free (ladder->pool, FALSE, TRUE);
+    ladder->pool = NULL;
+  }
+
+  pads = gst_x265_ladder_enc_get_renditions (ladder);
+  for (l = pads; l; l = l->next) {
+    GstX265LadderPad *pad = l->data;
+
+    gst_x265_ladder_pad_close (pad);
+    pad->need_stream_start = TRUE;
+    pad->need_caps = TRUE;
+    pad->need_segment = TRUE;
+  }
+  g_list_free_full (pads, gst_object_unref);
+
+  ladder->have_info = FALSE;
+}
+
+static GstStateChangeReturn
+gst_x265_ladder_enc_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_x265_ladder_enc_start (ladder))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_x265_ladder_enc_stop (ladder);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_x265_ladder_enc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (object);
+
+  GST_OBJECT_LOCK (ladder);
+  switch (prop_id) {
+    case PROP_X265_LOG_LEVEL:
+      ladder->log_level = g_value_get_enum (value);
+      break;
+    case PROP_SPEED_PRESET:
+      ladder->speed_preset = g_value_get_enum (value);
+      break;
+    case PROP_TUNE:
+      ladder->tune = g_value_get_enum (value);
+      break;
+    case PROP_KEY_INT_MAX:
+      ladder->key_int_max = g_value_get_uint (value);
+      break;
+    case PROP_OPTION_STRING:
+      g_free (ladder->option_string);
+      ladder->option_string = g_value_dup_string (value);
+      break;
+    case PROP_MAX_THREADS:
+      ladder->max_threads = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (ladder);
+}
+
+static void
+gst_x265_ladder_enc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (object);
+
+  GST_OBJECT_LOCK (ladder);
+  switch (prop_id) {
+    case PROP_X265_LOG_LEVEL:
+      g_value_set_enum (value, ladder->log_level);
+      break;
+    case PROP_SPEED_PRESET:
+      g_value_set_enum (value, ladder->speed_preset);
+      break;
+    case PROP_TUNE:
+      g_value_set_enum (value, ladder->tune);
+      break;
+    case PROP_KEY_INT_MAX:
+      g_value_set_uint (value, ladder->key_int_max);
+      break;
+    case PROP_OPTION_STRING:
+      g_value_set_string (value, ladder->option_string);
+      break;
+    case PROP_MAX_THREADS:
+      g_value_set_int (value, ladder->max_threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (ladder);
+}
+
+/* GstChildProxy implementation */
+static GObject *
+gst_x265_ladder_enc_child_proxy_get_child_by_index (GstChildProxy *
+    child_proxy, guint index)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (child_proxy);
+  GObject *obj = NULL;
+
+  GST_OBJECT_LOCK (ladder);
+  obj = g_list_nth_data (GST_ELEMENT_CAST (ladder)->srcpads, index);
+  if (obj)
+    gst_object_ref (obj);
+  GST_OBJECT_UNLOCK (ladder);
+
+  return obj;
+}
+
+static guint
+gst_x265_ladder_enc_child_proxy_get_children_count (GstChildProxy *
+    child_proxy)
+{
+  GstX265LadderEnc *ladder = GST_X265_LADDER_ENC (child_proxy);
+  guint count;
+
+  GST_OBJECT_LOCK (ladder);
+  count = GST_ELEMENT_CAST (ladder)->numsrcpads;
+  GST_OBJECT_UNLOCK (ladder);
+
+  return count;
+}
+
+static void
+gst_x265_ladder_enc_child_proxy_init (gpointer g_iface, gpointer iface_data)
+{
+  GstChildProxyInterface *iface = g_iface;
+
+  iface->get_child_by_index =
+      gst_x265_ladder_enc_child_proxy_get_child_by_index;
+  iface->get_children_count =
+      gst_x265_ladder_enc_child_proxy_get_children_count;
+}
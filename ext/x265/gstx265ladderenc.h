@@ -0,0 +1,132 @@
+/* GStreamer H265 multi-rendition encoder
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_X265_LADDER_ENC_H__
+#define __GST_X265_LADDER_ENC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/video/video.h>
+#include <x265.h>
+
+G_BEGIN_DECLS
+#define GST_TYPE_X265_LADDER_PAD \
+  (gst_x265_ladder_pad_get_type())
+#define GST_X265_LADDER_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_X265_LADDER_PAD,GstX265LadderPad))
+#define GST_X265_LADDER_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_X265_LADDER_PAD,GstX265LadderPadClass))
+#define GST_IS_X265_LADDER_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_X265_LADDER_PAD))
+#define GST_IS_X265_LADDER_PAD_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_X265_LADDER_PAD))
+typedef struct _GstX265LadderPad GstX265LadderPad;
+typedef struct _GstX265LadderPadClass GstX265LadderPadClass;
+
+#define GST_TYPE_X265_LADDER_ENC \
+  (gst_x265_ladder_enc_get_type())
+#define GST_X265_LADDER_ENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_X265_LADDER_ENC,GstX265LadderEnc))
+#define GST_X265_LADDER_ENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_X265_LADDER_ENC,GstX265LadderEncClass))
+#define GST_IS_X265_LADDER_ENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_X265_LADDER_ENC))
+#define GST_IS_X265_LADDER_ENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_X265_LADDER_ENC))
+typedef struct _GstX265LadderEnc GstX265LadderEnc;
+typedef struct _GstX265LadderEncClass GstX265LadderEncClass;
+
+/* one rendition of the ladder */
+struct _GstX265LadderPad
+{
+  GstPad parent;
+
+  /*< private > */
+  /* properties */
+  gint width;
+  gint height;
+  guint bitrate;
+
+  /* encoder state, only used by the streaming thread and by the
+   * worker thread that encodes this rendition */
+  x265_encoder *x265enc;
+  x265_param x265param;
+  GstVideoInfo info;
+  GstVideoConverter *convert;
+  GstBuffer *scaled;
+  gboolean push_header;
+
+  /* sticky events that still have to be sent */
+  gboolean need_stream_start;
+  gboolean need_caps;
+  gboolean need_segment;
+
+  /* result of the last encoding job */
+  GstBuffer *outbuf;
+  gboolean failed;
+};
+
+struct _GstX265LadderPadClass
+{
+  GstPadClass parent_class;
+};
+
+struct _GstX265LadderEnc
+{
+  GstElement element;
+
+  /*< private > */
+  GstPad *sinkpad;
+  GstFlowCombiner *flow_combiner;
+  guint pad_counter;
+
+  /* properties */
+  gint log_level;
+  gint speed_preset;
+  gint tune;
+  guint key_int_max;
+  gint max_threads;
+  gchar *option_string;
+
+  /* input description */
+  GstVideoInfo info;
+  gboolean have_info;
+  gboolean force_keyframe;
+
+  /* renditions are encoded in parallel by a shared pool */
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint pending;
+
+  /* input of the running jobs, NULL when draining */
+  GstVideoFrame *vframe;
+  GstClockTime pts;
+  gint slice_type;
+};
+
+struct _GstX265LadderEncClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_x265_ladder_pad_get_type (void);
+GType gst_x265_ladder_enc_get_type (void);
+
+G_END_DECLS
+#endif /* __GST_X265_LADDER_ENC_H__ */
@@ -258,6 +258,127 @@ gst_mpegts_section_get_eit (GstMpegtsSection * section)
   return (const GstMpegtsEIT *) section->cached_parsed;
 }
 
+/**
+ * gst_mpegts_section_eit_event_iter_init:
+ * @section: a #GstMpegtsSection of type %GST_MPEGTS_SECTION_EIT
+ * @iter: (out caller-allocates): a #GstMpegtsEITEventIter
+ *
+ * Initializes @iter to walk the events of the EIT contained in @section
+ * straight from the section data. Unlike gst_mpegts_section_get_eit() no
+ * #GstMpegtsEIT is built, which is cheaper when only a few fields of the
+ * events are needed.
+ *
+ * @section must stay alive for as long as @iter is used.
+ *
+ * Returns: %TRUE if @iter was initialized, %FALSE if the section is
+ * corrupted.
+ */
+gboolean
+gst_mpegts_section_eit_event_iter_init (GstMpegtsSection * section,
+    GstMpegtsEITEventIter * iter)
+{
+  g_return_val_if_fail (section->section_type == GST_MPEGTS_SECTION_EIT,
+      FALSE);
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  if (section->data == NULL)
+    return FALSE;
+
+  if (section->section_length < 18) {
+    GST_WARNING ("PID:0x%04x table_id:0x%02x, section too small (Got %d, "
+        "need at least 18)", section->pid, section->table_id,
+        section->section_length);
+    return FALSE;
+  }
+
+  /* The CRC was already checked if the section was parsed */
+  if (section->cached_parsed == NULL
+      && _calc_crc32 (section->data, section->section_length) != 0) {
+    GST_WARNING ("PID:0x%04x table_id:0x%02x, Bad CRC on section",
+        section->pid, section->table_id);
+    return FALSE;
+  }
+
+  /* Skip the table header */
+  iter->data = section->data + 14;
+  iter->end = section->data + section->section_length - 4;
+
+  return TRUE;
+}
+
+/**
+ * gst_mpegts_eit_event_iter_next:
+ * @iter: a #GstMpegtsEITEventIter
+ * @event_id: (out) (allow-none): the event id
+ * @start_time: (out) (transfer full) (allow-none): the start time of the
+ * event. Only created when requested.
+ * @duration: (out) (allow-none): the duration of the event in seconds
+ * @running_status: (out) (allow-none): the running status of the event
+ * @free_CA_mode: (out) (allow-none): whether the event is scrambled
+ * @descriptors: (out caller-allocates) (allow-none): a
+ * #GstMpegtsDescriptorIter over the descriptors of the event
+ *
+ * Reads the next event of @iter.
+ *
+ * Returns: %TRUE if an event was read, %FALSE when there are no more
+ * events or the remaining ones are corrupted.
+ */
+gboolean
+gst_mpegts_eit_event_iter_next (GstMpegtsEITEventIter * iter,
+    guint16 * event_id, GstDateTime ** start_time, guint32 * duration,
+    GstMpegtsRunningStatus * running_status, gboolean * free_CA_mode,
+    GstMpegtsDescriptorIter * descriptors)
+{
+  const guint8 *data, *duration_ptr;
+  guint16 descriptors_loop_length;
+
+  g_return_val_if_fail (iter != NULL, FALSE);
+
+  data = iter->data;
+  if (data >= iter->end)
+    return FALSE;
+
+  if (iter->end - data < 12) {
+    GST_WARNING ("invalid EIT entry length %d", (gint) (iter->end - data));
+    goto corrupted;
+  }
+
+  descriptors_loop_length = GST_READ_UINT16_BE (data + 10) & 0x0FFF;
+  if (iter->end - data - 12 < descriptors_loop_length) {
+    GST_WARNING ("invalid EIT descriptors length %d, %d bytes left",
+        descriptors_loop_length, (gint) (iter->end - data - 12));
+    goto corrupted;
+  }
+
+  if (event_id)
+    *event_id = GST_READ_UINT16_BE (data);
+  if (start_time)
+    *start_time = _parse_utc_time ((guint8 *) data + 2);
+  if (duration) {
+    duration_ptr = data + 7;
+    *duration = (((duration_ptr[0] & 0xF0) >> 4) * 10 +
+        (duration_ptr[0] & 0x0F)) * 60 * 60 +
+        (((duration_ptr[1] & 0xF0) >> 4) * 10 +
+        (duration_ptr[1] & 0x0F)) * 60 +
+        ((duration_ptr[2] & 0xF0) >> 4) * 10 + (duration_ptr[2] & 0x0F);
+  }
+  if (running_status)
+    *running_status = data[10] >> 5;
+  if (free_CA_mode)
+    *free_CA_mode = (data[10] >> 4) & 0x01;
+  if (descriptors)
+    gst_mpegts_descriptor_iter_init (descriptors, data + 12,
+        descriptors_loop_length);
+
+  iter->data = data + 12 + descriptors_loop_length;
+
+  return TRUE;
+
+corrupted:
+  iter->data = iter->end;
+  return FALSE;
+}
+
 /* Bouquet Association Table */
 static GstMpegtsBATStream *
 _gst_mpegts_bat_stream_copy (GstMpegtsBATStream * bat)
@@ -317,6 +317,31 @@ GType gst_mpegts_eit_event_get_type (void);
 
 const GstMpegtsEIT *gst_mpegts_section_get_eit (GstMpegtsSection *section);
 
+/**
+ * GstMpegtsEITEventIter:
+ *
+ * Iterator over the events of an EIT section that reads them in place, see
+ * gst_mpegts_section_eit_event_iter_init().
+ */
+typedef struct
+{
+  /*< private >*/
+  const guint8 *data;
+  const guint8 *end;
+
+  gpointer _gst_reserved[GST_PADDING];
+} GstMpegtsEITEventIter;
+
+gboolean gst_mpegts_section_eit_event_iter_init (GstMpegtsSection *section,
+						 GstMpegtsEITEventIter *iter);
+gboolean gst_mpegts_eit_event_iter_next (GstMpegtsEITEventIter *iter,
+					 guint16 *event_id,
+					 GstDateTime **start_time,
+					 guint32 *duration,
+					 GstMpegtsRunningStatus *running_status,
+					 gboolean *free_CA_mode,
+					 GstMpegtsDescriptorIter *descriptors);
+
 /* TDT */
 GstDateTime *gst_mpegts_section_get_tdt (GstMpegtsSection *section);
 
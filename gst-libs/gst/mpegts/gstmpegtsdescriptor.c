@@ -808,6 +808,78 @@ gst_mpegts_parse_descriptors (guint8 * buffer, gsize buf_len)
   return res;
 }
 
+/**
+ * gst_mpegts_descriptor_iter_init:
+ * @iter: (out caller-allocates): a #GstMpegtsDescriptorIter
+ * @buffer: (transfer none): descriptors to iterate
+ * @buf_len: Size of @buffer
+ *
+ * Initializes @iter to walk the descriptors present in @buffer without
+ * allocating nor copying them, unlike gst_mpegts_parse_descriptors().
+ *
+ * @buffer must stay valid for as long as @iter and the descriptors it
+ * returns are used.
+ */
+void
+gst_mpegts_descriptor_iter_init (GstMpegtsDescriptorIter * iter,
+    const guint8 * buffer, gsize buf_len)
+{
+  g_return_if_fail (iter != NULL);
+  g_return_if_fail (buffer != NULL || buf_len == 0);
+
+  iter->data = buffer;
+  iter->end = buffer + buf_len;
+}
+
+/**
+ * gst_mpegts_descriptor_iter_next:
+ * @iter: a #GstMpegtsDescriptorIter
+ * @desc: (out caller-allocates): the descriptor to fill
+ *
+ * Reads the next descriptor of @iter into @desc. The data of @desc points
+ * into the buffer @iter was initialized with, so @desc must not be freed
+ * with gst_mpegts_descriptor_free(). It can be passed to all the
+ * gst_mpegts_descriptor_parse_*() functions.
+ *
+ * Returns: %TRUE if @desc was filled, %FALSE when there are no more
+ * descriptors or the remaining ones are corrupted.
+ */
+gboolean
+gst_mpegts_descriptor_iter_next (GstMpegtsDescriptorIter * iter,
+    GstMpegtsDescriptor * desc)
+{
+  const guint8 *data;
+
+  g_return_val_if_fail (iter != NULL, FALSE);
+  g_return_val_if_fail (desc != NULL, FALSE);
+
+  data = iter->data;
+  if (data == iter->end)
+    return FALSE;
+
+  if (iter->end - data < 2 || iter->end - data - 2 < data[1]) {
+    GST_WARNING ("invalid descriptor length, %d bytes left",
+        (gint) (iter->end - data));
+    iter->data = iter->end;
+    return FALSE;
+  }
+
+  desc->data = (guint8 *) data;
+  desc->tag = data[0];
+  desc->length = data[1];
+  /* extended descriptors */
+  if (G_UNLIKELY (desc->tag == 0x7f) && desc->length > 0)
+    desc->tag_extension = data[2];
+  else
+    desc->tag_extension = 0;
+
+  GST_LOG ("descriptor 0x%02x length:%d", desc->tag, desc->length);
+
+  iter->data = data + 2 + desc->length;
+
+  return TRUE;
+}
+
 /**
  * gst_mpegts_find_descriptor:
  * @descriptors: (element-type GstMpegtsDescriptor) (transfer none): an array
@@ -269,6 +269,27 @@ GPtrArray *gst_mpegts_parse_descriptors (guint8 * buffer, gsize buf_len);
 const GstMpegtsDescriptor * gst_mpegts_find_descriptor (GPtrArray *descriptors,
 							guint8 tag);
 
+/**
+ * GstMpegtsDescriptorIter:
+ *
+ * Iterator over a loop of descriptors that reads them in place, see
+ * gst_mpegts_descriptor_iter_init().
+ */
+typedef struct
+{
+  /*< private >*/
+  const guint8 *data;
+  const guint8 *end;
+
+  gpointer _gst_reserved[GST_PADDING];
+} GstMpegtsDescriptorIter;
+
+void       gst_mpegts_descriptor_iter_init (GstMpegtsDescriptorIter *iter,
+					    const guint8 *buffer, gsize buf_len);
+
+gboolean   gst_mpegts_descriptor_iter_next (GstMpegtsDescriptorIter *iter,
+					    GstMpegtsDescriptor *desc);
+
 /* GST_MTS_DESC_REGISTRATION (0x05) */
 
 GstMpegtsDescriptor *gst_mpegts_descriptor_from_registration (
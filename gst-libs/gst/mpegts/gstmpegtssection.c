@@ -127,16 +127,54 @@ static const guint32 crc_tab[256] = {
   0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
 
+/* crc_tab extended to 8 bytes at a time, built from it on first use */
+static guint32 crc_tab8[8][256];
+
+static void
+_init_crc_tables (void)
+{
+  static gsize tables_initialized = 0;
+
+  if (g_once_init_enter (&tables_initialized)) {
+    guint i, k;
+
+    for (i = 0; i < 256; i++) {
+      guint32 crc = crc_tab[i];
+
+      crc_tab8[0][i] = crc;
+      for (k = 1; k < 8; k++) {
+        crc = (crc << 8) ^ crc_tab[crc >> 24];
+        crc_tab8[k][i] = crc;
+      }
+    }
+
+    g_once_init_leave (&tables_initialized, 1);
+  }
+}
+
 /* _calc_crc32 relicensed to LGPL from fluendo ts demuxer */
 guint32
 _calc_crc32 (const guint8 * data, guint datalen)
 {
-  gint i;
   guint32 crc = 0xffffffff;
 
-  for (i = 0; i < datalen; i++) {
-    crc = (crc << 8) ^ crc_tab[((crc >> 24) ^ *data++) & 0xff];
+  _init_crc_tables ();
+
+  while (datalen >= 8) {
+    crc ^= GST_READ_UINT32_BE (data);
+    crc = crc_tab8[7][crc >> 24] ^
+        crc_tab8[6][(crc >> 16) & 0xff] ^
+        crc_tab8[5][(crc >> 8) & 0xff] ^
+        crc_tab8[4][crc & 0xff] ^
+        crc_tab8[3][data[4]] ^
+        crc_tab8[2][data[5]] ^ crc_tab8[1][data[6]] ^ crc_tab8[0][data[7]];
+    data += 8;
+    datalen -= 8;
   }
+
+  while (datalen--)
+    crc = (crc << 8) ^ crc_tab[((crc >> 24) ^ *data++) & 0xff];
+
   return crc;
 }
 
@@ -0,0 +1,250 @@
+/* GStreamer ordered codec job queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Private helper, built into the codec plugins that use it and not
+ * installed.
+ *
+ * #GstVideoJobQueue processes the frames of a video encoder or decoder on a
+ * pool of threads and finishes them from the streaming thread in the order
+ * they were queued.
+ *
+ * A job wraps one frame and is owned by the queue from
+ * gst_video_job_queue_push() until it is passed to the finish or discard
+ * function. Processing happens on the worker threads and must not call into
+ * the base class, all output is done by the finish function, either from
+ * gst_video_job_queue_push() to bound the number of frames in flight or
+ * from gst_video_job_queue_finish() when draining. Flushing and stopping
+ * wait for the running jobs and hand all queued ones to the discard
+ * function.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstvideojobqueue.h"
+
+typedef struct
+{
+  gpointer data;
+  gboolean done;
+} GstVideoJob;
+
+struct _GstVideoJobQueue
+{
+  GThreadPool *pool;
+
+  GstVideoJobFunc process;
+  GstVideoJobFinishFunc finish;
+  GstVideoJobFunc discard;
+  gpointer user_data;
+
+  GMutex lock;
+  GCond cond;
+  /* jobs in the order they were queued */
+  GQueue pending;
+};
+
+static void
+gst_video_job_queue_run (GstVideoJob * job, GstVideoJobQueue * queue)
+{
+  queue->process (job->data, queue->user_data);
+
+  g_mutex_lock (&queue->lock);
+  job->done = TRUE;
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+/**
+ * gst_video_job_queue_new:
+ * @n_threads: number of worker threads
+ * @process: processes a job on a worker thread
+ * @finish: finishes a processed job from the streaming thread
+ * @discard: frees a processed job when flushing or stopping
+ * @user_data: user data passed to the functions
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full): a new #GstVideoJobQueue or %NULL if the threads
+ * could not be created
+ */
+GstVideoJobQueue *
+gst_video_job_queue_new (guint n_threads, GstVideoJobFunc process,
+    GstVideoJobFinishFunc finish, GstVideoJobFunc discard, gpointer user_data,
+    GError ** error)
+{
+  GstVideoJobQueue *queue;
+
+  g_return_val_if_fail (n_threads > 0, NULL);
+  g_return_val_if_fail (process != NULL, NULL);
+  g_return_val_if_fail (finish != NULL, NULL);
+  g_return_val_if_fail (discard != NULL, NULL);
+
+  queue = g_slice_new0 (GstVideoJobQueue);
+  queue->process = process;
+  queue->finish = finish;
+  queue->discard = discard;
+  queue->user_data = user_data;
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+  g_queue_init (&queue->pending);
+
+  queue->pool = g_thread_pool_new ((GFunc) gst_video_job_queue_run, queue,
+      n_threads, FALSE, error);
+  if (!queue->pool) {
+    gst_video_job_queue_free (queue);
+    return NULL;
+  }
+
+  return queue;
+}
+
+/**
+ * gst_video_job_queue_free:
+ * @queue: a #GstVideoJobQueue
+ *
+ * Discards all queued jobs and stops the worker threads.
+ */
+void
+gst_video_job_queue_free (GstVideoJobQueue * queue)
+{
+  g_return_if_fail (queue != NULL);
+
+  if (queue->pool) {
+    gst_video_job_queue_discard (queue);
+    g_thread_pool_free (queue->pool, FALSE, TRUE);
+  }
+
+  g_mutex_clear (&queue->lock);
+  g_cond_clear (&queue->cond);
+  g_slice_free (GstVideoJobQueue, queue);
+}
+
+/**
+ * gst_video_job_queue_finish:
+ * @queue: a #GstVideoJobQueue
+ * @max_pending: number of jobs that may be left in the queue
+ *
+ * Finishes the processed jobs at the head of the queue, in the order they
+ * were queued, and waits until no more than @max_pending jobs are left.
+ * Once finishing a job failed, the following ones are dropped. Pass 0 to
+ * drain the queue.
+ *
+ * Returns: the first #GstFlowReturn that was not %GST_FLOW_OK, or
+ * %GST_FLOW_OK
+ */
+GstFlowReturn
+gst_video_job_queue_finish (GstVideoJobQueue * queue, guint max_pending)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  g_return_val_if_fail (queue != NULL, GST_FLOW_ERROR);
+
+  g_mutex_lock (&queue->lock);
+  while (!g_queue_is_empty (&queue->pending)) {
+    GstVideoJob *job = g_queue_peek_head (&queue->pending);
+
+    if (!job->done) {
+      if (g_queue_get_length (&queue->pending) <= max_pending)
+        break;
+      g_cond_wait (&queue->cond, &queue->lock);
+      continue;
+    }
+
+    g_queue_pop_head (&queue->pending);
+    g_mutex_unlock (&queue->lock);
+
+    if (ret == GST_FLOW_OK)
+      ret = queue->finish (job->data, FALSE, queue->user_data);
+    else
+      queue->finish (job->data, TRUE, queue->user_data);
+    g_slice_free (GstVideoJob, job);
+
+    g_mutex_lock (&queue->lock);
+  }
+  g_mutex_unlock (&queue->lock);
+
+  return ret;
+}
+
+/**
+ * gst_video_job_queue_push:
+ * @queue: a #GstVideoJobQueue
+ * @job: (transfer full): the job to process
+ * @max_pending: maximum number of jobs in flight
+ *
+ * Finishes processed jobs until less than @max_pending are left in the
+ * queue, then queues @job for processing. If finishing failed, @job is
+ * dropped instead.
+ *
+ * Returns: the #GstFlowReturn of finishing the earlier jobs
+ */
+GstFlowReturn
+gst_video_job_queue_push (GstVideoJobQueue * queue, gpointer job,
+    guint max_pending)
+{
+  GstVideoJob *qjob;
+  GstFlowReturn ret;
+
+  g_return_val_if_fail (queue != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (max_pending > 0, GST_FLOW_ERROR);
+
+  ret = gst_video_job_queue_finish (queue, max_pending - 1);
+  if (ret != GST_FLOW_OK) {
+    queue->finish (job, TRUE, queue->user_data);
+    return ret;
+  }
+
+  qjob = g_slice_new0 (GstVideoJob);
+  qjob->data = job;
+
+  g_mutex_lock (&queue->lock);
+  g_queue_push_tail (&queue->pending, qjob);
+  g_mutex_unlock (&queue->lock);
+  g_thread_pool_push (queue->pool, qjob, NULL);
+
+  return GST_FLOW_OK;
+}
+
+/**
+ * gst_video_job_queue_discard:
+ * @queue: a #GstVideoJobQueue
+ *
+ * Waits for all queued jobs to be processed and passes them to the discard
+ * function, without finishing them.
+ */
+void
+gst_video_job_queue_discard (GstVideoJobQueue * queue)
+{
+  GstVideoJob *job;
+
+  g_return_if_fail (queue != NULL);
+
+  g_mutex_lock (&queue->lock);
+  while ((job = g_queue_peek_head (&queue->pending))) {
+    if (!job->done) {
+      g_cond_wait (&queue->cond, &queue->lock);
+      continue;
+    }
+
+    g_queue_pop_head (&queue->pending);
+    queue->discard (job->data, queue->user_data);
+    g_slice_free (GstVideoJob, job);
+  }
+  g_mutex_unlock (&queue->lock);
+}
@@ -0,0 +1,69 @@
+/* GStreamer ordered codec job queue
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_VIDEO_JOB_QUEUE_H__
+#define __GST_VIDEO_JOB_QUEUE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstVideoJobQueue GstVideoJobQueue;
+
+/**
+ * GstVideoJobFunc:
+ * @job: the job
+ * @user_data: the user data passed to gst_video_job_queue_new()
+ *
+ * Processes or frees @job.
+ */
+typedef void (*GstVideoJobFunc) (gpointer job, gpointer user_data);
+
+/**
+ * GstVideoJobFinishFunc:
+ * @job: the processed job
+ * @drop: %TRUE if an earlier job failed
+ * @user_data: the user data passed to gst_video_job_queue_new()
+ *
+ * Finishes the frame of @job, called from the streaming thread in the order
+ * the jobs were queued. Takes ownership of @job. If @drop is %TRUE the frame
+ * must be released without output and the return value is ignored.
+ *
+ * Returns: the #GstFlowReturn of finishing the frame
+ */
+typedef GstFlowReturn (*GstVideoJobFinishFunc) (gpointer job, gboolean drop,
+    gpointer user_data);
+
+GstVideoJobQueue * gst_video_job_queue_new      (guint n_threads,
+                                                 GstVideoJobFunc process,
+                                                 GstVideoJobFinishFunc finish,
+                                                 GstVideoJobFunc discard,
+                                                 gpointer user_data,
+                                                 GError ** error);
+void               gst_video_job_queue_free     (GstVideoJobQueue * queue);
+
+GstFlowReturn      gst_video_job_queue_push     (GstVideoJobQueue * queue,
+                                                 gpointer job,
+                                                 guint max_pending);
+GstFlowReturn      gst_video_job_queue_finish   (GstVideoJobQueue * queue,
+                                                 guint max_pending);
+void               gst_video_job_queue_discard  (GstVideoJobQueue * queue);
+
+G_END_DECLS
+
+#endif /* __GST_VIDEO_JOB_QUEUE_H__ */
@@ -31,6 +31,30 @@
  * gst-launch-1.0 playbin uri=file:///path/to/video.avi video-sink="fpsdisplaysink" audio-sink=fakesink
  * ]|
  * </refsect2>
+ *
+ * If #GstFPSDisplaySink:timing-stats is enabled, the intervals between frames
+ * and the lateness of frames are collected in histograms and every
+ * #GstFPSDisplaySink:fps-update-interval an element message named
+ * "fpsdisplaysink-timing" is posted with these fields, all times are in
+ * nanoseconds and measured over the last interval:
+ *
+ * - "frames" G_TYPE_UINT64: number of frame intervals measured
+ * - "interval-min", "interval-max" G_TYPE_UINT64: extremes of the time
+ *   between two consecutive frames
+ * - "interval-p50", "interval-p95", "interval-p99" G_TYPE_UINT64: percentiles
+ *   of the time between two consecutive frames
+ * - "late-frames" G_TYPE_UINT64: number of frames that arrived after their
+ *   render time
+ * - "lateness-max", "lateness-p50", "lateness-p95", "lateness-p99"
+ *   G_TYPE_UINT64: how late frames arrived at the sink, early frames count
+ *   as zero
+ *
+ * Lateness is taken from the QoS events the video sink sends upstream after
+ * synchronising each frame, so it is only measured when the video sink has
+ * QoS enabled. The statistics are reset on flush.
+ *
+ * Percentiles have a resolution of 12.5%. Time values are
+ * #GST_CLOCK_TIME_NONE when nothing was measured.
  */
 /* FIXME:
  * - can we avoid plugging the textoverlay?
@@ -47,6 +71,8 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include "fpsdisplaysink.h"
 
 #define DEFAULT_SIGNAL_FPS_MEASUREMENTS FALSE
@@ -54,6 +80,7 @@
 #define DEFAULT_FONT "Sans 15"
 #define DEFAULT_SILENT FALSE
 #define DEFAULT_LAST_MESSAGE NULL
+#define DEFAULT_TIMING_STATS FALSE
 
 /* generic templates */
 static GstStaticPadTemplate fps_display_sink_template =
@@ -71,6 +98,7 @@ enum
 {
   /* FILL ME */
   SIGNAL_FPS_MEASUREMENTS,
+  SIGNAL_TIMING_MEASUREMENTS,
   LAST_SIGNAL
 };
 
@@ -87,7 +115,8 @@ enum
   PROP_FRAMES_DROPPED,
   PROP_FRAMES_RENDERED,
   PROP_SILENT,
-  PROP_LAST_MESSAGE
+  PROP_LAST_MESSAGE,
+  PROP_TIMING_STATS
       /* FILL ME */
 };
 
@@ -189,6 +218,12 @@ fps_display_sink_class_init (GstFPSDisplaySinkClass * klass)
   g_object_class_install_property (gobject_klass, PROP_LAST_MESSAGE,
       pspec_last_message);
 
+  g_object_class_install_property (gobject_klass, PROP_TIMING_STATS,
+      g_param_spec_boolean ("timing-stats", "Timing statistics",
+          "Collect frame interval and lateness histograms and post them as "
+          "element messages every fps-update-interval", DEFAULT_TIMING_STATS,
+          G_PARAM_STATIC_STRINGS | G_PARAM_READWRITE));
+
   /**
    * GstFPSDisplaySink::fps-measurements:
    * @fpsdisplaysink: a #GstFPSDisplaySink
@@ -203,6 +238,21 @@ fps_display_sink_class_init (GstFPSDisplaySinkClass * klass)
       G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
       G_TYPE_NONE, 3, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE);
 
+  /**
+   * GstFPSDisplaySink::timing-measurements:
+   * @fpsdisplaysink: a #GstFPSDisplaySink
+   * @stats: a #GstStructure with the same fields as the
+   *   "fpsdisplaysink-timing" element message
+   *
+   * Signals the application about the frame timing statistics of the last
+   * interval. Only emitted if both timing-stats and signal-fps-measurements
+   * are enabled.
+   */
+  fpsdisplaysink_signals[SIGNAL_TIMING_MEASUREMENTS] =
+      g_signal_new ("timing-measurements", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+      G_TYPE_NONE, 1, GST_TYPE_STRUCTURE | G_SIGNAL_TYPE_STATIC_SCOPE);
+
   gstelement_klass->change_state = fps_display_sink_change_state;
 
   gst_element_class_add_static_pad_template (gstelement_klass,
@@ -214,6 +264,147 @@ fps_display_sink_class_init (GstFPSDisplaySinkClass * klass)
       "Zeeshan Ali <zeeshan.ali@nokia.com>, Stefan Kost <stefan.kost@nokia.com>");
 }
 
+static guint
+timing_histogram_bucket (GstClockTime t)
+{
+  guint64 us = t / GST_USECOND;
+  guint bits;
+
+  if (us > G_MAXUINT32)
+    us = G_MAXUINT32;
+  if (us < 16)
+    return us;
+
+  bits = g_bit_storage (us);
+  return 16 + (bits - 5) * 8 + ((us >> (bits - 4)) & 7);
+}
+
+/* middle of the range of values falling into @bucket */
+static GstClockTime
+timing_histogram_bucket_value (guint bucket)
+{
+  guint shift;
+  guint64 lower;
+
+  if (bucket < 16)
+    return bucket * GST_USECOND;
+
+  shift = (bucket - 16) / 8 + 1;
+  lower = (8 + (bucket - 16) % 8) << shift;
+
+  return (lower + (G_GUINT64_CONSTANT (1) << (shift - 1))) * GST_USECOND;
+}
+
+static GstClockTime
+timing_histogram_percentile (const guint32 * histogram, guint64 count,
+    guint percentile)
+{
+  guint64 target, sum = 0;
+  guint i;
+
+  if (count == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  /* nearest rank */
+  target = (count * percentile + 99) / 100;
+  for (i = 0; i < FPS_DISPLAY_SINK_HISTOGRAM_SIZE; i++) {
+    sum += histogram[i];
+    if (sum >= target)
+      return timing_histogram_bucket_value (i);
+  }
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+static void
+fps_display_sink_reset_timing (GstFPSDisplaySink * self)
+{
+  memset (self->interval_histogram, 0, sizeof (self->interval_histogram));
+  memset (self->lateness_histogram, 0, sizeof (self->lateness_histogram));
+  self->interval_count = self->lateness_count = self->late_frames = 0;
+  self->interval_min = self->interval_max = GST_CLOCK_TIME_NONE;
+  self->lateness_max = GST_CLOCK_TIME_NONE;
+}
+
+static void
+fps_display_sink_update_interval (GstFPSDisplaySink * self, GstClockTime ts)
+{
+  if (GST_CLOCK_TIME_IS_VALID (self->last_frame_ts)) {
+    GstClockTime interval = ts - self->last_frame_ts;
+
+    self->interval_histogram[timing_histogram_bucket (interval)]++;
+    self->interval_count++;
+    if (!GST_CLOCK_TIME_IS_VALID (self->interval_min)
+        || interval < self->interval_min)
+      self->interval_min = interval;
+    if (!GST_CLOCK_TIME_IS_VALID (self->interval_max)
+        || interval > self->interval_max)
+      self->interval_max = interval;
+  }
+  self->last_frame_ts = ts;
+}
+
+/* @jitter is the difference between the time the video sink rendered a frame
+ * and the time it should have, as reported in its QoS events */
+static void
+fps_display_sink_update_lateness (GstFPSDisplaySink * self,
+    GstClockTimeDiff jitter)
+{
+  GstClockTime lateness;
+
+  lateness = jitter > 0 ? jitter : 0;
+  if (lateness > 0)
+    self->late_frames++;
+
+  self->lateness_histogram[timing_histogram_bucket (lateness)]++;
+  self->lateness_count++;
+  if (!GST_CLOCK_TIME_IS_VALID (self->lateness_max)
+      || lateness > self->lateness_max)
+    self->lateness_max = lateness;
+}
+
+static void
+fps_display_sink_report_timing (GstFPSDisplaySink * self)
+{
+  GstStructure *s;
+
+  s = gst_structure_new ("fpsdisplaysink-timing",
+      "frames", G_TYPE_UINT64, self->interval_count,
+      "interval-min", G_TYPE_UINT64, self->interval_min,
+      "interval-max", G_TYPE_UINT64, self->interval_max,
+      "interval-p50", G_TYPE_UINT64,
+      timing_histogram_percentile (self->interval_histogram,
+          self->interval_count, 50),
+      "interval-p95", G_TYPE_UINT64,
+      timing_histogram_percentile (self->interval_histogram,
+          self->interval_count, 95),
+      "interval-p99", G_TYPE_UINT64,
+      timing_histogram_percentile (self->interval_histogram,
+          self->interval_count, 99),
+      "late-frames", G_TYPE_UINT64, self->late_frames,
+      "lateness-max", G_TYPE_UINT64, self->lateness_max,
+      "lateness-p50", G_TYPE_UINT64,
+      timing_histogram_percentile (self->lateness_histogram,
+          self->lateness_count, 50),
+      "lateness-p95", G_TYPE_UINT64,
+      timing_histogram_percentile (self->lateness_histogram,
+          self->lateness_count, 95),
+      "lateness-p99", G_TYPE_UINT64,
+      timing_histogram_percentile (self->lateness_histogram,
+          self->lateness_count, 99), NULL);
+
+  GST_LOG_OBJECT (self, "Timing measurements: %" GST_PTR_FORMAT, s);
+
+  if (self->signal_measurements)
+    g_signal_emit (G_OBJECT (self),
+        fpsdisplaysink_signals[SIGNAL_TIMING_MEASUREMENTS], 0, s);
+
+  gst_element_post_message (GST_ELEMENT_CAST (self),
+      gst_message_new_element (GST_OBJECT_CAST (self), s));
+
+  fps_display_sink_reset_timing (self);
+}
+
 static GstPadProbeReturn
 on_video_sink_data_flow (GstPad * pad, GstPadProbeInfo * info,
     gpointer user_data)
@@ -233,10 +424,31 @@ on_video_sink_data_flow (GstPad * pad, GstPadProbeInfo * info,
     if (G_UNLIKELY (!GST_CLOCK_TIME_IS_VALID (self->start_ts))) {
       self->interval_ts = self->last_ts = self->start_ts = ts;
     }
+    if (self->timing_stats)
+      fps_display_sink_update_interval (self, ts);
     if (GST_CLOCK_DIFF (self->interval_ts, ts) > self->fps_update_interval) {
       display_current_fps (self);
       self->interval_ts = ts;
     }
+  } else if (GST_IS_EVENT (mini_obj)) {
+    GstEvent *event = GST_EVENT_CAST (mini_obj);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_QOS:
+        if (self->timing_stats) {
+          GstClockTimeDiff jitter;
+
+          gst_event_parse_qos (event, NULL, NULL, &jitter, NULL);
+          fps_display_sink_update_lateness (self, jitter);
+        }
+        break;
+      case GST_EVENT_FLUSH_STOP:
+        self->last_frame_ts = GST_CLOCK_TIME_NONE;
+        fps_display_sink_reset_timing (self);
+        break;
+      default:
+        break;
+    }
   }
 
   return GST_PAD_PROBE_OK;
@@ -318,7 +530,8 @@ update_video_sink (GstFPSDisplaySink * self, GstElement * video_sink)
   /* attach or pad probe */
   sink_pad = gst_element_get_static_pad (self->video_sink, "sink");
   self->data_probe_id = gst_pad_add_probe (sink_pad,
-      GST_PAD_PROBE_TYPE_DATA_BOTH, on_video_sink_data_flow,
+      GST_PAD_PROBE_TYPE_DATA_BOTH | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      on_video_sink_data_flow,
       (gpointer) self, NULL);
   gst_object_unref (sink_pad);
 }
@@ -336,6 +549,7 @@ fps_display_sink_init (GstFPSDisplaySink * self,
   self->min_fps = -1;
   self->silent = DEFAULT_SILENT;
   self->last_message = g_strdup (DEFAULT_LAST_MESSAGE);
+  self->timing_stats = DEFAULT_TIMING_STATS;
 
   self->ghost_pad = gst_ghost_pad_new_no_target ("sink", GST_PAD_SINK);
   gst_element_add_pad (GST_ELEMENT (self), self->ghost_pad);
@@ -414,6 +628,9 @@ display_current_fps (gpointer data)
     g_object_notify_by_pspec ((GObject *) self, pspec_last_message);
   }
 
+  if (self->timing_stats)
+    fps_display_sink_report_timing (self);
+
   self->last_frames_rendered = frames_rendered;
   self->last_frames_dropped = frames_dropped;
   self->last_ts = current_ts;
@@ -437,6 +654,10 @@ fps_display_sink_start (GstFPSDisplaySink * self)
   /* init time stamps */
   self->last_ts = self->start_ts = self->interval_ts = GST_CLOCK_TIME_NONE;
 
+  /* init timing statistics */
+  self->last_frame_ts = GST_CLOCK_TIME_NONE;
+  fps_display_sink_reset_timing (self);
+
   GST_DEBUG_OBJECT (self, "Use text-overlay? %d", self->use_text_overlay);
 
   if (self->use_text_overlay) {
@@ -570,6 +791,9 @@ fps_display_sink_set_property (GObject * object, guint prop_id,
     case PROP_SILENT:
       self->silent = g_value_get_boolean (value);
       break;
+    case PROP_TIMING_STATS:
+      self->timing_stats = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -613,6 +837,9 @@ fps_display_sink_get_property (GObject * object, guint prop_id,
     case PROP_SILENT:
       g_value_set_boolean (value, self->silent);
       break;
+    case PROP_TIMING_STATS:
+      g_value_set_boolean (value, self->timing_stats);
+      break;
     case PROP_LAST_MESSAGE:
       GST_OBJECT_LOCK (self);
       g_value_set_string (value, self->last_message);
@@ -37,6 +37,10 @@ G_BEGIN_DECLS
 
 GType fps_display_sink_get_type (void);
 
+/* log-linear histogram of microsecond values, 8 sub-buckets per power of
+ * two, covering up to G_MAXUINT32 microseconds */
+#define FPS_DISPLAY_SINK_HISTOGRAM_SIZE 240
+
 typedef struct _GstFPSDisplaySink GstFPSDisplaySink;
 typedef struct _GstFPSDisplaySinkClass GstFPSDisplaySinkClass;
 
@@ -59,10 +63,18 @@ struct _GstFPSDisplaySink
   GstClockTime interval_ts;
   guint data_probe_id;
 
+  /* timing statistics, reset every fps-update-interval */
+  GstClockTime last_frame_ts;
+  guint32 interval_histogram[FPS_DISPLAY_SINK_HISTOGRAM_SIZE];
+  guint32 lateness_histogram[FPS_DISPLAY_SINK_HISTOGRAM_SIZE];
+  guint64 interval_count, lateness_count, late_frames;
+  GstClockTime interval_min, interval_max, lateness_max;
+
   /* properties */
   gboolean sync;
   gboolean use_text_overlay;
   gboolean signal_measurements;
+  gboolean timing_stats;
   GstClockTime fps_update_interval;
   gdouble max_fps;
   gdouble min_fps;
@@ -21,10 +21,15 @@
 #include "config.h"
 #endif
 
+#include <string.h>
+
 #include <gst/gst.h>
 #include <gst/base/gstbasesink.h>
 #include "gstchecksumsink.h"
 
+GST_DEBUG_CATEGORY_STATIC (gst_checksum_sink_debug);
+#define GST_CAT_DEFAULT gst_checksum_sink_debug
+
 static void gst_checksum_sink_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_checksum_sink_get_property (GObject * object, guint prop_id,
@@ -34,13 +39,56 @@ static void gst_checksum_sink_finalize (GObject * object);
 
 static gboolean gst_checksum_sink_start (GstBaseSink * sink);
 static gboolean gst_checksum_sink_stop (GstBaseSink * sink);
+static gboolean gst_checksum_sink_set_caps (GstBaseSink * sink, GstCaps * caps);
+static gboolean gst_checksum_sink_event (GstBaseSink * sink, GstEvent * event);
 static GstFlowReturn
 gst_checksum_sink_render (GstBaseSink * sink, GstBuffer * buffer);
 
+/* Not a GChecksumType, hashed with our own xxHash64 implementation */
+#define GST_CHECKSUM_SINK_HASH_XXH64 0x100
+
+#define DEFAULT_HASH G_CHECKSUM_SHA1
+#define DEFAULT_PLANE_CHECKSUM FALSE
+#define DEFAULT_TILE_WIDTH 0
+#define DEFAULT_TILE_HEIGHT 0
+#define DEFAULT_MAX_THREADS 0
+
 enum
 {
   PROP_0,
   PROP_HASH,
+  PROP_PLANE_CHECKSUM,
+  PROP_TILE_WIDTH,
+  PROP_TILE_HEIGHT,
+  PROP_MAX_THREADS,
+};
+
+typedef struct _GstChecksumSinkFrame GstChecksumSinkFrame;
+
+/* A contiguous run of rows that is hashed on its own, either the whole
+ * buffer, a video plane or a tile of a video plane */
+typedef struct
+{
+  GstChecksumSinkFrame *frame;
+  guint plane;
+  const guint8 *data;
+  gint stride;
+  gsize row_size;
+  guint n_rows;
+  gchar *result;
+} GstChecksumSinkRegion;
+
+struct _GstChecksumSinkFrame
+{
+  GstBuffer *buffer;
+  gboolean is_video;
+  GstVideoFrame vframe;
+  GstMapInfo map;
+
+  GstChecksumSinkRegion *regions;
+  guint n_regions;
+  /* regions not hashed yet, protected by the sink lock */
+  guint remaining;
 };
 
 static GstStaticPadTemplate gst_checksum_sink_sink_template =
@@ -69,6 +117,7 @@ gst_checksum_sink_hash_get_type (void)
       {G_CHECKSUM_SHA1, "SHA-1", "sha1"},
       {G_CHECKSUM_SHA256, "SHA-256", "sha256"},
       {G_CHECKSUM_SHA512, "SHA-512", "sha512"},
+      {GST_CHECKSUM_SINK_HASH_XXH64, "xxHash64 (non-cryptographic)", "xxh64"},
       {0, NULL, NULL},
     };
 
@@ -93,6 +142,8 @@ gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
   gobject_class->finalize = gst_checksum_sink_finalize;
   base_sink_class->start = GST_DEBUG_FUNCPTR (gst_checksum_sink_start);
   base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_checksum_sink_stop);
+  base_sink_class->set_caps = GST_DEBUG_FUNCPTR (gst_checksum_sink_set_caps);
+  base_sink_class->event = GST_DEBUG_FUNCPTR (gst_checksum_sink_event);
   base_sink_class->render = GST_DEBUG_FUNCPTR (gst_checksum_sink_render);
 
   gst_element_class_add_static_pad_template (element_class,
@@ -102,19 +153,54 @@ gst_checksum_sink_class_init (GstChecksumSinkClass * klass)
 
   g_object_class_install_property (gobject_class, PROP_HASH,
       g_param_spec_enum ("hash", "Hash", "Checksum type",
-          gst_checksum_sink_hash_get_type (), G_CHECKSUM_SHA1,
+          gst_checksum_sink_hash_get_type (), DEFAULT_HASH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PLANE_CHECKSUM,
+      g_param_spec_boolean ("plane-checksum", "Plane checksum",
+          "Calculate a separate checksum for each plane of raw video, "
+          "ignoring stride padding", DEFAULT_PLANE_CHECKSUM,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_TILE_WIDTH,
+      g_param_spec_uint ("tile-width", "Tile width",
+          "Width in luma pixels of the regions each plane is split into "
+          "with plane-checksum (0 = full width)", 0, G_MAXINT,
+          DEFAULT_TILE_WIDTH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_TILE_HEIGHT,
+      g_param_spec_uint ("tile-height", "Tile height",
+          "Height in luma lines of the regions each plane is split into "
+          "with plane-checksum (0 = full height)", 0, G_MAXINT,
+          DEFAULT_TILE_HEIGHT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_THREADS,
+      g_param_spec_uint ("max-threads", "Maximum threads",
+          "Maximum number of worker threads used for hashing "
+          "(0 = hash in the streaming thread)", 0, G_MAXINT,
+          DEFAULT_MAX_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (element_class, "Checksum sink",
       "Debug/Sink", "Calculates a checksum for buffers",
       "David Schleef <ds@schleef.org>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_checksum_sink_debug, "checksumsink", 0,
+      "checksumsink element");
 }
 
 static void
 gst_checksum_sink_init (GstChecksumSink * checksumsink)
 {
   gst_base_sink_set_sync (GST_BASE_SINK (checksumsink), FALSE);
-  checksumsink->hash = G_CHECKSUM_SHA1;
+  checksumsink->hash = DEFAULT_HASH;
+  checksumsink->plane_checksum = DEFAULT_PLANE_CHECKSUM;
+  checksumsink->tile_width = DEFAULT_TILE_WIDTH;
+  checksumsink->tile_height = DEFAULT_TILE_HEIGHT;
+  checksumsink->max_threads = DEFAULT_MAX_THREADS;
+
+  g_mutex_init (&checksumsink->lock);
+  g_cond_init (&checksumsink->cond);
+  g_queue_init (&checksumsink->pending);
 }
 
 static void
@@ -127,6 +213,18 @@ gst_checksum_sink_set_property (GObject * object, guint prop_id,
     case PROP_HASH:
       checksumsink->hash = g_value_get_enum (value);
       break;
+    case PROP_PLANE_CHECKSUM:
+      checksumsink->plane_checksum = g_value_get_boolean (value);
+      break;
+    case PROP_TILE_WIDTH:
+      checksumsink->tile_width = g_value_get_uint (value);
+      break;
+    case PROP_TILE_HEIGHT:
+      checksumsink->tile_height = g_value_get_uint (value);
+      break;
+    case PROP_MAX_THREADS:
+      checksumsink->max_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -143,6 +241,18 @@ gst_checksum_sink_get_property (GObject * object, guint prop_id,
     case PROP_HASH:
       g_value_set_enum (value, checksumsink->hash);
       break;
+    case PROP_PLANE_CHECKSUM:
+      g_value_set_boolean (value, checksumsink->plane_checksum);
+      break;
+    case PROP_TILE_WIDTH:
+      g_value_set_uint (value, checksumsink->tile_width);
+      break;
+    case PROP_TILE_HEIGHT:
+      g_value_set_uint (value, checksumsink->tile_height);
+      break;
+    case PROP_MAX_THREADS:
+      g_value_set_uint (value, checksumsink->max_threads);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -158,36 +268,487 @@ gst_checksum_sink_dispose (GObject * object)
 static void
 gst_checksum_sink_finalize (GObject * object)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (object);
+
+  g_mutex_clear (&checksumsink->lock);
+  g_cond_clear (&checksumsink->cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* xxHash64, see https://github.com/Cyan4973/xxHash */
+#define XXH_PRIME64_1 G_GUINT64_CONSTANT (0x9E3779B185EBCA87)
+#define XXH_PRIME64_2 G_GUINT64_CONSTANT (0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME64_3 G_GUINT64_CONSTANT (0x165667B19E3779F9)
+#define XXH_PRIME64_4 G_GUINT64_CONSTANT (0x85EBCA77C2B2AE63)
+#define XXH_PRIME64_5 G_GUINT64_CONSTANT (0x27D4EB2F165667C5)
+
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+typedef struct
+{
+  guint64 total_len;
+  guint64 v[4];
+  guint8 mem[32];
+  guint memsize;
+} GstChecksumSinkXXH64;
+
+static inline guint64
+xxh64_round (guint64 acc, guint64 input)
+{
+  acc += input * XXH_PRIME64_2;
+  acc = XXH_ROTL64 (acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline guint64
+xxh64_merge_round (guint64 acc, guint64 val)
+{
+  acc ^= xxh64_round (0, val);
+  return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+static void
+xxh64_reset (GstChecksumSinkXXH64 * state)
+{
+  memset (state, 0, sizeof (GstChecksumSinkXXH64));
+  state->v[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+  state->v[1] = XXH_PRIME64_2;
+  state->v[2] = 0;
+  state->v[3] = 0 - XXH_PRIME64_1;
+}
+
+static inline void
+xxh64_process_stripe (GstChecksumSinkXXH64 * state, const guint8 * p)
+{
+  state->v[0] = xxh64_round (state->v[0], GST_READ_UINT64_LE (p));
+  state->v[1] = xxh64_round (state->v[1], GST_READ_UINT64_LE (p + 8));
+  state->v[2] = xxh64_round (state->v[2], GST_READ_UINT64_LE (p + 16));
+  state->v[3] = xxh64_round (state->v[3], GST_READ_UINT64_LE (p + 24));
+}
+
+static void
+xxh64_update (GstChecksumSinkXXH64 * state, const guint8 * data, gsize len)
+{
+  const guint8 *end = data + len;
+
+  state->total_len += len;
+
+  if (state->memsize + len < 32) {
+    memcpy (state->mem + state->memsize, data, len);
+    state->memsize += len;
+    return;
+  }
+
+  if (state->memsize > 0) {
+    guint fill = 32 - state->memsize;
+
+    memcpy (state->mem + state->memsize, data, fill);
+    xxh64_process_stripe (state, state->mem);
+    data += fill;
+    state->memsize = 0;
+  }
+
+  while (end - data >= 32) {
+    xxh64_process_stripe (state, data);
+    data += 32;
+  }
+
+  if (data < end) {
+    memcpy (state->mem, data, end - data);
+    state->memsize = end - data;
+  }
+}
+
+static guint64
+xxh64_digest (const GstChecksumSinkXXH64 * state)
+{
+  const guint8 *p = state->mem;
+  const guint8 *end = state->mem + state->memsize;
+  guint64 h;
+
+  if (state->total_len >= 32) {
+    h = XXH_ROTL64 (state->v[0], 1) + XXH_ROTL64 (state->v[1], 7) +
+        XXH_ROTL64 (state->v[2], 12) + XXH_ROTL64 (state->v[3], 18);
+    h = xxh64_merge_round (h, state->v[0]);
+    h = xxh64_merge_round (h, state->v[1]);
+    h = xxh64_merge_round (h, state->v[2]);
+    h = xxh64_merge_round (h, state->v[3]);
+  } else {
+    h = state->v[2] + XXH_PRIME64_5;
+  }
+
+  h += state->total_len;
+
+  while (end - p >= 8) {
+    h ^= xxh64_round (0, GST_READ_UINT64_LE (p));
+    h = XXH_ROTL64 (h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    p += 8;
+  }
+  if (end - p >= 4) {
+    h ^= (guint64) GST_READ_UINT32_LE (p) * XXH_PRIME64_1;
+    h = XXH_ROTL64 (h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+    p += 4;
+  }
+  while (p < end) {
+    h ^= (*p) * XXH_PRIME64_5;
+    h = XXH_ROTL64 (h, 11) * XXH_PRIME64_1;
+    p++;
+  }
+
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+static gchar *
+gst_checksum_sink_hash_region (gint hash, const GstChecksumSinkRegion * region)
+{
+  const guint8 *data = region->data;
+  guint i;
+
+  if (hash == GST_CHECKSUM_SINK_HASH_XXH64) {
+    GstChecksumSinkXXH64 state;
+
+    xxh64_reset (&state);
+    for (i = 0; i < region->n_rows; i++, data += region->stride)
+      xxh64_update (&state, data, region->row_size);
+
+    return g_strdup_printf ("%016" G_GINT64_MODIFIER "x", xxh64_digest (&state));
+  } else {
+    GChecksum *checksum;
+    gchar *s;
+
+    checksum = g_checksum_new (hash);
+    for (i = 0; i < region->n_rows; i++, data += region->stride)
+      g_checksum_update (checksum, data, region->row_size);
+    s = g_strdup (g_checksum_get_string (checksum));
+    g_checksum_free (checksum);
+
+    return s;
+  }
+}
+
+/* Splits a mapped video frame into one region per plane, or per tile of a
+ * plane. Returns FALSE for formats where the visible bytes of a plane can't
+ * be described as rows of pixels, these are hashed as a whole */
+static gboolean
+gst_checksum_sink_frame_split_planes (GstChecksumSink * checksumsink,
+    GstChecksumSinkFrame * frame)
+{
+  const GstVideoFormatInfo *finfo = frame->vframe.info.finfo;
+  GArray *regions;
+  gint comps[GST_VIDEO_MAX_PLANES];
+  guint plane, c;
+
+  if (GST_VIDEO_FORMAT_INFO_IS_TILED (finfo))
+    return FALSE;
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (&frame->vframe); plane++) {
+    comps[plane] = -1;
+    for (c = 0; c < GST_VIDEO_FRAME_N_COMPONENTS (&frame->vframe); c++) {
+      if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, c) == plane) {
+        comps[plane] = c;
+        break;
+      }
+    }
+    if (comps[plane] < 0 || GST_VIDEO_FRAME_COMP_PSTRIDE (&frame->vframe,
+            comps[plane]) <= 0)
+      return FALSE;
+  }
+
+  regions = g_array_new (FALSE, FALSE, sizeof (GstChecksumSinkRegion));
+
+  for (plane = 0; plane < GST_VIDEO_FRAME_N_PLANES (&frame->vframe); plane++) {
+    gint comp = comps[plane];
+    gint pstride = GST_VIDEO_FRAME_COMP_PSTRIDE (&frame->vframe, comp);
+    gint width = GST_VIDEO_FRAME_COMP_WIDTH (&frame->vframe, comp);
+    gint height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame->vframe, comp);
+    gint stride = GST_VIDEO_FRAME_PLANE_STRIDE (&frame->vframe, plane);
+    const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (&frame->vframe, plane);
+    gint tile_w = width, tile_h = height;
+    gint x, y;
+
+    if (checksumsink->tile_width > 0)
+      tile_w = MAX (1, GST_VIDEO_FORMAT_INFO_SCALE_WIDTH (finfo, comp,
+              checksumsink->tile_width));
+    if (checksumsink->tile_height > 0)
+      tile_h = MAX (1, GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT (finfo, comp,
+              checksumsink->tile_height));
+
+    for (y = 0; y < height; y += tile_h) {
+      for (x = 0; x < width; x += tile_w) {
+        GstChecksumSinkRegion region = { 0, };
+
+        region.frame = frame;
+        region.plane = plane;
+        region.data = data + y * stride + x * pstride;
+        region.stride = stride;
+        region.row_size = MIN (tile_w, width - x) * pstride;
+        region.n_rows = MIN (tile_h, height - y);
+        g_array_append_val (regions, region);
+      }
+    }
+  }
+
+  frame->n_regions = regions->len;
+  frame->regions = (GstChecksumSinkRegion *) g_array_free (regions, FALSE);
+
+  return TRUE;
+}
+
+static GstChecksumSinkFrame *
+gst_checksum_sink_frame_new (GstChecksumSink * checksumsink,
+    GstBuffer * buffer)
+{
+  GstChecksumSinkFrame *frame;
+
+  frame = g_slice_new0 (GstChecksumSinkFrame);
+  frame->buffer = gst_buffer_ref (buffer);
+
+  if (checksumsink->plane_checksum && checksumsink->is_video &&
+      gst_video_frame_map (&frame->vframe, &checksumsink->info, buffer,
+          GST_MAP_READ)) {
+    frame->is_video = TRUE;
+    if (gst_checksum_sink_frame_split_planes (checksumsink, frame))
+      goto done;
+
+    gst_video_frame_unmap (&frame->vframe);
+    frame->is_video = FALSE;
+  }
+
+  if (!gst_buffer_map (buffer, &frame->map, GST_MAP_READ)) {
+    gst_buffer_unref (frame->buffer);
+    g_slice_free (GstChecksumSinkFrame, frame);
+    return NULL;
+  }
+
+  frame->n_regions = 1;
+  frame->regions = g_new0 (GstChecksumSinkRegion, 1);
+  frame->regions[0].frame = frame;
+  frame->regions[0].data = frame->map.data;
+  frame->regions[0].stride = frame->map.size;
+  frame->regions[0].row_size = frame->map.size;
+  frame->regions[0].n_rows = 1;
+
+done:
+  frame->remaining = frame->n_regions;
+  return frame;
+}
+
+static void
+gst_checksum_sink_frame_free (GstChecksumSinkFrame * frame)
+{
+  guint i;
+
+  if (frame->is_video)
+    gst_video_frame_unmap (&frame->vframe);
+  else
+    gst_buffer_unmap (frame->buffer, &frame->map);
+  gst_buffer_unref (frame->buffer);
+
+  for (i = 0; i < frame->n_regions; i++)
+    g_free (frame->regions[i].result);
+  g_free (frame->regions);
+
+  g_slice_free (GstChecksumSinkFrame, frame);
+}
+
+static void
+gst_checksum_sink_frame_print (GstChecksumSinkFrame * frame)
+{
+  GString *s;
+  guint i;
+
+  s = g_string_new (NULL);
+  g_string_append_printf (s, "%" GST_TIME_FORMAT,
+      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (frame->buffer)));
+
+  if (!frame->is_video) {
+    g_string_append_printf (s, " %s", frame->regions[0].result);
+  } else {
+    for (i = 0; i < frame->n_regions; i++) {
+      GstChecksumSinkRegion *region = &frame->regions[i];
+
+      if (i == 0 || frame->regions[i - 1].plane != region->plane)
+        g_string_append_printf (s, " %u:%s", region->plane, region->result);
+      else
+        g_string_append_printf (s, ",%s", region->result);
+    }
+  }
+
+  g_print ("%s\n", s->str);
+  g_string_free (s, TRUE);
+}
+
+static void
+gst_checksum_sink_hash_func (gpointer data, gpointer user_data)
+{
+  GstChecksumSink *checksumsink = user_data;
+  GstChecksumSinkRegion *region = data;
+  GstChecksumSinkFrame *frame = region->frame;
+
+  region->result = gst_checksum_sink_hash_region (checksumsink->hash, region);
+
+  g_mutex_lock (&checksumsink->lock);
+  if (--frame->remaining == 0)
+    g_cond_broadcast (&checksumsink->cond);
+  g_mutex_unlock (&checksumsink->lock);
+}
+
+/* Prints all frames at the head of the queue that are completely hashed,
+ * waiting for hashing to finish until at most @limit frames are pending */
+static void
+gst_checksum_sink_drain (GstChecksumSink * checksumsink, guint limit)
+{
+  GstChecksumSinkFrame *frame;
+
+  g_mutex_lock (&checksumsink->lock);
+  while ((frame = g_queue_peek_head (&checksumsink->pending))) {
+    if (frame->remaining > 0) {
+      if (g_queue_get_length (&checksumsink->pending) <= limit)
+        break;
+      g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+      continue;
+    }
+
+    g_queue_pop_head (&checksumsink->pending);
+    g_mutex_unlock (&checksumsink->lock);
+
+    gst_checksum_sink_frame_print (frame);
+    gst_checksum_sink_frame_free (frame);
+
+    g_mutex_lock (&checksumsink->lock);
+  }
+  g_mutex_unlock (&checksumsink->lock);
+}
+
+/* Drops all queued frames without printing them, once their hashing is
+ * done */
+static void
+gst_checksum_sink_discard (GstChecksumSink * checksumsink)
+{
+  GstChecksumSinkFrame *frame;
+
+  g_mutex_lock (&checksumsink->lock);
+  while ((frame = g_queue_peek_head (&checksumsink->pending))) {
+    if (frame->remaining > 0) {
+      g_cond_wait (&checksumsink->cond, &checksumsink->lock);
+      continue;
+    }
+
+    g_queue_pop_head (&checksumsink->pending);
+    gst_checksum_sink_frame_free (frame);
+  }
+  g_mutex_unlock (&checksumsink->lock);
+}
+
 static gboolean
 gst_checksum_sink_start (GstBaseSink * sink)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  GError *err = NULL;
+
+  checksumsink->is_video = FALSE;
+
+  if (checksumsink->max_threads > 0) {
+    checksumsink->pool = g_thread_pool_new (gst_checksum_sink_hash_func,
+        checksumsink, checksumsink->max_threads, FALSE, &err);
+    if (!checksumsink->pool) {
+      GST_ELEMENT_ERROR (checksumsink, RESOURCE, FAILED,
+          ("Failed to create hashing threads"), ("%s", err->message));
+      g_clear_error (&err);
+      return FALSE;
+    }
+  }
+
   return TRUE;
 }
 
 static gboolean
 gst_checksum_sink_stop (GstBaseSink * sink)
 {
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  if (checksumsink->pool) {
+    gst_checksum_sink_drain (checksumsink, 0);
+    g_thread_pool_free (checksumsink->pool, FALSE, TRUE);
+    checksumsink->pool = NULL;
+  }
+
   return TRUE;
 }
 
+static gboolean
+gst_checksum_sink_set_caps (GstBaseSink * sink, GstCaps * caps)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  checksumsink->is_video = gst_video_info_from_caps (&checksumsink->info, caps);
+
+  return TRUE;
+}
+
+static gboolean
+gst_checksum_sink_event (GstBaseSink * sink, GstEvent * event)
+{
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+
+  if (checksumsink->pool) {
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_EOS:
+        gst_checksum_sink_drain (checksumsink, 0);
+        break;
+      case GST_EVENT_FLUSH_STOP:
+        gst_checksum_sink_discard (checksumsink);
+        break;
+      default:
+        break;
+    }
+  }
+
+  return GST_BASE_SINK_CLASS (parent_class)->event (sink, event);
+}
+
 static GstFlowReturn
 gst_checksum_sink_render (GstBaseSink * sink, GstBuffer * buffer)
 {
-  gchar *s;
-  GstMapInfo map;
-  GstChecksumSink *checksumsink;
+  GstChecksumSink *checksumsink = GST_CHECKSUM_SINK (sink);
+  GstChecksumSinkFrame *frame;
+  guint i;
+
+  frame = gst_checksum_sink_frame_new (checksumsink, buffer);
+  if (!frame) {
+    GST_ELEMENT_ERROR (checksumsink, RESOURCE, READ, (NULL),
+        ("Failed to map buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  if (!checksumsink->pool) {
+    for (i = 0; i < frame->n_regions; i++)
+      frame->regions[i].result =
+          gst_checksum_sink_hash_region (checksumsink->hash,
+          &frame->regions[i]);
+    gst_checksum_sink_frame_print (frame);
+    gst_checksum_sink_frame_free (frame);
+    return GST_FLOW_OK;
+  }
+
+  g_mutex_lock (&checksumsink->lock);
+  g_queue_push_tail (&checksumsink->pending, frame);
+  g_mutex_unlock (&checksumsink->lock);
 
-  checksumsink = GST_CHECKSUM_SINK (sink);
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  s = g_compute_checksum_for_data (checksumsink->hash, map.data, map.size);
-  gst_buffer_unmap (buffer, &map);
-  g_print ("%" GST_TIME_FORMAT " %s\n",
-      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)), s);
+  for (i = 0; i < frame->n_regions; i++)
+    g_thread_pool_push (checksumsink->pool, &frame->regions[i], NULL);
 
-  g_free (s);
+  /* Keep enough frames in flight to saturate all threads even when a frame
+   * only has a single region */
+  gst_checksum_sink_drain (checksumsink,
+      2 * g_thread_pool_get_max_threads (checksumsink->pool));
 
   return GST_FLOW_OK;
 }
@@ -22,6 +22,7 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasesink.h>
+#include <gst/video/video.h>
 
 G_BEGIN_DECLS
 
@@ -37,7 +38,23 @@ typedef struct _GstChecksumSinkClass GstChecksumSinkClass;
 struct _GstChecksumSink
 {
   GstBaseSink base_checksumsink;
-  GChecksumType hash;
+
+  /* properties */
+  gint hash;
+  gboolean plane_checksum;
+  guint tile_width;
+  guint tile_height;
+  guint max_threads;
+
+  /* negotiated video format, if any */
+  gboolean is_video;
+  GstVideoInfo info;
+
+  /* worker pool; frames are printed in the order they were rendered */
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  GQueue pending;
 };
 
 struct _GstChecksumSinkClass
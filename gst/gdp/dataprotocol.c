@@ -147,6 +147,7 @@ gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
   guint16 flags_mask;
   guint16 header_crc = 0, crc = 0;
   gsize buffer_size;
+  guint i, n_mem;
 
   mem = gst_allocator_alloc (NULL, GST_DP_HEADER_LENGTH, NULL);
   gst_memory_map (mem, &map, GST_MAP_READWRITE);
@@ -157,7 +158,7 @@ gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
 
   if ((flags & GST_DP_HEADER_FLAG_CRC_PAYLOAD)) {
     GstMapInfo *maps;
-    guint n_maps, i;
+    guint n_maps;
 
     buffer_size = 0;
 
@@ -219,7 +220,18 @@ gst_dp_payload_buffer (GstBuffer * buffer, GstDPHeaderFlag flags)
   /* header */
   gst_buffer_append_memory (ret_buf, mem);
 
-  /* buffer data */
+  /* buffer data; share the payload memories directly instead of going
+   * through gst_buffer_append(), which would make a (shallow) writable copy
+   * of the input buffer first. If the memories don't fit next to the header
+   * they get merged, which is no worse than what appending would do. */
+  n_mem = gst_buffer_n_memory (buffer);
+  if (n_mem < gst_buffer_get_max_memory ()) {
+    for (i = 0; i < n_mem; i++)
+      gst_buffer_append_memory (ret_buf,
+          gst_memory_ref (gst_buffer_peek_memory (buffer, i)));
+    return ret_buf;
+  }
+
   return gst_buffer_append (ret_buf, gst_buffer_ref (buffer));
 }
 
@@ -363,6 +375,61 @@ static const guint16 gst_dp_crc_table[256] = {
   0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
 };
 
+/* Tables for slicing-by-8, gst_dp_crc_table8[k][i] is the CRC register
+ * after feeding byte i followed by k zero bytes into a zeroed register, so
+ * eight input bytes can be folded into the register with eight independent
+ * lookups instead of eight dependent ones. */
+static guint16 gst_dp_crc_table8[8][256];
+
+static void
+gst_dp_crc_init_tables (void)
+{
+  static gsize tables_initialized = 0;
+
+  if (g_once_init_enter (&tables_initialized)) {
+    guint i, k;
+
+    for (i = 0; i < 256; i++) {
+      guint16 crc = gst_dp_crc_table[i];
+
+      gst_dp_crc_table8[0][i] = crc;
+      for (k = 1; k < 8; k++) {
+        crc = (guint16) ((crc << 8) ^ gst_dp_crc_table[(crc >> 8) & 0x00ff]);
+        gst_dp_crc_table8[k][i] = crc;
+      }
+    }
+
+    g_once_init_leave (&tables_initialized, 1);
+  }
+}
+
+/* feed @length bytes of @buffer into @crc_register */
+static guint16
+gst_dp_crc_update (guint16 crc_register, const guint8 * buffer, gsize length)
+{
+  gst_dp_crc_init_tables ();
+
+  while (length >= 8) {
+    crc_register =
+        gst_dp_crc_table8[7][((crc_register >> 8) & 0x00ff) ^ buffer[0]] ^
+        gst_dp_crc_table8[6][(crc_register & 0x00ff) ^ buffer[1]] ^
+        gst_dp_crc_table8[5][buffer[2]] ^
+        gst_dp_crc_table8[4][buffer[3]] ^
+        gst_dp_crc_table8[3][buffer[4]] ^
+        gst_dp_crc_table8[2][buffer[5]] ^
+        gst_dp_crc_table8[1][buffer[6]] ^ gst_dp_crc_table8[0][buffer[7]];
+    buffer += 8;
+    length -= 8;
+  }
+
+  for (; length--;) {
+    crc_register = (guint16) ((crc_register << 8) ^
+        gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *buffer++]);
+  }
+
+  return crc_register;
+}
+
 /**
  * gst_dp_crc:
  * @buffer: array of bytes
@@ -385,10 +452,8 @@ gst_dp_crc (const guint8 * buffer, guint length)
   g_assert (buffer != NULL);
 
   /* calc CRC */
-  for (; length--;) {
-    crc_register = (guint16) ((crc_register << 8) ^
-        gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *buffer++]);
-  }
+  crc_register = gst_dp_crc_update (crc_register, buffer, length);
+
   return (0xffff ^ crc_register);
 }
 
@@ -405,15 +470,8 @@ gst_dp_crc_from_memory_maps (const GstMapInfo * maps, guint n_maps)
 
   /* calc CRC */
   while (n_maps > 0) {
-    guint8 *buffer = maps->data;
-    gsize length = maps->size;
-
-    total_length += length;
-
-    while (length-- > 0) {
-      crc_register = (guint16) ((crc_register << 8) ^
-          gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *buffer++]);
-    }
+    total_length += maps->size;
+    crc_register = gst_dp_crc_update (crc_register, maps->data, maps->size);
     --n_maps;
     ++maps;
   }
@@ -63,6 +63,15 @@
 
 #define DURATION_SCAN_LIMIT         4 * 1024 * 1024
 
+/* minimum SCR distance between two entries of the seek index */
+#define SCR_INDEX_INTERVAL          CLOCK_FREQ
+
+typedef struct
+{
+  guint64 scr;
+  guint64 offset;
+} GstPsDemuxScrEntry;
+
 typedef enum
 {
   SCAN_SCR,
@@ -274,6 +283,7 @@ gst_ps_demux_init (GstPsDemux * demux)
   demux->adapter = gst_adapter_new ();
   demux->rev_adapter = gst_adapter_new ();
   demux->flowcombiner = gst_flow_combiner_new ();
+  demux->scr_index = g_array_new (FALSE, FALSE, sizeof (GstPsDemuxScrEntry));
 
   gst_ps_demux_reset (demux);
 }
@@ -288,6 +298,7 @@ gst_ps_demux_finalize (GstPsDemux * demux)
   gst_flow_combiner_free (demux->flowcombiner);
   g_object_unref (demux->adapter);
   g_object_unref (demux->rev_adapter);
+  g_array_free (demux->scr_index, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (G_OBJECT (demux));
 }
@@ -334,6 +345,7 @@ gst_ps_demux_reset (GstPsDemux * demux)
   demux->mux_rate = G_MAXUINT64;
   demux->next_pts = G_MAXUINT64;
   demux->next_dts = G_MAXUINT64;
+  g_array_set_size (demux->scr_index, 0);
   demux->need_no_more_pads = TRUE;
   demux->adjust_segment = TRUE;
   gst_ps_demux_reset_psm (demux);
@@ -1115,6 +1127,84 @@ not_supported:
   }
 }
 
+/* index of the first entry with an SCR bigger than @scr */
+static guint
+gst_ps_demux_scr_index_find (GstPsDemux * demux, guint64 scr)
+{
+  guint lo = 0, hi = demux->scr_index->len;
+
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+
+    if (g_array_index (demux->scr_index, GstPsDemuxScrEntry, mid).scr <= scr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Remember the offset of a pack with the given SCR, so that later seeks can
+ * start their search from a narrower range than the whole file */
+static void
+gst_ps_demux_scr_index_add (GstPsDemux * demux, guint64 scr, guint64 offset)
+{
+  GstPsDemuxScrEntry entry, *prev = NULL, *next = NULL;
+  guint idx;
+
+  if (!demux->random_access)
+    return;
+
+  idx = gst_ps_demux_scr_index_find (demux, scr);
+  if (idx > 0)
+    prev = &g_array_index (demux->scr_index, GstPsDemuxScrEntry, idx - 1);
+  if (idx < demux->scr_index->len)
+    next = &g_array_index (demux->scr_index, GstPsDemuxScrEntry, idx);
+
+  /* keep the index sparse */
+  if ((prev && scr - prev->scr < SCR_INDEX_INTERVAL) ||
+      (next && next->scr - scr < SCR_INDEX_INTERVAL))
+    return;
+
+  /* the search needs SCR and offset to grow together, ignore entries from
+   * after a SCR discontinuity */
+  if ((prev && offset <= prev->offset) || (next && offset >= next->offset))
+    return;
+
+  GST_LOG_OBJECT (demux, "indexing SCR %" G_GUINT64_FORMAT " at offset %"
+      G_GUINT64_FORMAT, scr, offset);
+
+  entry.scr = scr;
+  entry.offset = offset;
+  g_array_insert_val (demux->scr_index, idx, entry);
+}
+
+/* Narrow the [min, max] search range around @scr using the index */
+static void
+gst_ps_demux_scr_index_lookup (GstPsDemux * demux, guint64 scr,
+    guint64 * min_scr, guint64 * min_scr_offset,
+    guint64 * max_scr, guint64 * max_scr_offset)
+{
+  GstPsDemuxScrEntry *entry;
+  guint idx;
+
+  idx = gst_ps_demux_scr_index_find (demux, scr);
+  if (idx > 0) {
+    entry = &g_array_index (demux->scr_index, GstPsDemuxScrEntry, idx - 1);
+    if (entry->scr > *min_scr) {
+      *min_scr = entry->scr;
+      *min_scr_offset = entry->offset;
+    }
+  }
+  if (idx < demux->scr_index->len) {
+    entry = &g_array_index (demux->scr_index, GstPsDemuxScrEntry, idx);
+    if (entry->scr < *max_scr) {
+      *max_scr = entry->scr;
+      *max_scr_offset = entry->offset;
+    }
+  }
+}
+
 #define MAX_RECURSION_COUNT 100
 
 /* Binary search for requested SCR */
@@ -1136,8 +1226,9 @@ find_offset (GstPsDemux * demux, guint64 scr,
       MIN (gst_util_uint64_scale (scr - min_scr, scr_rate_n,
           scr_rate_d), demux->sink_segment.stop);
 
-  if (!gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0)) {
-    gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0);
+  if (gst_ps_demux_scan_forward_ts (demux, &offset, SCAN_SCR, &fscr, 0) ||
+      gst_ps_demux_scan_backward_ts (demux, &offset, SCAN_SCR, &fscr, 0)) {
+    gst_ps_demux_scr_index_add (demux, fscr, offset);
   }
 
   if (fscr == scr || fscr == min_scr || fscr == max_scr) {
@@ -1158,6 +1249,7 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
 {
   gboolean found;
   guint64 fscr, offset;
+  guint64 min_scr, min_scr_offset, max_scr, max_scr_offset;
   guint64 scr = GSTTIME_TO_MPEGTIME (seeksegment->position + demux->base_time);
 
   /* In some clips the PTS values are completely unaligned with SCR values.
@@ -1173,9 +1265,19 @@ gst_ps_demux_do_seek (GstPsDemux * demux, GstSegment * seeksegment)
   GST_INFO_OBJECT (demux, "sink segment configured %" GST_SEGMENT_FORMAT
       ", trying to go at SCR: %" G_GUINT64_FORMAT, &demux->sink_segment, scr);
 
+  min_scr = demux->first_scr;
+  min_scr_offset = demux->first_scr_offset;
+  max_scr = demux->last_scr;
+  max_scr_offset = demux->last_scr_offset;
+  gst_ps_demux_scr_index_lookup (demux, scr, &min_scr, &min_scr_offset,
+      &max_scr, &max_scr_offset);
+
+  GST_DEBUG_OBJECT (demux, "searching between offsets %" G_GUINT64_FORMAT
+      " and %" G_GUINT64_FORMAT, min_scr_offset, max_scr_offset);
+
   offset =
-      find_offset (demux, scr, demux->first_scr, demux->first_scr_offset,
-      demux->last_scr, demux->last_scr_offset, 0);
+      find_offset (demux, scr, min_scr, min_scr_offset, max_scr,
+      max_scr_offset, 0);
 
   if (offset == (guint64) - 1) {
     return FALSE;
@@ -1716,6 +1818,15 @@ gst_ps_demux_parse_pack_start (GstPsDemux * demux)
   }
   new_rate *= MPEG_MUX_RATE_MULT;
 
+  /* index the pack, using its exact position in the input */
+  if (demux->random_access && demux->sink_segment.rate >= 0.0) {
+    guint64 pack_offset, distance;
+
+    pack_offset = gst_adapter_prev_offset (demux->adapter, &distance);
+    if (pack_offset != GST_BUFFER_OFFSET_NONE)
+      gst_ps_demux_scr_index_add (demux, scr, pack_offset + distance);
+  }
+
   /* scr adjusted is the new scr found + the colected adjustment */
   scr_adjusted = scr + demux->scr_adjust;
 
@@ -2188,12 +2299,14 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
   gint stream_type;
   guint32 start_code;
   guint8 id;
-  GstMapInfo map;
+  guint8 hdr[4];
   gsize datalen;
   guint offset = 0;
 
-  gst_buffer_map (buffer, &map, GST_MAP_READ);
-  datalen = map.size;
+  /* the payload may span several memories, only read the few header bytes
+   * we need instead of mapping (and merging) all of it */
+  datalen = gst_buffer_get_size (buffer);
+  gst_buffer_extract (buffer, 0, hdr, MIN (datalen, sizeof (hdr)));
 
   start_code = filter->start_code;
   id = filter->id;
@@ -2207,9 +2320,9 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
         /* VDR writes A52 streams without any header bytes
          * (see ftp://ftp.mplayerhq.hu/MPlayer/samples/MPEG-VOB/vdr-AC3) */
         if (datalen >= 4) {
-          guint hdr = GST_READ_UINT32_BE (map.data);
+          guint sync = GST_READ_UINT32_BE (hdr);
 
-          if (G_UNLIKELY ((hdr & 0xffff0000) == AC3_SYNC_WORD)) {
+          if (G_UNLIKELY ((sync & 0xffff0000) == AC3_SYNC_WORD)) {
             id = 0x80;
             stream_type = demux->psm[id] = ST_GST_AUDIO_RAWA52;
             GST_DEBUG_OBJECT (demux, "Found VDR raw A52 stream");
@@ -2218,7 +2331,7 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
 
         if (G_LIKELY (stream_type == -1)) {
           /* new id is in the first byte */
-          id = map.data[offset++];
+          id = hdr[offset++];
           datalen--;
 
           /* and remap */
@@ -2232,7 +2345,7 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
 #ifndef GST_DISABLE_GST_DEBUG
             guint8 nframes;
 
-            nframes = map.data[offset];
+            nframes = hdr[offset];
             GST_LOG_OBJECT (demux, "private type 0x%02x, %d frames", id,
                 nframes);
 #endif
@@ -2288,8 +2401,13 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
   }
 
   if (demux->current_stream->notlinked == FALSE) {
-    out_buf =
-        gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, offset, datalen);
+    if (offset == 0) {
+      out_buf = gst_buffer_make_writable (buffer);
+      buffer = NULL;
+    } else {
+      out_buf =
+          gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL, offset, datalen);
+    }
 
     ret = gst_ps_demux_send_data (demux, demux->current_stream, out_buf);
     if (ret == GST_FLOW_NOT_LINKED) {
@@ -2298,8 +2416,8 @@ gst_ps_demux_data_cb (GstPESFilter * filter, gboolean first,
   }
 
 done:
-  gst_buffer_unmap (buffer, &map);
-  gst_buffer_unref (buffer);
+  if (buffer)
+    gst_buffer_unref (buffer);
 
   return ret;
 
@@ -134,6 +134,9 @@ struct _GstPsDemux
   guint64 last_scr_offset;
   guint64 cur_scr_offset;
 
+  /* sparse SCR -> pack offset index, filled in pull mode */
+  GArray *scr_index;
+
   guint64 first_pts;
   guint64 last_pts;
 
@@ -456,6 +456,10 @@ gst_pes_filter_parse (GstPESFilter * filter)
     goto lost_sync;
   }
 
+  /* the optional fields took more than header_data_length announced */
+  if (datalen < 0)
+    goto lost_sync;
+
 push_out:
   {
     GstBuffer *out;
@@ -474,12 +478,18 @@ push_out:
           datalen, consumed);
     }
 
+    /* drop the header and take the payload as a sub-buffer of the input
+     * instead of copying it out of the mapped header data */
+    gst_adapter_unmap (filter->adapter);
+    gst_adapter_flush (filter->adapter, avail - datalen);
+
     if (datalen > 0) {
-      out = gst_buffer_new_allocate (NULL, datalen, NULL);
-      gst_buffer_fill (out, 0, data, datalen);
+      out = gst_adapter_take_buffer_fast (filter->adapter, datalen);
+      ADAPTER_OFFSET_FLUSH (avail);
       ret = gst_pes_filter_data_push (filter, TRUE, out);
       filter->first = FALSE;
     } else {
+      ADAPTER_OFFSET_FLUSH (avail);
       GST_LOG ("first being set to TRUE");
       filter->first = TRUE;
       ret = GST_FLOW_OK;
@@ -489,10 +499,6 @@ push_out:
       filter->state = STATE_DATA_PUSH;
   }
 
-  gst_adapter_unmap (filter->adapter);
-  gst_adapter_flush (filter->adapter, avail);
-  ADAPTER_OFFSET_FLUSH (avail);
-
   return ret;
 
 need_more_data:
@@ -620,7 +626,7 @@ gst_pes_filter_process (GstPESFilter * filter)
         } else {
           GstBuffer *out;
 
-          out = gst_adapter_take_buffer (filter->adapter, avail);
+          out = gst_adapter_take_buffer_fast (filter->adapter, avail);
 
           ret = gst_pes_filter_data_push (filter, filter->first, out);
           filter->first = FALSE;
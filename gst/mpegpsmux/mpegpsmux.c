@@ -94,7 +94,8 @@ static void gst_mpegpsmux_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
 static void mpegpsmux_finalize (GObject * object);
-static gboolean new_packet_cb (guint8 * data, guint len, void *user_data);
+static gboolean new_packet_cb (GstBuffer * buf, void *user_data);
+static void alloc_packet_cb (GstBuffer ** _buf, void *user_data);
 
 static gboolean mpegpsdemux_prepare_srcpad (MpegPsMux * mux);
 static GstFlowReturn mpegpsmux_collected (GstCollectPads * pads,
@@ -141,6 +142,8 @@ mpegpsmux_class_init (MpegPsMuxClass * klass)
 static void
 mpegpsmux_init (MpegPsMux * mux)
 {
+  GstStructure *config;
+
   mux->srcpad = gst_pad_new_from_static_template (&mpegpsmux_src_factory,
       "src");
   gst_pad_use_fixed_caps (mux->srcpad);
@@ -152,6 +155,14 @@ mpegpsmux_init (MpegPsMux * mux)
 
   mux->psmux = psmux_new ();
   psmux_set_write_func (mux->psmux, new_packet_cb, mux);
+  psmux_set_alloc_func (mux->psmux, alloc_packet_cb, mux);
+
+  mux->header_pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (mux->header_pool);
+  gst_buffer_pool_config_set_params (config, NULL, PSMUX_PES_MAX_HDR_LEN, 0,
+      0);
+  gst_buffer_pool_set_config (mux->header_pool, config);
+  mux->header_flow = GST_FLOW_OK;
 
   mux->first = TRUE;
   mux->last_flow_ret = GST_FLOW_OK;
@@ -177,6 +188,13 @@ mpegpsmux_finalize (GObject * object)
     mux->gop_list = NULL;
   }
 
+  if (mux->pes_list != NULL) {
+    gst_buffer_list_unref (mux->pes_list);
+    mux->pes_list = NULL;
+  }
+
+  gst_object_unref (mux->header_pool);
+
   G_OBJECT_CLASS (mpegpsmux_parent_class)->finalize (object);
 }
 
@@ -498,6 +516,23 @@ mpegpsmux_push_gop_list (MpegPsMux * mux)
   return flow;
 }
 
+static GstFlowReturn
+mpegpsmux_push_pes_list (MpegPsMux * mux)
+{
+  GstFlowReturn flow;
+
+  g_assert (mux->pes_list != NULL);
+
+  GST_LOG_OBJECT (mux, "Sending %u packets",
+      gst_buffer_list_length (mux->pes_list));
+  flow = gst_pad_push_list (mux->srcpad, mux->pes_list);
+  mux->pes_list = NULL;
+
+  if (G_UNLIKELY (flow != GST_FLOW_OK))
+    mux->last_flow_ret = flow;
+  return flow;
+}
+
 static GstFlowReturn
 mpegpsmux_collected (GstCollectPads * pads, MpegPsMux * mux)
 {
@@ -570,15 +605,22 @@ mpegpsmux_collected (GstCollectPads * pads, MpegPsMux * mux)
       }
     }
     mux->last_ts = best->last_ts;
+
+    /* all packets of the buffer go downstream in one push */
+    if (mux->pes_list != NULL)
+      ret = mpegpsmux_push_pes_list (mux);
   } else {
     /* FIXME: Drain all remaining streams */
     /* At EOS */
-    if (mux->gop_list != NULL)
-      mpegpsmux_push_gop_list (mux);
-
     if (!psmux_write_end_code (mux->psmux)) {
       GST_WARNING_OBJECT (mux, "Writing MPEG PS Program end code failed.");
     }
+
+    if (mux->gop_list != NULL)
+      mpegpsmux_push_gop_list (mux);
+    if (mux->pes_list != NULL)
+      mpegpsmux_push_pes_list (mux);
+
     gst_pad_push_event (mux->srcpad, gst_event_new_eos ());
 
     ret = GST_FLOW_EOS;
@@ -590,8 +632,17 @@ done:
 new_seg_fail:
   return GST_FLOW_ERROR;
 write_fail:
-  /* FIXME: Failed writing data for some reason. Should set appropriate error */
-  return mux->last_flow_ret;
+  if (mux->pes_list != NULL) {
+    gst_buffer_list_unref (mux->pes_list);
+    mux->pes_list = NULL;
+  }
+  /* the header pool is inactive while flushing or shutting down */
+  if (mux->header_flow == GST_FLOW_FLUSHING)
+    return GST_FLOW_FLUSHING;
+
+  GST_ELEMENT_ERROR (mux, STREAM, MUX,
+      ("Failed writing output data to stream %02x", best->stream_id), (NULL));
+  return GST_FLOW_ERROR;
 }
 
 static GstPad *
@@ -660,19 +711,16 @@ mpegpsmux_release_pad (GstElement * element, GstPad * pad)
 }
 
 static gboolean
-new_packet_cb (guint8 * data, guint len, void *user_data)
+new_packet_cb (GstBuffer * buf, void *user_data)
 {
-  /* Called when the PsMux has prepared a packet for output. Return FALSE
-   * on error */
+  /* Called when the PsMux has prepared a packet for output. The packets are
+   * collected and pushed as a list once the current input buffer has been
+   * written. Return FALSE on error */
 
   MpegPsMux *mux = (MpegPsMux *) user_data;
-  GstBuffer *buf;
-  GstFlowReturn ret;
-
-  GST_LOG_OBJECT (mux, "Outputting a packet of length %d", len);
 
-  data = g_memdup (data, len);
-  buf = gst_buffer_new_wrapped (data, len);
+  GST_LOG_OBJECT (mux, "Outputting a packet of length %" G_GSIZE_FORMAT,
+      gst_buffer_get_size (buf));
 
   GST_BUFFER_TIMESTAMP (buf) = mux->last_ts;
 
@@ -684,16 +732,26 @@ new_packet_cb (guint8 * data, guint len, void *user_data)
     return TRUE;
   }
 
-  ret = gst_pad_push (mux->srcpad, buf);
-
-  if (G_UNLIKELY (ret != GST_FLOW_OK)) {
-    mux->last_flow_ret = ret;
-    return FALSE;
-  }
+  if (mux->pes_list == NULL)
+    mux->pes_list = gst_buffer_list_new ();
 
+  gst_buffer_list_add (mux->pes_list, buf);
   return TRUE;
 }
 
+static void
+alloc_packet_cb (GstBuffer ** _buf, void *user_data)
+{
+  MpegPsMux *mux = (MpegPsMux *) user_data;
+
+  *_buf = NULL;
+  mux->header_flow = gst_buffer_pool_acquire_buffer (mux->header_pool, _buf,
+      NULL);
+  if (mux->header_flow != GST_FLOW_OK)
+    GST_DEBUG_OBJECT (mux, "Failed to acquire a header buffer: %s",
+        gst_flow_get_name (mux->header_flow));
+}
+
 /* prepare the source pad for output */
 static gboolean
 mpegpsdemux_prepare_srcpad (MpegPsMux * mux)
@@ -748,6 +806,7 @@ mpegpsmux_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_NULL_TO_READY:
       break;
     case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_buffer_pool_set_active (mux->header_pool, TRUE);
       gst_collect_pads_start (mux->collect);
       break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
@@ -764,6 +823,13 @@ mpegpsmux_change_state (GstElement * element, GstStateChange transition)
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
   switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (mux->pes_list != NULL) {
+        gst_buffer_list_unref (mux->pes_list);
+        mux->pes_list = NULL;
+      }
+      gst_buffer_pool_set_active (mux->header_pool, FALSE);
+      break;
     default:
       break;
   }
@@ -81,6 +81,14 @@ struct MpegPsMux {
 
   GstBufferList *gop_list;
   gboolean       aggregate_gops;
+
+  /* packets written for the current input buffer */
+  GstBufferList *pes_list;
+
+  /* small buffers for pack and PES headers */
+  GstBufferPool *header_pool;
+  /* result of the last header buffer acquisition */
+  GstFlowReturn header_flow;
 };
 
 struct MpegPsMuxClass  {
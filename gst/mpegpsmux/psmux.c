@@ -54,7 +54,7 @@
 #include "psmux.h"
 #include "crc.h"
 
-static gboolean psmux_packet_out (PsMux * mux);
+static gboolean psmux_packet_out (PsMux * mux, GstBuffer * buf);
 static gboolean psmux_write_pack_header (PsMux * mux);
 static gboolean psmux_write_system_header (PsMux * mux);
 static gboolean psmux_write_program_stream_map (PsMux * mux);
@@ -111,11 +111,56 @@ psmux_set_write_func (PsMux * mux, PsMuxWriteFunc func, void *user_data)
   mux->write_func_data = user_data;
 }
 
+/**
+ * psmux_set_alloc_func:
+ * @mux: a #PsMux
+ * @func: a user callback function
+ * @user_data: user data passed to @func
+ *
+ * Set the callback function and user data to be called when @mux needs
+ * a new buffer to write a pack or PES header into. The buffers must be at
+ * least %PSMUX_PES_MAX_HDR_LEN bytes.
+ * @user_data will be passed as user data in @func.
+ */
+void
+psmux_set_alloc_func (PsMux * mux, PsMuxAllocFunc func, void *user_data)
+{
+  g_return_if_fail (mux != NULL);
+
+  mux->alloc_func = func;
+  mux->alloc_func_data = user_data;
+}
+
+static gboolean
+psmux_get_buffer (PsMux * mux, GstBuffer ** buf)
+{
+  g_return_val_if_fail (buf, FALSE);
+
+  if (G_UNLIKELY (!mux->alloc_func))
+    return FALSE;
+
+  mux->alloc_func (buf, mux->alloc_func_data);
+
+  if (!*buf)
+    return FALSE;
+
+  g_assert (gst_buffer_get_size (*buf) >= PSMUX_PES_MAX_HDR_LEN);
+  return TRUE;
+}
+
 gboolean
 psmux_write_end_code (PsMux * mux)
 {
   guint8 end_code[4] = { 0, 0, 1, PSMUX_PROGRAM_END };
-  return mux->write_func (end_code, 4, mux->write_func_data);
+  GstBuffer *buf;
+
+  if (!psmux_get_buffer (mux, &buf))
+    return FALSE;
+
+  gst_buffer_fill (buf, 0, end_code, 4);
+  gst_buffer_set_size (buf, 4);
+
+  return psmux_packet_out (mux, buf);
 }
 
 
@@ -203,19 +248,22 @@ psmux_create_stream (PsMux * mux, PsMuxStreamType stream_type)
 }
 
 static gboolean
-psmux_packet_out (PsMux * mux)
+psmux_packet_out (PsMux * mux, GstBuffer * buf)
 {
   gboolean res;
-  if (G_UNLIKELY (mux->write_func == NULL))
+  gsize size;
+
+  if (G_UNLIKELY (mux->write_func == NULL)) {
+    gst_buffer_unref (buf);
     return TRUE;
+  }
 
-  res = mux->write_func (mux->packet_buf, mux->packet_bytes_written,
-      mux->write_func_data);
+  size = gst_buffer_get_size (buf);
+  res = mux->write_func (buf, mux->write_func_data);
 
   if (res) {
-    mux->bit_size += mux->packet_bytes_written;
+    mux->bit_size += size;
   }
-  mux->packet_bytes_written = 0;
   return res;
 }
 
@@ -231,6 +279,7 @@ psmux_packet_out (PsMux * mux)
 gboolean
 psmux_write_stream_packet (PsMux * mux, PsMuxStream * stream)
 {
+  GstBuffer *hdr, *payload = NULL;
   gboolean res;
 
   g_return_val_if_fail (mux != NULL, FALSE);
@@ -279,14 +328,24 @@ psmux_write_stream_packet (PsMux * mux, PsMuxStream * stream)
     mux->psm_pts = mux->pts;
   }
 
-  /* Write the packet */
-  if (!(mux->packet_bytes_written =
-          psmux_stream_get_data (stream, mux->packet_buf,
-              mux->pes_max_payload + PSMUX_PES_MAX_HDR_LEN))) {
+  /* Write the packet, the header and the payload go out as separate
+   * buffers so that the payload can keep referencing the input memory */
+  if (!psmux_get_buffer (mux, &hdr))
+    return FALSE;
+
+  if (!psmux_stream_get_data (stream, hdr, &payload,
+          mux->pes_max_payload + PSMUX_PES_MAX_HDR_LEN)) {
+    gst_buffer_unref (hdr);
     return FALSE;
   }
 
-  res = psmux_packet_out (mux);
+  res = psmux_packet_out (mux, hdr);
+  if (payload) {
+    if (res)
+      res = psmux_packet_out (mux, payload);
+    else
+      gst_buffer_unref (payload);
+  }
   if (!res) {
     GST_DEBUG_OBJECT (mux, "packet write false");
     return FALSE;
@@ -301,12 +360,22 @@ static gboolean
 psmux_write_pack_header (PsMux * mux)
 {
   bits_buffer_t bw;
+  GstBuffer *buf;
+  GstMapInfo map;
   guint64 scr = mux->pts;       /* XXX: is this correct? necessary to put any offset? */
   if (mux->pts == -1)
     scr = 0;
 
+  if (!psmux_get_buffer (mux, &buf))
+    return FALSE;
+
+  if (!gst_buffer_map (buf, &map, GST_MAP_WRITE)) {
+    gst_buffer_unref (buf);
+    return FALSE;
+  }
+
   /* pack_start_code */
-  bits_initwrite (&bw, 14, mux->packet_buf);
+  bits_initwrite (&bw, 14, map.data);
   bits_write (&bw, 24, PSMUX_START_CODE_PREFIX);
   bits_write (&bw, 8, PSMUX_PACK_HEADER);
 
@@ -334,8 +403,10 @@ psmux_write_pack_header (PsMux * mux)
   bits_write (&bw, 5, 0x1f);
   bits_write (&bw, 3, 0);       /* pack_stuffing_length */
 
-  mux->packet_bytes_written = 14;
-  return psmux_packet_out (mux);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_set_size (buf, 14);
+
+  return psmux_packet_out (mux, buf);
 }
 
 static void
@@ -396,16 +467,10 @@ psmux_ensure_system_header (PsMux * mux)
 static gboolean
 psmux_write_system_header (PsMux * mux)
 {
-  GstMapInfo map;
-
   psmux_ensure_system_header (mux);
 
-  gst_buffer_map (mux->sys_header, &map, GST_MAP_READ);
-  memcpy (mux->packet_buf, map.data, map.size);
-  mux->packet_bytes_written = map.size;
-  gst_buffer_unmap (mux->sys_header, &map);
-
-  return psmux_packet_out (mux);
+  /* shallow copy, shares the memory of the cached header */
+  return psmux_packet_out (mux, gst_buffer_copy (mux->sys_header));
 }
 
 static void
@@ -480,16 +545,10 @@ psmux_ensure_program_stream_map (PsMux * mux)
 static gboolean
 psmux_write_program_stream_map (PsMux * mux)
 {
-  GstMapInfo map;
-
   psmux_ensure_program_stream_map (mux);
 
-  gst_buffer_map (mux->psm, &map, GST_MAP_READ);
-  memcpy (mux->packet_buf, map.data, map.size);
-  mux->packet_bytes_written = map.size;
-  gst_buffer_unmap (mux->psm, &map);
-
-  return psmux_packet_out (mux);
+  /* shallow copy, shares the memory of the cached map */
+  return psmux_packet_out (mux, gst_buffer_copy (mux->psm));
 }
 
 GList *
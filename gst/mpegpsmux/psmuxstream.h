@@ -90,7 +90,7 @@ struct PsMuxStreamBuffer
   GstClockTime dts;
 
   GstBuffer *buf;
-  GstMapInfo map;
+  gsize size;
 };
 
 /* PsMuxStream receives elementary streams for parsing.
@@ -149,7 +149,8 @@ gint 		psmux_stream_bytes_in_buffer 	(PsMuxStream *stream);
 gint 		psmux_stream_bytes_avail 	(PsMuxStream *stream);
 
 /* write PES data */
-guint	 	psmux_stream_get_data 		(PsMuxStream *stream, guint8 *buf, guint len);
+gboolean 	psmux_stream_get_data 		(PsMuxStream *stream, GstBuffer *hdr,
+						 GstBuffer **payload, guint len);
 
 /* write corresponding descriptors of the stream */
 void 		psmux_stream_get_es_descrs 	(PsMuxStream *stream, guint8 *buf, guint16 *len);
@@ -32,6 +32,10 @@
 #include "config.h"
 #endif
 
+/* FIXME: GValueArray is deprecated, but there is currently no viabla alternative
+ * See https://bugzilla.gnome.org/show_bug.cgi?id=667228 */
+#define GLIB_DISABLE_DEPRECATION_WARNINGS
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -63,6 +67,7 @@ enum
 {
   PROP_0,
   PROP_PARSE_PRIVATE_SECTIONS,
+  PROP_IGNORED_TABLES,
   /* FILL ME */
 };
 
@@ -138,6 +143,57 @@ mpegts_base_class_init (MpegTSBaseClass * klass)
           "Parse private sections", FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_IGNORED_TABLES,
+      g_param_spec_value_array ("ignored-tables", "Ignored tables",
+          "Table IDs of the sections that are neither parsed nor posted "
+          "on the bus (PAT and PMT are still parsed internally)",
+          g_param_spec_uint ("table-id", "Table ID", "Table ID to ignore",
+              0, 0xff, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS),
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+}
+
+static void
+mpegts_base_set_ignored_tables (MpegTSBase * base, GValueArray * array)
+{
+  guint i, table_id;
+
+  memset (base->ignored_tables, 0, sizeof (base->ignored_tables));
+  if (array) {
+    for (i = 0; i < array->n_values; i++) {
+      table_id = g_value_get_uint (g_value_array_get_nth (array, i));
+      MPEGTS_BIT_SET (base->ignored_tables, table_id);
+    }
+  }
+
+  /* The packetizer skips them altogether, except for the PAT and PMT
+   * which we need to set up the programs */
+  memcpy (base->packetizer->ignored_tables, base->ignored_tables,
+      sizeof (base->ignored_tables));
+  MPEGTS_BIT_UNSET (base->packetizer->ignored_tables,
+      GST_MTS_TABLE_ID_PROGRAM_ASSOCIATION);
+  MPEGTS_BIT_UNSET (base->packetizer->ignored_tables,
+      GST_MTS_TABLE_ID_TS_PROGRAM_MAP);
+}
+
+static GValueArray *
+mpegts_base_get_ignored_tables (MpegTSBase * base)
+{
+  GValueArray *array;
+  GValue val = G_VALUE_INIT;
+  guint table_id;
+
+  array = g_value_array_new (0);
+  g_value_init (&val, G_TYPE_UINT);
+  for (table_id = 0; table_id < 0x100; table_id++) {
+    if (MPEGTS_BIT_IS_SET (base->ignored_tables, table_id)) {
+      g_value_set_uint (&val, table_id);
+      g_value_array_append (array, &val);
+    }
+  }
+  g_value_unset (&val);
+
+  return array;
 }
 
 static void
@@ -150,6 +206,9 @@ mpegts_base_set_property (GObject * object, guint prop_id,
     case PROP_PARSE_PRIVATE_SECTIONS:
       base->parse_private_sections = g_value_get_boolean (value);
       break;
+    case PROP_IGNORED_TABLES:
+      mpegts_base_set_ignored_tables (base, g_value_get_boxed (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -165,12 +224,32 @@ mpegts_base_get_property (GObject * object, guint prop_id,
     case PROP_PARSE_PRIVATE_SECTIONS:
       g_value_set_boolean (value, base->parse_private_sections);
       break;
+    case PROP_IGNORED_TABLES:
+      g_value_take_boxed (value, mpegts_base_get_ignored_tables (base));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
 }
 
 
+/* Must be called whenever PIDs are added to known_psi or is_pes. PIDs that
+ * were removed are only dropped from the filter by the next update */
+static void
+mpegts_base_update_wanted_pids (MpegTSBase * base)
+{
+  guint i;
+
+  if (!base->filter_pids) {
+    base->packetizer->wanted_pids = NULL;
+    return;
+  }
+
+  for (i = 0; i < 1024; i++)
+    base->wanted_pids[i] = base->known_psi[i] | base->is_pes[i];
+  base->packetizer->wanted_pids = base->wanted_pids;
+}
+
 static void
 mpegts_base_reset (MpegTSBase * base)
 {
@@ -217,6 +296,8 @@ mpegts_base_reset (MpegTSBase * base)
 
   if (klass->reset)
     klass->reset (base);
+
+  mpegts_base_update_wanted_pids (base);
 }
 
 static void
@@ -238,6 +319,7 @@ mpegts_base_init (MpegTSBase * base)
   base->parse_private_sections = FALSE;
   base->is_pes = g_new0 (guint8, 1024);
   base->known_psi = g_new0 (guint8, 1024);
+  base->wanted_pids = g_new0 (guint8, 1024);
   base->program_size = sizeof (MpegTSBaseProgram);
   base->stream_size = sizeof (MpegTSBaseStream);
 
@@ -257,6 +339,7 @@ mpegts_base_dispose (GObject * object)
     base->disposed = TRUE;
     g_free (base->known_psi);
     g_free (base->is_pes);
+    g_free (base->wanted_pids);
   }
 
   if (G_OBJECT_CLASS (parent_class)->dispose)
@@ -1145,6 +1228,7 @@ same_program:
 static void
 mpegts_base_handle_psi (MpegTSBase * base, GstMpegtsSection * section)
 {
+  GstMpegtsSectionType section_type = section->section_type;
   gboolean post_message = TRUE;
 
   GST_DEBUG ("Handling PSI (pid: 0x%04x , table_id: 0x%02x)",
@@ -1174,11 +1258,18 @@ mpegts_base_handle_psi (MpegTSBase * base, GstMpegtsSection * section)
       break;
   }
 
-  /* Finally post message (if it wasn't corrupted) */
-  if (post_message)
+  /* Finally post message (if it wasn't corrupted or ignored) */
+  if (post_message
+      && !MPEGTS_BIT_IS_SET (base->ignored_tables, section->table_id))
     gst_element_post_message (GST_ELEMENT_CAST (base),
         gst_message_new_mpegts_section (GST_OBJECT (base), section));
   gst_mpegts_section_unref (section);
+
+  /* The PAT, PMT or MGT might have added PIDs */
+  if (section_type == GST_MPEGTS_SECTION_PAT
+      || section_type == GST_MPEGTS_SECTION_PMT
+      || section_type == GST_MPEGTS_SECTION_ATSC_MGT)
+    mpegts_base_update_wanted_pids (base);
 }
 
 static gboolean
@@ -1208,9 +1299,13 @@ mpegts_base_parse_atsc_mgt (MpegTSBase * base, GstMpegtsSection * section)
 static gboolean
 mpegts_base_get_tags_from_eit (MpegTSBase * base, GstMpegtsSection * section)
 {
-  const GstMpegtsEIT *eit;
-  guint i;
+  GstMpegtsEITEventIter iter;
+  GstMpegtsDescriptorIter desc_iter;
+  GstMpegtsDescriptor desc;
+  GstMpegtsRunningStatus running_status;
   MpegTSBaseProgram *program;
+  guint16 event_id;
+  guint32 duration;
 
   /* Early exit if it's not from the present/following table_id */
   if (section->table_id != GST_MTS_TABLE_ID_EVENT_INFORMATION_ACTUAL_TS_PRESENT
@@ -1218,49 +1313,51 @@ mpegts_base_get_tags_from_eit (MpegTSBase * base, GstMpegtsSection * section)
       GST_MTS_TABLE_ID_EVENT_INFORMATION_OTHER_TS_PRESENT)
     return TRUE;
 
-  eit = gst_mpegts_section_get_eit (section);
-  if (G_UNLIKELY (eit == NULL))
+  /* Only the running event is needed, read it from the section data
+   * instead of building the whole EIT */
+  if (G_UNLIKELY (!gst_mpegts_section_eit_event_iter_init (section, &iter)))
     return FALSE;
 
   program = mpegts_base_get_program (base, section->subtable_extension);
 
-  GST_DEBUG
-      ("program_id:0x%04x, table_id:0x%02x, actual_stream:%d, present_following:%d, program:%p",
-      section->subtable_extension, section->table_id, eit->actual_stream,
-      eit->present_following, program);
-
-  if (program && eit->present_following) {
-    for (i = 0; i < eit->events->len; i++) {
-      GstMpegtsEITEvent *event = g_ptr_array_index (eit->events, i);
-      const GstMpegtsDescriptor *desc;
-
-      if (event->running_status == RUNNING_STATUS_RUNNING) {
-        program->event_id = event->event_id;
-        if ((desc =
-                gst_mpegts_find_descriptor (event->descriptors,
-                    GST_MTS_DESC_DVB_SHORT_EVENT))) {
-          gchar *name = NULL, *text = NULL;
-
-          if (gst_mpegts_descriptor_parse_dvb_short_event (desc, NULL, &name,
-                  &text)) {
-            program->tags = gst_tag_list_new_empty ();
-            if (name) {
-              gst_tag_list_add (program->tags, GST_TAG_MERGE_APPEND,
-                  GST_TAG_TITLE, name, NULL);
-              g_free (name);
-            }
-            if (text) {
-              gst_tag_list_add (program->tags, GST_TAG_MERGE_APPEND,
-                  GST_TAG_DESCRIPTION, text, NULL);
-              g_free (text);
-            }
-            /* FIXME : Is it correct to post an event duration as a GST_TAG_DURATION ??? */
-            gst_tag_list_add (program->tags, GST_TAG_MERGE_APPEND,
-                GST_TAG_DURATION, event->duration * GST_SECOND, NULL);
-            return TRUE;
-          }
+  GST_DEBUG ("program_id:0x%04x, table_id:0x%02x, program:%p",
+      section->subtable_extension, section->table_id, program);
+
+  if (program == NULL)
+    return TRUE;
+
+  while (gst_mpegts_eit_event_iter_next (&iter, &event_id, NULL, &duration,
+          &running_status, NULL, &desc_iter)) {
+    if (running_status != RUNNING_STATUS_RUNNING)
+      continue;
+
+    program->event_id = event_id;
+    while (gst_mpegts_descriptor_iter_next (&desc_iter, &desc)) {
+      gchar *name = NULL, *text = NULL;
+
+      if (desc.tag != GST_MTS_DESC_DVB_SHORT_EVENT)
+        continue;
+
+      if (gst_mpegts_descriptor_parse_dvb_short_event (&desc, NULL, &name,
+              &text)) {
+        program->tags = gst_tag_list_new_empty ();
+        if (name) {
+          gst_tag_list_add (program->tags, GST_TAG_MERGE_APPEND,
+              GST_TAG_TITLE, name, NULL);
+          g_free (name);
         }
+        if (text) {
+          gst_tag_list_add (program->tags, GST_TAG_MERGE_APPEND,
+              GST_TAG_DESCRIPTION, text, NULL);
+          g_free (text);
+        }
+        /* FIXME : Is it correct to post an event duration as a GST_TAG_DURATION ??? */
+        gst_tag_list_add (program->tags, GST_TAG_MERGE_APPEND,
+            GST_TAG_DURATION, duration * GST_SECOND, NULL);
+        return TRUE;
       }
+      /* Only the first short event descriptor is considered */
+      break;
     }
   }
 
@@ -132,6 +132,11 @@ struct _MpegTSBase {
   guint8 *known_psi;
   guint8 *is_pes;
 
+  /* known_psi | is_pes, the only PIDs the packetizer hands over when
+   * filter_pids is set by the subclass */
+  guint8 *wanted_pids;
+  gboolean filter_pids;
+
   gboolean disposed;
 
   /* size of the MpegTSBaseProgram structure, can be overridden
@@ -154,6 +159,9 @@ struct _MpegTSBase {
   /* Whether to parse private section or not */
   gboolean parse_private_sections;
 
+  /* Bitmask of table ids that are neither parsed nor posted */
+  guint8 ignored_tables[32];
+
   /* Whether to push data and/or sections to subclasses */
   gboolean push_data;
   gboolean push_section;
@@ -291,6 +291,7 @@ mpegts_packetizer_dispose (GObject * object)
 
     gst_adapter_clear (packetizer->adapter);
     g_object_unref (packetizer->adapter);
+    gst_buffer_replace (&packetizer->last_in_buffer, NULL);
     g_mutex_clear (&packetizer->group_lock);
     packetizer->disposed = TRUE;
     packetizer->offset = 0;
@@ -572,6 +573,7 @@ mpegts_packetizer_clear (MpegTSPacketizer2 * packetizer)
   }
 
   gst_adapter_clear (packetizer->adapter);
+  gst_buffer_replace (&packetizer->last_in_buffer, NULL);
   packetizer->offset = 0;
   packetizer->empty = TRUE;
   packetizer->need_sync = FALSE;
@@ -611,6 +613,7 @@ mpegts_packetizer_flush (MpegTSPacketizer2 * packetizer, gboolean hard)
     }
   }
   gst_adapter_clear (packetizer->adapter);
+  gst_buffer_replace (&packetizer->last_in_buffer, NULL);
 
   packetizer->offset = 0;
   packetizer->empty = TRUE;
@@ -673,6 +676,7 @@ mpegts_packetizer_push (MpegTSPacketizer2 * packetizer, GstBuffer * buffer)
   GST_DEBUG ("Pushing %" G_GSIZE_FORMAT " byte from offset %"
       G_GUINT64_FORMAT, gst_buffer_get_size (buffer),
       GST_BUFFER_OFFSET (buffer));
+  gst_buffer_replace (&packetizer->last_in_buffer, buffer);
   gst_adapter_push (packetizer->adapter, buffer);
   /* If buffer timestamp is valid, store it */
   if (GST_CLOCK_TIME_IS_VALID (GST_BUFFER_TIMESTAMP (buffer)))
@@ -722,8 +726,8 @@ mpegts_packetizer_map (MpegTSPacketizer2 * packetizer, gsize size)
 static gboolean
 mpegts_try_discover_packet_size (MpegTSPacketizer2 * packetizer)
 {
-  guint8 *data;
-  gsize size, i, j;
+  guint8 *data, *sync;
+  gsize size, limit, i, j;
 
   static const guint psizes[] = {
     MPEGTS_NORMAL_PACKETSIZE,
@@ -738,10 +742,16 @@ mpegts_try_discover_packet_size (MpegTSPacketizer2 * packetizer)
   size = packetizer->map_size - packetizer->map_offset;
   data = packetizer->map_data + packetizer->map_offset;
 
-  for (i = 0; i + 3 * MPEGTS_MAX_PACKETSIZE < size; i++) {
-    /* find a sync byte */
-    if (data[i] != PACKET_SYNC_BYTE)
-      continue;
+  limit = size - 3 * MPEGTS_MAX_PACKETSIZE;
+  for (i = 0; i < limit; i++) {
+    /* find a sync byte, memchr() is much faster than a byte loop on
+     * corrupted or misaligned input */
+    sync = memchr (data + i, PACKET_SYNC_BYTE, limit - i);
+    if (sync == NULL) {
+      i = limit;
+      break;
+    }
+    i = sync - data;
 
     /* check for 4 consecutive sync bytes with each possible packet size */
     for (j = 0; j < G_N_ELEMENTS (psizes); j++) {
@@ -779,9 +789,9 @@ static gboolean
 mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
 {
   gboolean found = FALSE;
-  guint8 *data;
+  guint8 *data, *sync;
   guint packet_size;
-  gsize size, sync_offset, i;
+  gsize size, limit, sync_offset, i;
 
   packet_size = packetizer->packet_size;
 
@@ -796,9 +806,16 @@ mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
   else
     sync_offset = 0;
 
-  for (i = sync_offset; i + 2 * packet_size < size; i++) {
-    if (data[i] == PACKET_SYNC_BYTE &&
-        data[i + packet_size] == PACKET_SYNC_BYTE &&
+  limit = size - 2 * packet_size;
+  for (i = sync_offset; i < limit; i++) {
+    sync = memchr (data + i, PACKET_SYNC_BYTE, limit - i);
+    if (sync == NULL) {
+      i = limit;
+      break;
+    }
+    i = sync - data;
+
+    if (data[i + packet_size] == PACKET_SYNC_BYTE &&
         data[i + 2 * packet_size] == PACKET_SYNC_BYTE) {
       found = TRUE;
       break;
@@ -813,13 +830,14 @@ mpegts_packetizer_sync (MpegTSPacketizer2 * packetizer)
   return found;
 }
 
-MpegTSPacketizerPacketReturn
-mpegts_packetizer_next_packet (MpegTSPacketizer2 * packetizer,
-    MpegTSPacketizerPacket * packet)
+static MpegTSPacketizerPacketReturn
+mpegts_packetizer_next_packet_filtered (MpegTSPacketizer2 * packetizer,
+    MpegTSPacketizerPacket * packet, const guint8 * wanted_pids)
 {
   guint8 *packet_data;
   guint packet_size;
   gsize sync_offset;
+  guint16 pid;
 
   packet_size = packetizer->packet_size;
   if (G_UNLIKELY (!packet_size)) {
@@ -851,6 +869,16 @@ mpegts_packetizer_next_packet (MpegTSPacketizer2 * packetizer,
       GST_DEBUG ("lost sync");
       packetizer->need_sync = TRUE;
     } else {
+      /* Drop packets of PIDs nobody is interested in before looking at
+       * their header and adaptation field */
+      pid = GST_READ_UINT16_BE (packet_data + 1) & 0x1FFF;
+      if (wanted_pids && !MPEGTS_BIT_IS_SET (wanted_pids, pid)) {
+        GST_LOG ("skipping packet of PID 0x%04x", pid);
+        packetizer->offset += packet_size;
+        packetizer->map_offset += packet_size;
+        continue;
+      }
+
       /* ALL mpeg-ts variants contain 188 bytes of data. Those with bigger
        * packet sizes contain either extra data (timesync, FEC, ..) either
        * before or after the data */
@@ -866,13 +894,22 @@ mpegts_packetizer_next_packet (MpegTSPacketizer2 * packetizer,
   }
 }
 
+MpegTSPacketizerPacketReturn
+mpegts_packetizer_next_packet (MpegTSPacketizer2 * packetizer,
+    MpegTSPacketizerPacket * packet)
+{
+  return mpegts_packetizer_next_packet_filtered (packetizer, packet,
+      packetizer->wanted_pids);
+}
+
 MpegTSPacketizerPacketReturn
 mpegts_packetizer_process_next_packet (MpegTSPacketizer2 * packetizer)
 {
   MpegTSPacketizerPacket packet;
   MpegTSPacketizerPacketReturn ret;
 
-  ret = mpegts_packetizer_next_packet (packetizer, &packet);
+  /* Used for scanning, which needs to see the PCRs of all PIDs */
+  ret = mpegts_packetizer_next_packet_filtered (packetizer, &packet, NULL);
   if (ret != PACKET_NEED_MORE)
     mpegts_packetizer_clear_packet (packetizer, &packet);
 
@@ -892,6 +929,36 @@ mpegts_packetizer_clear_packet (MpegTSPacketizer2 * packetizer,
   }
 }
 
+/* Returns a buffer with the 188 bytes of @packet. When the packet lies
+ * within the last pushed buffer, the returned buffer shares its memory
+ * instead of copying the data. Must be called before
+ * mpegts_packetizer_clear_packet() */
+GstBuffer *
+mpegts_packetizer_get_packet_buffer (MpegTSPacketizer2 * packetizer,
+    MpegTSPacketizerPacket * packet)
+{
+  GstBuffer *buf;
+  gsize pos, available, in_size;
+
+  /* The map always starts at the head of the adapter */
+  pos = packet->data_start - packetizer->map_data;
+
+  if (packetizer->last_in_buffer) {
+    available = gst_adapter_available (packetizer->adapter);
+    in_size = gst_buffer_get_size (packetizer->last_in_buffer);
+
+    if (pos + in_size >= available && pos + 188 <= available)
+      return gst_buffer_copy_region (packetizer->last_in_buffer,
+          GST_BUFFER_COPY_MEMORY, pos + in_size - available, 188);
+  }
+
+  /* The packet straddles two input buffers */
+  buf = gst_buffer_new_and_alloc (188);
+  gst_buffer_fill (buf, 0, packet->data_start, 188);
+
+  return buf;
+}
+
 gboolean
 mpegts_packetizer_has_packets (MpegTSPacketizer2 * packetizer)
 {
@@ -1083,6 +1150,17 @@ section_start:
    */
   long_packet = data[1] & 0x80;
 
+  /* Skip sections nobody is interested in before accumulating them */
+  if (G_UNLIKELY (MPEGTS_BIT_IS_SET (packetizer->ignored_tables, data[0]))) {
+    section_length = (GST_READ_UINT16_BE (data + 1) & 0xfff) + 3;
+    GST_LOG ("PID 0x%04x skipping ignored table_id 0x%02x", packet->pid,
+        data[0]);
+    data = data_start + MIN (section_length, packet->data_end - data_start);
+    if (data == packet->data_end || *data == 0xff)
+      goto out;
+    goto section_start;
+  }
+
   /* Fast path for short packets */
   if (!long_packet) {
     /* We can create the section now (function will check for size) */
@@ -278,6 +278,16 @@ struct _MpegTSPacketizer2 {
   /* Last inputted timestamp */
   GstClockTime last_in_time;
 
+  /* Last inputted buffer, the tail of the adapter */
+  GstBuffer *last_in_buffer;
+
+  /* Bitmask of table ids whose sections are skipped */
+  guint8 ignored_tables[32];
+
+  /* Bitmask of the PIDs returned by mpegts_packetizer_next_packet(),
+   * NULL to return all of them */
+  const guint8 *wanted_pids;
+
   /* offset to observations table */
   guint8 pcrtablelut[0x2000];
   MpegTSPCR *observations[MAX_PCR_OBS_CHANNELS];
@@ -348,6 +358,8 @@ G_GNUC_INTERNAL MpegTSPacketizerPacketReturn
 mpegts_packetizer_process_next_packet(MpegTSPacketizer2 * packetizer);
 G_GNUC_INTERNAL void mpegts_packetizer_clear_packet (MpegTSPacketizer2 *packetizer,
 				     MpegTSPacketizerPacket *packet);
+G_GNUC_INTERNAL GstBuffer *mpegts_packetizer_get_packet_buffer (MpegTSPacketizer2 *packetizer,
+				     MpegTSPacketizerPacket *packet);
 G_GNUC_INTERNAL void mpegts_packetizer_remove_stream(MpegTSPacketizer2 *packetizer,
   gint16 pid);
 
@@ -59,11 +59,9 @@ struct _MpegTSParsePad
   gint program_number;
   MpegTSParseProgram *program;
 
-  /* set to FALSE before a push and TRUE after */
-  gboolean pushed;
-
-  /* the return of the latest push */
-  GstFlowReturn flow_return;
+  /* packets collected for this pad from the current input buffer,
+   * protected by the object lock */
+  GstBufferList *pending;
 };
 
 static GstStaticPadTemplate src_template =
@@ -96,6 +94,8 @@ static void
 mpegts_parse_program_started (MpegTSBase * base, MpegTSBaseProgram * program);
 static void
 mpegts_parse_program_stopped (MpegTSBase * base, MpegTSBaseProgram * program);
+static void
+mpegts_parse_update_program (MpegTSBase * base, MpegTSBaseProgram * program);
 
 static GstFlowReturn
 mpegts_parse_push (MpegTSBase * base, MpegTSPacketizerPacket * packet,
@@ -115,6 +115,7 @@ static void mpegts_parse_release_pad (GstElement * element, GstPad * pad);
 static gboolean mpegts_parse_src_pad_query (GstPad * pad, GstObject * parent,
     GstQuery * query);
 static gboolean push_event (MpegTSBase * base, GstEvent * event);
+static void mpegts_parse_flush (MpegTSBase * base, gboolean hard);
 
 #define mpegts_parse_parent_class parent_class
 G_DEFINE_TYPE (MpegTSParse2, mpegts_parse, GST_TYPE_MPEGTS_BASE);
@@ -131,6 +132,15 @@ mpegts_parse_dispose (GObject * object)
 
   gst_flow_combiner_free (parse->flowcombiner);
 
+  if (parse->pid_pads) {
+    guint i;
+
+    for (i = 0; i < 0x2000; i++)
+      g_slist_free (parse->pid_pads[i]);
+    g_free (parse->pid_pads);
+    parse->pid_pads = NULL;
+  }
+
   GST_CALL_PARENT (G_OBJECT_CLASS, dispose, (object));
 }
 
@@ -179,7 +189,9 @@ mpegts_parse_class_init (MpegTSParse2Class * klass)
   ts_class->push_event = GST_DEBUG_FUNCPTR (push_event);
   ts_class->program_started = GST_DEBUG_FUNCPTR (mpegts_parse_program_started);
   ts_class->program_stopped = GST_DEBUG_FUNCPTR (mpegts_parse_program_stopped);
+  ts_class->update_program = GST_DEBUG_FUNCPTR (mpegts_parse_update_program);
   ts_class->reset = GST_DEBUG_FUNCPTR (mpegts_parse_reset);
+  ts_class->flush = GST_DEBUG_FUNCPTR (mpegts_parse_flush);
   ts_class->input_done = GST_DEBUG_FUNCPTR (mpegts_parse_input_done);
   ts_class->inspect_packet = GST_DEBUG_FUNCPTR (mpegts_parse_inspect_packet);
 }
@@ -197,6 +209,7 @@ mpegts_parse_init (MpegTSParse2 * parse)
   parse->user_pcr_pid = parse->pcr_pid = -1;
 
   parse->flowcombiner = gst_flow_combiner_new ();
+  parse->pid_pads = g_new0 (GSList *, 0x2000);
 
   parse->srcpad = gst_pad_new_from_static_template (&src_template, "src");
   gst_flow_combiner_add_pad (parse->flowcombiner, parse->srcpad);
@@ -209,6 +222,25 @@ mpegts_parse_init (MpegTSParse2 * parse)
   parse->group_id = G_MAXUINT;
 }
 
+/* drops the packets collected for the request pads that were not pushed
+ * yet, when processing an input buffer was interrupted */
+static void
+mpegts_parse_clear_pending (MpegTSParse2 * parse)
+{
+  GList *tmp;
+
+  GST_OBJECT_LOCK (parse);
+  for (tmp = parse->srcpads; tmp; tmp = tmp->next) {
+    MpegTSParsePad *tspad = gst_pad_get_element_private ((GstPad *) tmp->data);
+
+    if (tspad->pending) {
+      gst_buffer_list_unref (tspad->pending);
+      tspad->pending = NULL;
+    }
+  }
+  GST_OBJECT_UNLOCK (parse);
+}
+
 static void
 mpegts_parse_reset (MpegTSBase * base)
 {
@@ -243,6 +275,7 @@ mpegts_parse_reset (MpegTSBase * base)
 
   g_list_free_full (parse->pending_buffers, (GDestroyNotify) gst_buffer_unref);
   parse->pending_buffers = NULL;
+  mpegts_parse_clear_pending (parse);
 
   parse->current_pcr = GST_CLOCK_TIME_NONE;
   parse->previous_pcr = GST_CLOCK_TIME_NONE;
@@ -252,6 +285,16 @@ mpegts_parse_reset (MpegTSBase * base)
   parse->ts_offset = 0;
 }
 
+static void
+mpegts_parse_flush (MpegTSBase * base, gboolean hard)
+{
+  MpegTSParse2 *parse = (MpegTSParse2 *) base;
+
+  GST_DEBUG_OBJECT (parse, "flushing, hard %d", hard);
+
+  mpegts_parse_clear_pending (parse);
+}
+
 static void
 mpegts_parse_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -390,6 +433,47 @@ push_event (MpegTSBase * base, GstEvent * event)
   return TRUE;
 }
 
+/* Rebuilds the PID to program pads table used to dispatch PES packets.
+ * Must be called with the object lock taken */
+static void
+mpegts_parse_update_pid_table (MpegTSParse2 * parse)
+{
+  MpegTSBaseProgram *bp;
+  MpegTSBaseStream *stream;
+  MpegTSParsePad *tspad;
+  GList *tmp, *l;
+  guint i;
+
+  for (i = 0; i < 0x2000; i++) {
+    g_slist_free (parse->pid_pads[i]);
+    parse->pid_pads[i] = NULL;
+  }
+
+  for (tmp = parse->srcpads; tmp; tmp = tmp->next) {
+    tspad = gst_pad_get_element_private ((GstPad *) tmp->data);
+
+    if (tspad->program_number == -1)
+      continue;
+
+    if (tspad->program)
+      bp = (MpegTSBaseProgram *) tspad->program;
+    else
+      bp = mpegts_base_get_program ((MpegTSBase *) parse,
+          tspad->program_number);
+    if (bp == NULL)
+      continue;
+
+    parse->pid_pads[bp->pmt_pid] =
+        g_slist_prepend (parse->pid_pads[bp->pmt_pid], tspad);
+    for (l = bp->stream_list; l; l = l->next) {
+      stream = (MpegTSBaseStream *) l->data;
+      if (stream->pid != bp->pmt_pid)
+        parse->pid_pads[stream->pid] =
+            g_slist_prepend (parse->pid_pads[stream->pid], tspad);
+    }
+  }
+}
+
 static MpegTSParsePad *
 mpegts_parse_create_tspad (MpegTSParse2 * parse, const gchar * pad_name)
 {
@@ -405,8 +489,7 @@ mpegts_parse_create_tspad (MpegTSParse2 * parse, const gchar * pad_name)
   tspad->pad = pad;
   tspad->program_number = -1;
   tspad->program = NULL;
-  tspad->pushed = FALSE;
-  tspad->flow_return = GST_FLOW_NOT_LINKED;
+  tspad->pending = NULL;
   gst_pad_set_element_private (pad, tspad);
   gst_flow_combiner_add_pad (parse->flowcombiner, pad);
 
@@ -416,6 +499,9 @@ mpegts_parse_create_tspad (MpegTSParse2 * parse, const gchar * pad_name)
 static void
 mpegts_parse_destroy_tspad (MpegTSParse2 * parse, MpegTSParsePad * tspad)
 {
+  if (tspad->pending)
+    gst_buffer_list_unref (tspad->pending);
+
   /* free the wrapper */
   g_free (tspad);
 }
@@ -432,9 +518,12 @@ mpegts_parse_pad_removed (GstElement * element, GstPad * pad)
 
   tspad = (MpegTSParsePad *) gst_pad_get_element_private (pad);
   if (tspad) {
-    mpegts_parse_destroy_tspad (parse, tspad);
-
+    GST_OBJECT_LOCK (parse);
     parse->srcpads = g_list_remove_all (parse->srcpads, pad);
+    mpegts_parse_update_pid_table (parse);
+    GST_OBJECT_UNLOCK (parse);
+
+    mpegts_parse_destroy_tspad (parse, tspad);
   }
   if (parse->srcpads == NULL) {
     base->push_data = FALSE;
@@ -481,7 +570,10 @@ mpegts_parse_request_new_pad (GstElement * element, GstPadTemplate * template,
   }
 
   pad = tspad->pad;
+  GST_OBJECT_LOCK (parse);
   parse->srcpads = g_list_append (parse->srcpads, pad);
+  mpegts_parse_update_pid_table (parse);
+  GST_OBJECT_UNLOCK (parse);
   base->push_data = TRUE;
   base->push_section = TRUE;
 
@@ -525,11 +617,10 @@ mpegts_parse_release_pad (GstElement * element, GstPad * pad)
   gst_element_remove_pad (element, pad);
 }
 
-static GstFlowReturn
-mpegts_parse_tspad_push_section (MpegTSParse2 * parse, MpegTSParsePad * tspad,
-    GstMpegtsSection * section, MpegTSPacketizerPacket * packet)
+static gboolean
+mpegts_parse_tspad_wants_section (MpegTSParse2 * parse,
+    MpegTSParsePad * tspad, GstMpegtsSection * section)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
   gboolean to_push = TRUE;
 
   if (tspad->program_number != -1) {
@@ -553,137 +644,110 @@ mpegts_parse_tspad_push_section (MpegTSParse2 * parse, MpegTSParsePad * tspad,
       "pushing section: %d program number: %d table_id: %d", to_push,
       tspad->program_number, section->table_id);
 
-  if (to_push) {
-    GstBuffer *buf =
-        gst_buffer_new_and_alloc (packet->data_end - packet->data_start);
-    gst_buffer_fill (buf, 0, packet->data_start,
-        packet->data_end - packet->data_start);
-    ret = gst_pad_push (tspad->pad, buf);
-    ret = gst_flow_combiner_update_flow (parse->flowcombiner, ret);
-  }
+  return to_push;
+}
 
-  GST_LOG_OBJECT (parse, "Returning %s", gst_flow_get_name (ret));
-  return ret;
+static void
+mpegts_parse_tspad_queue (MpegTSParsePad * tspad, GstBuffer * buf)
+{
+  if (tspad->pending == NULL)
+    tspad->pending = gst_buffer_list_new ();
+  gst_buffer_list_add (tspad->pending, gst_buffer_ref (buf));
 }
 
+/* Packets are not pushed right away but collected per pad and pushed
+ * as buffer lists once the whole input buffer has been parsed, see
+ * mpegts_parse_push_pending() */
 static GstFlowReturn
-mpegts_parse_tspad_push (MpegTSParse2 * parse, MpegTSParsePad * tspad,
-    MpegTSPacketizerPacket * packet)
+mpegts_parse_push (MpegTSBase * base, MpegTSPacketizerPacket * packet,
+    GstMpegtsSection * section)
 {
-  GstFlowReturn ret = GST_FLOW_OK;
-  MpegTSBaseProgram *bp = NULL;
+  MpegTSParse2 *parse = (MpegTSParse2 *) base;
+  MpegTSParsePad *tspad;
+  GstBuffer *buf = NULL;
+  GSList *l;
+  GList *tmp;
 
-  if (tspad->program_number != -1) {
-    if (tspad->program)
-      bp = (MpegTSBaseProgram *) tspad->program;
-    else
-      bp = mpegts_base_get_program ((MpegTSBase *) parse,
-          tspad->program_number);
-  }
+  GST_OBJECT_LOCK (parse);
+  if (section) {
+    for (tmp = parse->srcpads; tmp; tmp = tmp->next) {
+      tspad = gst_pad_get_element_private ((GstPad *) tmp->data);
 
-  if (bp) {
-    if (packet->pid == bp->pmt_pid || bp->streams == NULL
-        || bp->streams[packet->pid]) {
-      GstBuffer *buf =
-          gst_buffer_new_and_alloc (packet->data_end - packet->data_start);
-      gst_buffer_fill (buf, 0, packet->data_start,
-          packet->data_end - packet->data_start);
-      /* push if there's no filter or if the pid is in the filter */
-      ret = gst_pad_push (tspad->pad, buf);
-      ret = gst_flow_combiner_update_flow (parse->flowcombiner, ret);
+      if (!mpegts_parse_tspad_wants_section (parse, tspad, section))
+        continue;
+
+      if (buf == NULL)
+        buf = mpegts_packetizer_get_packet_buffer (base->packetizer, packet);
+      mpegts_parse_tspad_queue (tspad, buf);
+    }
+  } else {
+    /* push if the pid is in the filter of the pad's program */
+    for (l = parse->pid_pads[packet->pid]; l; l = l->next) {
+      tspad = (MpegTSParsePad *) l->data;
+
+      if (buf == NULL)
+        buf = mpegts_packetizer_get_packet_buffer (base->packetizer, packet);
+      mpegts_parse_tspad_queue (tspad, buf);
     }
   }
-  GST_DEBUG_OBJECT (parse, "Returning %s", gst_flow_get_name (ret));
+  GST_OBJECT_UNLOCK (parse);
 
-  return ret;
+  if (buf)
+    gst_buffer_unref (buf);
+
+  return GST_FLOW_OK;
 }
 
-static void
-pad_clear_for_push (GstPad * pad, MpegTSParse2 * parse)
+typedef struct
 {
-  MpegTSParsePad *tspad = (MpegTSParsePad *) gst_pad_get_element_private (pad);
-
-  tspad->flow_return = GST_FLOW_NOT_LINKED;
-  tspad->pushed = FALSE;
-}
+  GstPad *pad;
+  GstBufferList *list;
+} MpegTSParsePending;
 
 static GstFlowReturn
-mpegts_parse_push (MpegTSBase * base, MpegTSPacketizerPacket * packet,
-    GstMpegtsSection * section)
+mpegts_parse_push_pending (MpegTSParse2 * parse)
 {
-  MpegTSParse2 *parse = (MpegTSParse2 *) base;
-  guint32 pads_cookie;
-  gboolean done = FALSE;
-  GstPad *pad = NULL;
-  MpegTSParsePad *tspad;
-  GstFlowReturn ret;
-  GList *srcpads;
+  GstFlowReturn ret = GST_FLOW_OK;
+  MpegTSParsePending *pending;
+  GSList *to_push = NULL, *l;
+  GList *tmp;
 
   GST_OBJECT_LOCK (parse);
-  srcpads = parse->srcpads;
-
-  /* clear tspad->pushed on pads */
-  g_list_foreach (srcpads, (GFunc) pad_clear_for_push, parse);
-  if (srcpads)
-    ret = GST_FLOW_NOT_LINKED;
-  else
-    ret = GST_FLOW_OK;
-
-  /* Get cookie and source pads list */
-  pads_cookie = GST_ELEMENT_CAST (parse)->pads_cookie;
-  if (G_LIKELY (srcpads)) {
-    pad = GST_PAD_CAST (srcpads->data);
-    g_object_ref (pad);
+  for (tmp = parse->srcpads; tmp; tmp = tmp->next) {
+    MpegTSParsePad *tspad = gst_pad_get_element_private ((GstPad *) tmp->data);
+
+    if (tspad->pending == NULL)
+      continue;
+
+    pending = g_slice_new (MpegTSParsePending);
+    pending->pad = gst_object_ref (tspad->pad);
+    pending->list = tspad->pending;
+    tspad->pending = NULL;
+    to_push = g_slist_prepend (to_push, pending);
   }
   GST_OBJECT_UNLOCK (parse);
 
-  while (pad && !done) {
-    tspad = gst_pad_get_element_private (pad);
-
-    if (G_LIKELY (!tspad->pushed)) {
-      if (section) {
-        tspad->flow_return =
-            mpegts_parse_tspad_push_section (parse, tspad, section, packet);
-      } else {
-        tspad->flow_return = mpegts_parse_tspad_push (parse, tspad, packet);
-      }
-      tspad->pushed = TRUE;
-
-      if (G_UNLIKELY (tspad->flow_return != GST_FLOW_OK
-              && tspad->flow_return != GST_FLOW_NOT_LINKED)) {
-        /* return the error upstream */
-        ret = tspad->flow_return;
-        done = TRUE;
-      }
+  to_push = g_slist_reverse (to_push);
+  for (l = to_push; l; l = l->next) {
+    pending = (MpegTSParsePending *) l->data;
 
+    if (ret == GST_FLOW_OK) {
+      GST_LOG_OBJECT (parse, "pushing %u packets on %s:%s",
+          gst_buffer_list_length (pending->list),
+          GST_DEBUG_PAD_NAME (pending->pad));
+      ret = gst_pad_push_list (pending->pad, pending->list);
+      ret = gst_flow_combiner_update_pad_flow (parse->flowcombiner,
+          pending->pad, ret);
+    } else {
+      gst_buffer_list_unref (pending->list);
     }
 
-    if (ret == GST_FLOW_NOT_LINKED)
-      ret = tspad->flow_return;
-
-    g_object_unref (pad);
-
-    if (G_UNLIKELY (!done)) {
-      GST_OBJECT_LOCK (parse);
-      if (G_UNLIKELY (pads_cookie != GST_ELEMENT_CAST (parse)->pads_cookie)) {
-        /* resync */
-        GST_DEBUG ("resync");
-        pads_cookie = GST_ELEMENT_CAST (parse)->pads_cookie;
-        srcpads = parse->srcpads;
-      } else {
-        GST_DEBUG ("getting next pad");
-        /* Get next pad */
-        srcpads = g_list_next (srcpads);
-      }
-
-      if (srcpads) {
-        pad = GST_PAD_CAST (srcpads->data);
-        g_object_ref (pad);
-      } else
-        done = TRUE;
-      GST_OBJECT_UNLOCK (parse);
-    }
+    gst_object_unref (pending->pad);
+    g_slice_free (MpegTSParsePending, pending);
   }
+  g_slist_free (to_push);
+
+  GST_DEBUG_OBJECT (parse, "Returning %s", gst_flow_get_name (ret));
 
   return ret;
 }
@@ -864,6 +928,12 @@ mpegts_parse_input_done (MpegTSBase * base, GstBuffer * buffer)
 
   GST_LOG_OBJECT (parse, "Received buffer %" GST_PTR_FORMAT, buffer);
 
+  ret = mpegts_parse_push_pending (parse);
+  if (ret != GST_FLOW_OK) {
+    gst_buffer_unref (buffer);
+    return ret;
+  }
+
   if (parse->current_pcr != GST_CLOCK_TIME_NONE) {
     GST_DEBUG_OBJECT (parse,
         "InputTS %" GST_TIME_FORMAT " PCR %" GST_TIME_FORMAT,
@@ -925,10 +995,24 @@ mpegts_parse_program_started (MpegTSBase * base, MpegTSBaseProgram * program)
   /* If we have a request pad for that program, activate it */
   tspad = find_pad_for_program (parse, program->program_number);
 
+  GST_OBJECT_LOCK (parse);
   if (tspad) {
     tspad->program = parseprogram;
     parseprogram->tspad = tspad;
   }
+  mpegts_parse_update_pid_table (parse);
+  GST_OBJECT_UNLOCK (parse);
+}
+
+static void
+mpegts_parse_update_program (MpegTSBase * base, MpegTSBaseProgram * program)
+{
+  MpegTSParse2 *parse = GST_MPEGTS_PARSE (base);
+
+  /* streams of the program were added or removed */
+  GST_OBJECT_LOCK (parse);
+  mpegts_parse_update_pid_table (parse);
+  GST_OBJECT_UNLOCK (parse);
 }
 
 static void
@@ -941,10 +1025,13 @@ mpegts_parse_program_stopped (MpegTSBase * base, MpegTSBaseProgram * program)
   /* If we have a request pad for that program, activate it */
   tspad = find_pad_for_program (parse, program->program_number);
 
+  GST_OBJECT_LOCK (parse);
   if (tspad) {
     tspad->program = NULL;
     parseprogram->tspad = NULL;
   }
+  mpegts_parse_update_pid_table (parse);
+  GST_OBJECT_UNLOCK (parse);
 
   parse->pcr_pid = -1;
   parse->ts_offset += parse->current_pcr - parse->base_pcr;
@@ -65,6 +65,9 @@ struct _MpegTSParse2 {
   /* Request source (single program) pads */
   GList *srcpads;
 
+  /* program pads wanting the PES packets of each PID */
+  GSList **pid_pads;
+
   GstFlowCombiner *flowcombiner;
   
   /* state */
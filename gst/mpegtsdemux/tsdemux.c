@@ -71,6 +71,19 @@
 
 #define GST_FLOW_REWINDING GST_FLOW_CUSTOM_ERROR
 
+/* Name of the custom query and upstream event structure used to get and
+ * restore the keyframe seek table */
+#define SEEK_TABLE_STRUCTURE_NAME "mpegts-seek-table"
+
+/* Maximum number of buffers and events queued on a stream pushed from its
+ * own thread */
+#define STREAM_QUEUE_MAX_ITEMS 256
+
+/* Flow returns after which the pad task of a stream drops buffers until the
+ * next flush. Not-linked is not one of them, the pad might get linked */
+#define STREAM_FLOW_IS_FATAL(ret) \
+    ((ret) != GST_FLOW_OK && (ret) != GST_FLOW_NOT_LINKED)
+
 /* latency in nsecs */
 #define TS_LATENCY (700 * GST_MSECOND)
 
@@ -109,6 +122,14 @@ typedef struct
   guint64 pts, dts;
 } PendingBuffer;
 
+/* Seek table entry: offset of the TS packet starting a keyframe PES and
+ * the stream time of that keyframe */
+typedef struct
+{
+  guint64 offset;
+  GstClockTime ts;
+} TSDemuxSeekEntry;
+
 typedef struct _TSDemuxStream TSDemuxStream;
 
 typedef struct _TSDemuxH264ParsingInfos TSDemuxH264ParsingInfos;
@@ -200,6 +221,17 @@ struct _TSDemuxStream
 
   GstTsDemuxKeyFrameScanFunction scan_function;
   TSDemuxH264ParsingInfos h264infos;
+
+  /* Data and serialized events are handed to the pad task through this
+   * bounded queue when pushing from a dedicated thread (parallel-streams) */
+  gboolean threaded;
+  GMutex queue_lock;
+  GCond queue_cond;
+  GQueue queue;
+  /* TRUE while the task pushes the item it took from the queue */
+  gboolean queue_busy;
+  gboolean flushing;
+  GstFlowReturn last_flow;
 };
 
 #define VIDEO_CAPS \
@@ -273,6 +305,7 @@ enum
   PROP_0,
   PROP_PROGRAM_NUMBER,
   PROP_EMIT_STATS,
+  PROP_PARALLEL_STREAMS,
   /* FILL ME */
 };
 
@@ -338,6 +371,10 @@ gst_ts_demux_dispose (GObject * object)
   GstTSDemux *demux = GST_TS_DEMUX_CAST (object);
 
   gst_flow_combiner_free (demux->flowcombiner);
+  if (demux->seek_table) {
+    g_array_free (demux->seek_table, TRUE);
+    demux->seek_table = NULL;
+  }
 
   GST_CALL_PARENT (G_OBJECT_CLASS, dispose, (object));
 }
@@ -364,6 +401,13 @@ gst_ts_demux_class_init (GstTSDemuxClass * klass)
           "Emit messages for every pcr/opcr/pts/dts", FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_PARALLEL_STREAMS,
+      g_param_spec_boolean ("parallel-streams", "Parallel streams",
+          "Push each stream from its own thread through a bounded queue, so "
+          "that a slow downstream doesn't hold back the other streams "
+          "(applies to streams added afterwards)", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   element_class = GST_ELEMENT_CLASS (klass);
   gst_element_class_add_pad_template (element_class,
       gst_static_pad_template_get (&video_template));
@@ -423,6 +467,12 @@ gst_ts_demux_reset (MpegTSBase * base)
 
   demux->last_seek_offset = -1;
   demux->program_generation = 0;
+
+  GST_OBJECT_LOCK (demux);
+  if (demux->seek_table)
+    g_array_set_size (demux->seek_table, 0);
+  demux->index_pid = -1;
+  GST_OBJECT_UNLOCK (demux);
 }
 
 static void
@@ -434,8 +484,11 @@ gst_ts_demux_init (GstTSDemux * demux)
   base->parse_private_sections = TRUE;
   /* We are not interested in sections (all handled by mpegtsbase) */
   base->push_section = FALSE;
+  /* Nor in packets of PIDs that are not part of an active program */
+  base->filter_pids = TRUE;
 
   demux->flowcombiner = gst_flow_combiner_new ();
+  demux->seek_table = g_array_new (FALSE, FALSE, sizeof (TSDemuxSeekEntry));
   demux->requested_program_number = -1;
   demux->program_number = -1;
   gst_ts_demux_reset (base);
@@ -457,6 +510,11 @@ gst_ts_demux_set_property (GObject * object, guint prop_id,
     case PROP_EMIT_STATS:
       demux->emit_statistics = g_value_get_boolean (value);
       break;
+    case PROP_PARALLEL_STREAMS:
+      GST_OBJECT_LOCK (demux);
+      demux->parallel_streams = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -475,6 +533,11 @@ gst_ts_demux_get_property (GObject * object, guint prop_id,
     case PROP_EMIT_STATS:
       g_value_set_boolean (value, demux->emit_statistics);
       break;
+    case PROP_PARALLEL_STREAMS:
+      GST_OBJECT_LOCK (demux);
+      g_value_set_boolean (value, demux->parallel_streams);
+      GST_OBJECT_UNLOCK (demux);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -499,6 +562,160 @@ gst_ts_demux_get_duration (GstTSDemux * demux, GstClockTime * dur)
   return res;
 }
 
+/* Call with the OBJECT_LOCK */
+static void
+gst_ts_demux_seek_table_add (GstTSDemux * demux, guint64 offset,
+    GstClockTime ts)
+{
+  GArray *table = demux->seek_table;
+  TSDemuxSeekEntry entry;
+  guint lo = 0, hi = table->len;
+
+  entry.offset = offset;
+  entry.ts = ts;
+
+  /* Appending while playing forward is the common case */
+  if (hi == 0 || g_array_index (table, TSDemuxSeekEntry, hi - 1).offset <
+      offset) {
+    g_array_append_val (table, entry);
+    return;
+  }
+
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+
+    if (g_array_index (table, TSDemuxSeekEntry, mid).offset < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (g_array_index (table, TSDemuxSeekEntry, lo).offset != offset)
+    g_array_insert_val (table, lo, entry);
+}
+
+/* Returns the offset of the last known keyframe at or before @ts if it is
+ * close enough to start from there, else -1 */
+static guint64
+gst_ts_demux_seek_table_lookup (GstTSDemux * demux, GstClockTime ts)
+{
+  GArray *table;
+  guint64 res = -1;
+  guint lo = 0, hi;
+
+  GST_OBJECT_LOCK (demux);
+  table = demux->seek_table;
+  hi = table->len;
+
+  /* Keyframe timestamps grow with the offset, look for the first one
+   * after ts */
+  while (lo < hi) {
+    guint mid = (lo + hi) / 2;
+
+    if (g_array_index (table, TSDemuxSeekEntry, mid).ts <= ts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo > 0) {
+    TSDemuxSeekEntry *entry = &g_array_index (table, TSDemuxSeekEntry, lo - 1);
+
+    if (ts - entry->ts <= SEEK_TIMESTAMP_OFFSET)
+      res = entry->offset;
+  }
+  GST_OBJECT_UNLOCK (demux);
+
+  return res;
+}
+
+static void
+gst_ts_demux_record_keyframe (GstTSDemux * demux, TSDemuxStream * stream,
+    guint64 offset)
+{
+  MpegTSBaseStream *bs = (MpegTSBaseStream *) stream;
+
+  /* Offsets are only meaningful if we are driving the reading */
+  if (((MpegTSBase *) demux)->mode == BASE_MODE_PUSHING)
+    return;
+
+  if (!GST_CLOCK_TIME_IS_VALID (stream->pts) || bs->stream_object == NULL ||
+      !(gst_stream_get_stream_type (bs->stream_object) & GST_STREAM_TYPE_VIDEO))
+    return;
+
+  GST_OBJECT_LOCK (demux);
+  /* Only index the first video stream */
+  if (demux->index_pid == -1)
+    demux->index_pid = bs->pid;
+  if (demux->index_pid == bs->pid) {
+    GST_LOG_OBJECT (demux, "keyframe at offset %" G_GUINT64_FORMAT " ts %"
+        GST_TIME_FORMAT, offset, GST_TIME_ARGS (stream->pts));
+    gst_ts_demux_seek_table_add (demux, offset, stream->pts);
+  }
+  GST_OBJECT_UNLOCK (demux);
+}
+
+static void
+gst_ts_demux_get_seek_table (GstTSDemux * demux, GstStructure * s)
+{
+  GValue offsets = G_VALUE_INIT, timestamps = G_VALUE_INIT;
+  GValue v = G_VALUE_INIT;
+  guint i;
+
+  g_value_init (&offsets, GST_TYPE_ARRAY);
+  g_value_init (&timestamps, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+
+  GST_OBJECT_LOCK (demux);
+  for (i = 0; i < demux->seek_table->len; i++) {
+    TSDemuxSeekEntry *entry =
+        &g_array_index (demux->seek_table, TSDemuxSeekEntry, i);
+
+    g_value_set_uint64 (&v, entry->offset);
+    gst_value_array_append_value (&offsets, &v);
+    g_value_set_uint64 (&v, entry->ts);
+    gst_value_array_append_value (&timestamps, &v);
+  }
+  GST_OBJECT_UNLOCK (demux);
+
+  gst_structure_take_value (s, "offsets", &offsets);
+  gst_structure_take_value (s, "timestamps", &timestamps);
+  g_value_unset (&v);
+}
+
+static gboolean
+gst_ts_demux_set_seek_table (GstTSDemux * demux, const GstStructure * s)
+{
+  const GValue *offsets, *timestamps;
+  guint i, n;
+
+  offsets = gst_structure_get_value (s, "offsets");
+  timestamps = gst_structure_get_value (s, "timestamps");
+  if (offsets == NULL || !GST_VALUE_HOLDS_ARRAY (offsets) ||
+      timestamps == NULL || !GST_VALUE_HOLDS_ARRAY (timestamps))
+    return FALSE;
+
+  n = gst_value_array_get_size (offsets);
+  if (gst_value_array_get_size (timestamps) != n)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (demux, "restoring %u seek table entries", n);
+
+  GST_OBJECT_LOCK (demux);
+  for (i = 0; i < n; i++) {
+    const GValue *offset = gst_value_array_get_value (offsets, i);
+    const GValue *ts = gst_value_array_get_value (timestamps, i);
+
+    if (!G_VALUE_HOLDS_UINT64 (offset) || !G_VALUE_HOLDS_UINT64 (ts))
+      continue;
+    gst_ts_demux_seek_table_add (demux, g_value_get_uint64 (offset),
+        g_value_get_uint64 (ts));
+  }
+  GST_OBJECT_UNLOCK (demux);
+
+  return TRUE;
+}
+
 static gboolean
 gst_ts_demux_srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
 {
@@ -596,6 +813,19 @@ gst_ts_demux_srcpad_query (GstPad * pad, GstObject * parent, GstQuery * query)
       res = TRUE;
       break;
     }
+    case GST_QUERY_CUSTOM:
+    {
+      const GstStructure *s = gst_query_get_structure (query);
+
+      if (s && gst_structure_has_name (s, SEEK_TABLE_STRUCTURE_NAME)) {
+        gst_ts_demux_get_seek_table (demux,
+            gst_query_writable_structure (query));
+        res = TRUE;
+      } else {
+        res = gst_pad_query_default (pad, parent, query);
+      }
+      break;
+    }
     default:
       res = gst_pad_query_default (pad, parent, query);
   }
@@ -841,9 +1071,16 @@ gst_ts_demux_do_seek (MpegTSBase * base, GstEvent * event)
   GST_DEBUG_OBJECT (demux, "configuring seek");
 
   if (start_type != GST_SEEK_TYPE_NONE) {
-    start_offset =
-        mpegts_packetizer_ts_to_offset (base->packetizer, MAX (0,
-            start - SEEK_TIMESTAMP_OFFSET), demux->program->pcr_pid);
+    /* Start from a known keyframe if we have one close enough, else
+     * interpolate from the PCR observations */
+    start_offset = gst_ts_demux_seek_table_lookup (demux, start);
+    if (start_offset != -1)
+      GST_DEBUG_OBJECT (demux, "Using keyframe at offset %" G_GUINT64_FORMAT
+          " from the seek table", start_offset);
+    else
+      start_offset =
+          mpegts_packetizer_ts_to_offset (base->packetizer, MAX (0,
+              start - SEEK_TIMESTAMP_OFFSET), demux->program->pcr_pid);
 
     if (G_UNLIKELY (start_offset == -1)) {
       GST_WARNING ("Couldn't convert start position to an offset");
@@ -913,6 +1150,15 @@ gst_ts_demux_srcpad_event (GstPad * pad, GstObject * parent, GstEvent * event)
         GST_WARNING ("seeking failed");
       gst_event_unref (event);
       break;
+    case GST_EVENT_CUSTOM_UPSTREAM:
+      if (gst_event_has_name (event, SEEK_TABLE_STRUCTURE_NAME)) {
+        res = gst_ts_demux_set_seek_table (demux,
+            gst_event_get_structure (event));
+        gst_event_unref (event);
+      } else {
+        res = gst_pad_event_default (pad, parent, event);
+      }
+      break;
     default:
       res = gst_pad_event_default (pad, parent, event);
   }
@@ -920,6 +1166,236 @@ gst_ts_demux_srcpad_event (GstPad * pad, GstObject * parent, GstEvent * event)
   return res;
 }
 
+/* Hand @item (a buffer, buffer list or serialized event) to the pad task of
+ * @stream, waiting for room in its queue. @item is only pushed later, so
+ * this returns the flow return of the items pushed before. Once that is
+ * fatal buffers are dropped until the next flush, events such as EOS still
+ * go through */
+static GstFlowReturn
+gst_ts_demux_stream_queue_item (TSDemuxStream * stream, GstMiniObject * item)
+{
+  GstFlowReturn ret;
+
+  g_mutex_lock (&stream->queue_lock);
+  while (stream->queue.length >= STREAM_QUEUE_MAX_ITEMS && !stream->flushing
+      && !STREAM_FLOW_IS_FATAL (stream->last_flow))
+    g_cond_wait (&stream->queue_cond, &stream->queue_lock);
+
+  if (G_UNLIKELY (stream->flushing)) {
+    g_mutex_unlock (&stream->queue_lock);
+    gst_mini_object_unref (item);
+    return GST_FLOW_FLUSHING;
+  }
+
+  if (G_UNLIKELY (STREAM_FLOW_IS_FATAL (stream->last_flow)
+          && !GST_IS_EVENT (item))) {
+    ret = stream->last_flow;
+    g_mutex_unlock (&stream->queue_lock);
+    GST_LOG_OBJECT (stream->pad, "dropping item, flow %s",
+        gst_flow_get_name (ret));
+    gst_mini_object_unref (item);
+    return ret;
+  }
+
+  g_queue_push_tail (&stream->queue, item);
+  g_cond_broadcast (&stream->queue_cond);
+  ret = stream->last_flow;
+  g_mutex_unlock (&stream->queue_lock);
+
+  return ret;
+}
+
+/* Call with the queue lock */
+static void
+gst_ts_demux_stream_drop_buffers (TSDemuxStream * stream)
+{
+  GList *l = stream->queue.head;
+
+  while (l) {
+    GList *next = l->next;
+
+    if (!GST_IS_EVENT (l->data)) {
+      gst_mini_object_unref (l->data);
+      g_queue_delete_link (&stream->queue, l);
+    }
+    l = next;
+  }
+}
+
+static void
+gst_ts_demux_stream_loop (TSDemuxStream * stream)
+{
+  GstMiniObject *item;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean is_event;
+
+  g_mutex_lock (&stream->queue_lock);
+  while (g_queue_is_empty (&stream->queue) && !stream->flushing)
+    g_cond_wait (&stream->queue_cond, &stream->queue_lock);
+
+  if (stream->flushing) {
+    g_mutex_unlock (&stream->queue_lock);
+    GST_DEBUG_OBJECT (stream->pad, "flushing, pausing task");
+    gst_pad_pause_task (stream->pad);
+    return;
+  }
+
+  item = g_queue_pop_head (&stream->queue);
+  stream->queue_busy = TRUE;
+  g_cond_broadcast (&stream->queue_cond);
+  g_mutex_unlock (&stream->queue_lock);
+
+  is_event = GST_IS_EVENT (item);
+  if (is_event)
+    gst_pad_push_event (stream->pad, GST_EVENT_CAST (item));
+  else if (GST_IS_BUFFER_LIST (item))
+    ret = gst_pad_push_list (stream->pad, GST_BUFFER_LIST_CAST (item));
+  else
+    ret = gst_pad_push (stream->pad, GST_BUFFER_CAST (item));
+
+  g_mutex_lock (&stream->queue_lock);
+  if (!is_event)
+    stream->last_flow = ret;
+  stream->queue_busy = FALSE;
+  /* No buffer is pushed anymore until the next flush, drop them so that
+   * neither the sink thread nor draining waits for them. The queued events
+   * are still pushed, downstream needs the EOS after returning EOS */
+  if (STREAM_FLOW_IS_FATAL (ret)) {
+    GST_DEBUG_OBJECT (stream->pad, "dropping queued buffers, reason %s",
+        gst_flow_get_name (ret));
+    gst_ts_demux_stream_drop_buffers (stream);
+  }
+  g_cond_broadcast (&stream->queue_cond);
+  g_mutex_unlock (&stream->queue_lock);
+}
+
+static void
+gst_ts_demux_stream_set_flushing (TSDemuxStream * stream, gboolean flushing)
+{
+  g_mutex_lock (&stream->queue_lock);
+  stream->flushing = flushing;
+  g_queue_foreach (&stream->queue, (GFunc) gst_mini_object_unref, NULL);
+  g_queue_clear (&stream->queue);
+  stream->last_flow = flushing ? GST_FLOW_FLUSHING : GST_FLOW_OK;
+  g_cond_broadcast (&stream->queue_cond);
+  g_mutex_unlock (&stream->queue_lock);
+}
+
+/* Wait until the pad task pushed everything that was queued */
+static void
+gst_ts_demux_stream_drain (TSDemuxStream * stream)
+{
+  g_mutex_lock (&stream->queue_lock);
+  while ((!g_queue_is_empty (&stream->queue) || stream->queue_busy) &&
+      !stream->flushing)
+    g_cond_wait (&stream->queue_cond, &stream->queue_lock);
+  g_mutex_unlock (&stream->queue_lock);
+}
+
+static gboolean
+gst_ts_demux_srcpad_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  TSDemuxStream *stream = gst_pad_get_element_private (pad);
+
+  if (!active && stream && stream->threaded) {
+    gst_ts_demux_stream_set_flushing (stream, TRUE);
+    return gst_pad_stop_task (pad);
+  }
+
+  return TRUE;
+}
+
+static void
+gst_ts_demux_stream_start_task (TSDemuxStream * stream)
+{
+  GST_DEBUG_OBJECT (stream->pad, "starting streaming thread");
+
+  g_mutex_init (&stream->queue_lock);
+  g_cond_init (&stream->queue_cond);
+  g_queue_init (&stream->queue);
+  stream->queue_busy = FALSE;
+  stream->flushing = FALSE;
+  stream->last_flow = GST_FLOW_OK;
+  stream->threaded = TRUE;
+
+  gst_pad_set_element_private (stream->pad, stream);
+  gst_pad_set_activatemode_function (stream->pad,
+      gst_ts_demux_srcpad_activate_mode);
+  gst_pad_start_task (stream->pad, (GstTaskFunction) gst_ts_demux_stream_loop,
+      stream, NULL);
+}
+
+static void
+gst_ts_demux_stream_stop_task (TSDemuxStream * stream)
+{
+  if (!stream->threaded)
+    return;
+
+  GST_DEBUG_OBJECT (stream->pad, "stopping streaming thread");
+
+  gst_ts_demux_stream_set_flushing (stream, TRUE);
+  gst_pad_stop_task (stream->pad);
+  gst_pad_set_element_private (stream->pad, NULL);
+
+  g_mutex_clear (&stream->queue_lock);
+  g_cond_clear (&stream->queue_cond);
+  stream->threaded = FALSE;
+}
+
+static GstFlowReturn
+gst_ts_demux_stream_push_buffer (TSDemuxStream * stream, GstBuffer * buffer)
+{
+  if (stream->threaded)
+    return gst_ts_demux_stream_queue_item (stream,
+        GST_MINI_OBJECT_CAST (buffer));
+
+  return gst_pad_push (stream->pad, buffer);
+}
+
+static GstFlowReturn
+gst_ts_demux_stream_push_list (TSDemuxStream * stream, GstBufferList * list)
+{
+  if (stream->threaded)
+    return gst_ts_demux_stream_queue_item (stream,
+        GST_MINI_OBJECT_CAST (list));
+
+  return gst_pad_push_list (stream->pad, list);
+}
+
+static gboolean
+gst_ts_demux_stream_push_event (TSDemuxStream * stream, GstEvent * event)
+{
+  gboolean res;
+
+  if (!stream->threaded)
+    return gst_pad_push_event (stream->pad, event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      /* Unblock the task, it pauses itself */
+      gst_ts_demux_stream_set_flushing (stream, TRUE);
+      return gst_pad_push_event (stream->pad, event);
+    case GST_EVENT_FLUSH_STOP:
+      /* Make sure the task is paused before restarting it, it could
+       * otherwise pause itself after seeing the flushing flag */
+      gst_pad_pause_task (stream->pad);
+      gst_ts_demux_stream_set_flushing (stream, FALSE);
+      res = gst_pad_push_event (stream->pad, event);
+      gst_pad_start_task (stream->pad,
+          (GstTaskFunction) gst_ts_demux_stream_loop, stream, NULL);
+      return res;
+    default:
+      break;
+  }
+
+  if (!GST_EVENT_IS_SERIALIZED (event))
+    return gst_pad_push_event (stream->pad, event);
+
+  return gst_ts_demux_stream_queue_item (stream,
+      GST_MINI_OBJECT_CAST (event)) != GST_FLOW_FLUSHING;
+}
+
 static void
 clean_global_taglist (GstTagList * taglist)
 {
@@ -979,7 +1455,7 @@ push_event (MpegTSBase * base, GstEvent * event)
         gst_ts_demux_push_pending_data (demux, stream, NULL);
 
       gst_event_ref (event);
-      gst_pad_push_event (stream->pad, event);
+      gst_ts_demux_stream_push_event (stream, event);
     }
   }
 
@@ -1719,9 +2195,12 @@ gst_ts_demux_stream_removed (MpegTSBase * base, MpegTSBaseStream * bstream)
         gst_ts_demux_push_pending_data ((GstTSDemux *) base, stream, NULL);
 
         GST_DEBUG_OBJECT (stream->pad, "Pushing out EOS");
-        gst_pad_push_event (stream->pad, gst_event_new_eos ());
+        gst_ts_demux_stream_push_event (stream, gst_event_new_eos ());
+        if (stream->threaded)
+          gst_ts_demux_stream_drain (stream);
         gst_pad_set_active (stream->pad, FALSE);
       }
+      gst_ts_demux_stream_stop_task (stream);
 
       GST_DEBUG_OBJECT (stream->pad, "Removing pad");
       gst_element_remove_pad (GST_ELEMENT_CAST (base), stream->pad);
@@ -1745,12 +2224,20 @@ gst_ts_demux_stream_removed (MpegTSBase * base, MpegTSBaseStream * bstream)
 static void
 activate_pad_for_stream (GstTSDemux * tsdemux, TSDemuxStream * stream)
 {
+  gboolean threaded;
+
   if (stream->pad) {
     GST_DEBUG_OBJECT (tsdemux, "Activating pad %s:%s for stream %p",
         GST_DEBUG_PAD_NAME (stream->pad), stream);
     gst_element_add_pad ((GstElement *) tsdemux, stream->pad);
     stream->active = TRUE;
     GST_DEBUG_OBJECT (stream->pad, "done adding pad");
+
+    GST_OBJECT_LOCK (tsdemux);
+    threaded = tsdemux->parallel_streams;
+    GST_OBJECT_UNLOCK (tsdemux);
+    if (threaded && !stream->threaded)
+      gst_ts_demux_stream_start_task (stream);
   } else if (((MpegTSBaseStream *) stream)->stream_type != 0xff) {
     GST_DEBUG_OBJECT (tsdemux,
         "stream %p (pid 0x%04x, type:0x%02x) has no pad", stream,
@@ -1852,7 +2339,7 @@ gst_ts_demux_update_program (MpegTSBase * base, MpegTSBaseProgram * program)
          * or serialized event (which means very late in case of subtitle streams),
          * and playsink waits for stream-start or another serialized event */
         GST_DEBUG_OBJECT (stream->pad, "sparse stream, pushing GAP event");
-        gst_pad_push_event (stream->pad, gst_event_new_gap (0, 0));
+        gst_ts_demux_stream_push_event (stream, gst_event_new_gap (0, 0));
       }
     }
   }
@@ -1940,7 +2427,7 @@ gst_ts_demux_program_started (MpegTSBase * base, MpegTSBaseProgram * program)
          * or serialized event (which means very late in case of subtitle streams),
          * and playsink waits for stream-start or another serialized event */
         GST_DEBUG_OBJECT (stream->pad, "sparse stream, pushing GAP event");
-        gst_pad_push_event (stream->pad, gst_event_new_gap (0, 0));
+        gst_ts_demux_stream_push_event (stream, gst_event_new_gap (0, 0));
       }
     }
 
@@ -2278,6 +2765,9 @@ gst_ts_demux_queue_data (GstTSDemux * demux, TSDemuxStream * stream,
 
       /* parse the header */
       gst_ts_demux_parse_pes_header (demux, stream, data, size, packet->offset);
+      if (stream->state == PENDING_PACKET_BUFFER &&
+          (packet->afc_flags & MPEGTS_AFC_RANDOM_ACCES_FLAGS))
+        gst_ts_demux_record_keyframe (demux, stream, packet->offset);
       break;
     }
     case PENDING_PACKET_BUFFER:
@@ -2387,11 +2877,11 @@ push_new_segment:
     if (demux->segment_event) {
       GST_DEBUG_OBJECT (stream->pad, "Pushing newsegment event");
       gst_event_ref (demux->segment_event);
-      gst_pad_push_event (stream->pad, demux->segment_event);
+      gst_ts_demux_stream_push_event (stream, demux->segment_event);
     }
 
     if (demux->global_tags) {
-      gst_pad_push_event (stream->pad,
+      gst_ts_demux_stream_push_event (stream,
           gst_event_new_tag (gst_tag_list_ref (demux->global_tags)));
     }
 
@@ -2399,7 +2889,8 @@ push_new_segment:
     if (stream->taglist) {
       GST_DEBUG_OBJECT (stream->pad, "Sending tags %" GST_PTR_FORMAT,
           stream->taglist);
-      gst_pad_push_event (stream->pad, gst_event_new_tag (stream->taglist));
+      gst_ts_demux_stream_push_event (stream,
+          gst_event_new_tag (stream->taglist));
       stream->taglist = NULL;
     }
 
@@ -2457,7 +2948,7 @@ gst_ts_demux_check_and_sync_streams (GstTSDemux * demux, GstClockTime time)
         calculate_and_push_newsegment (demux, ps, NULL);
 
       /* Now send gap event */
-      gst_pad_push_event (ps->pad, gst_event_new_gap (time, 0));
+      gst_ts_demux_stream_push_event (ps, gst_event_new_gap (time, 0));
     }
 
     /* Update GAP tracking vars so we don't re-check this stream for a while */
@@ -2701,7 +3192,7 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream,
         GST_BUFFER_FLAG_SET (pend->buffer, GST_BUFFER_FLAG_DISCONT);
       stream->discont = FALSE;
 
-      res = gst_pad_push (stream->pad, pend->buffer);
+      res = gst_ts_demux_stream_push_buffer (stream, pend->buffer);
       stream->nb_out_buffers += 1;
       g_slice_free (PendingBuffer, pend);
     }
@@ -2756,12 +3247,12 @@ gst_ts_demux_push_pending_data (GstTSDemux * demux, TSDemuxStream * stream,
     demux->segment.position = stream->pts;
 
   if (buffer) {
-    res = gst_pad_push (stream->pad, buffer);
+    res = gst_ts_demux_stream_push_buffer (stream, buffer);
     /* Record that a buffer was pushed */
     stream->nb_out_buffers += 1;
   } else {
     guint n = gst_buffer_list_length (buffer_list);
-    res = gst_pad_push_list (stream->pad, buffer_list);
+    res = gst_ts_demux_stream_push_list (stream, buffer_list);
     /* Record that a buffer was pushed */
     stream->nb_out_buffers += n;
   }
@@ -62,6 +62,7 @@ struct _GstTSDemux
   gint requested_program_number; /* Required program number (ignore:-1) */
   guint program_number;
   gboolean emit_statistics;
+  gboolean parallel_streams;
 
   /*< private >*/
   gint program_generation; /* Incremented each time we switch program 0..15 */
@@ -87,6 +88,12 @@ struct _GstTSDemux
 
   /* Used when seeking for a keyframe to go backward in the stream */
   guint64 last_seek_offset;
+
+  /* Keyframe index (TSDemuxSeekEntry) of the first video stream, sorted
+   * by offset. Protected by the OBJECT_LOCK as it can be queried and
+   * restored by the application */
+  GArray *seek_table;
+  gint index_pid;
 };
 
 struct _GstTSDemuxClass
@@ -113,6 +113,21 @@
  * so we have some slack to go backwards */
 #define CLOCK_BASE (TSMUX_CLOCK_FREQ * 10 * 360)
 
+/* PCR interval in CBR mode, in 27MHz clock ticks */
+#define TSMUX_CBR_PCR_INTERVAL (TSMUX_SYS_CLOCK_FREQ / TSMUX_DEFAULT_PCR_FREQ)
+
+/* Largest timestamp gap that is filled with null packets in CBR mode, in
+ * 27MHz clock ticks. Bigger gaps are discontinuities and restart the byte
+ * clock instead */
+#define TSMUX_CBR_MAX_GAP \
+    (4 * TSMUX_PCR_OFFSET * (TSMUX_SYS_CLOCK_FREQ / TSMUX_CLOCK_FREQ))
+
+/* The PCR refers to the byte that carries the last bit of
+ * program_clock_reference_base, this is its offset in the packet */
+#define TSMUX_PCR_BYTE_OFFSET 10
+
+#define TSMUX_NULL_PACKET_PID 0x1FFF
+
 static gboolean tsmux_write_pat (TsMux * mux);
 static gboolean tsmux_write_pmt (TsMux * mux, TsMuxProgram * program);
 static void
@@ -150,6 +165,8 @@ tsmux_new (void)
   mux->last_si_ts = G_MININT64;
   mux->si_interval = TSMUX_DEFAULT_SI_INTERVAL;
 
+  mux->pcr_base = -1;
+
   mux->si_sections = g_hash_table_new_full (g_direct_hash, g_direct_equal,
       NULL, (GDestroyNotify) tsmux_section_free);
 
@@ -260,6 +277,54 @@ tsmux_get_si_interval (TsMux * mux)
   return mux->si_interval;
 }
 
+static gint64
+tsmux_get_cbr_pcr (TsMux * mux)
+{
+  return mux->pcr_base +
+      gst_util_uint64_scale (mux->n_bytes + TSMUX_PCR_BYTE_OFFSET,
+      8 * TSMUX_SYS_CLOCK_FREQ, mux->bitrate);
+}
+
+/**
+ * tsmux_set_bitrate:
+ * @mux: a #TsMux
+ * @bitrate: the output bitrate in bits per second
+ *
+ * Set a constant output bitrate. In CBR mode the output is stuffed with null
+ * packets so that every PES leaves the muxer when the byte clock reaches its
+ * DTS (minus the PCR offset), and the PCR of each program is computed from
+ * the byte position and refreshed every 40ms even when its PCR stream is
+ * idle. A @bitrate of 0 selects variable bitrate output.
+ */
+void
+tsmux_set_bitrate (TsMux * mux, guint64 bitrate)
+{
+  g_return_if_fail (mux != NULL);
+
+  /* restart the byte clock where the old rate left it */
+  if (mux->bitrate && mux->pcr_base != -1) {
+    mux->pcr_base = bitrate ? tsmux_get_cbr_pcr (mux) : -1;
+    mux->n_bytes = 0;
+  }
+  mux->bitrate = bitrate;
+}
+
+/**
+ * tsmux_get_bitrate:
+ * @mux: a #TsMux
+ *
+ * Get the configured output bitrate. See also tsmux_set_bitrate().
+ *
+ * Returns: the configured bitrate in bits per second, 0 for VBR
+ */
+guint64
+tsmux_get_bitrate (TsMux * mux)
+{
+  g_return_val_if_fail (mux != NULL, 0);
+
+  return mux->bitrate;
+}
+
 /**
  * tsmux_add_mpegts_si_section:
  * @mux: a #TsMux
@@ -585,6 +650,9 @@ tsmux_get_buffer (TsMux * mux, GstBuffer ** buf)
 static gboolean
 tsmux_packet_out (TsMux * mux, GstBuffer * buf, gint64 pcr)
 {
+  if (buf)
+    mux->n_bytes += TSMUX_PACKET_LENGTH;
+
   if (G_UNLIKELY (mux->write_func == NULL)) {
     if (buf)
       gst_buffer_unref (buf);
@@ -976,6 +1044,144 @@ tsmux_write_si (TsMux * mux)
 
 }
 
+static gboolean
+tsmux_write_null_packet (TsMux * mux)
+{
+  GstBuffer *buf = NULL;
+  GstMapInfo map;
+
+  if (!tsmux_get_buffer (mux, &buf))
+    return FALSE;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  map.data[0] = TSMUX_SYNC_BYTE;
+  GST_WRITE_UINT16_BE (map.data + 1, TSMUX_NULL_PACKET_PID);
+  /* payload only, continuity counter undefined */
+  map.data[3] = 0x10;
+  memset (map.data + TSMUX_HEADER_LENGTH, 0xff, TSMUX_PAYLOAD_LENGTH);
+  gst_buffer_unmap (buf, &map);
+
+  return tsmux_packet_out (mux, buf, -1);
+}
+
+/* Adaptation field only packet carrying the current PCR on the PID
+ * of @stream */
+static gboolean
+tsmux_write_pcr_packet (TsMux * mux, TsMuxStream * stream)
+{
+  TsMuxPacketInfo pi = { 0, };
+  guint payload_len, payload_offs;
+  GstBuffer *buf = NULL;
+  GstMapInfo map;
+  gint64 pcr;
+
+  if (!tsmux_get_buffer (mux, &buf))
+    return FALSE;
+
+  pcr = tsmux_get_cbr_pcr (mux);
+
+  pi.pid = stream->pi.pid;
+  /* no payload, so repeat the counter of the last packet */
+  pi.packet_count = stream->pi.packet_count - 1;
+  pi.flags = TSMUX_PACKET_FLAG_ADAPTATION | TSMUX_PACKET_FLAG_WRITE_PCR;
+  pi.pcr = pcr;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  if (!tsmux_write_ts_header (map.data, &pi, &payload_len, &payload_offs)) {
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+    return FALSE;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  TS_DEBUG ("PCR only packet on PID 0x%04x, PCR %" G_GINT64_FORMAT,
+      pi.pid, pcr);
+  stream->last_pcr = pcr;
+
+  return tsmux_packet_out (mux, buf, pcr);
+}
+
+/* CBR mode: refresh the PCR of every program that is due. @stream is about
+ * to write a packet and takes care of its own PCR */
+static gboolean
+tsmux_write_pcr_packets (TsMux * mux, TsMuxStream * stream)
+{
+  gint64 cur_pcr = tsmux_get_cbr_pcr (mux);
+  gint64 next_pcr = G_MAXINT64;
+  GList *cur;
+
+  if (cur_pcr < mux->next_pcr)
+    return TRUE;
+
+  for (cur = mux->programs; cur; cur = cur->next) {
+    TsMuxProgram *program = (TsMuxProgram *) cur->data;
+    TsMuxStream *pcr_stream = program->pcr_stream;
+    gint64 due;
+
+    if (pcr_stream == NULL)
+      continue;
+
+    if (pcr_stream->last_pcr == -1)
+      due = cur_pcr;
+    else
+      due = pcr_stream->last_pcr + TSMUX_CBR_PCR_INTERVAL;
+
+    if (cur_pcr >= due && pcr_stream != stream) {
+      if (!tsmux_write_pcr_packet (mux, pcr_stream))
+        return FALSE;
+      cur_pcr = tsmux_get_cbr_pcr (mux);
+      due = pcr_stream->last_pcr + TSMUX_CBR_PCR_INTERVAL;
+    }
+    next_pcr = MIN (next_pcr, due);
+  }
+  mux->next_pcr = next_pcr;
+
+  return TRUE;
+}
+
+/* CBR mode: stuff the output with null packets until the byte clock reaches
+ * the time at which the PES with timestamp @ts has to be sent */
+static gboolean
+tsmux_pad_stream (TsMux * mux, TsMuxStream * stream, gint64 ts)
+{
+  gint64 target = (ts - TSMUX_PCR_OFFSET) *
+      (TSMUX_SYS_CLOCK_FREQ / TSMUX_CLOCK_FREQ);
+  gint64 cur_pcr;
+
+  if (mux->pcr_base == -1) {
+    TS_DEBUG ("Starting CBR byte clock at PCR %" G_GINT64_FORMAT, target);
+    mux->pcr_base = target;
+    mux->n_bytes = 0;
+    mux->next_pcr = 0;
+  } else if (target - tsmux_get_cbr_pcr (mux) > TSMUX_CBR_MAX_GAP) {
+    /* don't write seconds or hours worth of null packets for a timestamp
+     * jump, the PCR is sent right away and tells the decoder */
+    GST_WARNING ("PES on PID 0x%04x is %" G_GINT64_FORMAT " ticks ahead, "
+        "restarting the CBR byte clock", stream->pi.pid,
+        target - tsmux_get_cbr_pcr (mux));
+    mux->pcr_base = target;
+    mux->n_bytes = 0;
+    mux->next_pcr = 0;
+  }
+
+  while ((cur_pcr = tsmux_get_cbr_pcr (mux)) < target) {
+    if (!tsmux_write_pcr_packets (mux, NULL))
+      return FALSE;
+    if (!tsmux_write_null_packet (mux))
+      return FALSE;
+  }
+
+  /* the decoder has run out of data if we're later than the PCR offset */
+  if (cur_pcr - target > TSMUX_PCR_OFFSET *
+      (TSMUX_SYS_CLOCK_FREQ / TSMUX_CLOCK_FREQ)) {
+    GST_WARNING ("PES on PID 0x%04x is %" G_GINT64_FORMAT " ticks late, "
+        "bitrate %" G_GUINT64_FORMAT " too low", stream->pi.pid,
+        cur_pcr - target, mux->bitrate);
+  }
+
+  return TRUE;
+}
+
 /**
  * tsmux_write_stream_packet:
  * @mux: a #TsMux
@@ -998,6 +1204,26 @@ tsmux_write_stream_packet (TsMux * mux, TsMuxStream * stream)
   g_return_val_if_fail (mux != NULL, FALSE);
   g_return_val_if_fail (stream != NULL, FALSE);
 
+  pi->packet_start_unit_indicator = tsmux_stream_at_pes_start (stream);
+  if (pi->packet_start_unit_indicator) {
+    tsmux_stream_initialize_pes_packet (stream);
+    if (stream->dts != G_MININT64)
+      stream->dts += CLOCK_BASE;
+    if (stream->pts != G_MININT64)
+      stream->pts += CLOCK_BASE;
+  }
+
+  if (mux->bitrate) {
+    if (pi->packet_start_unit_indicator) {
+      gint64 ts = stream->dts != G_MININT64 ? stream->dts : stream->pts;
+
+      if (ts != G_MININT64 && !tsmux_pad_stream (mux, stream, ts))
+        return FALSE;
+    }
+    if (mux->pcr_base != -1 && !tsmux_write_pcr_packets (mux, stream))
+      return FALSE;
+  }
+
   if (tsmux_stream_is_pcr (stream)) {
     gint64 cur_pts = tsmux_stream_get_pts (stream);
     gboolean write_pat;
@@ -1017,6 +1243,8 @@ tsmux_write_stream_packet (TsMux * mux, TsMuxStream * stream)
       cur_pcr = (cur_pts - TSMUX_PCR_OFFSET) *
           (TSMUX_SYS_CLOCK_FREQ / TSMUX_CLOCK_FREQ);
     }
+    if (mux->bitrate && mux->pcr_base != -1)
+      cur_pcr = tsmux_get_cbr_pcr (mux);
 
     /* Need to decide whether to write a new PCR in this packet */
     if (stream->last_pcr == -1 ||
@@ -1079,14 +1307,12 @@ tsmux_write_stream_packet (TsMux * mux, TsMuxStream * stream)
     }
   }
 
-  pi->packet_start_unit_indicator = tsmux_stream_at_pes_start (stream);
-  if (pi->packet_start_unit_indicator) {
-    tsmux_stream_initialize_pes_packet (stream);
-    if (stream->dts != G_MININT64)
-      stream->dts += CLOCK_BASE;
-    if (stream->pts != G_MININT64)
-      stream->pts += CLOCK_BASE;
+  if (cur_pcr != -1 && mux->bitrate && mux->pcr_base != -1) {
+    /* the tables written above moved the byte clock */
+    cur_pcr = tsmux_get_cbr_pcr (mux);
+    pi->pcr = stream->last_pcr = cur_pcr;
   }
+
   pi->stream_avail = tsmux_stream_bytes_avail (stream);
 
   /* obtain buffer */
@@ -169,6 +169,15 @@ struct TsMux {
   /* last time SIT written in MPEG PTS clock time */
   gint64   last_si_ts;
 
+  /* constant output bitrate in bits per second, 0 for VBR */
+  guint64  bitrate;
+  /* bytes written since pcr_base, drives the PCR in CBR mode */
+  guint64  n_bytes;
+  /* PCR at the start of the CBR byte clock, -1 until the first PES */
+  gint64   pcr_base;
+  /* earliest PCR value at which a program needs a new PCR in CBR mode */
+  gint64   next_pcr;
+
   /* callback to write finished packet */
   TsMuxWriteFunc write_func;
   void *write_func_data;
@@ -190,6 +199,8 @@ void 		tsmux_set_alloc_func 		(TsMux *mux, TsMuxAllocFunc func, void *user_data)
 void 		tsmux_set_pat_interval          (TsMux *mux, guint interval);
 guint 		tsmux_get_pat_interval          (TsMux *mux);
 guint16		tsmux_get_new_pid 		(TsMux *mux);
+void 		tsmux_set_bitrate 		(TsMux *mux, guint64 bitrate);
+guint64 	tsmux_get_bitrate 		(TsMux *mux);
 
 /* pid/program management */
 TsMuxProgram *	tsmux_program_new 		(TsMux *mux, gint prog_id);
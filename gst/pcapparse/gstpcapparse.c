@@ -25,6 +25,12 @@
  * #GstPcapParse:src-port and #GstPcapParse:dst-port to restrict which packets
  * should be included.
  *
+ * Both classic libpcap and pcapng files are understood. When upstream
+ * supports random access, the element operates in pull mode and reads the
+ * file in large chunks; payloads are then pushed as sub-buffers of these
+ * chunks without copying. Set #GstPcapParse:realtime to push the packets at
+ * the pace at which they were captured.
+ *
  * <refsect2>
  * <title>Example pipelines</title>
  * |[
@@ -32,6 +38,11 @@
  * ! ffdec_h264 ! fakesink
  * ]| Read from a pcap dump file using filesrc, extract the raw UDP packets,
  * depayload and decode them.
+ * |[
+ * gst-launch-1.0 filesrc location=capture.pcapng ! pcapparse realtime=true
+ * dst-port=5004 ! udpsink port=5004
+ * ]| Replay the packets sent to port 5004 in a pcapng capture with their
+ * original timing.
  * </refsect2>
  */
 
@@ -50,7 +61,6 @@
 #ifndef G_OS_WIN32
 #include <arpa/inet.h>
 #include <netinet/in.h>
-#include <string.h>
 #else
 #include <winsock2.h>
 #endif
@@ -63,9 +73,12 @@ enum
   PROP_SRC_PORT,
   PROP_DST_PORT,
   PROP_CAPS,
-  PROP_TS_OFFSET
+  PROP_TS_OFFSET,
+  PROP_REALTIME
 };
 
+#define DEFAULT_REALTIME FALSE
+
 GST_DEBUG_CATEGORY_STATIC (gst_pcap_parse_debug);
 #define GST_CAT_DEFAULT gst_pcap_parse_debug
 
@@ -93,6 +106,10 @@ static GstFlowReturn gst_pcap_parse_chain (GstPad * pad,
     GstObject * parent, GstBuffer * buffer);
 static gboolean gst_pcap_sink_event (GstPad * pad,
     GstObject * parent, GstEvent * event);
+static gboolean gst_pcap_parse_sink_activate (GstPad * pad,
+    GstObject * parent);
+static gboolean gst_pcap_parse_sink_activate_mode (GstPad * pad,
+    GstObject * parent, GstPadMode mode, gboolean active);
 
 
 #define parent_class gst_pcap_parse_parent_class
@@ -138,6 +155,17 @@ gst_pcap_parse_class_init (GstPcapParseClass * klass)
           "Relative timestamp offset (ns) to apply (-1 = use absolute packet time)",
           -1, G_MAXINT64, -1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstPcapParse:realtime:
+   *
+   * Push the packets at the running time given by their capture timestamps
+   * instead of as fast as possible.
+   */
+  g_object_class_install_property (gobject_class, PROP_REALTIME,
+      g_param_spec_boolean ("realtime", "Realtime",
+          "Pace the output according to the capture timestamps",
+          DEFAULT_REALTIME, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (element_class, &sink_template);
   gst_element_class_add_static_pad_template (element_class, &src_template);
 
@@ -160,6 +188,10 @@ gst_pcap_parse_init (GstPcapParse * self)
   gst_pad_use_fixed_caps (self->sink_pad);
   gst_pad_set_event_function (self->sink_pad,
       GST_DEBUG_FUNCPTR (gst_pcap_sink_event));
+  gst_pad_set_activate_function (self->sink_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_sink_activate));
+  gst_pad_set_activatemode_function (self->sink_pad,
+      GST_DEBUG_FUNCPTR (gst_pcap_parse_sink_activate_mode));
   gst_element_add_pad (GST_ELEMENT (self), self->sink_pad);
 
   self->src_pad = gst_pad_new_from_static_template (&src_template, "src");
@@ -171,8 +203,11 @@ gst_pcap_parse_init (GstPcapParse * self)
   self->src_port = -1;
   self->dst_port = -1;
   self->offset = -1;
+  self->realtime = DEFAULT_REALTIME;
 
   self->adapter = gst_adapter_new ();
+  self->interfaces = g_array_new (FALSE, FALSE, sizeof (GstPcapParseInterface));
+  g_cond_init (&self->paused_cond);
 
   gst_pcap_parse_reset (self);
 }
@@ -183,6 +218,8 @@ gst_pcap_parse_finalize (GObject * object)
   GstPcapParse *self = GST_PCAP_PARSE (object);
 
   g_object_unref (self->adapter);
+  g_array_free (self->interfaces, TRUE);
+  g_cond_clear (&self->paused_cond);
   if (self->caps)
     gst_caps_unref (self->caps);
 
@@ -244,6 +281,10 @@ gst_pcap_parse_get_property (GObject * object, guint prop_id,
       g_value_set_int64 (value, self->offset);
       break;
 
+    case PROP_REALTIME:
+      g_value_set_boolean (value, self->realtime);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -298,6 +339,10 @@ gst_pcap_parse_set_property (GObject * object, guint prop_id,
       self->offset = g_value_get_int64 (value);
       break;
 
+    case PROP_REALTIME:
+      self->realtime = g_value_get_boolean (value);
+      break;
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -308,12 +353,17 @@ static void
 gst_pcap_parse_reset (GstPcapParse * self)
 {
   self->initialized = FALSE;
+  self->pcapng = FALSE;
   self->swap_endian = FALSE;
-  self->cur_packet_size = -1;
   self->cur_ts = GST_CLOCK_TIME_NONE;
   self->base_ts = GST_CLOCK_TIME_NONE;
+  self->needed = 0;
+  self->pull_offset = 0;
+  self->stream_start_sent = FALSE;
   self->newsegment_sent = FALSE;
 
+  g_array_set_size (self->interfaces, 0);
+  gst_segment_init (&self->segment, GST_FORMAT_TIME);
   gst_adapter_clear (self->adapter);
 }
 
@@ -333,6 +383,22 @@ gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
   }
 }
 
+static guint16
+gst_pcap_parse_read_uint16 (GstPcapParse * self, const guint8 * p)
+{
+  guint16 val = *((guint16 *) p);
+
+  if (self->swap_endian) {
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+    return GUINT16_FROM_BE (val);
+#else
+    return GUINT16_FROM_LE (val);
+#endif
+  } else {
+    return val;
+  }
+}
+
 #define ETH_HEADER_LEN    14
 #define SLL_HEADER_LEN    16
 #define IP_HEADER_MIN_LEN 20
@@ -341,10 +407,38 @@ gst_pcap_parse_read_uint32 (GstPcapParse * self, const guint8 * p)
 #define IP_PROTO_UDP      17
 #define IP_PROTO_TCP      6
 
+#define PCAP_FILE_HEADER_LEN   24
+#define PCAP_RECORD_HEADER_LEN 16
+
+#define PCAPNG_BLOCK_SHB  0x0A0D0D0A
+#define PCAPNG_BLOCK_IDB  0x00000001
+#define PCAPNG_BLOCK_SPB  0x00000003
+#define PCAPNG_BLOCK_EPB  0x00000006
+#define PCAPNG_BYTE_ORDER_MAGIC 0x1A2B3C4D
+#define PCAPNG_OPT_ENDOFOPT     0
+#define PCAPNG_OPT_IF_TSRESOL   9
+
+/* amount of data pulled from upstream at once in pull mode */
+#define PULL_CHUNK_SIZE (1024 * 1024)
+
+/* packets that are closer together than this are pushed in a single
+ * buffer list when pacing in realtime */
+#define REALTIME_GRANULARITY GST_MSECOND
+
+typedef struct
+{
+  /* bytes taken by the record, 0 if it is not complete yet */
+  gsize size;
+  /* the captured packet, NULL for records that carry no packet */
+  const guint8 *packet;
+  gsize packet_size;
+  GstClockTime ts;
+  GstPcapParseLinktype linktype;
+} GstPcapParseRecord;
 
 static gboolean
 gst_pcap_parse_scan_frame (GstPcapParse * self,
-    const guint8 * buf,
+    GstPcapParseLinktype linktype, const guint8 * buf,
     gint buf_size, const guint8 ** payload, gint * payload_size)
 {
   const guint8 *buf_ip = 0;
@@ -359,7 +453,7 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
   guint16 dst_port;
   guint16 len;
 
-  switch (self->linktype) {
+  switch (linktype) {
     case LINKTYPE_ETHER:
       if (buf_size < ETH_HEADER_LEN + IP_HEADER_MIN_LEN + UDP_HEADER_LEN)
         return FALSE;
@@ -429,7 +523,7 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
 
     /* all remaining data following tcp header is payload */
     *payload = buf_proto + len;
-    *payload_size = self->cur_packet_size - (buf_proto - buf) - len;
+    *payload_size = buf_size - (buf_proto - buf) - len;
   }
 
   /* but still filter as configured */
@@ -448,169 +542,706 @@ gst_pcap_parse_scan_frame (GstPcapParse * self,
   return TRUE;
 }
 
+static void
+gst_pcap_parse_add_interface (GstPcapParse * self, guint32 linktype,
+    guint64 ts_resolution)
+{
+  GstPcapParseInterface iface;
+
+  GST_DEBUG_OBJECT (self, "interface %u: linktype %u, %" G_GUINT64_FORMAT
+      " timestamp units per second", self->interfaces->len, linktype,
+      ts_resolution);
+
+  if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
+      linktype != LINKTYPE_RAW)
+    GST_WARNING_OBJECT (self, "packets of linktype %u will be skipped",
+        linktype);
+
+  iface.linktype = linktype;
+  iface.ts_resolution = ts_resolution;
+  g_array_append_val (self->interfaces, iface);
+}
+
 static GstFlowReturn
-gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+gst_pcap_parse_read_file_header (GstPcapParse * self, const guint8 * data,
+    gsize size, GstPcapParseRecord * record, gsize * needed)
 {
-  GstPcapParse *self = GST_PCAP_PARSE (parent);
-  GstFlowReturn ret = GST_FLOW_OK;
-  GstBufferList *list = NULL;
+  guint32 magic;
+  guint32 linktype;
+  guint16 major_version;
+  guint64 ts_resolution = G_GUINT64_CONSTANT (1000000);
+
+  if (size < PCAP_FILE_HEADER_LEN) {
+    *needed = PCAP_FILE_HEADER_LEN;
+    return GST_FLOW_OK;
+  }
 
-  gst_adapter_push (self->adapter, buffer);
+  magic = *((guint32 *) data);
+  major_version = *((guint16 *) (data + 4));
+
+  if (magic == 0xa1b2c3d4) {
+    self->swap_endian = FALSE;
+  } else if (magic == 0xd4c3b2a1) {
+    self->swap_endian = TRUE;
+  } else if (magic == 0xa1b23c4d) {
+    self->swap_endian = FALSE;
+    ts_resolution = GST_SECOND;
+  } else if (magic == 0x4d3cb2a1) {
+    self->swap_endian = TRUE;
+    ts_resolution = GST_SECOND;
+  } else {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("File is not a libpcap file, magic is %X", magic));
+    return GST_FLOW_ERROR;
+  }
 
-  while (ret == GST_FLOW_OK) {
-    gint avail;
-    const guint8 *data;
+  if (self->swap_endian)
+    major_version = major_version << 8 | major_version >> 8;
+  linktype = gst_pcap_parse_read_uint32 (self, data + 20);
 
-    avail = gst_adapter_available (self->adapter);
+  if (major_version != 2) {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("File is not a libpcap major version 2, but %u", major_version));
+    return GST_FLOW_ERROR;
+  }
+
+  if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
+      linktype != LINKTYPE_RAW) {
+    GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+        ("Only dumps of type Ethernet, raw IP or Linux Cooked (SLL) "
+            "understood; type %d unknown", linktype));
+    return GST_FLOW_ERROR;
+  }
+
+  gst_pcap_parse_add_interface (self, linktype, ts_resolution);
+  self->initialized = TRUE;
+  record->size = PCAP_FILE_HEADER_LEN;
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_pcap_parse_read_record (GstPcapParse * self, const guint8 * data,
+    gsize size, GstPcapParseRecord * record, gsize * needed)
+{
+  GstPcapParseInterface *iface;
+  guint32 ts_sec;
+  guint32 ts_frac;
+  guint32 incl_len;
+
+  if (size < PCAP_RECORD_HEADER_LEN) {
+    *needed = PCAP_RECORD_HEADER_LEN;
+    return GST_FLOW_OK;
+  }
+
+  ts_sec = gst_pcap_parse_read_uint32 (self, data + 0);
+  ts_frac = gst_pcap_parse_read_uint32 (self, data + 4);
+  incl_len = gst_pcap_parse_read_uint32 (self, data + 8);
+  /* orig_len = gst_pcap_parse_read_uint32 (self, data + 12); */
+
+  if (size - PCAP_RECORD_HEADER_LEN < incl_len) {
+    *needed = PCAP_RECORD_HEADER_LEN + (gsize) incl_len;
+    return GST_FLOW_OK;
+  }
+
+  iface = &g_array_index (self->interfaces, GstPcapParseInterface, 0);
+
+  record->size = PCAP_RECORD_HEADER_LEN + incl_len;
+  record->packet = data + PCAP_RECORD_HEADER_LEN;
+  record->packet_size = incl_len;
+  record->linktype = iface->linktype;
+  if (iface->ts_resolution == GST_SECOND)
+    record->ts = ts_sec * GST_SECOND + ts_frac;
+  else
+    record->ts = ts_sec * GST_SECOND + ts_frac * GST_USECOND;
+
+  return GST_FLOW_OK;
+}
+
+static guint64
+gst_pcap_parse_read_tsresol (guint8 tsresol)
+{
+  guint64 resolution = 1;
+  guint exp = tsresol & 0x7f;
+
+  /* the MSB selects between negative powers of 2 and 10 */
+  if (tsresol & 0x80)
+    return exp < 64 ? G_GUINT64_CONSTANT (1) << exp : 0;
+
+  if (exp > 19)
+    return 0;
+
+  while (exp--)
+    resolution *= 10;
 
-    if (self->initialized) {
-      if (self->cur_packet_size >= 0) {
-        if (avail < self->cur_packet_size)
+  return resolution;
+}
+
+static GstFlowReturn
+gst_pcap_parse_read_block (GstPcapParse * self, const guint8 * data,
+    gsize size, GstPcapParseRecord * record, gsize * needed)
+{
+  GstPcapParseInterface *iface;
+  guint32 block_type;
+  guint32 block_len;
+
+  if (size < 12) {
+    *needed = 12;
+    return GST_FLOW_OK;
+  }
+
+  /* the section header block type is the same in both byte orders */
+  block_type = *((guint32 *) data);
+  if (block_type == PCAPNG_BLOCK_SHB) {
+    guint32 magic = *((guint32 *) (data + 8));
+
+    if (magic == PCAPNG_BYTE_ORDER_MAGIC) {
+      self->swap_endian = FALSE;
+    } else if (magic == GUINT32_SWAP_LE_BE (PCAPNG_BYTE_ORDER_MAGIC)) {
+      self->swap_endian = TRUE;
+    } else {
+      GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
+          ("Invalid pcapng byte-order magic %X", magic));
+      return GST_FLOW_ERROR;
+    }
+
+    /* interfaces are numbered per section */
+    g_array_set_size (self->interfaces, 0);
+    self->pcapng = TRUE;
+    self->initialized = TRUE;
+  } else {
+    block_type = gst_pcap_parse_read_uint32 (self, data);
+  }
+
+  block_len = gst_pcap_parse_read_uint32 (self, data + 4);
+  if (block_len < 12 || block_len % 4 != 0) {
+    GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+        ("Invalid pcapng block length %u", block_len));
+    return GST_FLOW_ERROR;
+  }
+
+  if (size < block_len) {
+    *needed = block_len;
+    return GST_FLOW_OK;
+  }
+
+  record->size = block_len;
+
+  switch (block_type) {
+    case PCAPNG_BLOCK_IDB:{
+      const guint8 *opt, *end;
+      guint64 ts_resolution = G_GUINT64_CONSTANT (1000000);
+
+      if (block_len < 20)
+        goto invalid_block;
+
+      opt = data + 16;
+      end = data + block_len - 4;
+      while (opt + 4 <= end) {
+        guint16 code = gst_pcap_parse_read_uint16 (self, opt);
+        guint16 len = gst_pcap_parse_read_uint16 (self, opt + 2);
+
+        if (code == PCAPNG_OPT_ENDOFOPT || opt + 4 + len > end)
           break;
 
-        if (self->cur_packet_size > 0) {
-          const guint8 *payload_data;
-          gint payload_size;
-
-          data = gst_adapter_map (self->adapter, self->cur_packet_size);
-
-          GST_LOG_OBJECT (self, "examining packet size %" G_GINT64_FORMAT,
-              self->cur_packet_size);
-
-          if (gst_pcap_parse_scan_frame (self, data, self->cur_packet_size,
-                  &payload_data, &payload_size)) {
-            GstBuffer *out_buf;
-            guintptr offset = payload_data - data;
-
-            gst_adapter_unmap (self->adapter);
-            gst_adapter_flush (self->adapter, offset);
-            /* we don't use _take_buffer_fast() on purpose here, we need a
-             * buffer with a single memory, since the RTP depayloaders expect
-             * the complete RTP header to be in the first memory if there are
-             * multiple ones and we can't guarantee that with _fast() */
-            if (payload_size > 0) {
-              out_buf = gst_adapter_take_buffer (self->adapter, payload_size);
-            } else {
-              out_buf = gst_buffer_new ();
-            }
-            gst_adapter_flush (self->adapter,
-                self->cur_packet_size - offset - payload_size);
-
-            if (GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
-              if (!GST_CLOCK_TIME_IS_VALID (self->base_ts))
-                self->base_ts = self->cur_ts;
-              if (self->offset >= 0) {
-                self->cur_ts -= self->base_ts;
-                self->cur_ts += self->offset;
-              }
-            }
-            GST_BUFFER_TIMESTAMP (out_buf) = self->cur_ts;
-
-
-            if (list == NULL)
-              list = gst_buffer_list_new ();
-            gst_buffer_list_add (list, out_buf);
-          } else {
-            gst_adapter_unmap (self->adapter);
-            gst_adapter_flush (self->adapter, self->cur_packet_size);
+        if (code == PCAPNG_OPT_IF_TSRESOL && len >= 1) {
+          ts_resolution = gst_pcap_parse_read_tsresol (opt[4]);
+          if (ts_resolution == 0) {
+            GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+                ("Unsupported pcapng timestamp resolution %u", opt[4]));
+            return GST_FLOW_ERROR;
           }
         }
 
-        self->cur_packet_size = -1;
-      } else {
-        guint32 ts_sec;
-        guint32 ts_usec;
-        guint32 incl_len;
+        opt += 4 + GST_ROUND_UP_4 (len);
+      }
 
-        if (avail < 16)
-          break;
+      gst_pcap_parse_add_interface (self,
+          gst_pcap_parse_read_uint16 (self, data + 8), ts_resolution);
+      break;
+    }
+    case PCAPNG_BLOCK_EPB:{
+      guint32 if_id;
+      guint32 cap_len;
+      guint64 ts;
 
-        data = gst_adapter_map (self->adapter, 16);
+      if (block_len < 32)
+        goto invalid_block;
 
-        ts_sec = gst_pcap_parse_read_uint32 (self, data + 0);
-        ts_usec = gst_pcap_parse_read_uint32 (self, data + 4);
-        incl_len = gst_pcap_parse_read_uint32 (self, data + 8);
-        /* orig_len = gst_pcap_parse_read_uint32 (self, data + 12); */
+      if_id = gst_pcap_parse_read_uint32 (self, data + 8);
+      ts = gst_pcap_parse_read_uint32 (self, data + 12);
+      ts = (ts << 32) | gst_pcap_parse_read_uint32 (self, data + 16);
+      cap_len = gst_pcap_parse_read_uint32 (self, data + 20);
 
-        gst_adapter_unmap (self->adapter);
-        gst_adapter_flush (self->adapter, 16);
+      if (cap_len > block_len - 32)
+        goto invalid_block;
 
-        self->cur_ts = ts_sec * GST_SECOND + ts_usec * GST_USECOND;
-        self->cur_packet_size = incl_len;
+      if (if_id >= self->interfaces->len) {
+        GST_WARNING_OBJECT (self, "packet for unknown interface %u", if_id);
+        break;
       }
-    } else {
-      guint32 magic;
-      guint32 linktype;
-      guint16 major_version;
 
-      if (avail < 24)
+      iface = &g_array_index (self->interfaces, GstPcapParseInterface, if_id);
+      record->packet = data + 28;
+      record->packet_size = cap_len;
+      record->linktype = iface->linktype;
+      if (iface->ts_resolution == GST_SECOND)
+        record->ts = ts;
+      else
+        record->ts = gst_util_uint64_scale (ts, GST_SECOND,
+            iface->ts_resolution);
+      break;
+    }
+    case PCAPNG_BLOCK_SPB:{
+      guint32 orig_len;
+
+      if (block_len < 16)
+        goto invalid_block;
+
+      if (self->interfaces->len == 0) {
+        GST_WARNING_OBJECT (self, "simple packet block without interface");
         break;
+      }
+
+      /* simple packet blocks only store the original length, the captured
+       * length is whatever fits in the block */
+      orig_len = gst_pcap_parse_read_uint32 (self, data + 8);
+
+      iface = &g_array_index (self->interfaces, GstPcapParseInterface, 0);
+      record->packet = data + 12;
+      record->packet_size = MIN (orig_len, block_len - 16);
+      record->linktype = iface->linktype;
+      record->ts = GST_CLOCK_TIME_NONE;
+      break;
+    }
+    default:
+      GST_LOG_OBJECT (self, "skipping block type 0x%08x", block_type);
+      break;
+  }
+
+  return GST_FLOW_OK;
+
+invalid_block:
+  {
+    GST_ELEMENT_ERROR (self, STREAM, DECODE, (NULL),
+        ("Invalid pcapng block of type 0x%08x and length %u", block_type,
+            block_len));
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* Parses the next record at @data. If @size is too small for a complete
+ * record, record->size is left to 0 and @needed is set to the number of bytes
+ * that are required. */
+static GstFlowReturn
+gst_pcap_parse_next_record (GstPcapParse * self, const guint8 * data,
+    gsize size, GstPcapParseRecord * record, gsize * needed)
+{
+  if (self->pcapng)
+    return gst_pcap_parse_read_block (self, data, size, record, needed);
+
+  if (self->initialized)
+    return gst_pcap_parse_read_record (self, data, size, record, needed);
+
+  if (size < 4) {
+    *needed = 4;
+    return GST_FLOW_OK;
+  }
+
+  if (*((guint32 *) data) == PCAPNG_BLOCK_SHB)
+    return gst_pcap_parse_read_block (self, data, size, record, needed);
+
+  return gst_pcap_parse_read_file_header (self, data, size, record, needed);
+}
+
+/* Parses all complete records in @buffer and adds the payloads to @list as
+ * sub-buffers of @buffer, so that no data is copied. @consumed is set to the
+ * number of bytes that were parsed and self->needed to the size of the next
+ * incomplete record, which is always larger than the rest of @buffer. */
+static GstFlowReturn
+gst_pcap_parse_process (GstPcapParse * self, GstBuffer * buffer,
+    GstBufferList ** list, gsize * consumed)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo map;
+  gsize offset = 0;
+
+  self->needed = 0;
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+        ("Failed to map input buffer"));
+    *consumed = 0;
+    return GST_FLOW_ERROR;
+  }
+
+  while (offset < map.size) {
+    GstPcapParseRecord record = { 0, };
+    const guint8 *payload_data;
+    gint payload_size;
+    gsize needed = 0;
+
+    ret = gst_pcap_parse_next_record (self, map.data + offset,
+        map.size - offset, &record, &needed);
+    if (ret != GST_FLOW_OK)
+      break;
 
-      data = gst_adapter_map (self->adapter, 24);
+    if (record.size == 0) {
+      self->needed = needed;
+      break;
+    }
+    offset += record.size;
+
+    if (record.packet == NULL || record.packet_size == 0)
+      continue;
+
+    GST_LOG_OBJECT (self, "examining packet size %" G_GSIZE_FORMAT,
+        record.packet_size);
 
-      magic = *((guint32 *) data);
-      major_version = *((guint16 *) (data + 4));
-      linktype = gst_pcap_parse_read_uint32 (self, data + 20);
-      gst_adapter_unmap (self->adapter);
+    if (gst_pcap_parse_scan_frame (self, record.linktype, record.packet,
+            record.packet_size, &payload_data, &payload_size)) {
+      GstBuffer *out_buf;
 
-      if (magic == 0xa1b2c3d4) {
-        self->swap_endian = FALSE;
-      } else if (magic == 0xd4c3b2a1) {
-        self->swap_endian = TRUE;
-        major_version = major_version << 8 | major_version >> 8;
+      /* the payload is contiguous in @buffer, so the sub-buffer only holds
+       * a single memory, which is what the RTP depayloaders expect */
+      if (payload_size > 0) {
+        out_buf = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_MEMORY,
+            payload_data - map.data, payload_size);
       } else {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("File is not a libpcap file, magic is %X", magic));
-        ret = GST_FLOW_ERROR;
-        goto out;
+        out_buf = gst_buffer_new ();
       }
 
-      if (major_version != 2) {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("File is not a libpcap major version 2, but %u", major_version));
-        ret = GST_FLOW_ERROR;
-        goto out;
+      if (GST_CLOCK_TIME_IS_VALID (record.ts)) {
+        if (!GST_CLOCK_TIME_IS_VALID (self->base_ts))
+          self->base_ts = record.ts;
+        if (self->offset >= 0) {
+          record.ts -= self->base_ts;
+          record.ts += self->offset;
+        }
       }
+      self->cur_ts = record.ts;
+      GST_BUFFER_TIMESTAMP (out_buf) = record.ts;
 
-      if (linktype != LINKTYPE_ETHER && linktype != LINKTYPE_SLL &&
-          linktype != LINKTYPE_RAW) {
-        GST_ELEMENT_ERROR (self, STREAM, WRONG_TYPE, (NULL),
-            ("Only dumps of type Ethernet, raw IP or Linux Cooked (SLL) "
-                "understood; type %d unknown", linktype));
-        ret = GST_FLOW_ERROR;
-        goto out;
-      }
+      if (*list == NULL)
+        *list = gst_buffer_list_new ();
+      gst_buffer_list_add (*list, out_buf);
+    }
+  }
+
+  gst_buffer_unmap (buffer, &map);
+  *consumed = offset;
+
+  return ret;
+}
+
+static void
+gst_pcap_parse_set_flushing (GstPcapParse * self, gboolean flushing)
+{
+  GST_OBJECT_LOCK (self);
+  self->flushing = flushing;
+  if (flushing) {
+    /* the next buffer prerolls without waiting for PLAYING */
+    self->paused = FALSE;
+    g_cond_broadcast (&self->paused_cond);
+    if (self->clock_id)
+      gst_clock_id_unschedule (self->clock_id);
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+/* Going to PAUSED interrupts the current wait, the streaming thread then
+ * blocks until PLAYING and waits again against the new base time */
+static void
+gst_pcap_parse_set_paused (GstPcapParse * self, gboolean paused)
+{
+  GST_OBJECT_LOCK (self);
+  self->paused = paused;
+  if (paused && self->clock_id)
+    gst_clock_id_unschedule (self->clock_id);
+  g_cond_broadcast (&self->paused_cond);
+  GST_OBJECT_UNLOCK (self);
+}
+
+/* waits until the running time of @ts */
+static GstFlowReturn
+gst_pcap_parse_wait (GstPcapParse * self, GstClockTime ts)
+{
+  GstClockTime running_time;
+  GstClockReturn cret;
+  GstClockID clock_id;
+  GstClock *clock;
+
+  running_time =
+      gst_segment_to_running_time (&self->segment, GST_FORMAT_TIME, ts);
+  if (!GST_CLOCK_TIME_IS_VALID (running_time))
+    return GST_FLOW_OK;
+
+  GST_OBJECT_LOCK (self);
+  do {
+    while (self->paused && !self->flushing) {
+      GST_DEBUG_OBJECT (self, "paused, waiting for PLAYING");
+      g_cond_wait (&self->paused_cond, GST_OBJECT_GET_LOCK (self));
+    }
+
+    if (self->flushing) {
+      GST_OBJECT_UNLOCK (self);
+      return GST_FLOW_FLUSHING;
+    }
+
+    clock = GST_ELEMENT_CLOCK (self);
+    if (clock == NULL) {
+      GST_OBJECT_UNLOCK (self);
+      return GST_FLOW_OK;
+    }
+
+    clock_id = gst_clock_new_single_shot_id (clock,
+        running_time + GST_ELEMENT_CAST (self)->base_time);
+    self->clock_id = clock_id;
+    GST_OBJECT_UNLOCK (self);
+
+    GST_LOG_OBJECT (self, "waiting for running time %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (running_time));
+    cret = gst_clock_id_wait (clock_id, NULL);
+
+    GST_OBJECT_LOCK (self);
+    self->clock_id = NULL;
+    gst_clock_id_unref (clock_id);
+    /* unscheduled by a pause, wait again once playing */
+  } while (cret == GST_CLOCK_UNSCHEDULED && !self->flushing);
+  GST_OBJECT_UNLOCK (self);
 
-      GST_DEBUG_OBJECT (self, "linktype %u", linktype);
-      self->linktype = linktype;
+  if (cret == GST_CLOCK_UNSCHEDULED)
+    return GST_FLOW_FLUSHING;
 
-      gst_adapter_flush (self->adapter, 24);
-      self->initialized = TRUE;
+  return GST_FLOW_OK;
+}
+
+/* pushes the packets of @list at the time they were captured, packets that
+ * are close together are pushed as one list */
+static GstFlowReturn
+gst_pcap_parse_push_list_realtime (GstPcapParse * self, GstBufferList * list)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBufferList *batch = NULL;
+  GstClockTime batch_ts = GST_CLOCK_TIME_NONE;
+  guint i, len;
+
+  len = gst_buffer_list_length (list);
+  for (i = 0; i < len; i++) {
+    GstBuffer *buf = gst_buffer_list_get (list, i);
+    GstClockTime ts = GST_BUFFER_TIMESTAMP (buf);
+
+    if (batch && GST_CLOCK_TIME_IS_VALID (ts) &&
+        GST_CLOCK_TIME_IS_VALID (batch_ts) &&
+        ts > batch_ts + REALTIME_GRANULARITY) {
+      ret = gst_pad_push_list (self->src_pad, batch);
+      batch = NULL;
+      if (ret != GST_FLOW_OK)
+        break;
+    }
+
+    if (batch == NULL) {
+      if (GST_CLOCK_TIME_IS_VALID (ts)) {
+        ret = gst_pcap_parse_wait (self, ts);
+        if (ret != GST_FLOW_OK)
+          break;
+      }
+      batch = gst_buffer_list_new ();
+      batch_ts = ts;
     }
+
+    gst_buffer_list_add (batch, gst_buffer_ref (buf));
+  }
+
+  if (batch) {
+    if (ret == GST_FLOW_OK)
+      ret = gst_pad_push_list (self->src_pad, batch);
+    else
+      gst_buffer_list_unref (batch);
+  }
+  gst_buffer_list_unref (list);
+
+  return ret;
+}
+
+static void
+gst_pcap_parse_send_segment (GstPcapParse * self)
+{
+  if (self->caps)
+    gst_pad_set_caps (self->src_pad, self->caps);
+  gst_segment_init (&self->segment, GST_FORMAT_TIME);
+  if (GST_CLOCK_TIME_IS_VALID (self->base_ts))
+    self->segment.start = self->base_ts;
+  gst_pad_push_event (self->src_pad, gst_event_new_segment (&self->segment));
+  self->newsegment_sent = TRUE;
+}
+
+static GstFlowReturn
+gst_pcap_parse_push_list (GstPcapParse * self, GstBufferList * list)
+{
+  if (!self->newsegment_sent && GST_CLOCK_TIME_IS_VALID (self->cur_ts))
+    gst_pcap_parse_send_segment (self);
+
+  if (self->realtime)
+    return gst_pcap_parse_push_list_realtime (self, list);
+
+  return gst_pad_push_list (self->src_pad, list);
+}
+
+static GstFlowReturn
+gst_pcap_parse_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBufferList *list = NULL;
+
+  gst_adapter_push (self->adapter, buffer);
+
+  while (ret == GST_FLOW_OK) {
+    GstBuffer *buf;
+    gsize avail;
+    gsize consumed;
+
+    avail = gst_adapter_available (self->adapter);
+    if (avail == 0 || avail < self->needed)
+      break;
+
+    /* parse straight from the first buffer in the adapter, only a record
+     * that spans several input buffers is merged into a single one */
+    buf = gst_adapter_get_buffer (self->adapter,
+        MAX (gst_adapter_available_fast (self->adapter), self->needed));
+    ret = gst_pcap_parse_process (self, buf, &list, &consumed);
+    gst_buffer_unref (buf);
+
+    gst_adapter_flush (self->adapter, consumed);
   }
 
   if (list) {
-    if (!self->newsegment_sent && GST_CLOCK_TIME_IS_VALID (self->cur_ts)) {
-      GstSegment segment;
-
-      if (self->caps)
-        gst_pad_set_caps (self->src_pad, self->caps);
-      gst_segment_init (&segment, GST_FORMAT_TIME);
-      segment.start = self->base_ts;
-      gst_pad_push_event (self->src_pad, gst_event_new_segment (&segment));
-      self->newsegment_sent = TRUE;
-    }
+    if (ret == GST_FLOW_OK)
+      ret = gst_pcap_parse_push_list (self, list);
+    else
+      gst_buffer_list_unref (list);
+  }
+
+  return ret;
+}
+
+static void
+gst_pcap_parse_loop (GstPad * pad)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (GST_PAD_PARENT (pad));
+  GstBufferList *list = NULL;
+  GstBuffer *buf = NULL;
+  GstFlowReturn ret;
+  gsize consumed;
+
+  if (!self->stream_start_sent) {
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id (self->src_pad,
+        GST_ELEMENT_CAST (self), NULL);
+    gst_pad_push_event (self->src_pad, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+    self->stream_start_sent = TRUE;
+  }
+
+  ret = gst_pad_pull_range (pad, self->pull_offset,
+      MAX (PULL_CHUNK_SIZE, self->needed), &buf);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  /* the payloads are sub-buffers of the pulled chunk */
+  ret = gst_pcap_parse_process (self, buf, &list, &consumed);
+  gst_buffer_unref (buf);
+  if (ret != GST_FLOW_OK)
+    goto pause;
+
+  if (consumed == 0) {
+    GST_WARNING_OBJECT (self, "file ends with a truncated record");
+    ret = GST_FLOW_EOS;
+    goto pause;
+  }
+  self->pull_offset += consumed;
 
-    ret = gst_pad_push_list (self->src_pad, list);
+  if (list) {
+    ret = gst_pcap_parse_push_list (self, list);
     list = NULL;
+    if (ret != GST_FLOW_OK)
+      goto pause;
   }
 
-out:
+  return;
 
-  if (list)
-    gst_buffer_list_unref (list);
+pause:
+  {
+    GST_DEBUG_OBJECT (self, "pausing task, reason %s", gst_flow_get_name (ret));
 
-  return ret;
+    if (list)
+      gst_buffer_list_unref (list);
+
+    gst_pad_pause_task (pad);
+
+    if (ret == GST_FLOW_EOS) {
+      if (!self->newsegment_sent)
+        gst_pcap_parse_send_segment (self);
+      gst_pad_push_event (self->src_pad, gst_event_new_eos ());
+    } else if (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS) {
+      GST_ELEMENT_FLOW_ERROR (self, ret);
+      gst_pad_push_event (self->src_pad, gst_event_new_eos ());
+    }
+  }
+}
+
+static gboolean
+gst_pcap_parse_sink_activate (GstPad * pad, GstObject * parent)
+{
+  GstQuery *query;
+  gboolean pull_mode;
+
+  query = gst_query_new_scheduling ();
+
+  if (!gst_pad_peer_query (pad, query)) {
+    gst_query_unref (query);
+    goto activate_push;
+  }
+
+  pull_mode = gst_query_has_scheduling_mode_with_flags (query,
+      GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE);
+  gst_query_unref (query);
+
+  if (!pull_mode)
+    goto activate_push;
+
+  GST_DEBUG_OBJECT (pad, "activating pull");
+  return gst_pad_activate_mode (pad, GST_PAD_MODE_PULL, TRUE);
+
+activate_push:
+  {
+    GST_DEBUG_OBJECT (pad, "activating push");
+    return gst_pad_activate_mode (pad, GST_PAD_MODE_PUSH, TRUE);
+  }
+}
+
+static gboolean
+gst_pcap_parse_sink_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  GstPcapParse *self = GST_PCAP_PARSE (parent);
+
+  switch (mode) {
+    case GST_PAD_MODE_PUSH:
+      return TRUE;
+    case GST_PAD_MODE_PULL:
+      if (active) {
+        self->pull_offset = 0;
+        return gst_pad_start_task (pad,
+            (GstTaskFunction) gst_pcap_parse_loop, pad, NULL);
+      }
+      gst_pcap_parse_set_flushing (self, TRUE);
+      return gst_pad_stop_task (pad);
+    default:
+      return FALSE;
+  }
 }
 
 static gboolean
@@ -624,8 +1255,13 @@ gst_pcap_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
       /* Drop it, we'll replace it with our own */
       gst_event_unref (event);
       break;
+    case GST_EVENT_FLUSH_START:
+      gst_pcap_parse_set_flushing (self, TRUE);
+      ret = gst_pad_push_event (self->src_pad, event);
+      break;
     case GST_EVENT_FLUSH_STOP:
       gst_pcap_parse_reset (self);
+      gst_pcap_parse_set_flushing (self, FALSE);
       /* Push event down the pipeline so that other elements stop flushing */
       /* fall through */
     default:
@@ -642,9 +1278,26 @@ gst_pcap_parse_change_state (GstElement * element, GstStateChange transition)
   GstPcapParse *self = GST_PCAP_PARSE (element);
   GstStateChangeReturn ret;
 
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_pcap_parse_set_flushing (self, FALSE);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      gst_pcap_parse_set_paused (self, FALSE);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_pcap_parse_set_flushing (self, TRUE);
+      break;
+    default:
+      break;
+  }
+
   ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
 
   switch (transition) {
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      gst_pcap_parse_set_paused (self, TRUE);
+      break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       gst_pcap_parse_reset (self);
       break;
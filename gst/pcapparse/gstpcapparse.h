@@ -52,6 +52,14 @@ typedef enum
   LINKTYPE_SLL = 113
 } GstPcapParseLinktype;
 
+/* an interface of a pcapng section, classic pcap files have exactly one */
+typedef struct
+{
+  GstPcapParseLinktype linktype;
+  /* timestamp units per second */
+  guint64 ts_resolution;
+} GstPcapParseInterface;
+
 /**
  * GstPcapParse:
  *
@@ -74,14 +82,31 @@ struct _GstPcapParse
   GstCaps *caps;
   gint64 offset;
 
+  gboolean realtime;
+
   /* state */
   GstAdapter * adapter;
   gboolean initialized;
+  gboolean pcapng;
   gboolean swap_endian;
-  gint64 cur_packet_size;
   GstClockTime cur_ts;
   GstClockTime base_ts;
-  GstPcapParseLinktype linktype;
+  GArray *interfaces;
+
+  /* bytes needed before the next record can be parsed */
+  gsize needed;
+
+  /* pull mode */
+  guint64 pull_offset;
+  gboolean stream_start_sent;
+
+  /* realtime pacing */
+  GstSegment segment;
+  GstClockID clock_id;
+  gboolean flushing;
+  /* paused after playing, pacing waits for the next PLAYING */
+  gboolean paused;
+  GCond paused_cond;
 
   gboolean newsegment_sent;
 };
@@ -160,7 +160,7 @@ gst_h264_parse_class_init (GstH264ParseClass * klass)
 static void
 gst_h264_parse_init (GstH264Parse * h264parse)
 {
-  h264parse->frame_out = gst_adapter_new ();
+  h264parse->frame_nals = g_array_new (FALSE, FALSE, sizeof (GstH264ParseNal));
   gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (h264parse), FALSE);
   GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (h264parse));
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (h264parse));
@@ -172,11 +172,38 @@ gst_h264_parse_finalize (GObject * object)
 {
   GstH264Parse *h264parse = GST_H264_PARSE (object);
 
-  g_object_unref (h264parse->frame_out);
+  g_array_free (h264parse->frame_nals, TRUE);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+static void
+gst_h264_parse_clear_frame_nals (GstH264Parse * h264parse)
+{
+  guint i;
+
+  for (i = 0; i < h264parse->frame_nals->len; i++) {
+    GstH264ParseNal *nal =
+        &g_array_index (h264parse->frame_nals, GstH264ParseNal, i);
+
+    if (nal->data)
+      gst_buffer_unref (nal->data);
+  }
+  g_array_set_size (h264parse->frame_nals, 0);
+  h264parse->frame_out_size = 0;
+}
+
+static void
+gst_h264_parse_free_frame_pool (GstH264Parse * h264parse)
+{
+  if (h264parse->frame_pool) {
+    gst_buffer_pool_set_active (h264parse->frame_pool, FALSE);
+    gst_object_unref (h264parse->frame_pool);
+    h264parse->frame_pool = NULL;
+  }
+  h264parse->frame_pool_size = 0;
+}
+
 static void
 gst_h264_parse_reset_frame (GstH264Parse * h264parse)
 {
@@ -192,7 +219,7 @@ gst_h264_parse_reset_frame (GstH264Parse * h264parse)
   h264parse->keyframe = FALSE;
   h264parse->header = FALSE;
   h264parse->frame_start = FALSE;
-  gst_adapter_clear (h264parse->frame_out);
+  gst_h264_parse_clear_frame_nals (h264parse);
 }
 
 static void
@@ -284,6 +311,8 @@ gst_h264_parse_stop (GstBaseParse * parse)
 
   gst_h264_nal_parser_free (h264parse->nalparser);
 
+  gst_h264_parse_free_frame_pool (h264parse);
+
   return TRUE;
 }
 
@@ -440,6 +469,186 @@ gst_h264_parse_wrap_nal (GstH264Parse * h264parse, guint format, guint8 * data,
   return buf;
 }
 
+/* size of the start code or length prefix of transformed output */
+static guint
+gst_h264_parse_get_out_prefix_size (GstH264Parse * h264parse)
+{
+  if (h264parse->format == GST_H264_PARSE_FORMAT_AVC
+      || h264parse->format == GST_H264_PARSE_FORMAT_AVC3)
+    return h264parse->nal_length_size;
+
+  /* see gst_h264_parse_wrap_nal() */
+  return 4;
+}
+
+static void
+gst_h264_parse_collect_frame_nal (GstH264Parse * h264parse,
+    GstH264NalUnit * nalu)
+{
+  GstH264ParseNal nal = { 0, };
+  GArray *nals = h264parse->frame_nals;
+
+  GST_LOG_OBJECT (h264parse, "collecting NAL in AVC frame");
+
+  nal.start = nalu->sc_offset;
+  nal.offset = nalu->offset;
+  nal.size = nalu->size;
+
+  /* zero bytes trailing the previous nal belong to this start code */
+  if (nals->len > 0) {
+    GstH264ParseNal *prev = &g_array_index (nals, GstH264ParseNal,
+        nals->len - 1);
+
+    if (!prev->data && prev->offset + prev->size <= nal.start)
+      nal.start = prev->offset + prev->size;
+  }
+
+  g_array_append_val (nals, nal);
+  h264parse->frame_out_size +=
+      gst_h264_parse_get_out_prefix_size (h264parse) + nal.size;
+}
+
+/* copies the nals collected from @data, starting with nal @first,
+ * as @data is about to be gone */
+static void
+gst_h264_parse_store_frame_nals (GstH264Parse * h264parse,
+    const guint8 * data, guint first)
+{
+  guint i;
+
+  for (i = first; i < h264parse->frame_nals->len; i++) {
+    GstH264ParseNal *nal =
+        &g_array_index (h264parse->frame_nals, GstH264ParseNal, i);
+
+    if (!nal->data)
+      nal->data = gst_buffer_new_wrapped (g_memdup (data + nal->offset,
+              nal->size), nal->size);
+  }
+}
+
+/* output buffers come from a pool sized for the largest frame so far */
+static GstBuffer *
+gst_h264_parse_alloc_frame_out (GstH264Parse * h264parse, gsize size)
+{
+  GstBuffer *buf = NULL;
+
+  if (h264parse->frame_pool_size < size) {
+    GstStructure *config;
+    gsize pool_size = size + size / 4;
+
+    gst_h264_parse_free_frame_pool (h264parse);
+
+    h264parse->frame_pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (h264parse->frame_pool);
+    gst_buffer_pool_config_set_params (config, NULL, pool_size, 0, 0);
+    if (!gst_buffer_pool_set_config (h264parse->frame_pool, config) ||
+        !gst_buffer_pool_set_active (h264parse->frame_pool, TRUE)) {
+      GST_WARNING_OBJECT (h264parse, "failed to activate output pool");
+      gst_h264_parse_free_frame_pool (h264parse);
+    }
+    GST_DEBUG_OBJECT (h264parse, "output pool for frames up to %"
+        G_GSIZE_FORMAT " bytes", pool_size);
+    h264parse->frame_pool_size = pool_size;
+  }
+
+  if (h264parse->frame_pool &&
+      gst_buffer_pool_acquire_buffer (h264parse->frame_pool, &buf,
+          NULL) == GST_FLOW_OK) {
+    gst_buffer_set_size (buf, size);
+    return buf;
+  }
+
+  return gst_buffer_new_allocate (NULL, size, NULL);
+}
+
+static void
+gst_h264_parse_write_prefix (GstH264Parse * h264parse, guint8 * dest,
+    guint nal_size)
+{
+  guint nl = gst_h264_parse_get_out_prefix_size (h264parse);
+
+  if (h264parse->format == GST_H264_PARSE_FORMAT_BYTE) {
+    GST_WRITE_UINT32_BE (dest, 1);
+  } else {
+    guint8 tmp[4];
+
+    GST_WRITE_UINT32_BE (tmp, nal_size << (32 - 8 * nl));
+    memcpy (dest, tmp, nl);
+  }
+}
+
+/* Builds the transformed frame from the collected nals. Start codes and
+ * length prefixes usually have the same size, in which case the input is
+ * copied at once and only the prefixes are rewritten. Returns NULL if the
+ * input can be pushed as is. */
+static GstBuffer *
+gst_h264_parse_make_frame_out (GstH264Parse * h264parse, GstBuffer * input)
+{
+  GArray *nals = h264parse->frame_nals;
+  GstH264ParseNal *first, *last, *nal;
+  guint nl = gst_h264_parse_get_out_prefix_size (h264parse);
+  gboolean in_place = TRUE;
+  gboolean same_format;
+  GstMapInfo in_map, out_map;
+  GstBuffer *buf;
+  guint8 *dest;
+  guint i;
+
+  first = &g_array_index (nals, GstH264ParseNal, 0);
+  last = &g_array_index (nals, GstH264ParseNal, nals->len - 1);
+
+  for (i = 0; i < nals->len && in_place; i++) {
+    nal = &g_array_index (nals, GstH264ParseNal, i);
+
+    in_place = !nal->data && nal->offset - nal->start == nl;
+    if (in_place && i > 0)
+      in_place = nal->start == nal[-1].offset + nal[-1].size;
+  }
+
+  /* 4 byte start codes or the same length prefixes */
+  same_format = h264parse->packetized ?
+      h264parse->format != GST_H264_PARSE_FORMAT_BYTE :
+      h264parse->format == GST_H264_PARSE_FORMAT_BYTE;
+
+  if (in_place && same_format && first->start == 0) {
+    GST_LOG_OBJECT (h264parse, "frame needs no transformation");
+    return NULL;
+  }
+
+  buf = gst_h264_parse_alloc_frame_out (h264parse, h264parse->frame_out_size);
+
+  gst_buffer_map (input, &in_map, GST_MAP_READ);
+  gst_buffer_map (buf, &out_map, GST_MAP_WRITE);
+  dest = out_map.data;
+
+  if (in_place) {
+    GST_LOG_OBJECT (h264parse, "rewriting %u prefixes in place", nals->len);
+    memcpy (dest, in_map.data + first->start,
+        last->offset + last->size - first->start);
+    for (i = 0; i < nals->len; i++) {
+      nal = &g_array_index (nals, GstH264ParseNal, i);
+      gst_h264_parse_write_prefix (h264parse, dest + nal->start - first->start,
+          nal->size);
+    }
+  } else {
+    for (i = 0; i < nals->len; i++) {
+      nal = &g_array_index (nals, GstH264ParseNal, i);
+      gst_h264_parse_write_prefix (h264parse, dest, nal->size);
+      dest += nl;
+      if (nal->data)
+        gst_buffer_extract (nal->data, 0, dest, nal->size);
+      else
+        memcpy (dest, in_map.data + nal->offset, nal->size);
+      dest += nal->size;
+    }
+  }
+
+  gst_buffer_unmap (buf, &out_map);
+  gst_buffer_unmap (input, &in_map);
+
+  return buf;
+}
+
 static void
 gst_h264_parser_store_nal (GstH264Parse * h264parse, guint id,
     GstH264NalUnitType naltype, GstH264NalUnit * nalu)
@@ -794,7 +1003,7 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       /* mark SEI pos */
       if (h264parse->sei_pos == -1) {
         if (h264parse->transform)
-          h264parse->sei_pos = gst_adapter_available (h264parse->frame_out);
+          h264parse->sei_pos = h264parse->frame_out_size;
         else
           h264parse->sei_pos = nalu->sc_offset;
         GST_DEBUG_OBJECT (h264parse, "marking SEI in frame at offset %d",
@@ -850,7 +1059,7 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       /* mind replacement buffer if applicable */
       if (h264parse->idr_pos == -1) {
         if (h264parse->transform)
-          h264parse->idr_pos = gst_adapter_available (h264parse->frame_out);
+          h264parse->idr_pos = h264parse->frame_out_size;
         else
           h264parse->idr_pos = nalu->sc_offset;
         GST_DEBUG_OBJECT (h264parse, "marking IDR in frame at offset %d",
@@ -880,16 +1089,11 @@ gst_h264_parse_process_nal (GstH264Parse * h264parse, GstH264NalUnit * nalu)
       break;
   }
 
-  /* if AVC output needed, collect properly prefixed nal in adapter,
+  /* if AVC output needed, collect the position of the nal,
    * and use that to replace outgoing buffer data later on */
-  if (h264parse->transform) {
-    GstBuffer *buf;
+  if (h264parse->transform)
+    gst_h264_parse_collect_frame_nal (h264parse, nalu);
 
-    GST_LOG_OBJECT (h264parse, "collecting NAL in AVC frame");
-    buf = gst_h264_parse_wrap_nal (h264parse, h264parse->format,
-        nalu->data + nalu->offset, nalu->size);
-    gst_adapter_push (h264parse->frame_out, buf);
-  }
   return TRUE;
 }
 
@@ -990,13 +1194,14 @@ gst_h264_parse_handle_frame_packetized (GstBaseParse * parse,
       tmp_frame.flags |= frame->flags;
       tmp_frame.offset = frame->offset;
       tmp_frame.overhead = frame->overhead;
-      tmp_frame.buffer = gst_buffer_copy_region (buffer, GST_BUFFER_COPY_ALL,
-          nalu.offset, nalu.size);
-
-      /* note we don't need to come up with a sub-buffer, since
-       * subsequent code only considers input buffer's metadata.
-       * Real data is either taken from input by baseclass or
-       * a replacement output buffer is provided anyway. */
+      /* the sub-buffer starts with the input data, so the offsets of the
+       * collected nal stay valid for a replacement output buffer. Like a
+       * sub-buffer of the nal alone, it does not carry the timestamps of
+       * the input, they are left to baseclass. Otherwise only its metadata
+       * is considered, the real data is taken from input by baseclass. */
+      tmp_frame.buffer = gst_buffer_copy_region (buffer,
+          GST_BUFFER_COPY_ALL & ~GST_BUFFER_COPY_TIMESTAMPS, 0,
+          nalu.offset + nalu.size);
       gst_h264_parse_parse_frame (parse, &tmp_frame);
       ret = gst_base_parse_finish_frame (parse, &tmp_frame, nl + nalu.size);
       left -= nl + nalu.size;
@@ -1272,6 +1477,8 @@ skip:
       !(h264parse->state & GST_H264_PARSE_STATE_VALID_PICTURE_HEADERS) ||
       (h264parse->state & GST_H264_PARSE_STATE_GOT_SLICE))
     gst_h264_parse_reset_frame (h264parse);
+  else
+    gst_h264_parse_store_frame_nals (h264parse, data, 0);
   goto out;
 
 invalid_stream:
@@ -2076,7 +2283,6 @@ gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
 {
   GstH264Parse *h264parse;
   GstBuffer *buffer;
-  guint av;
 
   h264parse = GST_H264_PARSE (parse);
   buffer = frame->buffer;
@@ -2106,14 +2312,16 @@ gst_h264_parse_parse_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
   }
 
   /* replace with transformed AVC output if applicable */
-  av = gst_adapter_available (h264parse->frame_out);
-  if (av) {
+  if (h264parse->frame_nals->len > 0) {
     GstBuffer *buf;
 
-    buf = gst_adapter_take_buffer (h264parse->frame_out, av);
-    gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
-    gst_buffer_replace (&frame->out_buffer, buf);
-    gst_buffer_unref (buf);
+    buf = gst_h264_parse_make_frame_out (h264parse, buffer);
+    if (buf) {
+      gst_buffer_copy_into (buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
+      gst_buffer_replace (&frame->out_buffer, buf);
+      gst_buffer_unref (buf);
+    }
+    gst_h264_parse_clear_frame_nals (h264parse);
   }
 
   return GST_FLOW_OK;
@@ -2233,6 +2441,53 @@ gst_h264_parse_prepare_key_unit (GstH264Parse * parse, GstEvent * event)
   parse->push_codec = TRUE;
 }
 
+/* all SPS and PPS, each with a start code or length prefix, in one
+ * memory block that can be inserted in front of an IDR */
+static GstMemory *
+gst_h264_parse_make_config_memory (GstH264Parse * h264parse)
+{
+  GstBuffer *nals[GST_H264_MAX_SPS_COUNT + GST_H264_MAX_PPS_COUNT];
+  guint nl = gst_h264_parse_get_out_prefix_size (h264parse);
+  guint n_nals = 0, i;
+  gsize size = 0;
+  GstMemory *mem;
+  GstMapInfo map;
+  guint8 *data;
+
+  for (i = 0; i < GST_H264_MAX_SPS_COUNT; i++) {
+    if (h264parse->sps_nals[i]) {
+      GST_DEBUG_OBJECT (h264parse, "inserting SPS nal");
+      nals[n_nals++] = h264parse->sps_nals[i];
+    }
+  }
+  for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++) {
+    if (h264parse->pps_nals[i]) {
+      GST_DEBUG_OBJECT (h264parse, "inserting PPS nal");
+      nals[n_nals++] = h264parse->pps_nals[i];
+    }
+  }
+
+  if (n_nals == 0)
+    return NULL;
+
+  for (i = 0; i < n_nals; i++)
+    size += nl + gst_buffer_get_size (nals[i]);
+
+  mem = gst_allocator_alloc (NULL, size, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  data = map.data;
+  for (i = 0; i < n_nals; i++) {
+    gsize nal_size = gst_buffer_get_size (nals[i]);
+
+    gst_h264_parse_write_prefix (h264parse, data, nal_size);
+    gst_buffer_extract (nals[i], 0, data + nl, nal_size);
+    data += nl + nal_size;
+  }
+  gst_memory_unmap (mem, &map);
+
+  return mem;
+}
+
 static gboolean
 gst_h264_parse_handle_sps_pps_nals (GstH264Parse * h264parse,
     GstBuffer * buffer, GstBaseParseFrame * frame)
@@ -2261,58 +2516,27 @@ gst_h264_parse_handle_sps_pps_nals (GstH264Parse * h264parse,
     }
   } else {
     /* insert config NALs into AU */
-    GstByteWriter bw;
+    GstMemory *config;
     GstBuffer *new_buf;
-    const gboolean bs = h264parse->format == GST_H264_PARSE_FORMAT_BYTE;
-    const gint nls = 4 - h264parse->nal_length_size;
-    gboolean ok;
 
-    gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer), FALSE);
-    ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h264parse->idr_pos);
     GST_DEBUG_OBJECT (h264parse, "- inserting SPS/PPS");
-    for (i = 0; i < GST_H264_MAX_SPS_COUNT; i++) {
-      if ((codec_nal = h264parse->sps_nals[i])) {
-        gsize nal_size = gst_buffer_get_size (codec_nal);
-        GST_DEBUG_OBJECT (h264parse, "inserting SPS nal");
-        if (bs) {
-          ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-        } else {
-          ok &= gst_byte_writer_put_uint32_be (&bw, (nal_size << (nls * 8)));
-          ok &= gst_byte_writer_set_pos (&bw,
-              gst_byte_writer_get_pos (&bw) - nls);
-        }
-
-        ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
-        send_done = TRUE;
-      }
-    }
-    for (i = 0; i < GST_H264_MAX_PPS_COUNT; i++) {
-      if ((codec_nal = h264parse->pps_nals[i])) {
-        gsize nal_size = gst_buffer_get_size (codec_nal);
-        GST_DEBUG_OBJECT (h264parse, "inserting PPS nal");
-        if (bs) {
-          ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-        } else {
-          ok &= gst_byte_writer_put_uint32_be (&bw, (nal_size << (nls * 8)));
-          ok &= gst_byte_writer_set_pos (&bw,
-              gst_byte_writer_get_pos (&bw) - nls);
-        }
-        ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
-        send_done = TRUE;
-      }
-    }
-    ok &= gst_byte_writer_put_buffer (&bw, buffer, h264parse->idr_pos, -1);
-    /* collect result and push */
-    new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
-    gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
-    /* should already be keyframe/IDR, but it may not have been,
-     * so mark it as such to avoid being discarded by picky decoder */
-    GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
-    gst_buffer_replace (&frame->out_buffer, new_buf);
-    gst_buffer_unref (new_buf);
-    /* some result checking seems to make some compilers happy */
-    if (G_UNLIKELY (!ok)) {
-      GST_ERROR_OBJECT (h264parse, "failed to insert SPS/PPS");
+    config = gst_h264_parse_make_config_memory (h264parse);
+    if (config) {
+      /* the frame data is shared, only the config NALs are new */
+      new_buf = gst_buffer_new ();
+      if (h264parse->idr_pos > 0)
+        gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_MEMORY, 0,
+            h264parse->idr_pos);
+      gst_buffer_append_memory (new_buf, config);
+      gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_MEMORY,
+          h264parse->idr_pos, -1);
+      gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0, -1);
+      /* should already be keyframe/IDR, but it may not have been,
+       * so mark it as such to avoid being discarded by picky decoder */
+      GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
+      gst_buffer_replace (&frame->out_buffer, new_buf);
+      gst_buffer_unref (new_buf);
+      send_done = TRUE;
     }
   }
 
@@ -2525,7 +2749,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
   if (codec_data_value != NULL) {
     GstMapInfo map;
     guint8 *data;
-    guint num_sps, num_pps;
+    guint num_sps, num_pps, first_nal;
 #ifndef GST_DISABLE_GST_DEBUG
     guint profile;
 #endif
@@ -2571,12 +2795,16 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
     GST_DEBUG_OBJECT (h264parse, "nal length size %u",
         h264parse->nal_length_size);
 
+    /* collected nals must not refer to codec_data */
+    first_nal = h264parse->frame_nals->len;
+
     num_sps = data[5] & 0x1f;
     off = 6;
     for (i = 0; i < num_sps; i++) {
       parseres = gst_h264_parser_identify_nalu_avc (h264parse->nalparser,
           data, off, size, 2, &nalu);
       if (parseres != GST_H264_PARSER_OK) {
+        gst_h264_parse_store_frame_nals (h264parse, data, first_nal);
         gst_buffer_unmap (codec_data, &map);
         goto avcc_too_small;
       }
@@ -2586,6 +2814,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
     }
 
     if (off >= size) {
+      gst_h264_parse_store_frame_nals (h264parse, data, first_nal);
       gst_buffer_unmap (codec_data, &map);
       goto avcc_too_small;
     }
@@ -2596,6 +2825,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
       parseres = gst_h264_parser_identify_nalu_avc (h264parse->nalparser,
           data, off, size, 2, &nalu);
       if (parseres != GST_H264_PARSER_OK) {
+        gst_h264_parse_store_frame_nals (h264parse, data, first_nal);
         gst_buffer_unmap (codec_data, &map);
         goto avcc_too_small;
       }
@@ -2604,6 +2834,7 @@ gst_h264_parse_set_caps (GstBaseParse * parse, GstCaps * caps)
       off = nalu.offset + nalu.size;
     }
 
+    gst_h264_parse_store_frame_nals (h264parse, data, first_nal);
     gst_buffer_unmap (codec_data, &map);
 
     gst_buffer_replace (&h264parse->codec_data_in, codec_data);
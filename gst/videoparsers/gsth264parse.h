@@ -50,6 +50,18 @@ GType gst_h264_parse_get_type (void);
 typedef struct _GstH264Parse GstH264Parse;
 typedef struct _GstH264ParseClass GstH264ParseClass;
 
+/* NAL collected for transformed output, referring to the input frame */
+typedef struct
+{
+  /* start of the start code or length prefix */
+  guint start;
+  /* payload */
+  guint offset;
+  guint size;
+  /* copy of the payload once the input data is gone */
+  GstBuffer *data;
+} GstH264ParseNal;
+
 struct _GstH264Parse
 {
   GstBaseParse baseparse;
@@ -111,7 +123,10 @@ struct _GstH264Parse
   /*guint next_sc_pos;*/
   gint idr_pos, sei_pos;
   gboolean update_caps;
-  GstAdapter *frame_out;
+  GArray *frame_nals;
+  guint frame_out_size;
+  GstBufferPool *frame_pool;
+  gsize frame_pool_size;
   gboolean keyframe;
   gboolean header;
   gboolean frame_start;
@@ -1782,6 +1782,67 @@ gst_h265_parse_prepare_key_unit (GstH265Parse * parse, GstEvent * event)
   parse->push_codec = TRUE;
 }
 
+/* all VPS, SPS and PPS, each with a start code or length prefix, in one
+ * memory block that can be inserted in front of an IRAP picture */
+static GstMemory *
+gst_h265_parse_make_config_memory (GstH265Parse * h265parse)
+{
+  GstBuffer *nals[GST_H265_MAX_VPS_COUNT + GST_H265_MAX_SPS_COUNT +
+      GST_H265_MAX_PPS_COUNT];
+  const gboolean bs = h265parse->format == GST_H265_PARSE_FORMAT_BYTE;
+  const guint nl = bs ? 4 : h265parse->nal_length_size;
+  guint n_nals = 0, i;
+  gsize size = 0;
+  GstMemory *mem;
+  GstMapInfo map;
+  guint8 *data;
+
+  for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++) {
+    if (h265parse->vps_nals[i]) {
+      GST_DEBUG_OBJECT (h265parse, "inserting VPS nal");
+      nals[n_nals++] = h265parse->vps_nals[i];
+    }
+  }
+  for (i = 0; i < GST_H265_MAX_SPS_COUNT; i++) {
+    if (h265parse->sps_nals[i]) {
+      GST_DEBUG_OBJECT (h265parse, "inserting SPS nal");
+      nals[n_nals++] = h265parse->sps_nals[i];
+    }
+  }
+  for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++) {
+    if (h265parse->pps_nals[i]) {
+      GST_DEBUG_OBJECT (h265parse, "inserting PPS nal");
+      nals[n_nals++] = h265parse->pps_nals[i];
+    }
+  }
+
+  if (n_nals == 0)
+    return NULL;
+
+  for (i = 0; i < n_nals; i++)
+    size += nl + gst_buffer_get_size (nals[i]);
+
+  mem = gst_allocator_alloc (NULL, size, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  data = map.data;
+  for (i = 0; i < n_nals; i++) {
+    gsize nal_size = gst_buffer_get_size (nals[i]);
+    guint8 prefix[4];
+
+    /* see gst_h265_parse_wrap_nal() */
+    if (bs)
+      GST_WRITE_UINT32_BE (prefix, 1);
+    else
+      GST_WRITE_UINT32_BE (prefix, nal_size << (32 - 8 * nl));
+    memcpy (data, prefix, nl);
+    gst_buffer_extract (nals[i], 0, data + nl, nal_size);
+    data += nl + nal_size;
+  }
+  gst_memory_unmap (mem, &map);
+
+  return mem;
+}
+
 static GstFlowReturn
 gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
 {
@@ -1892,80 +1953,28 @@ gst_h265_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
           }
         } else {
           /* insert config NALs into AU */
-          GstByteWriter bw;
+          GstMemory *config;
           GstBuffer *new_buf;
-          const gboolean bs = h265parse->format == GST_H265_PARSE_FORMAT_BYTE;
-          const gint nls = 4 - h265parse->nal_length_size;
-          gboolean ok;
 
-          gst_byte_writer_init_with_size (&bw, gst_buffer_get_size (buffer),
-              FALSE);
-          ok = gst_byte_writer_put_buffer (&bw, buffer, 0, h265parse->idr_pos);
           GST_DEBUG_OBJECT (h265parse, "- inserting VPS/SPS/PPS");
-          for (i = 0; i < GST_H265_MAX_VPS_COUNT; i++) {
-            if ((codec_nal = h265parse->vps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
-              GST_DEBUG_OBJECT (h265parse, "inserting VPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
-              h265parse->last_report = new_ts;
-            }
-          }
-          for (i = 0; i < GST_H265_MAX_SPS_COUNT; i++) {
-            if ((codec_nal = h265parse->sps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
-              GST_DEBUG_OBJECT (h265parse, "inserting SPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
-              h265parse->last_report = new_ts;
-            }
-          }
-          for (i = 0; i < GST_H265_MAX_PPS_COUNT; i++) {
-            if ((codec_nal = h265parse->pps_nals[i])) {
-              gsize nal_size = gst_buffer_get_size (codec_nal);
-              GST_DEBUG_OBJECT (h265parse, "inserting PPS nal");
-              if (bs) {
-                ok &= gst_byte_writer_put_uint32_be (&bw, 1);
-              } else {
-                ok &= gst_byte_writer_put_uint32_be (&bw,
-                    (nal_size << (nls * 8)));
-                ok &= gst_byte_writer_set_pos (&bw,
-                    gst_byte_writer_get_pos (&bw) - nls);
-              }
-              ok &= gst_byte_writer_put_buffer (&bw, codec_nal, 0, nal_size);
-              h265parse->last_report = new_ts;
-            }
-          }
-          ok &=
-              gst_byte_writer_put_buffer (&bw, buffer, h265parse->idr_pos, -1);
-          /* collect result and push */
-          new_buf = gst_byte_writer_reset_and_get_buffer (&bw);
-          gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA, 0,
-              -1);
-          /* should already be keyframe/IDR, but it may not have been,
-           * so mark it as such to avoid being discarded by picky decoder */
-          GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
-          gst_buffer_replace (&frame->out_buffer, new_buf);
-          gst_buffer_unref (new_buf);
-          /* some result checking seems to make some compilers happy */
-          if (G_UNLIKELY (!ok)) {
-            GST_ERROR_OBJECT (h265parse, "failed to insert SPS/PPS");
+          config = gst_h265_parse_make_config_memory (h265parse);
+          if (config) {
+            /* the frame data is shared, only the config NALs are new */
+            new_buf = gst_buffer_new ();
+            if (h265parse->idr_pos > 0)
+              gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_MEMORY, 0,
+                  h265parse->idr_pos);
+            gst_buffer_append_memory (new_buf, config);
+            gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_MEMORY,
+                h265parse->idr_pos, -1);
+            gst_buffer_copy_into (new_buf, buffer, GST_BUFFER_COPY_METADATA,
+                0, -1);
+            /* should already be keyframe/IDR, but it may not have been,
+             * so mark it as such to avoid being discarded by picky decoder */
+            GST_BUFFER_FLAG_UNSET (new_buf, GST_BUFFER_FLAG_DELTA_UNIT);
+            gst_buffer_replace (&frame->out_buffer, new_buf);
+            gst_buffer_unref (new_buf);
+            h265parse->last_report = new_ts;
           }
         }
       }
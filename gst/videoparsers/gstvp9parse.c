@@ -0,0 +1,568 @@
+/* GStreamer VP9 Parser
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-vp9parse
+ *
+ * Parses VP9 streams that are already framed by a container, such as
+ * the ones coming out of matroskademux or ivfparse. The frame headers
+ * are used to mark key frames and to describe the stream in the caps
+ * (size, profile, bit depth and chroma format).
+ *
+ * Superframes are passed on unchanged by default. If downstream only
+ * accepts "alignment=frame", they are split into their frames. The
+ * frames are output as sub-buffers of the superframe so no data is
+ * copied. Only the shown frames carry a presentation timestamp, the
+ * hidden ones are flagged as decode-only.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 filesrc location=video.webm ! matroskademux ! vp9parse ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gstvp9parse.h"
+
+#include <string.h>
+#include <gst/pbutils/pbutils.h>
+
+GST_DEBUG_CATEGORY (vp9_parse_debug);
+#define GST_CAT_DEFAULT vp9_parse_debug
+
+static GstStaticPadTemplate srctemplate =
+GST_STATIC_PAD_TEMPLATE ("src", GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-vp9, parsed = (boolean) true, "
+        "alignment = (string) { super-frame, frame }")
+    );
+
+static GstStaticPadTemplate sinktemplate =
+GST_STATIC_PAD_TEMPLATE ("sink", GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-vp9")
+    );
+
+#define parent_class gst_vp9_parse_parent_class
+G_DEFINE_TYPE (GstVp9Parse, gst_vp9_parse, GST_TYPE_BASE_PARSE);
+
+static gboolean gst_vp9_parse_start (GstBaseParse * parse);
+static gboolean gst_vp9_parse_stop (GstBaseParse * parse);
+static gboolean gst_vp9_parse_event (GstBaseParse * parse, GstEvent * event);
+static gboolean gst_vp9_parse_set_sink_caps (GstBaseParse * parse,
+    GstCaps * caps);
+static GstFlowReturn gst_vp9_parse_handle_frame (GstBaseParse * parse,
+    GstBaseParseFrame * frame, gint * skipsize);
+static GstFlowReturn gst_vp9_parse_pre_push_frame (GstBaseParse * parse,
+    GstBaseParseFrame * frame);
+
+static void
+gst_vp9_parse_class_init (GstVp9ParseClass * klass)
+{
+  GstElementClass *gstelement_class = GST_ELEMENT_CLASS (klass);
+  GstBaseParseClass *parse_class = GST_BASE_PARSE_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (vp9_parse_debug, "vp9parse", 0, "vp9 parser");
+
+  gst_element_class_add_static_pad_template (gstelement_class, &srctemplate);
+  gst_element_class_add_static_pad_template (gstelement_class, &sinktemplate);
+  gst_element_class_set_static_metadata (gstelement_class, "VP9 parser",
+      "Codec/Parser/Converter/Video",
+      "Parses VP9 streams",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  /* Override BaseParse vfuncs */
+  parse_class->start = GST_DEBUG_FUNCPTR (gst_vp9_parse_start);
+  parse_class->stop = GST_DEBUG_FUNCPTR (gst_vp9_parse_stop);
+  parse_class->sink_event = GST_DEBUG_FUNCPTR (gst_vp9_parse_event);
+  parse_class->set_sink_caps = GST_DEBUG_FUNCPTR (gst_vp9_parse_set_sink_caps);
+  parse_class->handle_frame = GST_DEBUG_FUNCPTR (gst_vp9_parse_handle_frame);
+  parse_class->pre_push_frame =
+      GST_DEBUG_FUNCPTR (gst_vp9_parse_pre_push_frame);
+}
+
+static void
+gst_vp9_parse_init (GstVp9Parse * vp9parse)
+{
+  /* the container provides the timestamps, hidden frames have none */
+  gst_base_parse_set_pts_interpolation (GST_BASE_PARSE (vp9parse), FALSE);
+  gst_base_parse_set_infer_ts (GST_BASE_PARSE (vp9parse), FALSE);
+
+  GST_PAD_SET_ACCEPT_INTERSECT (GST_BASE_PARSE_SINK_PAD (vp9parse));
+  GST_PAD_SET_ACCEPT_TEMPLATE (GST_BASE_PARSE_SINK_PAD (vp9parse));
+}
+
+static void
+gst_vp9_parse_reset_split (GstVp9Parse * vp9parse)
+{
+  vp9parse->n_frames = 0;
+  vp9parse->cur_frame = 0;
+  vp9parse->trailing = 0;
+}
+
+static gboolean
+gst_vp9_parse_start (GstBaseParse * parse)
+{
+  GstVp9Parse *vp9parse = GST_VP9_PARSE (parse);
+
+  GST_DEBUG_OBJECT (vp9parse, "start");
+
+  vp9parse->parser = gst_vp9_parser_new ();
+
+  vp9parse->width = 0;
+  vp9parse->height = 0;
+  vp9parse->profile = GST_VP9_PROFILE_UNDEFINED;
+  vp9parse->bit_depth = 0;
+  vp9parse->subsampling_x = -1;
+  vp9parse->subsampling_y = -1;
+  vp9parse->update_caps = TRUE;
+
+  vp9parse->in_align = GST_VP9_PARSE_ALIGN_NONE;
+  vp9parse->align = GST_VP9_PARSE_ALIGN_NONE;
+
+  gst_vp9_parse_reset_split (vp9parse);
+
+  vp9parse->sent_codec_tag = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vp9_parse_stop (GstBaseParse * parse)
+{
+  GstVp9Parse *vp9parse = GST_VP9_PARSE (parse);
+
+  GST_DEBUG_OBJECT (vp9parse, "stop");
+
+  if (vp9parse->parser) {
+    gst_vp9_parser_free (vp9parse->parser);
+    vp9parse->parser = NULL;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_vp9_parse_event (GstBaseParse * parse, GstEvent * event)
+{
+  GstVp9Parse *vp9parse = GST_VP9_PARSE (parse);
+  gboolean res;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    gst_vp9_parse_reset_split (vp9parse);
+
+  res = GST_BASE_PARSE_CLASS (parent_class)->sink_event (parse, event);
+
+  return res;
+}
+
+static GstVp9ParseAlignment
+gst_vp9_parse_alignment_from_caps (GstCaps * caps)
+{
+  const gchar *str;
+
+  if (caps == NULL || gst_caps_is_empty (caps))
+    return GST_VP9_PARSE_ALIGN_NONE;
+
+  str = gst_structure_get_string (gst_caps_get_structure (caps, 0),
+      "alignment");
+  if (g_strcmp0 (str, "super-frame") == 0)
+    return GST_VP9_PARSE_ALIGN_SUPER_FRAME;
+  if (g_strcmp0 (str, "frame") == 0)
+    return GST_VP9_PARSE_ALIGN_FRAME;
+
+  return GST_VP9_PARSE_ALIGN_NONE;
+}
+
+static gboolean
+gst_vp9_parse_set_sink_caps (GstBaseParse * parse, GstCaps * caps)
+{
+  GstVp9Parse *vp9parse = GST_VP9_PARSE (parse);
+
+  GST_DEBUG_OBJECT (vp9parse, "sink caps %" GST_PTR_FORMAT, caps);
+
+  vp9parse->in_align = gst_vp9_parse_alignment_from_caps (caps);
+  vp9parse->align = GST_VP9_PARSE_ALIGN_NONE;
+  vp9parse->update_caps = TRUE;
+
+  return TRUE;
+}
+
+/* keeps superframes unless downstream only handles frames */
+static void
+gst_vp9_parse_negotiate (GstVp9Parse * vp9parse)
+{
+  GstCaps *caps;
+  GstVp9ParseAlignment align = GST_VP9_PARSE_ALIGN_NONE;
+
+  caps = gst_pad_get_allowed_caps (GST_BASE_PARSE_SRC_PAD (vp9parse));
+  GST_DEBUG_OBJECT (vp9parse, "allowed caps %" GST_PTR_FORMAT, caps);
+
+  if (caps) {
+    if (!gst_caps_is_empty (caps)) {
+      caps = gst_caps_fixate (caps);
+      align = gst_vp9_parse_alignment_from_caps (caps);
+    }
+    gst_caps_unref (caps);
+  }
+
+  if (align == GST_VP9_PARSE_ALIGN_NONE)
+    align = GST_VP9_PARSE_ALIGN_SUPER_FRAME;
+
+  /* frames can't be merged back into superframes */
+  if (vp9parse->in_align == GST_VP9_PARSE_ALIGN_FRAME)
+    align = GST_VP9_PARSE_ALIGN_FRAME;
+
+  GST_DEBUG_OBJECT (vp9parse, "output %s",
+      align == GST_VP9_PARSE_ALIGN_FRAME ? "frames" : "superframes");
+
+  if (align != vp9parse->align)
+    vp9parse->update_caps = TRUE;
+  vp9parse->align = align;
+}
+
+static const gchar *
+gst_vp9_parse_get_chroma_format (GstVp9Parse * vp9parse)
+{
+  if (vp9parse->subsampling_x == 1 && vp9parse->subsampling_y == 1)
+    return "4:2:0";
+  if (vp9parse->subsampling_x == 1 && vp9parse->subsampling_y == 0)
+    return "4:2:2";
+  if (vp9parse->subsampling_x == 0 && vp9parse->subsampling_y == 1)
+    return "4:4:0";
+  if (vp9parse->subsampling_x == 0 && vp9parse->subsampling_y == 0)
+    return "4:4:4";
+
+  return NULL;
+}
+
+static gboolean
+gst_vp9_parse_update_src_caps (GstVp9Parse * vp9parse)
+{
+  static const gchar *profiles[] = { "0", "1", "2", "3" };
+  GstCaps *caps, *sink_caps;
+  const gchar *chroma_format;
+  gboolean ret;
+
+  caps = gst_caps_new_simple ("video/x-vp9",
+      "parsed", G_TYPE_BOOLEAN, TRUE,
+      "alignment", G_TYPE_STRING,
+      vp9parse->align == GST_VP9_PARSE_ALIGN_FRAME ? "frame" : "super-frame",
+      NULL);
+
+  sink_caps = gst_pad_get_current_caps (GST_BASE_PARSE_SINK_PAD (vp9parse));
+  if (sink_caps) {
+    GstStructure *s = gst_caps_get_structure (sink_caps, 0);
+    gint num, denom;
+
+    if (gst_structure_get_fraction (s, "framerate", &num, &denom))
+      gst_caps_set_simple (caps, "framerate", GST_TYPE_FRACTION, num, denom,
+          NULL);
+    if (gst_structure_get_fraction (s, "pixel-aspect-ratio", &num, &denom))
+      gst_caps_set_simple (caps, "pixel-aspect-ratio", GST_TYPE_FRACTION,
+          num, denom, NULL);
+
+    gst_caps_unref (sink_caps);
+  }
+
+  if (vp9parse->width > 0 && vp9parse->height > 0)
+    gst_caps_set_simple (caps, "width", G_TYPE_INT, vp9parse->width,
+        "height", G_TYPE_INT, vp9parse->height, NULL);
+
+  if (vp9parse->profile < GST_VP9_PROFILE_UNDEFINED)
+    gst_caps_set_simple (caps, "profile", G_TYPE_STRING,
+        profiles[vp9parse->profile], NULL);
+
+  if (vp9parse->bit_depth > 0)
+    gst_caps_set_simple (caps, "bit-depth-luma", G_TYPE_UINT,
+        vp9parse->bit_depth, "bit-depth-chroma", G_TYPE_UINT,
+        vp9parse->bit_depth, NULL);
+
+  chroma_format = gst_vp9_parse_get_chroma_format (vp9parse);
+  if (chroma_format)
+    gst_caps_set_simple (caps, "chroma-format", G_TYPE_STRING, chroma_format,
+        NULL);
+
+  GST_DEBUG_OBJECT (vp9parse, "setting caps %" GST_PTR_FORMAT, caps);
+
+  ret = gst_pad_set_caps (GST_BASE_PARSE_SRC_PAD (vp9parse), caps);
+  gst_caps_unref (caps);
+
+  vp9parse->update_caps = FALSE;
+
+  return ret;
+}
+
+/* Parses the superframe index at the end of @data, see Annex B of the VP9
+ * bitstream specification. Data without an index is a single frame.
+ * Returns FALSE if the index is corrupted. */
+static gboolean
+gst_vp9_parse_superframe_index (GstVp9Parse * vp9parse, const guint8 * data,
+    gsize size, guint * n_frames, guint * sizes, guint * index_size)
+{
+  const guint8 *index;
+  guint8 marker;
+  guint frames, mag, total, i, j;
+
+  marker = data[size - 1];
+  frames = (marker & 0x7) + 1;
+  mag = ((marker >> 3) & 0x3) + 1;
+  *index_size = 2 + mag * frames;
+
+  /* the index starts and ends with the same marker byte */
+  if ((marker & 0xe0) != 0xc0 || size < *index_size
+      || data[size - *index_size] != marker) {
+    *n_frames = 1;
+    sizes[0] = size;
+    *index_size = 0;
+    return TRUE;
+  }
+
+  index = data + size - *index_size + 1;
+  total = 0;
+
+  for (i = 0; i < frames; i++) {
+    guint frame_size = 0;
+
+    for (j = 0; j < mag; j++)
+      frame_size |= ((guint) index[j]) << (j * 8);
+    index += mag;
+
+    if (frame_size == 0 || frame_size > size - *index_size - total) {
+      GST_WARNING_OBJECT (vp9parse, "invalid size %u for frame %u of %u",
+          frame_size, i, frames);
+      return FALSE;
+    }
+
+    sizes[i] = frame_size;
+    total += frame_size;
+  }
+
+  *n_frames = frames;
+
+  return TRUE;
+}
+
+static void
+gst_vp9_parse_update_stream_info (GstVp9Parse * vp9parse,
+    GstVp9FrameHdr * frame_hdr)
+{
+  GstVp9Parser *parser = vp9parse->parser;
+
+  if (vp9parse->width != frame_hdr->width
+      || vp9parse->height != frame_hdr->height
+      || vp9parse->profile != frame_hdr->profile
+      || vp9parse->bit_depth != parser->bit_depth
+      || vp9parse->subsampling_x != parser->subsampling_x
+      || vp9parse->subsampling_y != parser->subsampling_y) {
+    GST_INFO_OBJECT (vp9parse, "%ux%u, profile %u, %u bits, subsampling %d/%d",
+        frame_hdr->width, frame_hdr->height, frame_hdr->profile,
+        parser->bit_depth, parser->subsampling_x, parser->subsampling_y);
+
+    vp9parse->width = frame_hdr->width;
+    vp9parse->height = frame_hdr->height;
+    vp9parse->profile = frame_hdr->profile;
+    vp9parse->bit_depth = parser->bit_depth;
+    vp9parse->subsampling_x = parser->subsampling_x;
+    vp9parse->subsampling_y = parser->subsampling_y;
+    vp9parse->update_caps = TRUE;
+  }
+}
+
+static void
+gst_vp9_parse_set_key_unit (GstBuffer * buffer, gboolean key)
+{
+  if (key)
+    GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  else
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+}
+
+/* outputs the next frame of the superframe being split, the rest of the
+ * superframe stays in the adapter until the following calls */
+static GstFlowReturn
+gst_vp9_parse_finish_split_frame (GstVp9Parse * vp9parse,
+    GstBaseParseFrame * frame, gint * skipsize)
+{
+  guint i = vp9parse->cur_frame;
+  guint size = vp9parse->frame_sizes[i];
+  guint needed = size;
+  GstBuffer *buffer;
+
+  if (i == vp9parse->n_frames - 1)
+    needed += vp9parse->trailing;
+
+  /* the rest of the superframe was lost, e.g. by a discontinuity */
+  if (gst_buffer_get_size (frame->buffer) < needed) {
+    GST_ELEMENT_WARNING (vp9parse, STREAM, DECODE, (NULL),
+        ("Dropping truncated superframe, frame %u of %u is missing", i + 1,
+            vp9parse->n_frames));
+    *skipsize = gst_buffer_get_size (frame->buffer);
+    gst_vp9_parse_reset_split (vp9parse);
+    return GST_FLOW_OK;
+  }
+
+  /* shares the memory of the superframe */
+  buffer = gst_buffer_copy_region (frame->buffer, GST_BUFFER_COPY_ALL, 0, size);
+
+  GST_BUFFER_DTS (buffer) = vp9parse->dts;
+  if (vp9parse->frame_shown[i]) {
+    GST_BUFFER_PTS (buffer) = vp9parse->pts;
+    GST_BUFFER_DURATION (buffer) = vp9parse->duration;
+    GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+  } else {
+    GST_BUFFER_PTS (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+  }
+  gst_vp9_parse_set_key_unit (buffer, vp9parse->frame_key[i]);
+
+  GST_LOG_OBJECT (vp9parse, "frame %u of %u, %u bytes, %s", i + 1,
+      vp9parse->n_frames, size, vp9parse->frame_shown[i] ? "shown" : "hidden");
+
+  frame->out_buffer = buffer;
+
+  /* the last frame also consumes the superframe index */
+  vp9parse->cur_frame++;
+  if (vp9parse->cur_frame == vp9parse->n_frames)
+    gst_vp9_parse_reset_split (vp9parse);
+
+  return gst_base_parse_finish_frame (GST_BASE_PARSE (vp9parse), frame,
+      needed);
+}
+
+static GstFlowReturn
+gst_vp9_parse_handle_frame (GstBaseParse * parse,
+    GstBaseParseFrame * frame, gint * skipsize)
+{
+  GstVp9Parse *vp9parse = GST_VP9_PARSE (parse);
+  GstBuffer *buffer = frame->buffer;
+  GstVp9FrameHdr frame_hdr;
+  GstMapInfo map;
+  guint sizes[GST_VP9_PARSE_MAX_FRAMES];
+  gboolean shown[GST_VP9_PARSE_MAX_FRAMES];
+  gboolean key[GST_VP9_PARSE_MAX_FRAMES];
+  guint n_frames, index_size, offset, i;
+  gboolean any_shown = FALSE;
+
+  if (vp9parse->n_frames > 0)
+    return gst_vp9_parse_finish_split_frame (vp9parse, frame, skipsize);
+
+  if (vp9parse->align == GST_VP9_PARSE_ALIGN_NONE)
+    gst_vp9_parse_negotiate (vp9parse);
+
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+
+  if (!gst_vp9_parse_superframe_index (vp9parse, map.data, map.size,
+          &n_frames, sizes, &index_size))
+    goto invalid;
+
+  for (i = 0, offset = 0; i < n_frames; offset += sizes[i], i++) {
+    if (gst_vp9_parser_parse_frame_header (vp9parse->parser, &frame_hdr,
+            map.data + offset, sizes[i]) != GST_VP9_PARSER_OK) {
+      GST_WARNING_OBJECT (vp9parse, "failed to parse header of frame %u", i);
+      goto invalid;
+    }
+
+    if (frame_hdr.show_existing_frame) {
+      shown[i] = TRUE;
+      key[i] = FALSE;
+    } else {
+      shown[i] = frame_hdr.show_frame;
+      key[i] = frame_hdr.frame_type == GST_VP9_KEY_FRAME;
+      if (key[i] || frame_hdr.intra_only)
+        gst_vp9_parse_update_stream_info (vp9parse, &frame_hdr);
+    }
+    any_shown |= shown[i];
+  }
+
+  gst_buffer_unmap (buffer, &map);
+
+  if (vp9parse->update_caps && !gst_vp9_parse_update_src_caps (vp9parse))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  if (index_size > 0 && vp9parse->align == GST_VP9_PARSE_ALIGN_FRAME) {
+    vp9parse->n_frames = n_frames;
+    vp9parse->cur_frame = 0;
+    memcpy (vp9parse->frame_sizes, sizes, n_frames * sizeof (guint));
+    memcpy (vp9parse->frame_shown, shown, n_frames * sizeof (gboolean));
+    memcpy (vp9parse->frame_key, key, n_frames * sizeof (gboolean));
+    vp9parse->trailing = map.size - offset;
+    vp9parse->pts = GST_BUFFER_PTS (buffer);
+    vp9parse->dts = GST_BUFFER_DTS (buffer);
+    vp9parse->duration = GST_BUFFER_DURATION (buffer);
+
+    return gst_vp9_parse_finish_split_frame (vp9parse, frame, skipsize);
+  }
+
+  /* a superframe is decodable on its own if it starts with a key frame */
+  gst_vp9_parse_set_key_unit (buffer, key[0]);
+  if (!any_shown)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY);
+
+  return gst_base_parse_finish_frame (parse, frame, map.size);
+
+invalid:
+  GST_ELEMENT_WARNING (vp9parse, STREAM, DECODE, (NULL),
+      ("Dropping invalid VP9 frame of %" G_GSIZE_FORMAT " bytes", map.size));
+  *skipsize = map.size;
+  gst_buffer_unmap (buffer, &map);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_vp9_parse_pre_push_frame (GstBaseParse * parse, GstBaseParseFrame * frame)
+{
+  GstVp9Parse *vp9parse = GST_VP9_PARSE (parse);
+
+  if (!vp9parse->sent_codec_tag) {
+    GstTagList *taglist;
+    GstCaps *caps;
+
+    /* codec tag */
+    caps = gst_pad_get_current_caps (GST_BASE_PARSE_SRC_PAD (parse));
+    if (G_UNLIKELY (caps == NULL)) {
+      if (GST_PAD_IS_FLUSHING (GST_BASE_PARSE_SRC_PAD (parse))) {
+        GST_INFO_OBJECT (parse, "Src pad is flushing");
+        return GST_FLOW_FLUSHING;
+      } else {
+        GST_INFO_OBJECT (parse, "Src pad is not negotiated!");
+        return GST_FLOW_NOT_NEGOTIATED;
+      }
+    }
+
+    taglist = gst_tag_list_new_empty ();
+    gst_pb_utils_add_codec_description_to_tag_list (taglist,
+        GST_TAG_VIDEO_CODEC, caps);
+    gst_caps_unref (caps);
+
+    gst_base_parse_merge_tags (parse, taglist, GST_TAG_MERGE_REPLACE);
+    gst_tag_list_unref (taglist);
+
+    /* also signals the end of first-frame processing */
+    vp9parse->sent_codec_tag = TRUE;
+  }
+
+  return GST_FLOW_OK;
+}
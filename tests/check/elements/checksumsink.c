@@ -0,0 +1,250 @@
+/* GStreamer
+ *
+ * unit test for checksumsink
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+/* checksumsink prints one line per buffer with g_print() */
+static GPtrArray *lines;
+
+static void
+print_func (const gchar * string)
+{
+  g_ptr_array_add (lines, g_strchomp (g_strdup (string)));
+}
+
+static void
+setup (void)
+{
+  lines = g_ptr_array_new_with_free_func (g_free);
+  g_set_print_handler (print_func);
+}
+
+static void
+teardown (void)
+{
+  g_set_print_handler (NULL);
+  g_ptr_array_unref (lines);
+  lines = NULL;
+}
+
+static GstBuffer *
+create_buffer (const guint8 * data, gsize size, GstClockTime pts)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_fill (buffer, 0, data, size);
+  GST_BUFFER_PTS (buffer) = pts;
+
+  return buffer;
+}
+
+static void
+push_hello (GstHarness * h)
+{
+  fail_unless_equals_int (gst_harness_push (h,
+          create_buffer ((const guint8 *) "hello", 5, 0)), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+}
+
+GST_START_TEST (test_sha1)
+{
+  GstHarness *h = gst_harness_new ("checksumsink");
+
+  gst_harness_set_src_caps_str (h, "application/x-test");
+  push_hello (h);
+
+  fail_unless_equals_int (lines->len, 1);
+  fail_unless_equals_string (g_ptr_array_index (lines, 0),
+      "0:00:00.000000000 aaf4c61ddcc5e8a2dabede0f3b482cd9aea9434d");
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_xxh64)
+{
+  GstHarness *h = gst_harness_new ("checksumsink");
+
+  gst_util_set_object_arg (G_OBJECT (h->element), "hash", "xxh64");
+  gst_harness_set_src_caps_str (h, "application/x-test");
+  push_hello (h);
+
+  fail_unless_equals_int (lines->len, 1);
+  fail_unless_equals_string (g_ptr_array_index (lines, 0),
+      "0:00:00.000000000 26c7827d889f6da3");
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* GRAY8 3x2 frames have a stride of 4, the padding byte must not be hashed */
+static const guint8 gray_frame[8] = { 1, 2, 3, 0xaa, 4, 5, 6, 0xbb };
+static const guint8 gray_frame_padded[8] = { 1, 2, 3, 0x11, 4, 5, 6, 0x22 };
+
+GST_START_TEST (test_plane_checksum)
+{
+  GstHarness *h = gst_harness_new ("checksumsink");
+  GChecksum *checksum;
+  gchar *expected;
+  const guint8 visible[6] = { 1, 2, 3, 4, 5, 6 };
+
+  g_object_set (h->element, "plane-checksum", TRUE, NULL);
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=GRAY8,width=3,height=2,"
+      "framerate=25/1");
+
+  fail_unless_equals_int (gst_harness_push (h,
+          create_buffer (gray_frame, 8, 0)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_buffer (gray_frame_padded, 8, GST_SECOND)), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, visible, sizeof (visible));
+
+  fail_unless_equals_int (lines->len, 2);
+  expected = g_strdup_printf ("0:00:00.000000000 0:%s",
+      g_checksum_get_string (checksum));
+  fail_unless_equals_string (g_ptr_array_index (lines, 0), expected);
+  g_free (expected);
+  expected = g_strdup_printf ("0:00:01.000000000 0:%s",
+      g_checksum_get_string (checksum));
+  fail_unless_equals_string (g_ptr_array_index (lines, 1), expected);
+  g_free (expected);
+
+  g_checksum_free (checksum);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+#define N_FRAMES 32
+
+static void
+push_frames (GstHarness * h)
+{
+  guint8 data[64 * 16];
+  guint i, j;
+
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=GRAY8,width=64,"
+      "height=16,framerate=25/1");
+
+  for (i = 0; i < N_FRAMES; i++) {
+    for (j = 0; j < sizeof (data); j++)
+      data[j] = i * 31 + j;
+    fail_unless_equals_int (gst_harness_push (h, create_buffer (data,
+                sizeof (data), i * GST_SECOND / 25)), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+}
+
+GST_START_TEST (test_threaded_matches_serial)
+{
+  GstHarness *h;
+  GPtrArray *serial;
+  guint i;
+
+  h = gst_harness_new ("checksumsink");
+  g_object_set (h->element, "plane-checksum", TRUE, "tile-width", 16,
+      "tile-height", 8, NULL);
+  push_frames (h);
+  gst_harness_teardown (h);
+
+  serial = lines;
+  lines = g_ptr_array_new_with_free_func (g_free);
+
+  h = gst_harness_new ("checksumsink");
+  g_object_set (h->element, "plane-checksum", TRUE, "tile-width", 16,
+      "tile-height", 8, "max-threads", 4, NULL);
+  push_frames (h);
+  gst_harness_teardown (h);
+
+  /* same checksums, printed in the same order */
+  fail_unless_equals_int (serial->len, N_FRAMES);
+  fail_unless_equals_int (lines->len, N_FRAMES);
+  for (i = 0; i < N_FRAMES; i++)
+    fail_unless_equals_string (g_ptr_array_index (lines, i),
+        g_ptr_array_index (serial, i));
+
+  g_ptr_array_unref (serial);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flush_drops_pending)
+{
+  GstHarness *h = gst_harness_new ("checksumsink");
+  guint8 data[16] = { 0, };
+  guint before_flush, i;
+  GstSegment segment;
+
+  g_object_set (h->element, "max-threads", 1, NULL);
+  gst_harness_set_src_caps_str (h, "application/x-test");
+
+  for (i = 0; i < 8; i++) {
+    data[0] = i;
+    fail_unless_equals_int (gst_harness_push (h,
+            create_buffer (data, sizeof (data), i * GST_SECOND)), GST_FLOW_OK);
+  }
+
+  before_flush = lines->len;
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  /* frames queued before the flush are not printed afterwards */
+  fail_unless_equals_int (lines->len, before_flush);
+
+  fail_unless_equals_int (gst_harness_push (h,
+          create_buffer (data, sizeof (data), 100 * GST_SECOND)), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (lines->len, before_flush + 1);
+  fail_unless (g_str_has_prefix (g_ptr_array_index (lines, before_flush),
+          "0:01:40.000000000 "));
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+checksumsink_suite (void)
+{
+  Suite *s = suite_create ("checksumsink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+
+  tcase_add_test (tc_chain, test_sha1);
+  tcase_add_test (tc_chain, test_xxh64);
+  tcase_add_test (tc_chain, test_plane_checksum);
+  tcase_add_test (tc_chain, test_threaded_matches_serial);
+  tcase_add_test (tc_chain, test_flush_drops_pending);
+
+  return s;
+}
+
+GST_CHECK_MAIN (checksumsink);
@@ -0,0 +1,194 @@
+/* GStreamer
+ *
+ * unit test for fpsdisplaysink
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+static GstElement *fpssink;
+static GstBus *bus;
+static GstHarness *h;
+
+static void
+setup (void)
+{
+  GstElement *video_sink;
+
+  fpssink = gst_element_factory_make ("fpsdisplaysink", NULL);
+  video_sink = gst_element_factory_make ("fakesink", NULL);
+  fail_unless (fpssink != NULL && video_sink != NULL);
+
+  /* the QoS events of the video sink are sent by the tests */
+  g_object_set (video_sink, "qos", FALSE, NULL);
+  g_object_set (fpssink, "video-sink", video_sink, "text-overlay", FALSE,
+      "sync", FALSE, "timing-stats", TRUE, "fps-update-interval", 1, NULL);
+
+  bus = gst_bus_new ();
+  gst_element_set_bus (fpssink, bus);
+
+  h = gst_harness_new_with_element (fpssink, "sink", NULL);
+  gst_harness_set_src_caps_str (h, "video/x-raw,format=GRAY8,width=4,"
+      "height=4,framerate=25/1");
+}
+
+static void
+teardown (void)
+{
+  gst_harness_teardown (h);
+  gst_element_set_bus (fpssink, NULL);
+  gst_object_unref (bus);
+  gst_object_unref (fpssink);
+}
+
+static void
+push_frame (void)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, 16, NULL);
+
+  gst_buffer_memset (buffer, 0, 0, 16);
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+}
+
+/* a video sink reports the jitter of each rendered frame upstream */
+static void
+send_qos (GstClockTimeDiff jitter)
+{
+  GstElement *video_sink;
+  GstPad *pad;
+
+  g_object_get (fpssink, "video-sink", &video_sink, NULL);
+  pad = gst_element_get_static_pad (video_sink, "sink");
+  fail_unless (gst_pad_push_event (pad,
+          gst_event_new_qos (GST_QOS_TYPE_UNDERFLOW, 1.0, jitter, 0)));
+  gst_object_unref (pad);
+  gst_object_unref (video_sink);
+}
+
+/* pushes a frame after the update interval expired, which posts a report
+ * covering everything since the previous one */
+static GstStructure *
+report_timing (void)
+{
+  GstMessage *msg;
+  GstStructure *s;
+
+  /* drop reports of intervals that expired earlier */
+  while ((msg = gst_bus_pop (bus)))
+    gst_message_unref (msg);
+
+  g_usleep (5000);
+  push_frame ();
+
+  while ((msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT))) {
+    if (gst_message_has_name (msg, "fpsdisplaysink-timing")) {
+      s = gst_structure_copy (gst_message_get_structure (msg));
+      gst_message_unref (msg);
+      return s;
+    }
+    gst_message_unref (msg);
+  }
+
+  fail ("no fpsdisplaysink-timing message posted");
+  return NULL;
+}
+
+static guint64
+get_uint64 (const GstStructure * s, const gchar * field)
+{
+  guint64 val = 0;
+
+  fail_unless (gst_structure_get_uint64 (s, field, &val));
+  return val;
+}
+
+GST_START_TEST (test_timing_stats)
+{
+  GstStructure *s;
+
+  push_frame ();
+  send_qos (5 * GST_MSECOND);
+  send_qos (-2 * GST_MSECOND);
+  send_qos (1 * GST_MSECOND);
+
+  s = report_timing ();
+  fail_unless_equals_uint64 (get_uint64 (s, "frames"), 1);
+  fail_unless (get_uint64 (s, "interval-min") >= 5 * GST_MSECOND);
+  fail_unless_equals_uint64 (get_uint64 (s, "interval-min"),
+      get_uint64 (s, "interval-max"));
+  fail_unless_equals_uint64 (get_uint64 (s, "late-frames"), 2);
+  fail_unless_equals_uint64 (get_uint64 (s, "lateness-max"), 5 * GST_MSECOND);
+  /* 0, 1ms and 5ms, percentiles are rounded to the histogram buckets */
+  fail_unless (get_uint64 (s, "lateness-p50") > GST_MSECOND / 2);
+  fail_unless (get_uint64 (s, "lateness-p50") < 2 * GST_MSECOND);
+  gst_structure_free (s);
+
+  /* nothing measured since the last report */
+  s = report_timing ();
+  fail_unless_equals_uint64 (get_uint64 (s, "frames"), 1);
+  fail_unless_equals_uint64 (get_uint64 (s, "late-frames"), 0);
+  fail_unless_equals_uint64 (get_uint64 (s, "lateness-max"),
+      GST_CLOCK_TIME_NONE);
+  fail_unless_equals_uint64 (get_uint64 (s, "lateness-p99"),
+      GST_CLOCK_TIME_NONE);
+  gst_structure_free (s);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flush_resets_timing)
+{
+  GstStructure *s;
+  GstSegment segment;
+
+  push_frame ();
+  send_qos (5 * GST_MSECOND);
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  /* the first frame after the flush does not start an interval */
+  push_frame ();
+  s = report_timing ();
+  fail_unless_equals_uint64 (get_uint64 (s, "frames"), 1);
+  fail_unless_equals_uint64 (get_uint64 (s, "late-frames"), 0);
+  fail_unless_equals_uint64 (get_uint64 (s, "lateness-max"),
+      GST_CLOCK_TIME_NONE);
+  gst_structure_free (s);
+}
+
+GST_END_TEST;
+
+static Suite *
+fpsdisplaysink_suite (void)
+{
+  Suite *s = suite_create ("fpsdisplaysink");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+
+  tcase_add_test (tc_chain, test_timing_stats);
+  tcase_add_test (tc_chain, test_flush_resets_timing);
+
+  return s;
+}
+
+GST_CHECK_MAIN (fpsdisplaysink);
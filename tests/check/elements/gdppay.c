@@ -556,6 +556,78 @@ GST_START_TEST (test_crc)
 
 GST_END_TEST;
 
+/* byte-wise reference implementation of the GDP CRC */
+static guint16
+reference_crc (const guint8 * data, gsize length)
+{
+  guint16 crc_register = CRC_INIT;
+
+  while (length--) {
+    crc_register = (guint16) ((crc_register << 8) ^
+        gst_dp_crc_table[((crc_register >> 8) & 0x00ff) ^ *data++]);
+  }
+
+  return 0xffff ^ crc_register;
+}
+
+GST_START_TEST (test_crc_payload)
+{
+  GstBuffer *inbuffer, *outbuffer;
+  GstMapInfo map, header_map;
+  guint8 *data;
+  gsize size = 1024 * 1024 + 13;
+  guint i, offset;
+
+  data = g_malloc (size);
+  for (i = 0; i < size; i++)
+    data[i] = g_random_int () & 0xff;
+
+  /* split over several memories of odd sizes */
+  inbuffer = gst_buffer_new ();
+  for (offset = 0, i = 0; offset < size; i++) {
+    gsize len = MIN (size - offset, 65536 * i + 7);
+
+    guint8 *chunk = g_memdup (data + offset, len);
+
+    gst_buffer_append_memory (inbuffer,
+        gst_memory_new_wrapped (0, chunk, len, 0, len, chunk, g_free));
+    offset += len;
+  }
+
+  for (i = 0; i < 64; i++)
+    fail_unless_equals_int (gst_dp_crc (data + i, size - i),
+        reference_crc (data + i, size - i));
+
+  outbuffer = gst_dp_payload_buffer (inbuffer, GST_DP_HEADER_FLAG_CRC);
+  fail_unless_equals_int (gst_buffer_get_size (outbuffer),
+      GST_DP_HEADER_LENGTH + size);
+
+  /* the payload memories are shared, not copied */
+  fail_unless_equals_int (gst_buffer_n_memory (outbuffer),
+      gst_buffer_n_memory (inbuffer) + 1);
+  for (i = 0; i < gst_buffer_n_memory (inbuffer); i++)
+    fail_unless (gst_buffer_peek_memory (outbuffer, i + 1) ==
+        gst_buffer_peek_memory (inbuffer, i));
+
+  gst_memory_map (gst_buffer_peek_memory (outbuffer, 0), &header_map,
+      GST_MAP_READ);
+  fail_unless_equals_int (GST_DP_HEADER_CRC_PAYLOAD (header_map.data),
+      reference_crc (data, size));
+  fail_unless (gst_dp_validate_header (header_map.size, header_map.data));
+
+  gst_buffer_map (inbuffer, &map, GST_MAP_READ);
+  fail_unless (gst_dp_validate_payload (header_map.size, header_map.data,
+          map.data));
+  gst_buffer_unmap (inbuffer, &map);
+  gst_memory_unmap (gst_buffer_peek_memory (outbuffer, 0), &header_map);
+
+  gst_buffer_unref (outbuffer);
+  gst_buffer_unref (inbuffer);
+  g_free (data);
+}
+
+GST_END_TEST;
+
 
 static Suite *
 gdppay_suite (void)
@@ -569,6 +641,7 @@ gdppay_suite (void)
   tcase_add_test (tc_chain, test_first_no_new_segment);
   tcase_add_test (tc_chain, test_streamheader);
   tcase_add_test (tc_chain, test_crc);
+  tcase_add_test (tc_chain, test_crc_payload);
 
   return s;
 }
@@ -24,6 +24,7 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
 #include "parser.h"
 
 #define SRC_CAPS_TMPL   "video/x-h264, parsed=(boolean)false"
@@ -415,6 +416,340 @@ h264parse_packetized_suite (void)
   return s;
 }
 
+GST_START_TEST (test_parse_bs_to_avc_short_start_codes)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint8 *data;
+  gsize size;
+  const guint idr_size = sizeof (h264_idrframe) - 4;
+
+  h = gst_harness_new ("h264parse");
+  gst_harness_set_src_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) au");
+  gst_harness_set_sink_caps_str (h, "video/x-h264, "
+      "stream-format = (string) avc, alignment = (string) au");
+
+  /* the slice has a 3 byte start code, which can't be rewritten in place */
+  size = sizeof (h264_sps) + sizeof (h264_pps) + 3 + idr_size;
+  data = g_malloc (size);
+  memcpy (data, h264_sps, sizeof (h264_sps));
+  memcpy (data + sizeof (h264_sps), h264_pps, sizeof (h264_pps));
+  GST_WRITE_UINT24_BE (data + sizeof (h264_sps) + sizeof (h264_pps), 1);
+  memcpy (data + size - idr_size, h264_idrframe + 4, idr_size);
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_wrapped (data, size)), GST_FLOW_OK);
+
+  buf = gst_harness_pull (h);
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, size + 1);
+  data = map.data;
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), sizeof (h264_sps) - 4);
+  fail_unless (memcmp (data + 4, h264_sps + 4, sizeof (h264_sps) - 4) == 0);
+  data += sizeof (h264_sps);
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), sizeof (h264_pps) - 4);
+  fail_unless (memcmp (data + 4, h264_pps + 4, sizeof (h264_pps) - 4) == 0);
+  data += sizeof (h264_pps);
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), idr_size);
+  fail_unless (memcmp (data + 4, h264_idrframe + 4, idr_size) == 0);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_bs_to_avc_long_start_codes)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint8 *data;
+  gsize size;
+
+  h = gst_harness_new ("h264parse");
+  gst_harness_set_src_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) au");
+  gst_harness_set_sink_caps_str (h, "video/x-h264, "
+      "stream-format = (string) avc, alignment = (string) au");
+
+  /* 4 byte start codes are replaced by the length prefixes */
+  size = sizeof (h264_sps) + sizeof (h264_pps) + sizeof (h264_idrframe);
+  data = g_malloc (size);
+  memcpy (data, h264_sps, sizeof (h264_sps));
+  memcpy (data + sizeof (h264_sps), h264_pps, sizeof (h264_pps));
+  memcpy (data + sizeof (h264_sps) + sizeof (h264_pps), h264_idrframe,
+      sizeof (h264_idrframe));
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_wrapped (data, size)), GST_FLOW_OK);
+
+  buf = gst_harness_pull (h);
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size, size);
+  data = map.data;
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), sizeof (h264_sps) - 4);
+  fail_unless (memcmp (data + 4, h264_sps + 4, sizeof (h264_sps) - 4) == 0);
+  data += sizeof (h264_sps);
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), sizeof (h264_pps) - 4);
+  fail_unless (memcmp (data + 4, h264_pps + 4, sizeof (h264_pps) - 4) == 0);
+  data += sizeof (h264_pps);
+  fail_unless_equals_int (GST_READ_UINT32_BE (data),
+      sizeof (h264_idrframe) - 4);
+  fail_unless (memcmp (data + 4, h264_idrframe + 4,
+          sizeof (h264_idrframe) - 4) == 0);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static void
+set_avc_src_caps (GstHarness * h)
+{
+  GstBuffer *cdata;
+  GstCaps *caps;
+
+  cdata = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      h264_avc_codec_data, sizeof (h264_avc_codec_data), 0,
+      sizeof (h264_avc_codec_data), NULL, NULL);
+  caps = gst_caps_new_simple ("video/x-h264", "stream-format", G_TYPE_STRING,
+      "avc", "alignment", G_TYPE_STRING, "au", "codec_data", GST_TYPE_BUFFER,
+      cdata, NULL);
+  gst_harness_set_src_caps (h, caps);
+  gst_buffer_unref (cdata);
+}
+
+/* replaces the start code of each nal with its length */
+static void
+write_avc_nal (guint8 * dest, const guint8 * nal, gsize size)
+{
+  GST_WRITE_UINT32_BE (dest, size - 4);
+  memcpy (dest + 4, nal + 4, size - 4);
+}
+
+GST_START_TEST (test_parse_avc_to_bs)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  guint8 *data;
+
+  h = gst_harness_new ("h264parse");
+  set_avc_src_caps (h);
+  gst_harness_set_sink_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) au");
+
+  data = g_malloc (sizeof (h264_idrframe));
+  write_avc_nal (data, h264_idrframe, sizeof (h264_idrframe));
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_wrapped (data, sizeof (h264_idrframe))), GST_FLOW_OK);
+
+  /* the parameter sets of the codec_data go in front of the IDR */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf),
+      sizeof (h264_sps) + sizeof (h264_pps) + sizeof (h264_idrframe));
+  fail_unless (gst_buffer_memcmp (buf, 0, h264_sps, sizeof (h264_sps)) == 0);
+  fail_unless (gst_buffer_memcmp (buf, sizeof (h264_sps), h264_pps,
+          sizeof (h264_pps)) == 0);
+  fail_unless (gst_buffer_memcmp (buf, sizeof (h264_sps) + sizeof (h264_pps),
+          h264_idrframe, sizeof (h264_idrframe)) == 0);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_avc_split_to_bs)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  guint8 *data;
+  gsize size;
+
+  h = gst_harness_new ("h264parse");
+  set_avc_src_caps (h);
+  gst_harness_set_sink_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) nal");
+
+  /* an AU with in-band parameter sets is split into its nals */
+  size = sizeof (h264_sps) + sizeof (h264_pps) + sizeof (h264_idrframe);
+  data = g_malloc (size);
+  write_avc_nal (data, h264_sps, sizeof (h264_sps));
+  write_avc_nal (data + sizeof (h264_sps), h264_pps, sizeof (h264_pps));
+  write_avc_nal (data + sizeof (h264_sps) + sizeof (h264_pps), h264_idrframe,
+      sizeof (h264_idrframe));
+  fail_unless_equals_int (gst_harness_push (h,
+          gst_buffer_new_wrapped (data, size)), GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 3);
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h264_sps));
+  fail_unless (gst_buffer_memcmp (buf, 0, h264_sps, sizeof (h264_sps)) == 0);
+  gst_buffer_unref (buf);
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h264_pps));
+  fail_unless (gst_buffer_memcmp (buf, 0, h264_pps, sizeof (h264_pps)) == 0);
+  gst_buffer_unref (buf);
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h264_idrframe));
+  fail_unless (gst_buffer_memcmp (buf, 0, h264_idrframe,
+          sizeof (h264_idrframe)) == 0);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static GstBuffer *
+create_au (GstClockTime pts, gboolean with_config)
+{
+  GstBuffer *buf;
+  gsize offset = 0;
+
+  buf = gst_buffer_new_allocate (NULL, sizeof (h264_idrframe) +
+      (with_config ? sizeof (h264_sps) + sizeof (h264_pps) : 0), NULL);
+  if (with_config) {
+    gst_buffer_fill (buf, offset, h264_sps, sizeof (h264_sps));
+    offset += sizeof (h264_sps);
+    gst_buffer_fill (buf, offset, h264_pps, sizeof (h264_pps));
+    offset += sizeof (h264_pps);
+  }
+  gst_buffer_fill (buf, offset, h264_idrframe, sizeof (h264_idrframe));
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = pts;
+
+  return buf;
+}
+
+GST_START_TEST (test_parse_config_interval)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  gsize offset;
+
+  h = gst_harness_new ("h264parse");
+  g_object_set (h->element, "config-interval", 1, NULL);
+  gst_harness_set_src_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) au");
+  gst_harness_set_sink_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) au");
+
+  fail_unless_equals_int (gst_harness_push (h, create_au (0, TRUE)),
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_au (GST_SECOND / 2, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_au (3 * GST_SECOND / 2, FALSE)), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 3);
+
+  /* the stream starts with its own parameter sets */
+  buf = gst_harness_pull (h);
+  fail_unless (gst_buffer_memcmp (buf, 0, h264_sps, sizeof (h264_sps)) == 0);
+  gst_buffer_unref (buf);
+
+  /* less than the interval since the last ones */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), GST_SECOND / 2);
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h264_idrframe));
+  fail_unless (gst_buffer_memcmp (buf, 0, h264_idrframe,
+          sizeof (h264_idrframe)) == 0);
+  gst_buffer_unref (buf);
+
+  /* the interval expired, SPS and PPS go in front of the IDR */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 3 * GST_SECOND / 2);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_unless_equals_int (gst_buffer_get_size (buf),
+      sizeof (h264_sps) + sizeof (h264_pps) + sizeof (h264_idrframe));
+  offset = 0;
+  fail_unless (gst_buffer_memcmp (buf, offset, h264_sps,
+          sizeof (h264_sps)) == 0);
+  offset += sizeof (h264_sps);
+  fail_unless (gst_buffer_memcmp (buf, offset, h264_pps,
+          sizeof (h264_pps)) == 0);
+  offset += sizeof (h264_pps);
+  fail_unless (gst_buffer_memcmp (buf, offset, h264_idrframe,
+          sizeof (h264_idrframe)) == 0);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parse_config_interval_avc)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint8 *data;
+
+  h = gst_harness_new ("h264parse");
+  g_object_set (h->element, "config-interval", 1, NULL);
+  gst_harness_set_src_caps_str (h, "video/x-h264, "
+      "stream-format = (string) byte-stream, alignment = (string) au");
+  gst_harness_set_sink_caps_str (h, "video/x-h264, "
+      "stream-format = (string) avc, alignment = (string) au");
+
+  fail_unless_equals_int (gst_harness_push (h, create_au (0, TRUE)),
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_au (3 * GST_SECOND / 2, FALSE)), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 2);
+  gst_buffer_unref (gst_harness_pull (h));
+
+  /* the inserted parameter sets get length prefixes as well */
+  buf = gst_harness_pull (h);
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  fail_unless_equals_int (map.size,
+      sizeof (h264_sps) + sizeof (h264_pps) + sizeof (h264_idrframe));
+  data = map.data;
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), sizeof (h264_sps) - 4);
+  fail_unless (memcmp (data + 4, h264_sps + 4, sizeof (h264_sps) - 4) == 0);
+  data += sizeof (h264_sps);
+  fail_unless_equals_int (GST_READ_UINT32_BE (data), sizeof (h264_pps) - 4);
+  fail_unless (memcmp (data + 4, h264_pps + 4, sizeof (h264_pps) - 4) == 0);
+  data += sizeof (h264_pps);
+  fail_unless_equals_int (GST_READ_UINT32_BE (data),
+      sizeof (h264_idrframe) - 4);
+  fail_unless (memcmp (data + 4, h264_idrframe + 4,
+          sizeof (h264_idrframe) - 4) == 0);
+  gst_buffer_unmap (buf, &map);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+h264parse_conversion_suite (void)
+{
+  Suite *s = suite_create ("h264parse_conversion");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_bs_to_avc_short_start_codes);
+  tcase_add_test (tc_chain, test_parse_bs_to_avc_long_start_codes);
+  tcase_add_test (tc_chain, test_parse_avc_to_bs);
+  tcase_add_test (tc_chain, test_parse_avc_split_to_bs);
+  tcase_add_test (tc_chain, test_parse_config_interval);
+  tcase_add_test (tc_chain, test_parse_config_interval_avc);
+
+  return s;
+}
+
 
 /*
  * TODO:
@@ -522,5 +857,11 @@ main (int argc, char **argv)
   nf += srunner_ntests_failed (sr);
   srunner_free (sr);
 
+  s = h264parse_conversion_suite ();
+  sr = srunner_create (s);
+  srunner_run_all (sr, CK_NORMAL);
+  nf += srunner_ntests_failed (sr);
+  srunner_free (sr);
+
   return nf;
 }
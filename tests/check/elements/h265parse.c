@@ -0,0 +1,145 @@
+/* GStreamer
+ *
+ * unit test for h265parse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define BS_AU_CAPS "video/x-h265, stream-format = (string) byte-stream, " \
+    "alignment = (string) au"
+
+/* 64x64 main profile parameter sets */
+static const guint8 h265_vps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x40, 0x01, 0x0c, 0x01, 0xff, 0xff, 0x01, 0x60,
+  0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00,
+  0x3c, 0xf0, 0x24
+};
+
+static const guint8 h265_sps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03,
+  0x00, 0x90, 0x00, 0x00, 0x03, 0x00, 0x00, 0x03, 0x00, 0x3c, 0xa0, 0x20,
+  0x81, 0x05, 0x97, 0xea, 0xf0, 0x82
+};
+
+static const guint8 h265_pps[] = {
+  0x00, 0x00, 0x00, 0x01, 0x44, 0x01, 0xc0, 0x71, 0x80, 0x12
+};
+
+/* IDR_W_RADL slice, the slice data is made up */
+static const guint8 h265_idr[] = {
+  0x00, 0x00, 0x00, 0x01, 0x26, 0x01, 0xaf, 0xaf, 0x06, 0xb8, 0x63, 0xef,
+  0x3a, 0x7f, 0x3e, 0x53, 0xff
+};
+
+static GstBuffer *
+create_au (GstClockTime pts, gboolean with_config)
+{
+  GstBuffer *buf;
+  gsize offset = 0;
+
+  buf = gst_buffer_new_allocate (NULL, sizeof (h265_idr) + (with_config ?
+          sizeof (h265_vps) + sizeof (h265_sps) + sizeof (h265_pps) : 0),
+      NULL);
+  if (with_config) {
+    gst_buffer_fill (buf, offset, h265_vps, sizeof (h265_vps));
+    offset += sizeof (h265_vps);
+    gst_buffer_fill (buf, offset, h265_sps, sizeof (h265_sps));
+    offset += sizeof (h265_sps);
+    gst_buffer_fill (buf, offset, h265_pps, sizeof (h265_pps));
+    offset += sizeof (h265_pps);
+  }
+  gst_buffer_fill (buf, offset, h265_idr, sizeof (h265_idr));
+  GST_BUFFER_PTS (buf) = GST_BUFFER_DTS (buf) = pts;
+
+  return buf;
+}
+
+GST_START_TEST (test_parse_config_interval)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  gsize offset;
+
+  h = gst_harness_new ("h265parse");
+  g_object_set (h->element, "config-interval", 1, NULL);
+  gst_harness_set_src_caps_str (h, BS_AU_CAPS);
+  gst_harness_set_sink_caps_str (h, BS_AU_CAPS);
+
+  fail_unless_equals_int (gst_harness_push (h, create_au (0, TRUE)),
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_au (GST_SECOND / 2, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_au (3 * GST_SECOND / 2, FALSE)), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 3);
+
+  /* the stream starts with its own parameter sets */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 0);
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h265_vps) +
+      sizeof (h265_sps) + sizeof (h265_pps) + sizeof (h265_idr));
+  gst_buffer_unref (buf);
+
+  /* less than the interval since the last ones */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), GST_SECOND / 2);
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h265_idr));
+  fail_unless (gst_buffer_memcmp (buf, 0, h265_idr, sizeof (h265_idr)) == 0);
+  gst_buffer_unref (buf);
+
+  /* the interval expired, VPS, SPS and PPS go in front of the IDR */
+  buf = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), 3 * GST_SECOND / 2);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_unless_equals_int (gst_buffer_get_size (buf), sizeof (h265_vps) +
+      sizeof (h265_sps) + sizeof (h265_pps) + sizeof (h265_idr));
+  offset = 0;
+  fail_unless (gst_buffer_memcmp (buf, offset, h265_vps,
+          sizeof (h265_vps)) == 0);
+  offset += sizeof (h265_vps);
+  fail_unless (gst_buffer_memcmp (buf, offset, h265_sps,
+          sizeof (h265_sps)) == 0);
+  offset += sizeof (h265_sps);
+  fail_unless (gst_buffer_memcmp (buf, offset, h265_pps,
+          sizeof (h265_pps)) == 0);
+  offset += sizeof (h265_pps);
+  fail_unless (gst_buffer_memcmp (buf, offset, h265_idr,
+          sizeof (h265_idr)) == 0);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+h265parse_suite (void)
+{
+  Suite *s = suite_create ("h265parse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parse_config_interval);
+
+  return s;
+}
+
+GST_CHECK_MAIN (h265parse);
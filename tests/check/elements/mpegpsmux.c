@@ -0,0 +1,168 @@
+/* GStreamer
+ *
+ * unit test for mpegpsmux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define N_FRAMES 3
+#define FRAME_SIZE 16
+
+/* the stream written for N_FRAMES MPEG-1 video frames 40ms apart, all in
+ * the first pack */
+static const guint8 reference[] = {
+  /* pack header, SCR 0 */
+  0x00, 0x00, 0x01, 0xba, 0x44, 0x00, 0x04, 0x00, 0x04, 0x01, 0x00, 0x10,
+  0x03, 0xf8,
+  /* system header */
+  0x00, 0x00, 0x01, 0xbb, 0x00, 0x09, 0x80, 0x10, 0x01, 0x00, 0x21, 0x7f,
+  0xe0, 0xe1, 0x90,
+  /* program stream map */
+  0x00, 0x00, 0x01, 0xbc, 0x00, 0x0e, 0xe1, 0xff, 0x00, 0x00, 0x00, 0x04,
+  0x01, 0xe0, 0x00, 0x00, 0xc6, 0xa8, 0x80, 0x52,
+  /* PES header, PTS 0 */
+  0x00, 0x00, 0x01, 0xe0, 0x00, 0x18, 0x81, 0x80, 0x05, 0x21, 0x00, 0x01,
+  0x00, 0x01,
+  /* payload */
+  0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0,
+  0xa0, 0xa0, 0xa0, 0xa0,
+  /* PES header, PTS 3600 */
+  0x00, 0x00, 0x01, 0xe0, 0x00, 0x18, 0x81, 0x80, 0x05, 0x21, 0x00, 0x01,
+  0x1c, 0x21,
+  /* payload */
+  0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1, 0xa1,
+  0xa1, 0xa1, 0xa1, 0xa1,
+  /* PES header, PTS 7200 */
+  0x00, 0x00, 0x01, 0xe0, 0x00, 0x18, 0x81, 0x80, 0x05, 0x21, 0x00, 0x01,
+  0x38, 0x41,
+  /* payload */
+  0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2, 0xa2,
+  0xa2, 0xa2, 0xa2, 0xa2,
+  /* program end code */
+  0x00, 0x00, 0x01, 0xb9
+};
+
+static GstHarness *
+setup_psmux (gboolean aggregate_gops)
+{
+  GstHarness *h = gst_harness_new_with_padnames ("mpegpsmux", "sink_0", "src");
+
+  g_object_set (h->element, "aggregate-gops", aggregate_gops, NULL);
+  gst_harness_set_src_caps_str (h,
+      "video/mpeg,mpegversion=1,systemstream=false");
+
+  return h;
+}
+
+/* every other frame is a keyframe */
+static void
+push_frame (GstHarness * h, guint n)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, FRAME_SIZE, NULL);
+
+  gst_buffer_memset (buffer, 0, 0xa0 + n, FRAME_SIZE);
+  GST_BUFFER_PTS (buffer) = n * 40 * GST_MSECOND;
+  if (n % 2)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+}
+
+static void
+check_output (GstHarness * h)
+{
+  static const guint8 end_code[] = { 0x00, 0x00, 0x01, 0xb9 };
+  GByteArray *output = g_byte_array_new ();
+  GstBuffer *buffer;
+  GstMapInfo map;
+
+  while ((buffer = gst_harness_try_pull (h))) {
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    g_byte_array_append (output, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+  }
+
+  fail_unless_equals_int (output->len, sizeof (reference));
+  fail_unless (memcmp (output->data, reference, sizeof (reference)) == 0);
+  fail_unless (memcmp (output->data + output->len - sizeof (end_code),
+          end_code, sizeof (end_code)) == 0);
+
+  g_byte_array_unref (output);
+}
+
+GST_START_TEST (test_packets)
+{
+  GstHarness *h = setup_psmux (FALSE);
+  guint i;
+
+  /* the pack header, system header, program stream map, then the PES
+   * header and payload of each frame come out as separate buffers, in one
+   * push per frame */
+  for (i = 0; i < N_FRAMES; i++) {
+    push_frame (h, i);
+    fail_unless_equals_int (gst_harness_buffers_received (h), 5 + 2 * i);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 4 + 2 * N_FRAMES);
+
+  check_output (h);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_aggregate_gops)
+{
+  GstHarness *h = setup_psmux (TRUE);
+
+  /* the first GOP goes out when the second one starts */
+  push_frame (h, 0);
+  push_frame (h, 1);
+  fail_unless_equals_int (gst_harness_buffers_received (h), 0);
+  push_frame (h, 2);
+  fail_unless_equals_int (gst_harness_buffers_received (h), 7);
+
+  /* and the last one at EOS, with the program end code */
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_received (h), 4 + 2 * N_FRAMES);
+
+  check_output (h);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+mpegpsmux_suite (void)
+{
+  Suite *s = suite_create ("mpegpsmux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, test_packets);
+  tcase_add_test (tc_chain, test_aggregate_gops);
+
+  return s;
+}
+
+GST_CHECK_MAIN (mpegpsmux);
@@ -803,6 +803,151 @@ GST_START_TEST (test_keyframe_flag_propagation)
 
 GST_END_TEST;
 
+GST_START_TEST (test_cbr)
+{
+  GstElement *mux;
+  gchar *padname;
+  GstCaps *caps;
+  GList *l;
+  gint64 first_pcr = -1, last_pcr = -1;
+  guint64 offset = 0, first_pcr_offset = 0;
+  guint n_null = 0;
+  gint i;
+
+  mux = setup_tsmux (&audio_src_template, "sink_%d", &padname);
+  g_object_set (mux, "bitrate", (guint64) 1000000, NULL);
+
+  fail_unless (gst_element_set_state (mux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (AUDIO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, mux, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  for (i = 0; i < 25; i++) {
+    GstBuffer *inbuffer = gst_buffer_new_and_alloc (100);
+
+    GST_BUFFER_PTS (inbuffer) = i * 40 * GST_MSECOND;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+
+  for (l = buffers; l; l = l->next) {
+    GstMapInfo map;
+    guint8 *data;
+    gsize size;
+
+    gst_buffer_map (GST_BUFFER (l->data), &map, GST_MAP_READ);
+    fail_unless (map.size % 188 == 0);
+
+    for (data = map.data, size = map.size; size; data += 188, size -= 188) {
+      guint pid = GST_READ_UINT16_BE (data + 1) & 0x1FFF;
+      guint64 pcr_base;
+      gint64 pcr, expected;
+
+      fail_unless (data[0] == 0x47);
+      if (pid == 0x1FFF)
+        n_null++;
+
+      if ((data[3] & 0x20) && data[4] > 0 && (data[5] & 0x10)) {
+        pcr_base = ((guint64) GST_READ_UINT32_BE (data + 6) << 1) |
+            (data[10] >> 7);
+        pcr = pcr_base * 300 + (((data[10] & 0x01) << 8) | data[11]);
+
+        if (first_pcr == -1) {
+          first_pcr = pcr;
+          first_pcr_offset = offset;
+        } else {
+          /* the PCR follows the byte position */
+          expected = first_pcr + gst_util_uint64_scale (offset -
+              first_pcr_offset, 8 * 27000000, 1000000);
+          fail_unless (ABS (pcr - expected) <= 1,
+              "PCR %" G_GINT64_FORMAT " expected %" G_GINT64_FORMAT, pcr,
+              expected);
+          /* every 40ms, give or take a packet */
+          fail_unless (pcr - last_pcr <= 27000000 / 25 + 188 * 8 * 27);
+        }
+        last_pcr = pcr;
+      }
+      offset += 188;
+    }
+    gst_buffer_unmap (GST_BUFFER (l->data), &map);
+  }
+
+  fail_unless (n_null > 0);
+  /* 25 buffers of 40ms at 1Mbit/s */
+  fail_unless (last_pcr - first_pcr >= 27000000 * 9 / 10);
+  fail_unless (last_pcr - first_pcr <= 27000000);
+
+  gst_check_drop_buffers ();
+  cleanup_tsmux (mux, padname);
+  g_free (padname);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_cbr_gap)
+{
+  GstElement *mux;
+  gchar *padname;
+  GstCaps *caps;
+  GList *l;
+  gint64 first_pcr = -1, last_pcr = -1;
+  gsize total = 0;
+  gint i;
+
+  mux = setup_tsmux (&audio_src_template, "sink_%d", &padname);
+  g_object_set (mux, "bitrate", (guint64) 1000000, NULL);
+
+  fail_unless (gst_element_set_state (mux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (AUDIO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, mux, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  /* a jump of an hour between the second and the third buffer */
+  for (i = 0; i < 4; i++) {
+    GstBuffer *inbuffer = gst_buffer_new_and_alloc (100);
+
+    GST_BUFFER_PTS (inbuffer) = i * 40 * GST_MSECOND;
+    if (i >= 2)
+      GST_BUFFER_PTS (inbuffer) += 3600 * GST_SECOND;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+
+  for (l = buffers; l; l = l->next) {
+    GstMapInfo map;
+    guint8 *data;
+    gsize size;
+
+    gst_buffer_map (GST_BUFFER (l->data), &map, GST_MAP_READ);
+    for (data = map.data, size = map.size; size; data += 188, size -= 188) {
+      if ((data[3] & 0x20) && data[4] > 0 && (data[5] & 0x10)) {
+        guint64 pcr_base = ((guint64) GST_READ_UINT32_BE (data + 6) << 1) |
+            (data[10] >> 7);
+
+        last_pcr = pcr_base * 300 + (((data[10] & 0x01) << 8) | data[11]);
+        if (first_pcr == -1)
+          first_pcr = last_pcr;
+      }
+    }
+    total += map.size;
+    gst_buffer_unmap (GST_BUFFER (l->data), &map);
+  }
+
+  /* the gap is not stuffed, the byte clock restarts at the new timestamp */
+  fail_unless (total < 1000000 / 8);
+  fail_unless (last_pcr - first_pcr >= (gint64) 27000000 * 3600);
+
+  gst_check_drop_buffers ();
+  cleanup_tsmux (mux, padname);
+  g_free (padname);
+}
+
+GST_END_TEST;
+
 static Suite *
 mpegtsmux_suite (void)
 {
@@ -819,6 +964,8 @@ mpegtsmux_suite (void)
   tcase_add_test (tc_chain, test_multiple_state_change);
   tcase_add_test (tc_chain, test_align);
   tcase_add_test (tc_chain, test_keyframe_flag_propagation);
+  tcase_add_test (tc_chain, test_cbr);
+  tcase_add_test (tc_chain, test_cbr_gap);
 
   return s;
 }
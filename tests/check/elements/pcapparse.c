@@ -2,6 +2,8 @@
 #include <gst/check/gstcheck.h>
 #include <gst/check/gstharness.h>
 
+#include <string.h>
+
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
@@ -115,6 +117,69 @@ GST_START_TEST (test_parse_zerosize_frames)
 
 GST_END_TEST;
 
+static const guint8 pcapng_header[] = {
+  /* section header block, little endian */
+  0x0a, 0x0d, 0x0d, 0x0a, 0x1c, 0x00, 0x00, 0x00,
+  0x4d, 0x3c, 0x2b, 0x1a, 0x01, 0x00, 0x00, 0x00,
+  0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+  0x1c, 0x00, 0x00, 0x00,
+  /* interface description block, ethernet, nanosecond timestamps */
+  0x01, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00,
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00,
+  0x09, 0x00, 0x01, 0x00, 0x09, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0x00, 0x00,
+  /* enhanced packet block header, timestamp 1000000123 ns, 60 bytes */
+  0x06, 0x00, 0x00, 0x00, 0x5c, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x7b, 0xca, 0x9a, 0x3b, 0x3c, 0x00, 0x00, 0x00,
+  0x3c, 0x00, 0x00, 0x00
+};
+
+GST_START_TEST (test_parse_pcapng)
+{
+  const guint8 epb_trailer[] = { 0x5c, 0x00, 0x00, 0x00 };
+  const guint packet_size = sizeof (pcap_frame_with_eth_padding) - 16;
+  GstBuffer *in_buf, *out_buf;
+  GstHarness *h;
+  guint8 *data;
+  gsize size;
+
+  size = sizeof (pcapng_header) + packet_size + sizeof (epb_trailer);
+  data = g_malloc (size);
+  memcpy (data, pcapng_header, sizeof (pcapng_header));
+  memcpy (data + sizeof (pcapng_header), pcap_frame_with_eth_padding + 16,
+      packet_size);
+  memcpy (data + sizeof (pcapng_header) + packet_size, epb_trailer,
+      sizeof (epb_trailer));
+
+  h = gst_harness_new ("pcapparse");
+  gst_harness_set_src_caps_str (h, "raw/x-pcap");
+  gst_harness_play (h);
+
+  /* split in the middle of the packet block */
+  in_buf = gst_buffer_new_wrapped (data, size);
+  gst_harness_push (h, gst_buffer_copy_region (in_buf, GST_BUFFER_COPY_ALL,
+          0, 100));
+  gst_harness_push (h, gst_buffer_copy_region (in_buf, GST_BUFFER_COPY_ALL,
+          100, size - 100));
+  gst_buffer_unref (in_buf);
+
+  out_buf = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (out_buf),
+      sizeof (pcap_frame_with_eth_padding) -
+      pcap_frame_with_eth_padding_offset - 2);
+  fail_unless (gst_buffer_memcmp (out_buf, 0,
+          pcap_frame_with_eth_padding + pcap_frame_with_eth_padding_offset,
+          gst_buffer_get_size (out_buf)) == 0);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (out_buf), 1000000123);
+  fail_unless_equals_int (gst_buffer_n_memory (out_buf), 1);
+
+  gst_buffer_unref (out_buf);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
 static Suite *
 pcapparse_suite (void)
 {
@@ -133,6 +198,7 @@ pcapparse_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_parse_frames_with_eth_padding);
   tcase_add_test (tc_chain, test_parse_zerosize_frames);
+  tcase_add_test (tc_chain, test_parse_pcapng);
 
   return s;
 }
@@ -31,6 +31,8 @@
 # include <valgrind/valgrind.h>
 #endif
 
+#include <string.h>
+
 #include <gst/check/gstcheck.h>
 
 #include <gst/check/gstharness.h>
@@ -208,6 +210,89 @@ GST_START_TEST (test_roc)
 
 GST_END_TEST;
 
+#define TEST_SSRC 1356955624
+#define TEST_KEY "012345678901234567890123456789012345678901234567890123456789"
+#define TEST_NUM_PACKETS 1000
+#define TEST_PAYLOAD_SIZE 1200
+
+static GstBuffer *
+create_rtp_buffer (guint16 seqnum)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+
+  buf = gst_buffer_new_allocate (NULL, 12 + TEST_PAYLOAD_SIZE, NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  map.data[0] = 0x80;
+  map.data[1] = 8;
+  GST_WRITE_UINT16_BE (map.data + 2, seqnum);
+  GST_WRITE_UINT32_BE (map.data + 4, seqnum * 160);
+  GST_WRITE_UINT32_BE (map.data + 8, TEST_SSRC);
+  memset (map.data + 12, seqnum & 0xff, TEST_PAYLOAD_SIZE);
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+GST_START_TEST (test_dec_buffer_list)
+{
+  GstHarness *enc_h, *dec_h;
+  GstBufferList *list;
+  GstClockTime start, elapsed;
+  guint i;
+
+  enc_h = gst_harness_new_with_padnames ("srtpenc", "rtp_sink_0",
+      "rtp_src_0");
+  gst_util_set_object_arg (G_OBJECT (enc_h->element), "key", TEST_KEY);
+  gst_harness_set_src_caps_str (enc_h,
+      "application/x-rtp, payload=(int)8, ssrc=(uint)1356955624");
+
+  dec_h = gst_harness_new_with_padnames ("srtpdec", "rtp_sink", "rtp_src");
+  gst_harness_set_src_caps_str (dec_h,
+      "application/x-srtp, payload=(int)8, ssrc=(uint)1356955624, "
+      "srtp-key=(buffer)" TEST_KEY ", srtp-cipher=(string)aes-128-icm, "
+      "srtp-auth=(string)hmac-sha1-80, srtcp-cipher=(string)aes-128-icm, "
+      "srtcp-auth=(string)hmac-sha1-80");
+
+  list = gst_buffer_list_new_sized (TEST_NUM_PACKETS);
+  for (i = 0; i < TEST_NUM_PACKETS; i++) {
+    fail_unless_equals_int (gst_harness_push (enc_h, create_rtp_buffer (i)),
+        GST_FLOW_OK);
+    gst_buffer_list_add (list, gst_harness_pull (enc_h));
+  }
+
+  start = gst_util_get_timestamp ();
+  fail_unless_equals_int (gst_pad_push_list (dec_h->srcpad, list),
+      GST_FLOW_OK);
+  elapsed = gst_util_get_timestamp () - start;
+
+  GST_INFO ("Decoded %u packets of %u bytes in %" GST_TIME_FORMAT,
+      TEST_NUM_PACKETS, TEST_PAYLOAD_SIZE, GST_TIME_ARGS (elapsed));
+
+  fail_unless_equals_int (gst_harness_buffers_received (dec_h),
+      TEST_NUM_PACKETS);
+  for (i = 0; i < TEST_NUM_PACKETS; i++) {
+    GstBuffer *expected, *buf;
+    GstMapInfo map;
+
+    expected = create_rtp_buffer (i);
+    buf = gst_harness_pull (dec_h);
+    fail_unless_equals_int (gst_buffer_get_size (buf),
+        gst_buffer_get_size (expected));
+    gst_buffer_map (expected, &map, GST_MAP_READ);
+    fail_unless (gst_buffer_memcmp (buf, 0, map.data, map.size) == 0);
+    gst_buffer_unmap (expected, &map);
+
+    gst_buffer_unref (expected);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (enc_h);
+  gst_harness_teardown (dec_h);
+}
+
+GST_END_TEST;
+
 static Suite *
 srtp_suite (void)
 {
@@ -218,6 +303,7 @@ srtp_suite (void)
   tcase_add_test (tc_chain, test_create_and_unref);
   tcase_add_test (tc_chain, test_play);
   tcase_add_test (tc_chain, test_roc);
+  tcase_add_test (tc_chain, test_dec_buffer_list);
 
   return s;
 }
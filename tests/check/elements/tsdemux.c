@@ -0,0 +1,575 @@
+/* GStreamer
+ *
+ * unit test for tsdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#define TS_PACKET_SIZE 188
+#define PES_PAYLOAD_SIZE 100
+
+/* program 1 with its PMT on PID 0x100 */
+static const guint8 pat_section[] = {
+  0x00, 0xb0, 0x0d, 0x00, 0x01, 0xc1, 0x00, 0x00, 0x00, 0x01, 0xe1, 0x00,
+  0xe8, 0xf9, 0x5e, 0x7d
+};
+
+/* an MPEG-1 audio stream on PID 0x101, which also carries the PCR */
+static const guint8 pmt_section[] = {
+  0x02, 0xb0, 0x12, 0x00, 0x01, 0xc1, 0x00, 0x00, 0xe1, 0x01, 0xf0, 0x00,
+  0x03, 0xe1, 0x01, 0xf0, 0x00, 0x8d, 0xff, 0x34, 0x11
+};
+
+/* version 1 of the PMT, the audio stream moved to PID 0x102 */
+static const guint8 pmt_section_v1[] = {
+  0x02, 0xb0, 0x12, 0x00, 0x01, 0xc3, 0x00, 0x00, 0xe1, 0x02, 0xf0, 0x00,
+  0x03, 0xe1, 0x02, 0xf0, 0x00, 0x6c, 0x99, 0x62, 0xca
+};
+
+/* an H.264 stream on PID 0x101, which also carries the PCR */
+static const guint8 pmt_section_h264[] = {
+  0x02, 0xb0, 0x12, 0x00, 0x01, 0xc1, 0x00, 0x00, 0xe1, 0x01, 0xf0, 0x00,
+  0x1b, 0xe1, 0x01, 0xf0, 0x00, 0x4f, 0xc4, 0x3d, 0x1b
+};
+
+/* the file read in pull mode, a video PES every 40ms and a random access
+ * point every KEYFRAME_DISTANCE of them */
+#define N_VIDEO_PES 30
+#define KEYFRAME_DISTANCE 10
+#define LAST_KEYFRAME \
+    ((N_VIDEO_PES - 1) / KEYFRAME_DISTANCE * KEYFRAME_DISTANCE)
+static guint8 pull_data[(2 + N_VIDEO_PES) * TS_PACKET_SIZE];
+
+static GstPad *mysrcpad, *mysinkpad;
+static GstElement *demux;
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/mpegts,systemstream=(boolean)true"));
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+/* state of the downstream element, protected by the lock */
+static GMutex lock;
+static GCond cond;
+static gboolean block;
+static gboolean flushing;
+static gboolean slow;
+static GstFlowReturn chain_ret;
+static gboolean have_eos;
+static guint n_buffers;
+static guint n_buffers_at_eos;
+/* offset whose pulling upstream is waited for */
+static guint64 expected_offset;
+static gboolean have_expected_offset;
+
+static GstFlowReturn
+sink_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstFlowReturn ret;
+
+  gst_buffer_unref (buffer);
+
+  if (slow)
+    g_usleep (2000);
+
+  g_mutex_lock (&lock);
+  n_buffers++;
+  g_cond_broadcast (&cond);
+  /* like a sink waiting for its clock, only a flush unblocks it */
+  while (block && !flushing)
+    g_cond_wait (&cond, &lock);
+  if (flushing)
+    ret = GST_FLOW_FLUSHING;
+  else
+    ret = chain_ret;
+  g_mutex_unlock (&lock);
+
+  return ret;
+}
+
+static gboolean
+sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  g_mutex_lock (&lock);
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      flushing = TRUE;
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      flushing = FALSE;
+      n_buffers = 0;
+      break;
+    case GST_EVENT_EOS:
+      have_eos = TRUE;
+      n_buffers_at_eos = n_buffers;
+      break;
+    default:
+      break;
+  }
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* only the first stream is linked */
+static void
+pad_added (GstElement * element, GstPad * pad, gpointer user_data)
+{
+  if (!gst_pad_is_linked (mysinkpad))
+    fail_unless (gst_pad_link (pad, mysinkpad) == GST_PAD_LINK_OK);
+}
+
+static void
+setup (void)
+{
+  GstCaps *caps;
+
+  block = flushing = slow = have_eos = FALSE;
+  chain_ret = GST_FLOW_OK;
+  n_buffers = n_buffers_at_eos = 0;
+
+  demux = gst_check_setup_element ("tsdemux");
+  g_object_set (demux, "parallel-streams", TRUE, NULL);
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added), NULL);
+
+  mysinkpad = gst_pad_new_from_static_template (&sinktemplate, "sink");
+  gst_pad_set_chain_function (mysinkpad, sink_chain);
+  gst_pad_set_event_function (mysinkpad, sink_event);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  mysrcpad = gst_check_setup_src_pad (demux, &srctemplate);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  fail_unless (gst_element_set_state (demux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+
+  caps = gst_static_pad_template_get_caps (&srctemplate);
+  gst_check_setup_events (mysrcpad, demux, caps, GST_FORMAT_BYTES);
+  gst_caps_unref (caps);
+}
+
+static void
+teardown (void)
+{
+  g_mutex_lock (&lock);
+  block = FALSE;
+  g_cond_broadcast (&cond);
+  g_mutex_unlock (&lock);
+
+  gst_element_set_state (demux, GST_STATE_NULL);
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_check_teardown_src_pad (demux);
+  gst_check_teardown_element (demux);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_object_unref (mysinkpad);
+}
+
+static void
+write_section_packet (guint8 * data, guint16 pid, guint8 cc,
+    const guint8 * section, gsize size)
+{
+  memset (data, 0xff, TS_PACKET_SIZE);
+  data[0] = 0x47;
+  data[1] = 0x40 | (pid >> 8);
+  data[2] = pid & 0xff;
+  data[3] = 0x10 | (cc & 0x0f);
+  data[4] = 0;
+  memcpy (data + 5, section, size);
+}
+
+/* a whole PES in one packet, with a PCR and a PTS 100ms later */
+static void
+write_pes_packet (guint8 * data, guint16 pid, guint8 stream_id, guint n,
+    gboolean random_access)
+{
+  guint64 pcr = 90000 + n * 3600;
+  guint64 pts = pcr + 9000;
+  guint8 *pes;
+
+  memset (data, 0xff, TS_PACKET_SIZE);
+  data[0] = 0x47;
+  data[1] = 0x40 | (pid >> 8);
+  data[2] = pid & 0xff;
+  data[3] = 0x30 | (n & 0x0f);
+
+  /* adaptation field with the PCR, stuffed up to the PES */
+  data[4] = TS_PACKET_SIZE - 5 - 14 - PES_PAYLOAD_SIZE;
+  data[5] = random_access ? 0x50 : 0x10;
+  data[6] = pcr >> 25;
+  data[7] = pcr >> 17;
+  data[8] = pcr >> 9;
+  data[9] = pcr >> 1;
+  data[10] = ((pcr & 0x01) << 7) | 0x7e;
+  data[11] = 0;
+
+  pes = data + 5 + data[4];
+  pes[0] = 0x00;
+  pes[1] = 0x00;
+  pes[2] = 0x01;
+  pes[3] = stream_id;
+  GST_WRITE_UINT16_BE (pes + 4, 8 + PES_PAYLOAD_SIZE);
+  pes[6] = 0x80;
+  pes[7] = 0x80;
+  pes[8] = 0x05;
+  pes[9] = 0x21 | ((pts >> 29) & 0x0e);
+  pes[10] = pts >> 22;
+  pes[11] = 0x01 | ((pts >> 14) & 0xfe);
+  pes[12] = pts >> 7;
+  pes[13] = 0x01 | ((pts << 1) & 0xfe);
+  memset (pes + 14, n, PES_PAYLOAD_SIZE);
+}
+
+/* the PAT, @pmt and @n_pes audio PES starting with number @first */
+static GstBuffer *
+create_stream (const guint8 * pmt, gsize pmt_size, guint first, guint n_pes)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint i;
+
+  buffer = gst_buffer_new_allocate (NULL, (2 + n_pes) * TS_PACKET_SIZE, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  write_section_packet (map.data, 0x00, first, pat_section,
+      sizeof (pat_section));
+  write_section_packet (map.data + TS_PACKET_SIZE, 0x100, first, pmt,
+      pmt_size);
+  for (i = 0; i < n_pes; i++)
+    write_pes_packet (map.data + (2 + i) * TS_PACKET_SIZE, 0x101, 0xc0,
+        first + i, FALSE);
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static void
+wait_for_eos (void)
+{
+  g_mutex_lock (&lock);
+  while (!have_eos)
+    g_cond_wait (&cond, &lock);
+  g_mutex_unlock (&lock);
+}
+
+GST_START_TEST (test_flush_blocked_downstream)
+{
+  GstSegment segment;
+
+  block = TRUE;
+  fail_unless_equals_int (gst_pad_push (mysrcpad, create_stream (pmt_section,
+              sizeof (pmt_section), 0, 10)), GST_FLOW_OK);
+
+  /* the stream thread is stuck downstream, the sink thread isn't */
+  g_mutex_lock (&lock);
+  while (n_buffers == 0)
+    g_cond_wait (&cond, &lock);
+  g_mutex_unlock (&lock);
+  fail_unless_equals_int (gst_pad_push (mysrcpad, create_stream (pmt_section,
+              sizeof (pmt_section), 10, 10)), GST_FLOW_OK);
+
+  /* the flush unblocks downstream, the queued data is dropped */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_flush_start ()));
+  g_mutex_lock (&lock);
+  block = FALSE;
+  g_mutex_unlock (&lock);
+  fail_unless (gst_pad_push_event (mysrcpad,
+          gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_segment (&segment)));
+
+  /* and the stream thread pushes again afterwards */
+  fail_unless_equals_int (gst_pad_push (mysrcpad, create_stream (pmt_section,
+              sizeof (pmt_section), 20, 10)), GST_FLOW_OK);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  wait_for_eos ();
+  fail_unless (n_buffers_at_eos > 0);
+  fail_unless (n_buffers_at_eos <= 10);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_fatal_flow_stops_stream)
+{
+  GstFlowReturn ret;
+  guint i;
+
+  fail_unless_equals_int (gst_pad_push (mysrcpad, create_stream (pmt_section,
+              sizeof (pmt_section), 0, 5)), GST_FLOW_OK);
+
+  /* downstream stops accepting data, which is seen by the sink thread on
+   * one of the following pushes */
+  gst_pad_set_active (mysinkpad, FALSE);
+  for (i = 1; i < 20; i++) {
+    ret = gst_pad_push (mysrcpad, create_stream (pmt_section,
+            sizeof (pmt_section), i * 5, 5));
+    if (ret != GST_FLOW_OK)
+      break;
+    g_usleep (1000);
+  }
+  fail_unless_equals_int (ret, GST_FLOW_FLUSHING);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_eos_flow_forwards_eos)
+{
+  /* downstream doesn't want any more data after the first buffer */
+  chain_ret = GST_FLOW_EOS;
+  gst_pad_push (mysrcpad, create_stream (pmt_section, sizeof (pmt_section), 0,
+          10));
+
+  /* the other buffers are dropped, but the EOS still goes through */
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  wait_for_eos ();
+  fail_unless_equals_int (n_buffers_at_eos, 1);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_stream_removed_drains)
+{
+  slow = TRUE;
+  fail_unless_equals_int (gst_pad_push (mysrcpad, create_stream (pmt_section,
+              sizeof (pmt_section), 0, 10)), GST_FLOW_OK);
+
+  /* the new PMT replaces the stream, everything queued on the old one is
+   * pushed before its EOS, and before its pad goes away */
+  fail_unless_equals_int (gst_pad_push (mysrcpad,
+          create_stream (pmt_section_v1, sizeof (pmt_section_v1), 10, 0)),
+      GST_FLOW_OK);
+
+  g_mutex_lock (&lock);
+  fail_unless (have_eos);
+  fail_unless_equals_int (n_buffers_at_eos, 10);
+  g_mutex_unlock (&lock);
+  fail_if (gst_pad_is_linked (mysinkpad));
+}
+
+GST_END_TEST;
+
+static void
+create_pull_data (void)
+{
+  guint i;
+
+  write_section_packet (pull_data, 0x00, 0, pat_section, sizeof (pat_section));
+  write_section_packet (pull_data + TS_PACKET_SIZE, 0x100, 0,
+      pmt_section_h264, sizeof (pmt_section_h264));
+  for (i = 0; i < N_VIDEO_PES; i++)
+    write_pes_packet (pull_data + (2 + i) * TS_PACKET_SIZE, 0x101, 0xe0, i,
+        i % KEYFRAME_DISTANCE == 0);
+}
+
+static GstFlowReturn
+src_getrange (GstPad * pad, GstObject * parent, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  if (offset >= sizeof (pull_data))
+    return GST_FLOW_EOS;
+  length = MIN (length, sizeof (pull_data) - offset);
+
+  g_mutex_lock (&lock);
+  if (offset == expected_offset) {
+    have_expected_offset = TRUE;
+    g_cond_broadcast (&cond);
+  }
+  g_mutex_unlock (&lock);
+
+  *buffer = gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+      pull_data + offset, length, 0, length, NULL, NULL);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  gboolean res = FALSE;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_DURATION:{
+      GstFormat fmt;
+
+      gst_query_parse_duration (query, &fmt, NULL);
+      if (fmt != GST_FORMAT_BYTES)
+        break;
+
+      gst_query_set_duration (query, fmt, sizeof (pull_data));
+      res = TRUE;
+      break;
+    }
+    case GST_QUERY_SCHEDULING:{
+      gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+      res = TRUE;
+      break;
+    }
+    default:
+      break;
+  }
+
+  return res;
+}
+
+/* a tsdemux reading pull_data in pull mode */
+static void
+setup_pull (void)
+{
+  GstPad *sinkpad;
+
+  block = flushing = slow = have_eos = FALSE;
+  chain_ret = GST_FLOW_OK;
+  n_buffers = n_buffers_at_eos = 0;
+  expected_offset = -1;
+  have_expected_offset = FALSE;
+
+  demux = gst_element_factory_make ("tsdemux", NULL);
+  fail_unless (demux != NULL);
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added), NULL);
+
+  mysinkpad = gst_pad_new_from_static_template (&sinktemplate, "sink");
+  gst_pad_set_chain_function (mysinkpad, sink_chain);
+  gst_pad_set_event_function (mysinkpad, sink_event);
+  gst_pad_set_active (mysinkpad, TRUE);
+
+  mysrcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  gst_pad_set_getrange_function (mysrcpad, src_getrange);
+  gst_pad_set_query_function (mysrcpad, src_query);
+  sinkpad = gst_element_get_static_pad (demux, "sink");
+  fail_unless (gst_pad_link (mysrcpad, sinkpad) == GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  fail_unless (gst_element_set_state (demux,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS);
+}
+
+static void
+teardown_pull (void)
+{
+  gst_element_set_state (demux, GST_STATE_NULL);
+  gst_object_unref (demux);
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_object_unref (mysrcpad);
+  gst_pad_set_active (mysinkpad, FALSE);
+  gst_object_unref (mysinkpad);
+}
+
+GST_START_TEST (test_seek_table)
+{
+  const GValue *offsets, *timestamps;
+  GstStructure *table;
+  GstQuery *query;
+  guint64 offset = 0, prev_offset = 0;
+  GstClockTime ts = 0, prev_ts = 0;
+  guint i, n;
+
+  create_pull_data ();
+
+  /* the random access points are indexed while playing */
+  setup_pull ();
+  wait_for_eos ();
+  query = gst_query_new_custom (GST_QUERY_CUSTOM,
+      gst_structure_new_empty ("mpegts-seek-table"));
+  fail_unless (gst_pad_peer_query (mysinkpad, query));
+  table = gst_structure_copy (gst_query_get_structure (query));
+  gst_query_unref (query);
+  teardown_pull ();
+
+  offsets = gst_structure_get_value (table, "offsets");
+  timestamps = gst_structure_get_value (table, "timestamps");
+  fail_unless (offsets != NULL && GST_VALUE_HOLDS_ARRAY (offsets));
+  fail_unless (timestamps != NULL && GST_VALUE_HOLDS_ARRAY (timestamps));
+  n = gst_value_array_get_size (offsets);
+  fail_unless (n >= 2);
+  fail_unless_equals_int (gst_value_array_get_size (timestamps), n);
+
+  for (i = 0; i < n; i++) {
+    offset = g_value_get_uint64 (gst_value_array_get_value (offsets, i));
+    ts = g_value_get_uint64 (gst_value_array_get_value (timestamps, i));
+
+    /* only the packets starting a random access point are recorded */
+    fail_unless (offset >= 2 * TS_PACKET_SIZE);
+    fail_unless_equals_uint64 (offset % TS_PACKET_SIZE, 0);
+    fail_unless_equals_uint64 ((offset / TS_PACKET_SIZE - 2) %
+        KEYFRAME_DISTANCE, 0);
+    fail_unless (GST_CLOCK_TIME_IS_VALID (ts));
+    if (i > 0) {
+      fail_unless (offset > prev_offset);
+      fail_unless (ts > prev_ts);
+    }
+    prev_offset = offset;
+    prev_ts = ts;
+  }
+  fail_unless_equals_uint64 (offset, (2 + LAST_KEYFRAME) * TS_PACKET_SIZE);
+
+  /* a new demuxer given the table seeks straight to the last random access
+   * point, instead of interpolating from the PCR before the target */
+  setup_pull ();
+  wait_for_eos ();
+  fail_unless (gst_pad_push_event (mysinkpad,
+          gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM, table)));
+
+  g_mutex_lock (&lock);
+  have_eos = FALSE;
+  expected_offset = offset;
+  g_mutex_unlock (&lock);
+  fail_unless (gst_pad_push_event (mysinkpad, gst_event_new_seek (1.0,
+              GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET, ts,
+              GST_SEEK_TYPE_NONE, -1)));
+
+  wait_for_eos ();
+  fail_unless (have_expected_offset);
+  fail_unless (n_buffers_at_eos > 0);
+  fail_unless (n_buffers_at_eos <= N_VIDEO_PES - LAST_KEYFRAME);
+
+  teardown_pull ();
+}
+
+GST_END_TEST;
+
+static Suite *
+tsdemux_suite (void)
+{
+  Suite *s = suite_create ("tsdemux");
+  TCase *tc_chain = tcase_create ("general");
+  TCase *tc_pull = tcase_create ("pull");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_checked_fixture (tc_chain, setup, teardown);
+
+  tcase_add_test (tc_chain, test_flush_blocked_downstream);
+  tcase_add_test (tc_chain, test_fatal_flow_stops_stream);
+  tcase_add_test (tc_chain, test_eos_flow_forwards_eos);
+  tcase_add_test (tc_chain, test_stream_removed_drains);
+
+  suite_add_tcase (s, tc_pull);
+  tcase_add_test (tc_pull, test_seek_table);
+
+  return s;
+}
+
+GST_CHECK_MAIN (tsdemux);
@@ -0,0 +1,215 @@
+/* GStreamer
+ *
+ * unit test for tsparse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* for GValueArray, used by the ignored-tables property */
+#define GLIB_DISABLE_DEPRECATION_WARNINGS
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/mpegts/mpegts.h>
+
+#define TS_PACKET_SIZE 188
+
+/* program 1 with its PMT on PID 0x100 */
+static const guint8 pat_section[] = {
+  0x00, 0xb0, 0x0d, 0x00, 0x01, 0xc1, 0x00, 0x00, 0x00, 0x01, 0xe1, 0x00,
+  0xe8, 0xf9, 0x5e, 0x7d
+};
+
+/* one H.264 stream on PID 0x101 */
+static const guint8 pmt_section[] = {
+  0x02, 0xb0, 0x12, 0x00, 0x01, 0xc1, 0x00, 0x00, 0xe1, 0x01, 0xf0, 0x00,
+  0x1b, 0xe1, 0x01, 0xf0, 0x00, 0x4f, 0xc4, 0x3d, 0x1b
+};
+
+static const guint8 tdt_section[] = {
+  0x70, 0x70, 0x05, 0xc0, 0x79, 0x12, 0x45, 0x00
+};
+
+static GstBus *bus;
+
+/* a single section in a TS packet */
+static void
+write_section_packet (guint8 * data, guint16 pid, guint8 cc,
+    const guint8 * section, gsize size)
+{
+  memset (data, 0xff, TS_PACKET_SIZE);
+  data[0] = 0x47;
+  data[1] = 0x40 | (pid >> 8);
+  data[2] = pid & 0xff;
+  data[3] = 0x10 | (cc & 0x0f);
+  data[4] = 0;
+  memcpy (data + 5, section, size);
+}
+
+/* PAT, PMT and TDT, repeated a few times to let the packet size be
+ * detected */
+static GstBuffer *
+create_stream (void)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint i;
+
+  buffer = gst_buffer_new_allocate (NULL, 4 * 3 * TS_PACKET_SIZE, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (i = 0; i < 4; i++) {
+    guint8 *data = map.data + i * 3 * TS_PACKET_SIZE;
+
+    write_section_packet (data, 0x00, i, pat_section, sizeof (pat_section));
+    write_section_packet (data + TS_PACKET_SIZE, 0x100, i, pmt_section,
+        sizeof (pmt_section));
+    write_section_packet (data + 2 * TS_PACKET_SIZE, 0x14, i, tdt_section,
+        sizeof (tdt_section));
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static GstHarness *
+setup_tsparse (const guint8 * ignored_tables, guint n_ignored)
+{
+  GstHarness *h = gst_harness_new ("tsparse");
+  GValueArray *array;
+  GValue val = G_VALUE_INIT;
+  guint i;
+
+  array = g_value_array_new (n_ignored);
+  g_value_init (&val, G_TYPE_UINT);
+  for (i = 0; i < n_ignored; i++) {
+    g_value_set_uint (&val, ignored_tables[i]);
+    g_value_array_append (array, &val);
+  }
+  g_value_unset (&val);
+  g_object_set (h->element, "ignored-tables", array, NULL);
+  g_value_array_free (array);
+
+  bus = gst_bus_new ();
+  gst_element_set_bus (h->element, bus);
+
+  gst_harness_set_src_caps_str (h, "video/mpegts,systemstream=true");
+
+  return h;
+}
+
+static void
+teardown_tsparse (GstHarness * h)
+{
+  gst_element_set_bus (h->element, NULL);
+  gst_object_unref (bus);
+  gst_harness_teardown (h);
+}
+
+/* number of section messages posted, per table id */
+static void
+count_sections (guint * counts)
+{
+  GstMpegtsSection *section;
+  GstMessage *msg;
+
+  memset (counts, 0, 0x100 * sizeof (guint));
+  while ((msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT))) {
+    section = gst_message_parse_mpegts_section (msg);
+    if (section) {
+      counts[section->table_id]++;
+      gst_mpegts_section_unref (section);
+    }
+    gst_message_unref (msg);
+  }
+}
+
+GST_START_TEST (test_sections_posted)
+{
+  GstHarness *h = setup_tsparse (NULL, 0);
+  guint counts[0x100];
+
+  fail_unless_equals_int (gst_harness_push (h, create_stream ()),
+      GST_FLOW_OK);
+
+  count_sections (counts);
+  fail_unless (counts[GST_MTS_TABLE_ID_PROGRAM_ASSOCIATION] > 0);
+  fail_unless (counts[GST_MTS_TABLE_ID_TS_PROGRAM_MAP] > 0);
+  fail_unless (counts[GST_MTS_TABLE_ID_TIME_DATE] > 0);
+
+  teardown_tsparse (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_ignored_tables)
+{
+  static const guint8 ignored[] = {
+    GST_MTS_TABLE_ID_PROGRAM_ASSOCIATION, GST_MTS_TABLE_ID_TIME_DATE
+  };
+  GstHarness *h = setup_tsparse (ignored, G_N_ELEMENTS (ignored));
+  guint counts[0x100];
+
+  fail_unless_equals_int (gst_harness_push (h, create_stream ()),
+      GST_FLOW_OK);
+
+  /* the PAT is not posted but still parsed, which makes the PMT known */
+  count_sections (counts);
+  fail_unless_equals_int (counts[GST_MTS_TABLE_ID_PROGRAM_ASSOCIATION], 0);
+  fail_unless_equals_int (counts[GST_MTS_TABLE_ID_TIME_DATE], 0);
+  fail_unless (counts[GST_MTS_TABLE_ID_TS_PROGRAM_MAP] > 0);
+
+  teardown_tsparse (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_ignored_tables_property)
+{
+  static const guint8 ignored[] = { 0x4e, 0x70 };
+  GstHarness *h = setup_tsparse (ignored, G_N_ELEMENTS (ignored));
+  GValueArray *array;
+
+  g_object_get (h->element, "ignored-tables", &array, NULL);
+  fail_unless_equals_int (array->n_values, 2);
+  fail_unless_equals_int (g_value_get_uint (g_value_array_get_nth (array, 0)),
+      0x4e);
+  fail_unless_equals_int (g_value_get_uint (g_value_array_get_nth (array, 1)),
+      0x70);
+  g_value_array_free (array);
+
+  teardown_tsparse (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+tsparse_suite (void)
+{
+  Suite *s = suite_create ("tsparse");
+  TCase *tc_chain = tcase_create ("general");
+
+  gst_mpegts_initialize ();
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, test_sections_posted);
+  tcase_add_test (tc_chain, test_ignored_tables);
+  tcase_add_test (tc_chain, test_ignored_tables_property);
+
+  return s;
+}
+
+GST_CHECK_MAIN (tsparse);
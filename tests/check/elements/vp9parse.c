@@ -0,0 +1,204 @@
+/* GStreamer
+ *
+ * unit test for vp9parse
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define SRC_CAPS "video/x-vp9,width=320,height=240,framerate=25/1"
+
+/* 320x240 profile 0 key frame headers, hidden and shown, followed by a
+ * few bytes of payload */
+static const guint8 key_frame_hidden[] = {
+  0x80, 0x49, 0x83, 0x42, 0x20, 0x13, 0xf0, 0x0e, 0xf4, 0x14, 0x07, 0x80,
+  0x00, 0x04, 0x11, 0x22, 0x33, 0x00
+};
+
+static const guint8 key_frame_shown[] = {
+  0x82, 0x49, 0x83, 0x42, 0x20, 0x13, 0xf0, 0x0e, 0xf4, 0x14, 0x07, 0x80,
+  0x00, 0x04, 0x11, 0x22, 0x33, 0x00
+};
+
+/* shows the reference frame in slot 0 */
+static const guint8 show_existing_frame[] = { 0x88 };
+
+/* superframe index with one byte per frame size */
+#define SUPERFRAME_MARKER(n_frames) (0xc0 | ((n_frames) - 1))
+
+/* the hidden key frame and a shown frame in one superframe */
+static GstBuffer *
+create_superframe (guint8 first_size)
+{
+  GstBuffer *buffer;
+  guint8 index[4];
+  gsize offset = 0;
+
+  index[0] = SUPERFRAME_MARKER (2);
+  index[1] = first_size;
+  index[2] = sizeof (show_existing_frame);
+  index[3] = SUPERFRAME_MARKER (2);
+
+  buffer = gst_buffer_new_allocate (NULL, sizeof (key_frame_hidden) +
+      sizeof (show_existing_frame) + sizeof (index), NULL);
+  gst_buffer_fill (buffer, offset, key_frame_hidden,
+      sizeof (key_frame_hidden));
+  offset += sizeof (key_frame_hidden);
+  gst_buffer_fill (buffer, offset, show_existing_frame,
+      sizeof (show_existing_frame));
+  offset += sizeof (show_existing_frame);
+  gst_buffer_fill (buffer, offset, index, sizeof (index));
+
+  GST_BUFFER_PTS (buffer) = 0;
+  GST_BUFFER_DTS (buffer) = 0;
+  GST_BUFFER_DURATION (buffer) = GST_SECOND / 25;
+
+  return buffer;
+}
+
+static GstBuffer *
+create_frame (const guint8 * data, gsize size, GstClockTime pts)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, size, NULL);
+
+  gst_buffer_fill (buffer, 0, data, size);
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_DTS (buffer) = pts;
+  GST_BUFFER_DURATION (buffer) = GST_SECOND / 25;
+
+  return buffer;
+}
+
+GST_START_TEST (test_superframe_kept)
+{
+  GstHarness *h = gst_harness_new ("vp9parse");
+  GstBuffer *buffer;
+  GstCaps *caps;
+
+  gst_harness_set_src_caps_str (h, SRC_CAPS);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_superframe (sizeof (key_frame_hidden))), GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 1);
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer),
+      sizeof (key_frame_hidden) + sizeof (show_existing_frame) + 4);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 0);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY));
+  gst_buffer_unref (buffer);
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  fail_unless_equals_string (gst_structure_get_string (gst_caps_get_structure
+          (caps, 0), "alignment"), "super-frame");
+  gst_caps_unref (caps);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_superframe_split)
+{
+  GstHarness *h = gst_harness_new ("vp9parse");
+  GstBuffer *buffer;
+
+  gst_harness_set_sink_caps_str (h, "video/x-vp9,alignment=frame");
+  gst_harness_set_src_caps_str (h, SRC_CAPS);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_superframe (sizeof (key_frame_hidden))), GST_FLOW_OK);
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 2);
+
+  /* the hidden key frame is only decoded */
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer),
+      sizeof (key_frame_hidden));
+  fail_unless (gst_buffer_memcmp (buffer, 0, key_frame_hidden,
+          sizeof (key_frame_hidden)) == 0);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), GST_CLOCK_TIME_NONE);
+  fail_unless_equals_uint64 (GST_BUFFER_DTS (buffer), 0);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_unless (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY));
+  gst_buffer_unref (buffer);
+
+  /* the shown frame gets the timestamps of the superframe, without the
+   * index */
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer),
+      sizeof (show_existing_frame));
+  fail_unless (gst_buffer_memcmp (buffer, 0, show_existing_frame,
+          sizeof (show_existing_frame)) == 0);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 0);
+  fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer), GST_SECOND / 25);
+  fail_unless (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DECODE_ONLY));
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_superframe_invalid_index)
+{
+  GstHarness *h = gst_harness_new ("vp9parse");
+  GstBuffer *buffer;
+
+  gst_harness_set_sink_caps_str (h, "video/x-vp9,alignment=frame");
+  gst_harness_set_src_caps_str (h, SRC_CAPS);
+
+  /* the first frame size runs into the second frame and the index, the
+   * superframe is dropped without an error */
+  fail_unless_equals_int (gst_harness_push (h, create_superframe (200)),
+      GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 0);
+
+  /* and the stream continues */
+  fail_unless_equals_int (gst_harness_push (h, create_frame (key_frame_shown,
+              sizeof (key_frame_shown), GST_SECOND / 25)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 1);
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer),
+      sizeof (key_frame_shown));
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), GST_SECOND / 25);
+  fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+vp9parse_suite (void)
+{
+  Suite *s = suite_create ("vp9parse");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, test_superframe_kept);
+  tcase_add_test (tc_chain, test_superframe_split);
+  tcase_add_test (tc_chain, test_superframe_invalid_index);
+
+  return s;
+}
+
+GST_CHECK_MAIN (vp9parse);
@@ -0,0 +1,241 @@
+/* GStreamer
+ *
+ * unit test for webpenc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define N_FRAMES 12
+
+static void
+set_caps (GstHarness * h, gint width, gint height)
+{
+  gchar *caps;
+
+  caps = g_strdup_printf ("video/x-raw,format=I420,width=%d,height=%d,"
+      "framerate=25/1", width, height);
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (caps);
+}
+
+static GstFlowReturn
+push_frame (GstHarness * h, gint width, gint height, guint n)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  gsize size, i;
+
+  size = width * height * 3 / 2;
+  buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (i = 0; i < size; i++)
+    map.data[i] = (i * (n + 1) + n * 17) & 0xff;
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = n * GST_SECOND / 25;
+  GST_BUFFER_DURATION (buffer) = GST_SECOND / 25;
+
+  return gst_harness_push (h, buffer);
+}
+
+/* the width of a simple lossy WebP image, from its VP8 frame header */
+static gint
+webp_width (GstBuffer * buffer)
+{
+  guint8 width[2];
+
+  fail_unless (gst_buffer_memcmp (buffer, 0, "RIFF", 4) == 0);
+  fail_unless (gst_buffer_memcmp (buffer, 8, "WEBPVP8 ", 8) == 0);
+  fail_unless_equals_int (gst_buffer_extract (buffer, 26, width, 2), 2);
+
+  return GST_READ_UINT16_LE (width) & 0x3fff;
+}
+
+static GPtrArray *
+encode_frames (const gchar * launch)
+{
+  GstHarness *h = gst_harness_new_parse (launch);
+  GPtrArray *out = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_buffer_unref);
+  GstBuffer *buffer;
+  guint i;
+
+  set_caps (h, 64, 48);
+  for (i = 0; i < N_FRAMES; i++)
+    fail_unless_equals_int (push_frame (h, 64, 48, i), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buffer = gst_harness_try_pull (h)))
+    g_ptr_array_add (out, buffer);
+
+  gst_harness_teardown (h);
+
+  return out;
+}
+
+GST_START_TEST (test_threaded_matches_serial)
+{
+  GPtrArray *serial, *threaded;
+  guint i;
+
+  serial = encode_frames ("webpenc max-threads=1");
+  threaded = encode_frames ("webpenc max-threads=4");
+
+  fail_unless_equals_int (serial->len, N_FRAMES);
+  fail_unless_equals_int (threaded->len, N_FRAMES);
+
+  /* same images, output in input order */
+  for (i = 0; i < N_FRAMES; i++) {
+    GstBuffer *a = g_ptr_array_index (serial, i);
+    GstBuffer *b = g_ptr_array_index (threaded, i);
+    GstMapInfo map;
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (b), i * GST_SECOND / 25);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (a), GST_BUFFER_PTS (b));
+
+    gst_buffer_map (a, &map, GST_MAP_READ);
+    fail_unless (gst_buffer_memcmp (b, 0, map.data, map.size) == 0);
+    fail_unless_equals_uint64 (gst_buffer_get_size (b), map.size);
+    gst_buffer_unmap (a, &map);
+  }
+
+  g_ptr_array_unref (serial);
+  g_ptr_array_unref (threaded);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_caps_change_finishes_pending)
+{
+  GstHarness *h = gst_harness_new_parse ("webpenc max-threads=4");
+  GstBuffer *buffer;
+  guint i;
+
+  set_caps (h, 64, 48);
+  for (i = 0; i < 3; i++)
+    fail_unless_equals_int (push_frame (h, 64, 48, i), GST_FLOW_OK);
+
+  /* the frames queued with the old size are output before the new ones */
+  set_caps (h, 32, 16);
+  for (i = 3; i < 6; i++)
+    fail_unless_equals_int (push_frame (h, 32, 16, i), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 6);
+  for (i = 0; i < 6; i++) {
+    buffer = gst_harness_pull (h);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), i * GST_SECOND / 25);
+    fail_unless_equals_int (webp_width (buffer), i < 3 ? 64 : 32);
+    gst_buffer_unref (buffer);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_flush_discards_pending)
+{
+  GstHarness *h = gst_harness_new_parse ("webpenc max-threads=4");
+  GstBuffer *buffer;
+  GstSegment segment;
+  guint i, before_flush;
+
+  set_caps (h, 64, 48);
+  for (i = 0; i < N_FRAMES; i++)
+    fail_unless_equals_int (push_frame (h, 64, 48, i), GST_FLOW_OK);
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_start ()));
+  fail_unless (gst_harness_push_event (h, gst_event_new_flush_stop (TRUE)));
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  fail_unless (gst_harness_push_event (h, gst_event_new_segment (&segment)));
+
+  /* frames still queued at the flush are dropped */
+  before_flush = gst_harness_buffers_in_queue (h);
+  fail_unless (before_flush < N_FRAMES);
+  for (i = 0; i < before_flush; i++)
+    gst_buffer_unref (gst_harness_pull (h));
+
+  fail_unless_equals_int (push_frame (h, 64, 48, 100), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 1);
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), 100 * GST_SECOND / 25);
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* with a single thread all frames are encoded with the same picture */
+GST_START_TEST (test_lossless_yuv_reuses_picture)
+{
+  GstHarness *h = gst_harness_new_parse ("webpenc lossless=true max-threads=1");
+  GstHarness *dec = gst_harness_new ("webpdec");
+  GstBuffer *decoded[2];
+  GstMapInfo map;
+  guint i;
+
+  set_caps (h, 64, 48);
+  for (i = 0; i < 2; i++)
+    fail_unless_equals_int (push_frame (h, 64, 48, i), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+  fail_unless_equals_int (gst_harness_buffers_in_queue (h), 2);
+
+  gst_harness_set_src_caps_str (dec, "image/webp");
+  for (i = 0; i < 2; i++) {
+    fail_unless_equals_int (gst_harness_push (dec, gst_harness_pull (h)),
+        GST_FLOW_OK);
+    decoded[i] = gst_harness_pull (dec);
+  }
+
+  /* the second frame is not the ARGB conversion of the first one */
+  fail_unless_equals_uint64 (gst_buffer_get_size (decoded[0]),
+      gst_buffer_get_size (decoded[1]));
+  gst_buffer_map (decoded[0], &map, GST_MAP_READ);
+  fail_if (gst_buffer_memcmp (decoded[1], 0, map.data, map.size) == 0);
+  gst_buffer_unmap (decoded[0], &map);
+
+  gst_buffer_unref (decoded[0]);
+  gst_buffer_unref (decoded[1]);
+  gst_harness_teardown (dec);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+webpenc_suite (void)
+{
+  Suite *s = suite_create ("webpenc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, test_threaded_matches_serial);
+  tcase_add_test (tc_chain, test_caps_change_finishes_pending);
+  tcase_add_test (tc_chain, test_flush_discards_pending);
+  tcase_add_test (tc_chain, test_lossless_yuv_reuses_picture);
+
+  return s;
+}
+
+GST_CHECK_MAIN (webpenc);
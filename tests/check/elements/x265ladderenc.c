@@ -0,0 +1,123 @@
+/* GStreamer
+ *
+ * unit test for x265ladderenc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+#define N_FRAMES 10
+
+static void
+check_rendition (GstHarness * h, gint width, gint height)
+{
+  GstStructure *s;
+  GstBuffer *buffer;
+  GstCaps *caps;
+  gint w, h_;
+  gint i;
+
+  fail_unless_equals_int (gst_harness_buffers_received (h), N_FRAMES);
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  s = gst_caps_get_structure (caps, 0);
+  fail_unless (gst_structure_has_name (s, "video/x-h265"));
+  fail_unless (gst_structure_get_int (s, "width", &w));
+  fail_unless (gst_structure_get_int (s, "height", &h_));
+  fail_unless_equals_int (w, width);
+  fail_unless_equals_int (h_, height);
+  gst_caps_unref (caps);
+
+  for (i = 0; i < N_FRAMES; i++) {
+    buffer = gst_harness_pull (h);
+    fail_unless (buffer != NULL);
+    /* renditions must start with a keyframe to be switchable */
+    if (i == 0)
+      fail_if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+        gst_util_uint64_scale (1, GST_SECOND, 25));
+    gst_buffer_unref (buffer);
+  }
+}
+
+GST_START_TEST (test_encode_renditions)
+{
+  GstElement *ladder;
+  GstPad *pad0, *pad1;
+  GstHarness *h0, *h1;
+  GstBuffer *buffer;
+  gint i;
+
+  ladder = gst_element_factory_make ("x265ladderenc", NULL);
+  fail_unless (ladder != NULL);
+  gst_object_ref_sink (ladder);
+  g_object_set (ladder, "max-threads", 2, NULL);
+
+  pad0 = gst_element_get_request_pad (ladder, "src_%u");
+  pad1 = gst_element_get_request_pad (ladder, "src_%u");
+  fail_unless (pad0 != NULL && pad1 != NULL);
+  g_object_set (pad1, "width", 160, "bitrate", 256, NULL);
+
+  h0 = gst_harness_new_with_element (ladder, "sink", GST_PAD_NAME (pad0));
+  h1 = gst_harness_new_with_element (ladder, NULL, GST_PAD_NAME (pad1));
+
+  gst_harness_set_src_caps_str (h0,
+      "video/x-raw,format=(string)I420,width=(int)320,height=(int)240,"
+      "framerate=(fraction)25/1");
+
+  for (i = 0; i < N_FRAMES; i++) {
+    buffer = gst_harness_create_buffer (h0, 320 * 240 + 2 * 160 * 120);
+    gst_buffer_memset (buffer, 0, i * 8, -1);
+    GST_BUFFER_PTS (buffer) = gst_util_uint64_scale (i, GST_SECOND, 25);
+    GST_BUFFER_DURATION (buffer) = gst_util_uint64_scale (1, GST_SECOND, 25);
+    fail_unless_equals_int (gst_harness_push (h0, buffer), GST_FLOW_OK);
+  }
+
+  fail_unless (gst_harness_push_event (h0, gst_event_new_eos ()));
+
+  /* the second rendition keeps the aspect ratio of the input */
+  check_rendition (h0, 320, 240);
+  check_rendition (h1, 160, 120);
+
+  gst_harness_teardown (h1);
+  gst_harness_teardown (h0);
+
+  gst_element_release_request_pad (ladder, pad0);
+  gst_element_release_request_pad (ladder, pad1);
+  gst_object_unref (pad0);
+  gst_object_unref (pad1);
+  gst_object_unref (ladder);
+}
+
+GST_END_TEST;
+
+static Suite *
+x265ladderenc_suite (void)
+{
+  Suite *s = suite_create ("x265ladderenc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+
+  tcase_add_test (tc_chain, test_encode_renditions);
+
+  return s;
+}
+
+GST_CHECK_MAIN (x265ladderenc);
@@ -68,6 +68,16 @@ static const guint8 stt_data_check[] = {
   0xc0, 0x00, 0xc4, 0x86, 0x56, 0xa5
 };
 
+/* present/following EIT with a running event carrying a content and a
+ * registration descriptor, and a scrambled event without descriptors */
+static const guint8 eit_data_check[] = {
+  0x4e, 0xb0, 0x31, 0x00, 0x01, 0xc1, 0x00, 0x00, 0x00, 0x01, 0x00, 0x01,
+  0x00, 0x4e, 0x12, 0x34, 0xc0, 0x79, 0x12, 0x45, 0x00, 0x01, 0x30, 0x00,
+  0x80, 0x0a, 0x54, 0x02, 0x10, 0x00, 0x05, 0x04, 0x54, 0x45, 0x53, 0x54,
+  0x12, 0x35, 0xc0, 0x79, 0x14, 0x15, 0x00, 0x00, 0x45, 0x30, 0x30, 0x00,
+  0xc3, 0x99, 0x7a, 0xba
+};
+
 GST_START_TEST (test_mpegts_pat)
 {
   GstMpegtsPatProgram *program;
@@ -560,6 +570,117 @@ GST_START_TEST (test_mpegts_dvb_descriptors)
 
 GST_END_TEST;
 
+GST_START_TEST (test_mpegts_descriptor_iter)
+{
+  GstMpegtsDescriptorIter iter;
+  GstMpegtsDescriptor desc;
+  guint8 data[sizeof (registration_descriptor) +
+      sizeof (network_name_descriptor)];
+  gchar *string;
+
+  memcpy (data, registration_descriptor, sizeof (registration_descriptor));
+  memcpy (data + sizeof (registration_descriptor), network_name_descriptor,
+      sizeof (network_name_descriptor));
+
+  gst_mpegts_descriptor_iter_init (&iter, data, sizeof (data));
+
+  fail_unless (gst_mpegts_descriptor_iter_next (&iter, &desc));
+  fail_unless (desc.tag == 0x05);
+  fail_unless (desc.length == 4);
+  fail_unless (desc.data == data);
+
+  /* descriptors point into the iterated buffer and can be parsed */
+  fail_unless (gst_mpegts_descriptor_iter_next (&iter, &desc));
+  fail_unless (desc.tag == 0x40);
+  fail_unless (desc.data == data + sizeof (registration_descriptor));
+  fail_unless (gst_mpegts_descriptor_parse_dvb_network_name (&desc, &string));
+  fail_unless (strcmp (string, "Name") == 0);
+  g_free (string);
+
+  fail_if (gst_mpegts_descriptor_iter_next (&iter, &desc));
+
+  /* truncated descriptor */
+  gst_mpegts_descriptor_iter_init (&iter, data, sizeof (data) - 1);
+  fail_unless (gst_mpegts_descriptor_iter_next (&iter, &desc));
+  fail_if (gst_mpegts_descriptor_iter_next (&iter, &desc));
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_mpegts_eit_event_iter)
+{
+  GstMpegtsSection *section;
+  GstMpegtsEITEventIter iter;
+  GstMpegtsDescriptorIter desc_iter;
+  GstMpegtsDescriptor desc;
+  GstMpegtsRunningStatus running_status;
+  GstDateTime *start_time;
+  guint16 event_id;
+  guint32 duration;
+  gboolean free_CA_mode;
+  guint8 *data;
+
+  data = g_memdup (eit_data_check, sizeof (eit_data_check));
+  section = gst_mpegts_section_new (0x12, data, sizeof (eit_data_check));
+  fail_unless (section->section_type == GST_MPEGTS_SECTION_EIT);
+
+  fail_unless (gst_mpegts_section_eit_event_iter_init (section, &iter));
+
+  fail_unless (gst_mpegts_eit_event_iter_next (&iter, &event_id, &start_time,
+          &duration, &running_status, &free_CA_mode, &desc_iter));
+  fail_unless (event_id == 0x1234);
+  fail_unless (gst_date_time_get_year (start_time) == 1993);
+  fail_unless (gst_date_time_get_month (start_time) == 10);
+  fail_unless (gst_date_time_get_day (start_time) == 13);
+  fail_unless (gst_date_time_get_hour (start_time) == 12);
+  fail_unless (gst_date_time_get_minute (start_time) == 45);
+  gst_date_time_unref (start_time);
+  fail_unless (duration == 90 * 60);
+  fail_unless (running_status == GST_MPEGTS_RUNNING_STATUS_RUNNING);
+  fail_if (free_CA_mode);
+
+  /* the descriptors are read from the section data */
+  fail_unless (gst_mpegts_descriptor_iter_next (&desc_iter, &desc));
+  fail_unless (desc.tag == 0x54);
+  fail_unless (desc.length == 2);
+  fail_unless (desc.data == section->data + 26);
+  fail_unless (gst_mpegts_descriptor_iter_next (&desc_iter, &desc));
+  fail_unless (desc.tag == 0x05);
+  fail_unless (desc.length == 4);
+  fail_unless (memcmp (desc.data + 2, "TEST", 4) == 0);
+  fail_if (gst_mpegts_descriptor_iter_next (&desc_iter, &desc));
+
+  /* all fields are optional */
+  fail_unless (gst_mpegts_eit_event_iter_next (&iter, &event_id, NULL,
+          &duration, &running_status, &free_CA_mode, &desc_iter));
+  fail_unless (event_id == 0x1235);
+  fail_unless (duration == 45 * 60 + 30);
+  fail_unless (running_status == GST_MPEGTS_RUNNING_STATUS_NOT_RUNNING);
+  fail_unless (free_CA_mode);
+  fail_if (gst_mpegts_descriptor_iter_next (&desc_iter, &desc));
+
+  fail_if (gst_mpegts_eit_event_iter_next (&iter, NULL, NULL, NULL, NULL,
+          NULL, NULL));
+
+  /* the same events as the parsed table */
+  fail_unless (gst_mpegts_section_get_eit (section)->events->len == 2);
+  fail_unless (gst_mpegts_section_eit_event_iter_init (section, &iter));
+  fail_unless (gst_mpegts_eit_event_iter_next (&iter, &event_id, NULL, NULL,
+          NULL, NULL, NULL));
+  fail_unless (event_id == 0x1234);
+
+  gst_mpegts_section_unref (section);
+
+  /* corrupted CRC */
+  data = g_memdup (eit_data_check, sizeof (eit_data_check));
+  data[20] ^= 0xff;
+  section = gst_mpegts_section_new (0x12, data, sizeof (eit_data_check));
+  fail_if (gst_mpegts_section_eit_event_iter_init (section, &iter));
+  gst_mpegts_section_unref (section);
+}
+
+GST_END_TEST;
+
 static Suite *
 mpegts_suite (void)
 {
@@ -577,6 +698,8 @@ mpegts_suite (void)
   tcase_add_test (tc_chain, test_mpegts_atsc_stt);
   tcase_add_test (tc_chain, test_mpegts_descriptors);
   tcase_add_test (tc_chain, test_mpegts_dvb_descriptors);
+  tcase_add_test (tc_chain, test_mpegts_descriptor_iter);
+  tcase_add_test (tc_chain, test_mpegts_eit_event_iter);
 
   return s;
 }